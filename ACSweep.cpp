@@ -0,0 +1,162 @@
+#include "ACSweep.h"
+#include "BlockLU.h"
+#include "Parallel.h"
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+std::vector<double> sweepFrequencies(SweepType type, size_t points, double fstart, double fstop) {
+    if (points == 0 || fstart <= 0 || fstop < fstart) {
+        throw std::invalid_argument("Sweep needs points > 0 and 0 < fstart <= fstop.");
+    }
+
+    std::vector<double> freqs;
+    if (type == SweepType::Linear) {
+        double step = points > 1 ? (fstop - fstart) / (points - 1) : 0;
+        for (size_t k = 0; k < points; k++) freqs.push_back(fstart + k * step);
+        return freqs;
+    }
+
+    double base = type == SweepType::Decade ? 10.0 : 2.0;
+    double ratio = std::pow(base, 1.0 / points);
+    size_t total = static_cast<size_t>(std::floor(std::log(fstop / fstart) / std::log(ratio) + 1e-9)) + 1;
+    for (size_t k = 0; k < total; k++) freqs.push_back(fstart * std::pow(ratio, static_cast<double>(k)));
+    return freqs;
+}
+
+// Union of the G and C patterns, both summed into the aligned value arrays
+
+FrequencyPattern::FrequencyPattern(const NumericSystem& sys, unsigned threads) : n(sys.size()) {
+    TripletMatrix<double> both(n, n);
+    both.reserve(sys.G.entries() + sys.C.entries());
+    for (size_t k = 0; k < sys.G.entries(); k++) both.add(sys.G.row(k), sys.G.col(k), 0.0);
+    for (size_t k = 0; k < sys.C.entries(); k++) both.add(sys.C.row(k), sys.C.col(k), 0.0);
+    SparseMatrix<double> pattern = SparseMatrix<double>::fromTriplets(both, threads);
+
+    col_ptr = pattern.colPtr();
+    row_idx = pattern.rowIdx();
+
+    // Position of (i, j) in the pattern, columns are short so a linear scan is enough
+    auto position = [&](int i, int j) {
+        for (int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+            if (row_idx[p] == i) return p;
+        }
+        throw std::logic_error("Entry missing from the frequency pattern.");
+    };
+    g_pos.resize(sys.G.entries());
+    c_pos.resize(sys.C.entries());
+    for (size_t k = 0; k < sys.G.entries(); k++) g_pos[k] = position(sys.G.row(k), sys.G.col(k));
+    for (size_t k = 0; k < sys.C.entries(); k++) c_pos[k] = position(sys.C.row(k), sys.C.col(k));
+    refill(sys);
+}
+
+// Stamps come in a fixed order for one topology, matching counts and rows are the same stamps
+
+bool FrequencyPattern::refill(const NumericSystem& sys) {
+    if (sys.size() != n || sys.G.entries() != g_pos.size() || sys.C.entries() != c_pos.size()) return false;
+    for (size_t k = 0; k < g_pos.size(); k++) {
+        if (row_idx[g_pos[k]] != sys.G.row(k)) return false;
+    }
+    for (size_t k = 0; k < c_pos.size(); k++) {
+        if (row_idx[c_pos[k]] != sys.C.row(k)) return false;
+    }
+    g.assign(row_idx.size(), 0.0);
+    c.assign(row_idx.size(), 0.0);
+    for (size_t k = 0; k < g_pos.size(); k++) g[g_pos[k]] += sys.G.value(k);
+    for (size_t k = 0; k < c_pos.size(); k++) c[c_pos[k]] += sys.C.value(k);
+    return true;
+}
+
+SparseMatrix<std::complex<double>> FrequencyPattern::makeMatrix() const {
+    return SparseMatrix<std::complex<double>>(n, n, col_ptr, row_idx);
+}
+
+void FrequencyPattern::assemble(double omega, SparseMatrix<std::complex<double>>& A) const {
+    assemble(std::complex<double>(0.0, omega), A);
+}
+
+// Complex values are written as interleaved real and imaginary parts, plain double arithmetic
+// without branches that the compiler turns into SIMD code
+
+void FrequencyPattern::assemble(std::complex<double> s, SparseMatrix<std::complex<double>>& A) const {
+    double* values = reinterpret_cast<double*>(A.getValues().data());
+    const double* gv = g.data();
+    const double* cv = c.data();
+    const double re = s.real(), im = s.imag();
+    size_t count = g.size();
+    for (size_t p = 0; p < count; p++) {
+        values[2 * p] = gv[p] + re * cv[p];
+        values[2 * p + 1] = im * cv[p];
+    }
+}
+
+SparseMatrix<double> FrequencyPattern::combine(double alpha) const {
+    SparseMatrix<double> A(n, n, col_ptr, row_idx);
+    combine(alpha, A);
+    return A;
+}
+
+void FrequencyPattern::combine(double alpha, SparseMatrix<double>& A) const {
+    double* values = A.getValues().data();
+    const double* gv = g.data();
+    const double* cv = c.data();
+    size_t count = g.size();
+    for (size_t p = 0; p < count; p++) values[p] = gv[p] + alpha * cv[p];
+}
+
+SweepFactors::SweepFactors(const FrequencyPattern& pattern, std::shared_ptr<const LUAnalysis> analysis, double omega,
+    size_t points, size_t chunk, unsigned threads) {
+    unsigned workers = parallelWorkers(points, chunk, threads);
+    lus.reserve(workers);
+    matrices.reserve(workers);
+    matrices.push_back(pattern.makeMatrix());
+    pattern.assemble(omega, matrices[0]);
+    lus.emplace_back(std::move(analysis));
+    lus[0].factorize(matrices[0]);
+    for (unsigned w = 1; w < workers; w++) {
+        lus.push_back(lus[0]);
+        matrices.push_back(matrices[0]);
+    }
+}
+
+ACSweepResult runACSweep(const NumericSystem& sys, const std::vector<double>& frequencies,
+    const std::vector<int>& outputs, unsigned threads) {
+    const double two_pi = 2.0 * std::acos(-1.0);
+    auto start = std::chrono::steady_clock::now();
+
+    ACSweepResult result;
+    result.frequencies = frequencies;
+    result.outputs = outputs;
+    result.values.assign(frequencies.size() * outputs.size(), 0.0);
+    if (frequencies.empty()) return result;
+
+    for (int idx : outputs) {
+        if (idx >= static_cast<int>(sys.size())) throw std::out_of_range("Sweep output outside of the system.");
+    }
+
+    // One symbolic pass: pattern, block form and ordering, pivots from the first point
+    FrequencyPattern pattern(sys);
+    auto analysis = std::make_shared<const LUAnalysis>(analyzePattern(pattern.size(), pattern.colPtr(), pattern.rowIdx()));
+    constexpr size_t chunk = 16;
+    SweepFactors factors(pattern, analysis, two_pi * frequencies[0], frequencies.size(), chunk, threads);
+    std::vector<std::vector<std::complex<double>>> rhs(factors.lus.size());
+
+    parallelFor(frequencies.size(), chunk, threads, [&](size_t begin, size_t end, unsigned id) {
+        auto& lu = factors.lus[id];
+        auto& A = factors.matrices[id];
+        auto& x = rhs[id];
+        for (size_t k = begin; k < end; k++) {
+            pattern.assemble(two_pi * frequencies[k], A);
+            if (!lu.refactor(A)) lu.factorize(A); // Pivot became too small, search again
+
+            x.assign(sys.rhs.begin(), sys.rhs.end());
+            lu.solve(x);
+
+            std::complex<double>* row = &result.values[k * outputs.size()];
+            for (size_t o = 0; o < outputs.size(); o++) row[o] = outputs[o] >= 0 ? x[outputs[o]] : 0.0;
+        }
+    });
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "BlockLU.h"
+#include "NumericSystem.h"
+#include "SparseMatrix.h"
+#include <complex>
+#include <vector>
+
+enum class SweepType
+{
+	Linear,
+	Decade,
+	Octave
+};
+
+// Sweep points like SPICE .ac, in Hz
+// Linear takes the total number of points, Decade and Octave the points per decade / octave
+std::vector<double> sweepFrequencies(SweepType type, size_t points, double fstart, double fstop);
+
+// G and C merged onto one CSC pattern
+// A(w) = G + jwC (or G + alpha * C for transient steps) is then formed entry by entry without touching the structure.
+// The place of every stamp in the pattern is kept, new values of the same stamps refill it without sorting.
+
+class FrequencyPattern
+{
+	size_t n = 0;
+	std::vector<int> col_ptr, row_idx;
+	std::vector<double> g, c;         // Aligned with row_idx
+	std::vector<int> g_pos, c_pos;    // Pattern entry of every G and C triplet
+
+public:
+	explicit FrequencyPattern(const NumericSystem& sys, unsigned threads = 1);
+
+	// Takes the values of sys, false if its stamps don't match the ones the pattern was built from
+	bool refill(const NumericSystem& sys);
+
+	size_t size() const { return n; }
+	size_t nonZeros() const { return row_idx.size(); }
+	const std::vector<int>& colPtr() const { return col_ptr; }
+	const std::vector<int>& rowIdx() const { return row_idx; }
+
+	SparseMatrix<std::complex<double>> makeMatrix() const; // Pattern only, zero values
+	void assemble(double omega, SparseMatrix<std::complex<double>>& A) const;
+	void assemble(std::complex<double> s, SparseMatrix<std::complex<double>>& A) const; // G + s * C
+
+	// Real G + alpha * C on the same pattern
+	SparseMatrix<double> combine(double alpha) const;
+	void combine(double alpha, SparseMatrix<double>& A) const;
+};
+
+// Factors for a parallel loop over frequency points, shared by the sweep, sensitivity and noise analyses
+// The pivots come from one factorization at omega, the first point. Every worker that
+// parallelFor(points, chunk, threads) runs gets its own copy of the factors and of the matrix it refactors,
+// worker 0 takes the original
+
+struct SweepFactors
+{
+	std::vector<BlockLU<std::complex<double>>> lus;
+	std::vector<SparseMatrix<std::complex<double>>> matrices;
+
+	SweepFactors(const FrequencyPattern& pattern, std::shared_ptr<const LUAnalysis> analysis, double omega,
+		size_t points, size_t chunk, unsigned threads);
+};
+
+// Frequency x requested unknowns, row major
+
+struct ACSweepResult
+{
+	std::vector<double> frequencies; // Hz
+	std::vector<int> outputs;        // MNA unknown of every column, -1 is ground
+	std::vector<std::complex<double>> values;
+	double seconds = 0;
+
+	std::complex<double> at(size_t point, size_t output) const { return values[point * outputs.size() + output]; }
+	double pointsPerSecond() const { return seconds > 0 ? frequencies.size() / seconds : 0; }
+};
+
+// Ordering and pivot sequence come from the first point and are shared by every worker,
+// the rest of the points only refactor numerically and solve
+ACSweepResult runACSweep(const NumericSystem& sys, const std::vector<double>& frequencies,
+	const std::vector<int>& outputs, unsigned threads = 0);
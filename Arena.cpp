@@ -0,0 +1,132 @@
+#include "Arena.h"
+#include "Topology.h"
+#include "Parallel.h"
+
+namespace {
+
+// Stamps of one pool, or of the elements outside the arena. Slot k is element ids[k], it stamped the G
+// entries g_at[k] .. g_at[k + 1] - 1 of the buffer and likewise for C and the rhs terms
+
+struct Batch
+{
+    NumericSystem buffer;
+    std::vector<int> ids;
+    std::vector<size_t> g_at, c_at, rhs_at;
+
+    explicit Batch(size_t size) : buffer(NumericSystem::buffer(size)) {}
+
+    void open(int id) {
+        ids.push_back(id);
+        g_at.push_back(buffer.G.entries());
+        c_at.push_back(buffer.C.entries());
+        rhs_at.push_back(buffer.rhs_terms.size());
+    }
+
+    void close() {
+        g_at.push_back(buffer.G.entries());
+        c_at.push_back(buffer.C.entries());
+        rhs_at.push_back(buffer.rhs_terms.size());
+    }
+};
+
+// One loop per type, stampAt() is inlined and the objects are read in memory order
+template <typename T>
+void stampPool(const ArenaPool<T>& pool, const int* terminal_ptr, const int* terminals, Batch& batch) {
+    batch.ids.reserve(pool.size());
+    pool.forEachRun([&](const T* first, size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            int id = first[k].getElementIndex();
+            batch.open(id); // Slot k of the batch is slot k of the pool
+            if (id >= 0) first[k].stampAt(batch.buffer, terminals + terminal_ptr[id]); // Else addComponent() threw
+        }
+    });
+    batch.close();
+}
+
+template <typename Pools, size_t... I>
+void stampPools(const Pools& pools, size_t type, const int* terminal_ptr, const int* terminals, Batch& batch, std::index_sequence<I...>) {
+    ((type == I ? stampPool(std::get<I>(pools), terminal_ptr, terminals, batch) : void()), ...);
+}
+
+template <typename Pools, size_t... I>
+void stampOne(const Pools& pools, std::pair<unsigned, unsigned> at, const int* nodes, NumericSystem& sys, std::index_sequence<I...>) {
+    ((at.first == I ? std::get<I>(pools)[at.second].stampAt(sys, nodes) : void()), ...);
+}
+
+} // namespace
+
+void ElementArena::stamp(const Topology& topology, NumericSystem& sys, unsigned threads) const {
+    const auto& elements = topology.elementHandles();
+    const int* terminal_ptr = topology.terminalPtr().data();
+    const int* terminals = topology.terminalNodes().data();
+    size_t count = elements.size();
+    auto sequence = std::make_index_sequence<type_count>();
+    std::vector<std::pair<unsigned, unsigned>> where(located.begin(), located.begin() + std::min(located.size(), count));
+    where.resize(count, { static_cast<unsigned>(type_count), 0u });
+
+    if (threads <= 1) {
+        // In id order straight into sys, a serial stamp with the kernels called directly
+        sys.element_g.reserve(count + 1);
+        sys.element_c.reserve(count + 1);
+        for (size_t e = 0; e < count; e++) {
+            sys.element_g.push_back(sys.G.entries());
+            sys.element_c.push_back(sys.C.entries());
+            if (where[e].first < type_count) stampOne(pools, where[e], terminals + terminal_ptr[e], sys, sequence);
+            else elements[e]->stampNumeric(sys);
+        }
+        sys.element_g.push_back(sys.G.entries());
+        sys.element_c.push_back(sys.C.entries());
+        return;
+    }
+
+    // One worker per pool, the elements outside the arena go through the virtual call into the last batch
+    std::vector<Batch> batches(type_count + 1, Batch(sys.size()));
+    parallelFor(type_count + 1, 1, threads, [&](size_t b, size_t, unsigned) {
+        Batch& batch = batches[b];
+        if (b < type_count) {
+            stampPools(pools, b, terminal_ptr, terminals, batch, sequence);
+            return;
+        }
+        for (size_t e = 0; e < count; e++) {
+            if (where[e].first < type_count) continue;
+            batch.open(static_cast<int>(e));
+            elements[e]->stampNumeric(batch.buffer);
+        }
+        batch.close();
+    });
+
+    // Batch and slot of every element, its slice goes where a serial stamp would have put it
+    const Batch& rest = batches[type_count];
+    for (size_t k = 0; k < rest.ids.size(); k++) where[rest.ids[k]].second = static_cast<unsigned>(k);
+
+    sys.element_g.resize(count + 1);
+    sys.element_c.resize(count + 1);
+    size_t g = 0, c = 0;
+    for (size_t e = 0; e < count; e++) {
+        const Batch& batch = batches[where[e].first];
+        size_t k = where[e].second;
+        sys.element_g[e] = g;
+        sys.element_c[e] = c;
+        g += batch.g_at[k + 1] - batch.g_at[k];
+        c += batch.c_at[k + 1] - batch.c_at[k];
+    }
+    sys.element_g[count] = g;
+    sys.element_c[count] = c;
+
+    sys.G.resizeEntries(g);
+    sys.C.resizeEntries(c);
+    parallelFor(count, 4096, threads, [&](size_t begin, size_t end, unsigned) {
+        for (size_t e = begin; e < end; e++) {
+            const Batch& batch = batches[where[e].first];
+            size_t k = where[e].second;
+            sys.G.place(sys.element_g[e], batch.buffer.G, batch.g_at[k], batch.g_at[k + 1]);
+            sys.C.place(sys.element_c[e], batch.buffer.C, batch.c_at[k], batch.c_at[k + 1]);
+        }
+    });
+
+    for (size_t e = 0; e < count; e++) {
+        const Batch& batch = batches[where[e].first];
+        size_t k = where[e].second;
+        for (size_t t = batch.rhs_at[k]; t < batch.rhs_at[k + 1]; t++) sys.addRHS(batch.buffer.rhs_terms[t].first, batch.buffer.rhs_terms[t].second);
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include "DiscreteComponents.h"
+#include "TwoPorts.h"
+#include "NumericSystem.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class Topology;
+
+// Bump allocated storage for the elements of one concrete type
+// Objects are placed back to back in chunks of chunk_objects. Chunks never move, so addresses stay valid
+// while the pool grows, and nothing is freed before the pool, which destroys every object.
+
+template <typename T>
+class ArenaPool
+{
+	static constexpr size_t chunk_objects = 1024;
+	struct Chunk { alignas(T) unsigned char bytes[chunk_objects * sizeof(T)]; };
+
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	size_t count = 0;
+
+	T* slot(size_t k) const {
+		return std::launder(reinterpret_cast<T*>(chunks[k / chunk_objects]->bytes + (k % chunk_objects) * sizeof(T)));
+	}
+
+public:
+	ArenaPool() = default;
+	ArenaPool(const ArenaPool&) = delete;
+	ArenaPool& operator=(const ArenaPool&) = delete;
+	~ArenaPool() {
+		for (size_t k = count; k-- > 0;) slot(k)->~T();
+	}
+
+	template <typename... Args>
+	T* emplace(Args&&... args) {
+		if (count == chunks.size() * chunk_objects) chunks.push_back(std::unique_ptr<Chunk>(new Chunk));
+		T* object = new (chunks.back()->bytes + (count % chunk_objects) * sizeof(T)) T(std::forward<Args>(args)...);
+		count++;
+		return object;
+	}
+
+	size_t size() const { return count; }
+	const T& operator[](size_t k) const { return *slot(k); }
+
+	// body(first, n) for every run of n objects next to each other in memory
+	template <typename Body>
+	void forEachRun(Body body) const {
+		for (size_t c = 0; c < chunks.size(); c++) {
+			size_t n = std::min(chunk_objects, count - c * chunk_objects);
+			body(std::launder(reinterpret_cast<const T*>(chunks[c]->bytes)), n);
+		}
+	}
+};
+
+// Elements of the linear types below, one pool per concrete type, see Circuit::emplace()
+// Numeric stamps call the inline stampAt() kernel of the type on the terminal ids of the topology: no virtual
+// call and no node handles. Parallel assembly runs one loop per type over its pool, the objects of a type in a
+// row. Elements of other types stamp through stampNumeric() as before.
+
+class ElementArena
+{
+	using Types = std::tuple<Resistor, Capacitor, Inductor, VoltageSource, CurrentSource, VCVS, CCVS, VCCS, CCCS>;
+
+	template <typename Tuple> struct PoolsOf;
+	template <typename... Ts> struct PoolsOf<std::tuple<Ts...>> { using type = std::tuple<ArenaPool<Ts>...>; };
+	template <typename T, typename Tuple> struct Contains;
+	template <typename T, typename... Ts> struct Contains<T, std::tuple<Ts...>> : std::bool_constant<(std::is_same_v<T, Ts> || ...)> {};
+
+	template <typename T, typename Tuple> struct IndexOf;
+	template <typename T, typename... Ts> struct IndexOf<T, std::tuple<T, Ts...>> : std::integral_constant<unsigned, 0> {};
+	template <typename T, typename U, typename... Ts> struct IndexOf<T, std::tuple<U, Ts...>>
+		: std::integral_constant<unsigned, 1 + IndexOf<T, std::tuple<Ts...>>::value> {};
+
+	typename PoolsOf<Types>::type pools;
+	std::vector<std::pair<unsigned, unsigned>> located; // Pool and slot by element id, type_count if not in the arena
+	size_t count = 0;
+	std::mutex mutex;
+
+public:
+	static constexpr size_t type_count = std::tuple_size_v<Types>;
+
+	template <typename T>
+	static constexpr bool holds = Contains<T, Types>::value;
+
+	// Both are safe to call from several threads, like Circuit::addComponent(). create() returns the object
+	// and its slot, bind() records the element id the topology gave it
+	template <typename T, typename... Args>
+	std::pair<T*, unsigned> create(Args&&... args) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& pool = std::get<ArenaPool<T>>(pools);
+		unsigned slot = static_cast<unsigned>(pool.size());
+		return { pool.emplace(std::forward<Args>(args)...), slot };
+	}
+
+	template <typename T>
+	void bind(int element, unsigned slot) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (located.size() <= static_cast<size_t>(element)) located.resize(element + 1, { static_cast<unsigned>(type_count), 0u });
+		located[element] = { IndexOf<T, Types>::value, slot };
+		count++;
+	}
+
+	size_t size() const { return count; } // Elements bound to a circuit
+
+	// Stamps every element of the topology into sys, arena elements through their kernel and the others
+	// through stampNumeric(). One thread stamps in id order. More stamp the pools side by side into one buffer
+	// each and put the element slices together in id order, so sys (element offsets included) is the one of a
+	// serial stamp bit for bit
+	void stamp(const Topology& topology, NumericSystem& sys, unsigned threads) const;
+};
@@ -0,0 +1,322 @@
+#include "BlockLU.h"
+#include "Ordering.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// Symbolic phase
+// 1. maximum transversal puts a nonzero on every diagonal, or proves there is none
+// 2. strongly connected components of the matched pattern give block upper triangular form
+// 3. approximate minimum degree inside every block keeps the fill of its LU low
+
+LUAnalysis analyzePattern(size_t n, const std::vector<int>& col_ptr, const std::vector<int>& row_idx) {
+    if (col_ptr.size() != n + 1) {
+        throw std::invalid_argument("Pattern does not match the matrix size.");
+    }
+
+    LUAnalysis an;
+    an.n = n;
+    an.nnz = row_idx.size();
+
+    std::vector<int> match;
+    an.structural_rank = maximumTransversal(n, col_ptr, row_idx, match);
+    std::vector<int> row_match(n, -1);
+    for (size_t j = 0; j < n; j++) {
+        if (match[j] >= 0) row_match[match[j]] = static_cast<int>(j);
+    }
+
+    if (an.isStructurallySingular()) {
+        // Alternating paths from the unmatched columns (column -> its rows -> their matched columns)
+        std::vector<char> seen(n, 0);
+        std::vector<int> queue;
+        for (size_t j = 0; j < n; j++) {
+            if (match[j] == -1) { seen[j] = 1; queue.push_back(static_cast<int>(j)); }
+        }
+        for (size_t h = 0; h < queue.size(); h++) {
+            int j = queue[h];
+            for (int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+                int jj = row_match[row_idx[p]];
+                if (jj >= 0 && !seen[jj]) { seen[jj] = 1; queue.push_back(jj); }
+            }
+        }
+        an.singular_cols = queue;
+        std::sort(an.singular_cols.begin(), an.singular_cols.end());
+
+        // Same from the unmatched rows, over the rows of the pattern
+        std::vector<int> t_ptr(n + 1, 0), t_idx(row_idx.size());
+        for (int i : row_idx) t_ptr[i + 1]++;
+        for (size_t i = 0; i < n; i++) t_ptr[i + 1] += t_ptr[i];
+        std::vector<int> fill(t_ptr.begin(), t_ptr.end() - 1);
+        for (size_t j = 0; j < n; j++) {
+            for (int p = col_ptr[j]; p < col_ptr[j + 1]; p++) t_idx[fill[row_idx[p]]++] = static_cast<int>(j);
+        }
+        std::fill(seen.begin(), seen.end(), 0);
+        queue.clear();
+        for (size_t i = 0; i < n; i++) {
+            if (row_match[i] == -1) { seen[i] = 1; queue.push_back(static_cast<int>(i)); }
+        }
+        for (size_t h = 0; h < queue.size(); h++) {
+            int i = queue[h];
+            for (int p = t_ptr[i]; p < t_ptr[i + 1]; p++) {
+                int ii = match[t_idx[p]];
+                if (ii >= 0 && !seen[ii]) { seen[ii] = 1; queue.push_back(ii); }
+            }
+        }
+        an.singular_rows = queue;
+        std::sort(an.singular_rows.begin(), an.singular_rows.end());
+
+        // Pair the leftovers so the permutations are still complete, factorize() refuses anyway
+        size_t free_row = 0;
+        for (size_t j = 0; j < n; j++) {
+            if (match[j] != -1) continue;
+            while (row_match[free_row] != -1) free_row++;
+            match[j] = static_cast<int>(free_row);
+            row_match[free_row] = static_cast<int>(j);
+        }
+    }
+
+    // Matched pattern: row i of A becomes row row_match[i], the diagonal is the matching
+    std::vector<int> matched_idx(row_idx.size());
+    for (size_t p = 0; p < row_idx.size(); p++) matched_idx[p] = row_match[row_idx[p]];
+    std::vector<int> order = stronglyConnectedBlocks(n, col_ptr, matched_idx, an.block_ptr);
+
+    // Order inside every block, on the block's own pattern
+    size_t block_count = an.block_ptr.size() - 1;
+    std::vector<int> position(n);
+    for (size_t k = 0; k < n; k++) position[order[k]] = static_cast<int>(k);
+    std::vector<int> local_ptr, local_idx;
+    for (size_t b = 0; b < block_count; b++) {
+        int begin = an.block_ptr[b], end = an.block_ptr[b + 1];
+        if (end - begin < 3) continue;
+        local_ptr.assign(1, 0);
+        local_idx.clear();
+        for (int k = begin; k < end; k++) {
+            int j = order[k];
+            for (int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+                int r = position[matched_idx[p]];
+                if (r >= begin) local_idx.push_back(r - begin);
+            }
+            local_ptr.push_back(static_cast<int>(local_idx.size()));
+        }
+        std::vector<int> local = approximateMinimumDegree(end - begin, local_ptr, local_idx);
+        std::vector<int> block(order.begin() + begin, order.begin() + end);
+        for (int k = 0; k < end - begin; k++) order[begin + k] = block[local[k]];
+    }
+
+    an.col_perm = order;
+    an.row_perm.resize(n);
+    for (size_t k = 0; k < n; k++) {
+        an.row_perm[k] = match[order[k]];
+        position[order[k]] = static_cast<int>(k);
+    }
+
+    // Scatter maps from A into the diagonal blocks and the off-diagonal part
+    std::vector<int> row_position(n);
+    for (size_t k = 0; k < n; k++) row_position[an.row_perm[k]] = static_cast<int>(k);
+    an.blocks.resize(block_count);
+    an.off_ptr.assign(1, 0);
+    for (size_t b = 0; b < block_count; b++) {
+        int begin = an.block_ptr[b], end = an.block_ptr[b + 1];
+        auto& block = an.blocks[b];
+        block.col_ptr.assign(1, 0);
+        for (int k = begin; k < end; k++) {
+            int j = an.col_perm[k];
+            for (int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+                int r = row_position[row_idx[p]];
+                if (r >= begin) {
+                    block.row_idx.push_back(r - begin);
+                    block.source.push_back(p);
+                }
+                else {
+                    an.off_idx.push_back(r);
+                    an.off_source.push_back(p);
+                }
+            }
+            block.col_ptr.push_back(static_cast<int>(block.row_idx.size()));
+            an.off_ptr.push_back(static_cast<int>(an.off_idx.size()));
+        }
+    }
+
+    return an;
+}
+
+std::string LUAnalysis::structuralReport(const std::function<std::string(int, bool)>& name) const {
+    if (!isStructurallySingular()) return "Structurally nonsingular.";
+
+    auto label = [&](int k, bool equation) {
+        return name ? name(k, equation) : std::string(equation ? "equation #" : "unknown #") + std::to_string(k);
+    };
+    auto join = [&](const std::vector<int>& list, bool equation) {
+        std::string out;
+        for (size_t k = 0; k < list.size(); k++) out += (k ? ", " : "") + label(list[k], equation);
+        return out;
+    };
+
+    std::string report = "Structurally singular matrix, rank " + std::to_string(structural_rank) + " of " + std::to_string(n) + ".";
+    if (!singular_cols.empty()) report += " Not determined: " + join(singular_cols, false) + ".";
+    if (!singular_rows.empty()) report += " Conflicting: " + join(singular_rows, true) + ".";
+    return report;
+}
+
+template <typename T>
+void BlockLU<T>::analyze(const SparseMatrix<T>& A) {
+    if (A.rows() != A.cols()) {
+        throw std::invalid_argument("BlockLU needs a square matrix.");
+    }
+    analysis = std::make_shared<const LUAnalysis>(analyzePattern(A.rows(), A.colPtr(), A.rowIdx()));
+}
+
+template <typename T>
+void BlockLU<T>::checkPattern(const SparseMatrix<T>& A) const {
+    if (A.rows() != analysis->n || A.cols() != analysis->n || A.nonZeros() != analysis->nnz) {
+        throw std::invalid_argument("Matrix does not have the analysed pattern.");
+    }
+}
+
+template <typename T>
+void BlockLU<T>::gather(const SparseMatrix<T>& A) {
+    const auto& Ax = A.getValues();
+    const auto& an = *analysis;
+
+    for (size_t b = 0; b < an.blocks.size(); b++) {
+        const auto& block = an.blocks[b];
+        if (an.block_ptr[b + 1] - an.block_ptr[b] == 1) {
+            singletons[b] = Ax[block.source[0]];
+            continue;
+        }
+        auto& values = block_matrices[b].getValues();
+        for (size_t k = 0; k < block.source.size(); k++) values[k] = Ax[block.source[k]];
+    }
+
+    off_val.resize(an.off_source.size());
+    for (size_t p = 0; p < off_val.size(); p++) off_val[p] = Ax[an.off_source[p]];
+}
+
+template <typename T>
+void BlockLU<T>::factorize(const SparseMatrix<T>& A) {
+    if (!analysis) analyze(A);
+    checkPattern(A);
+    const auto& an = *analysis;
+    if (an.isStructurallySingular()) {
+        throw std::runtime_error(an.structuralReport());
+    }
+
+    size_t count = an.blocks.size();
+    lus.assign(count, SparseLU<T>());
+    singletons.assign(count, T(0));
+    block_matrices.resize(count);
+    for (size_t b = 0; b < count; b++) {
+        size_t dim = an.block_ptr[b + 1] - an.block_ptr[b];
+        if (dim > 1) block_matrices[b] = SparseMatrix<T>(dim, dim, an.blocks[b].col_ptr, an.blocks[b].row_idx);
+    }
+    gather(A);
+
+    for (size_t b = 0; b < count; b++) {
+        if (an.block_ptr[b + 1] - an.block_ptr[b] == 1) {
+            if (std::abs(singletons[b]) == 0) {
+                throw std::runtime_error("Singular matrix, zero pivot at position " + std::to_string(an.block_ptr[b]) + ".");
+            }
+            continue;
+        }
+        try {
+            lus[b].factorize(block_matrices[b]); // Already ordered by the analysis
+        }
+        catch (const std::runtime_error&) {
+            throw std::runtime_error("Singular matrix, no pivot in diagonal block " + std::to_string(b) + ".");
+        }
+    }
+}
+
+template <typename T>
+bool BlockLU<T>::refactor(const SparseMatrix<T>& A) {
+    if (!analysis || lus.size() != analysis->blocks.size()) {
+        throw std::logic_error("Refactor needs a previous factorize().");
+    }
+    checkPattern(A);
+    gather(A);
+
+    for (size_t b = 0; b < lus.size(); b++) {
+        if (analysis->block_ptr[b + 1] - analysis->block_ptr[b] == 1) {
+            if (std::abs(singletons[b]) == 0) return false;
+        }
+        else if (!lus[b].refactor(block_matrices[b])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void BlockLU<T>::solve(std::vector<T>& b) const {
+    const auto& an = *analysis;
+    if (b.size() != an.n) {
+        throw std::invalid_argument("Right hand side size does not match the factorization.");
+    }
+
+    std::vector<T> y(an.n), part;
+    for (size_t k = 0; k < an.n; k++) y[k] = b[an.row_perm[k]];
+
+    // Last block first, then push its solution into the right hand side of the blocks above
+    for (size_t blk = an.blocks.size(); blk-- > 0;) {
+        int begin = an.block_ptr[blk], end = an.block_ptr[blk + 1];
+        if (end - begin == 1) {
+            y[begin] /= singletons[blk];
+        }
+        else {
+            part.assign(y.begin() + begin, y.begin() + end);
+            lus[blk].solve(part);
+            std::copy(part.begin(), part.end(), y.begin() + begin);
+        }
+        for (int k = begin; k < end; k++) {
+            T yk = y[k];
+            for (int p = an.off_ptr[k]; p < an.off_ptr[k + 1]; p++) y[an.off_idx[p]] -= off_val[p] * yk;
+        }
+    }
+
+    for (size_t k = 0; k < an.n; k++) b[an.col_perm[k]] = y[k];
+}
+
+// The permuted matrix is block upper triangular, its transpose block lower triangular. Entries above
+// the diagonal blocks become a dot product with the earlier blocks of the solution
+
+template <typename T>
+void BlockLU<T>::solveTransposed(std::vector<T>& b) const {
+    const auto& an = *analysis;
+    if (b.size() != an.n) {
+        throw std::invalid_argument("Right hand side size does not match the factorization.");
+    }
+
+    std::vector<T> y(an.n), part;
+    for (size_t k = 0; k < an.n; k++) y[k] = b[an.col_perm[k]];
+
+    for (size_t blk = 0; blk < an.blocks.size(); blk++) {
+        int begin = an.block_ptr[blk], end = an.block_ptr[blk + 1];
+        for (int k = begin; k < end; k++) {
+            T sum = y[k];
+            for (int p = an.off_ptr[k]; p < an.off_ptr[k + 1]; p++) sum -= off_val[p] * y[an.off_idx[p]];
+            y[k] = sum;
+        }
+        if (end - begin == 1) {
+            y[begin] /= singletons[blk];
+        }
+        else {
+            part.assign(y.begin() + begin, y.begin() + end);
+            lus[blk].solveTransposed(part);
+            std::copy(part.begin(), part.end(), y.begin() + begin);
+        }
+    }
+
+    for (size_t k = 0; k < an.n; k++) b[an.row_perm[k]] = y[k];
+}
+
+template <typename T>
+size_t BlockLU<T>::factorNonZeros() const {
+    size_t count = off_val.size();
+    for (size_t b = 0; b < lus.size(); b++) {
+        count += analysis->block_ptr[b + 1] - analysis->block_ptr[b] == 1 ? 1 : lus[b].factorNonZeros();
+    }
+    return count;
+}
+
+template class BlockLU<double>;
+template class BlockLU<std::complex<double>>;
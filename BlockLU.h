@@ -0,0 +1,80 @@
+#pragma once
+#include "SparseMatrix.h"
+#include "SparseLU.h"
+#include <vector>
+#include <complex>
+#include <string>
+#include <memory>
+#include <functional>
+
+// Symbolic analysis of an MNA pattern, done once and shared by every numeric factorization
+// Maximum transversal, block triangular form and an AMD order inside every diagonal block
+// (P * A * Q)(k, k) is A(row_perm[k], col_perm[k]), zero-free when the pattern is structurally nonsingular
+
+struct LUAnalysis
+{
+	size_t n = 0, nnz = 0;
+	size_t structural_rank = 0;
+	std::vector<int> row_perm, col_perm;
+	std::vector<int> block_ptr; // Block b covers positions block_ptr[b]..block_ptr[b + 1] - 1
+
+	// Unknowns (columns) and equations (rows) taking part in a structural singularity
+	// Columns reachable from an unmatched column by alternating paths are underdetermined (e.g. the
+	// branch currents of a voltage source loop), rows reachable from an unmatched row are overdetermined
+	std::vector<int> singular_cols, singular_rows;
+
+	// Pattern to factor positions, filled by analyzePattern() for BlockLU
+	struct Block { std::vector<int> col_ptr, row_idx, source; };
+	std::vector<Block> blocks;                     // Local diagonal blocks, source[k] is the entry of A
+	std::vector<int> off_ptr, off_idx, off_source; // Entries above the diagonal blocks, CSC over positions
+
+	bool isStructurallySingular() const { return structural_rank < n; }
+	size_t blockCount() const { return blocks.size(); }
+
+	// Human readable report, name(k, equation) labels unknown or equation k
+	std::string structuralReport(const std::function<std::string(int, bool)>& name = {}) const;
+};
+
+LUAnalysis analyzePattern(size_t n, const std::vector<int>& col_ptr, const std::vector<int>& row_idx);
+
+// KLU style LU: every diagonal block is factored on its own, off-diagonal blocks are only multiplied
+// The analysis is shared, so copies for worker threads only duplicate the numeric factors
+
+template <typename T>
+class BlockLU
+{
+	std::shared_ptr<const LUAnalysis> analysis;
+	std::vector<SparseLU<T>> lus;
+	std::vector<SparseMatrix<T>> block_matrices;
+	std::vector<T> off_val;
+	std::vector<T> singletons; // Pivots of 1 x 1 blocks, no SparseLU needed for them
+
+	void gather(const SparseMatrix<T>& A);
+	void checkPattern(const SparseMatrix<T>& A) const;
+
+public:
+	BlockLU() = default;
+	explicit BlockLU(std::shared_ptr<const LUAnalysis> symbolic) : analysis(std::move(symbolic)) {}
+
+	// Runs the symbolic phase on the pattern of A
+	void analyze(const SparseMatrix<T>& A);
+	const LUAnalysis& getAnalysis() const { return *analysis; }
+	std::shared_ptr<const LUAnalysis> sharedAnalysis() const { return analysis; }
+
+	// Throws std::runtime_error with the structural report if the pattern is structurally singular,
+	// or if a block is numerically singular. A has to have the analysed pattern
+	void factorize(const SparseMatrix<T>& A);
+
+	// Same pattern, same pivots, no ordering or pivot search
+	// Returns false if a reused pivot became too small, factorize() again in that case
+	bool refactor(const SparseMatrix<T>& A);
+
+	// Solves A * x = b in place, block back substitution
+	void solve(std::vector<T>& b) const;
+
+	// Solves A^T * x = b in place, plain transpose for complex T. Blocks in forward order
+	void solveTransposed(std::vector<T>& b) const;
+
+	size_t size() const { return analysis ? analysis->n : 0; }
+	size_t factorNonZeros() const;
+};
@@ -1,36 +1,760 @@
 #include "Circuit.h"
+#include "Connectivity.h"
+#include "NumericSystem.h"
+#include "SparseMatrix.h"
+#include "BlockLU.h"
+#include "SymbolicSolver.h"
+#include "Subcircuit.h"
+#include "Parallel.h"
+#include "Partition.h"
 #include "ginac/ginac.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
 
 using namespace GiNaC;
 
 GiNaC::symbol s("s"); // Laplace variable
 GiNaC::symbol w("w"); // Angular velocity
 
-void Circuit::addComponent(std::shared_ptr<Component> component) {
-    components.push_back(component);
+void Circuit::addComponent(std::shared_ptr<CircuitElement> component) {
+    topology->addElement(component);
 }
 
 void Circuit::addNode(std::shared_ptr<Node> node) {
-    nodes.push_back(node);
+    topology->addNode(node);
+}
+
+size_t Circuit::nodeCount() const {
+    return topology->nodeCount(); // Ground has no id
+}
+
+// Counting pass before assembly
+// Node ids from the topology are the first unknowns, then every element gets
+// its block of branch current unknowns. Returns the size of the MNA system
+
+size_t Circuit::assignIndices() {
+    int next = static_cast<int>(nodeCount());
+
+    for (const auto& component : topology->elementHandles()) {
+        size_t count = component->branchCount();
+        component->setBranchIndex(count ? next : -1);
+        next += static_cast<int>(count);
+    }
+
+    return static_cast<size_t>(next);
+}
+
+// Initialize conductance matrix and current vector, sized for every node and branch
+
+void Circuit::stampSymbolic(matrix& G, matrix& I, AnalysisType analysis, SolveStats* profile) {
+    size_t size;
+    {
+        PhaseTimer timer(profile, SolvePhase::Indexing);
+        size = assignIndices();
+        G = matrix(size, size);
+        I = matrix(size, 1);
+    }
+    {
+        PhaseTimer timer(profile, SolvePhase::Stamping);
+        for (const auto& component : topology->elementHandles()) {
+            component->stamp(G, I, analysis); // Pass analysis type
+        }
+    }
+
+    if (profile) {
+        profile->unknowns = size;
+        profile->matrixAllocations += 2;
+        profile->matrixBytes += (size * size + size) * sizeof(ex);
+        for (size_t i = 0; i < size; i++) {
+            for (size_t j = 0; j < size; j++) {
+                if (G(i, j).is_zero()) continue;
+                profile->stampEntries++;
+                profile->stampNodes += expressionSize(G(i, j));
+            }
+            if (!I(i, 0).is_zero()) profile->stampNodes += expressionSize(I(i, 0));
+        }
+    }
+}
+
+// The numeric backend needs plain numbers everywhere, and a frequency for AC
+
+bool Circuit::hasNumericValues() const {
+    for (const auto& component : topology->elementHandles()) {
+        if (!component->isNumeric()) return false;
+    }
+    return true;
+}
+
+bool Circuit::isNumeric() const {
+    if (analysisType == AnalysisType::Transient) return false;
+    if (analysisType == AnalysisType::AC && !omega) return false;
+    return hasNumericValues();
+}
+
+namespace {
+
+constexpr size_t parallel_min_elements = 4096; // Below this the threads cost more than the stamps
+constexpr size_t stamp_chunk_min = 512;
+constexpr size_t domain_min_unknowns = 2048; // Smaller systems factor faster in one piece
+constexpr size_t subnetwork_min_unknowns = 1024; // Below this one factorization beats splitting the system
+
+// Joins the stamp buffers of consecutive element ranges in range order, so triplets, element offsets
+// and the order of the rhs additions match a serial stamp
+void mergeBuffers(NumericSystem& sys, const std::vector<NumericSystem>& parts, unsigned threads) {
+    size_t parts_count = parts.size();
+    std::vector<size_t> g_at(parts_count + 1, 0), c_at(parts_count + 1, 0);
+    size_t elements = 0;
+    for (size_t p = 0; p < parts_count; p++) {
+        g_at[p + 1] = g_at[p] + parts[p].G.entries();
+        c_at[p + 1] = c_at[p] + parts[p].C.entries();
+        elements += parts[p].element_g.size();
+    }
+
+    sys.G.resizeEntries(g_at[parts_count]);
+    sys.C.resizeEntries(c_at[parts_count]);
+    parallelFor(parts_count, 1, threads, [&](size_t p, size_t, unsigned) {
+        sys.G.place(g_at[p], parts[p].G);
+        sys.C.place(c_at[p], parts[p].C);
+    });
+
+    sys.element_g.reserve(elements + 1);
+    sys.element_c.reserve(elements + 1);
+    for (size_t p = 0; p < parts_count; p++) {
+        for (size_t offset : parts[p].element_g) sys.element_g.push_back(g_at[p] + offset);
+        for (size_t offset : parts[p].element_c) sys.element_c.push_back(c_at[p] + offset);
+        for (const auto& term : parts[p].rhs_terms) sys.addRHS(term.first, term.second);
+    }
+    sys.element_g.push_back(sys.G.entries());
+    sys.element_c.push_back(sys.C.entries());
+}
+
+} // namespace
+
+NumericSystem Circuit::stampNumeric(SolveStats* profile) {
+    size_t size;
+    {
+        PhaseTimer timer(profile, SolvePhase::Indexing);
+        size = assignIndices();
+    }
+
+    // Everything GiNaC happened serially by now: element values became doubles when they were set, and
+    // assignIndices() brought the subcircuit models up to date. The stamps below may run on several threads
+    PhaseTimer timer(profile, SolvePhase::Stamping);
+    NumericSystem sys(size);
+    const auto& elements = topology->elementHandles();
+    unsigned threads = assemblyThreads ? assemblyThreads : hardwareThreads();
+
+    if (arena->size() > 0) {
+        // Arena elements type by type, the others through the virtual call
+        arena->stamp(*topology, sys, elements.size() >= parallel_min_elements ? threads : 1);
+    }
+    else if (threads > 1 && elements.size() >= parallel_min_elements) {
+        // Disjoint element ranges into one buffer each, merged in range order
+        size_t chunk = std::max(stamp_chunk_min, elements.size() / (4 * threads));
+        std::vector<NumericSystem> parts;
+        parts.reserve((elements.size() + chunk - 1) / chunk);
+        for (size_t begin = 0; begin < elements.size(); begin += chunk) parts.push_back(NumericSystem::buffer(size));
+
+        parallelFor(elements.size(), chunk, threads, [&](size_t begin, size_t end, unsigned) {
+            NumericSystem& part = parts[begin / chunk];
+            part.element_g.reserve(end - begin);
+            part.element_c.reserve(end - begin);
+            for (size_t e = begin; e < end; e++) {
+                part.element_g.push_back(part.G.entries());
+                part.element_c.push_back(part.C.entries());
+                elements[e]->stampNumeric(part);
+            }
+        });
+        mergeBuffers(sys, parts, threads);
+    }
+    else {
+        sys.element_g.reserve(elements.size() + 1);
+        sys.element_c.reserve(elements.size() + 1);
+        for (const auto& component : elements) {
+            sys.element_g.push_back(sys.G.entries());
+            sys.element_c.push_back(sys.C.entries());
+            component->stampNumeric(sys);
+        }
+        sys.element_g.push_back(sys.G.entries());
+        sys.element_c.push_back(sys.C.entries());
+    }
+
+    if (profile) {
+        size_t entries = sys.G.entries() + sys.C.entries();
+        profile->unknowns = size;
+        profile->stampEntries = entries;
+        profile->matrixAllocations += 3; // G and C triplets, rhs
+        profile->matrixBytes += entries * (2 * sizeof(int) + sizeof(double)) + size * sizeof(double);
+    }
+    return sys;
 }
 
 void Circuit::solve() {
-    // Initialize conductance matrix and current vector
-    size_t nodes_count = nodes.size() - 1; // Exclude ground node
-    matrix G(nodes_count, nodes_count);
-    matrix I(nodes_count, 1);
+    if (analysisType == AnalysisType::Transient) {
+        throw std::logic_error("Transient analysis runs through Circuit::transient().");
+    }
+
+    // Profiling off costs a null check per phase
+    SolveStats* profile = nullptr;
+    std::chrono::steady_clock::time_point start;
+    if (profiling) {
+        solveStats = SolveStats();
+        profile = &solveStats;
+        start = std::chrono::steady_clock::now();
+    }
+
+    {
+        PhaseTimer timer(profile, SolvePhase::Preflight);
+        preflight();
+    }
+    if (isNumeric()) solveNumeric(profile);
+    else solveSymbolic(profile);
+
+    if (profile) solveStats.totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
 
-    for (const auto& component : components) {
-        component->stamp(G, I, analysisType); // Pass analysis type
+// Symbolic path, solved in s, jω is put in afterwards
+
+void Circuit::solveSymbolic(SolveStats* profile) {
+    matrix G, I;
+    stampSymbolic(G, I, analysisType, profile);
+    {
+        PhaseTimer timer(profile, SolvePhase::Elimination);
+        SymbolicSolver solver(G, I);
+        symbolicSolution = solver.solveAll();
     }
 
-    // Handle DC (real matrices) or AC (substitute s = jω)
     if (analysisType == AnalysisType::AC) {
+        PhaseTimer timer(profile, SolvePhase::Substitution);
         exmap sub_map;
         sub_map[s] = GiNaC::I * w; // Use GiNaC's predefined imaginary unit
-        G = ex_to<matrix>(G.subs(sub_map));
-        I = ex_to<matrix>(I.subs(sub_map));
+        for (auto& value : symbolicSolution) value = value.subs(sub_map);
+    }
+
+    {
+        PhaseTimer timer(profile, SolvePhase::Writeback);
+        for (const auto& node : topology->nodeHandles()) {
+            node->setPotential(symbolicSolution[node->getIndex()]);
+        }
     }
 
-    // TODO: Solve G*x = I using GiNaC's linear algebra tools
+    if (profile) {
+        for (const auto& value : symbolicSolution) profile->resultNodes += expressionSize(value);
+    }
+}
+
+// Sparse numeric solve
+// DC uses G only (capacitors open, inductors shorted), AC factorizes G + jωC in complex arithmetic
+// In incremental mode the factors stay cached and value changes are applied as low rank updates
+
+void Circuit::solveNumeric(SolveStats* profile) {
+    NumericSystem sys = stampNumeric(profile);
+    auto name = [this](int k, bool equation) { return unknownName(k, equation); };
+    auto devices = nonlinearDevices();
+
+    if (!devices.empty() && analysisType == AnalysisType::DC) {
+        std::vector<double> x = operatingPoint(sys, devices, profile);
+        topology->takeChanged(); // Newton keeps no factors between solves
+        dcSolver.reset();
+        solution.assign(x.begin(), x.end());
+    }
+    else {
+        if (!devices.empty()) {
+            operatingPoint(sys, devices, profile);
+            sys = stampNumeric(profile); // Small signal conductances at the new operating point
+        }
+        size_t structure = topology->revision();
+        std::vector<int> changed = topology->takeChanged();
+        if (iterative && analysisType == AnalysisType::DC) {
+            dcSolver.reset(); // The changes are taken, cached factors would miss them
+            for (auto& part : dcParts) part.reset();
+            krylovStats = solveKrylov(sys, krylovGuess, krylovOptions, profile);
+            if (!krylovStats.converged) {
+                throw std::runtime_error("Iterative DC solve did not converge in " + std::to_string(krylovStats.iterations)
+                    + " iterations, relative residual " + std::to_string(krylovStats.residual) + ".");
+            }
+            solution.assign(krylovGuess.begin(), krylovGuess.end());
+            splitSolve = false;
+        }
+        else {
+            updateDomains(sys.size(), profile);
+            updateSubnetworks(sys.size());
+            splitSolve = subnetworks && subnetworks->count() > 1;
+
+            if (splitSolve) {
+                solveSubnetworks(sys, structure, changed, profile);
+            }
+            else if (analysisType == AnalysisType::DC) {
+                if (!incremental) dcSolver.reset();
+                std::vector<double> x;
+                dcSolver.solve(sys, 0.0, structure, changed, x, name, profile);
+                solution.assign(x.begin(), x.end());
+            }
+            else {
+                if (!incremental) acSolver.reset();
+                acSolver.solve(sys, std::complex<double>(0.0, *omega), structure, changed, solution, name, profile);
+            }
+        }
+    }
+
+    // Write the node voltages back as potentials
+    if (profile) profile->numeric = true;
+    PhaseTimer timer(profile, SolvePhase::Writeback);
+    for (const auto& node : topology->nodeHandles()) {
+        int idx = node->getIndex();
+        node->setPotential(ex(solution[idx].real()) + GiNaC::I * ex(solution[idx].imag()));
+    }
+}
+
+std::vector<std::shared_ptr<NonlinearDevice>> Circuit::nonlinearDevices() const {
+    std::vector<std::shared_ptr<NonlinearDevice>> devices;
+    for (const auto& element : topology->elementHandles()) {
+        if (auto device = std::dynamic_pointer_cast<NonlinearDevice>(element)) devices.push_back(device);
+    }
+    return devices;
+}
+
+// Newton from the last operating point while the topology stays the same, the result is stored in
+// the devices as the bias of their small signal stamps
+
+std::vector<double> Circuit::operatingPoint(const NumericSystem& sys, const std::vector<std::shared_ptr<NonlinearDevice>>& devices,
+    SolveStats* profile) {
+    std::vector<double> x;
+    if (operatingRevision == topology->revision()) x = lastOperatingPoint;
+    auto name = [this](int k, bool equation) { return unknownName(k, equation); };
+    newtonStats = solveOperatingPoint(sys, nodeCount(), devices, x, newtonOptions, name, profile);
+    lastOperatingPoint = x;
+    operatingRevision = topology->revision();
+
+    for (const auto& device : devices) {
+        std::vector<double> v;
+        for (const auto& terminal : device->getTerminals()) v.push_back(terminal->getIndex() >= 0 ? x[terminal->getIndex()] : 0.0);
+        device->setOperatingPoint(std::move(v));
+    }
+    return x;
+}
+
+void Circuit::setIncremental(bool enabled, size_t rankLimit) {
+    incremental = enabled;
+    dcSolver.rankLimit = acSolver.rankLimit = rankLimit;
+    for (auto& part : dcParts) part.rankLimit = rankLimit;
+    for (auto& part : acParts) part.rankLimit = rankLimit;
+    if (!enabled) {
+        dcSolver.reset();
+        acSolver.reset();
+        for (auto& part : dcParts) part.reset();
+        for (auto& part : acParts) part.reset();
+    }
+}
+
+void Circuit::setAssemblyThreads(unsigned threads) {
+    assemblyThreads = threads;
+    dcSolver.threads = acSolver.threads = threads;
+}
+
+void Circuit::setIterativeSolver(bool enabled, const KrylovOptions& options) {
+    iterative = enabled;
+    krylovOptions = options;
+    if (!enabled) krylovGuess.clear();
+}
+
+void Circuit::setDomainDecomposition(size_t parts, unsigned threads) {
+    domainParts = parts;
+    domainThreads = threads;
+    domainSplit.reset();
+    dcSolver.domainThreads = acSolver.domainThreads = threads;
+    dcSolver.reset(); // The next solve factors with the new split
+    acSolver.reset();
+}
+
+// The split follows the topology, element values don't change it
+
+void Circuit::updateDomains(size_t unknowns, SolveStats* profile) {
+    if (domainParts < 2 || unknowns < domain_min_unknowns) {
+        domainSplit.reset();
+    }
+    else if (!domainSplit || domainRevision != topology->revision() || domainSplit->size() != unknowns) {
+        PhaseTimer timer(profile, SolvePhase::Analysis);
+        domainSplit = std::make_shared<const std::vector<int>>(unknownDomains(*topology, unknowns, domainParts));
+        domainRevision = topology->revision();
+    }
+    dcSolver.domains = acSolver.domains = domainSplit;
+}
+
+// The connectivity only changes with the topology and the analysis type
+
+void Circuit::preflight() {
+    size_t revision = topology->revision();
+    if (connectivityChecked && checkedRevision == revision && checkedType == analysisType) return;
+    connectivityChecked = false;
+    checkConnectivity(*topology, analysisType, [this](int e) { return elementName(e); });
+    connectivityChecked = true;
+    checkedRevision = revision;
+    checkedType = analysisType;
+}
+
+// Parts are found once per topology, each keeps its own solver so incremental updates work per part
+
+void Circuit::updateSubnetworks(size_t unknowns) {
+    if (domainSplit || unknowns < subnetwork_min_unknowns) {
+        subnetworks.reset();
+        dcParts.clear();
+        acParts.clear();
+        return;
+    }
+    if (subnetworks && subnetworkRevision == topology->revision() && subnetworks->unknown_part.size() == unknowns) return;
+
+    subnetworks = std::make_unique<Subnetworks>(splitSubnetworks(*topology, unknowns));
+    subnetworkRevision = topology->revision();
+    size_t count = subnetworks->count() > 1 ? subnetworks->count() : 0;
+    dcParts.clear();
+    acParts.clear();
+    dcParts.resize(count);
+    acParts.resize(count);
+    for (auto& part : dcParts) part.rankLimit = dcSolver.rankLimit;
+    for (auto& part : acParts) part.rankLimit = acSolver.rankLimit;
+    dcSolver.reset(); // Changes taken while the parts solve never reach the whole-circuit solvers
+    acSolver.reset();
+}
+
+// Every part is stamped into a system of its own and solved on a worker, profiles and incremental
+// statistics of the parts are summed
+
+void Circuit::solveSubnetworks(const NumericSystem& sys, size_t structure, const std::vector<int>& changed, SolveStats* profile) {
+    const Subnetworks& parts = *subnetworks;
+    size_t count = parts.count();
+    std::vector<NumericSystem> systems;
+    std::vector<std::vector<int>> partChanged(count);
+    {
+        PhaseTimer timer(profile, SolvePhase::Assembly);
+        systems = extractSubnetworks(sys, parts);
+        std::vector<int> local(parts.element_part.size());
+        for (const auto& elements : parts.elements) {
+            for (size_t k = 0; k < elements.size(); k++) local[elements[k]] = static_cast<int>(k);
+        }
+        for (int e : changed) partChanged[parts.element_part[e]].push_back(local[e]);
+    }
+
+    std::vector<SolveStats> stats(profile ? count : 0);
+    bool dc = analysisType == AnalysisType::DC;
+    solution.assign(sys.size(), 0.0);
+    parallelFor(count, 1, subnetworkThreads, [&](size_t begin, size_t end, unsigned) {
+        for (size_t p = begin; p < end; p++) {
+            const auto& unknowns = parts.unknowns[p];
+            auto name = [&](int k, bool equation) { return unknownName(unknowns[k], equation); };
+            SolveStats* partProfile = profile ? &stats[p] : nullptr;
+            if (dc) {
+                if (!incremental) dcParts[p].reset();
+                std::vector<double> x;
+                dcParts[p].solve(systems[p], 0.0, structure, partChanged[p], x, name, partProfile);
+                for (size_t k = 0; k < unknowns.size(); k++) solution[unknowns[k]] = x[k];
+            }
+            else {
+                if (!incremental) acParts[p].reset();
+                std::vector<std::complex<double>> x;
+                acParts[p].solve(systems[p], std::complex<double>(0.0, *omega), structure, partChanged[p], x, name, partProfile);
+                for (size_t k = 0; k < unknowns.size(); k++) solution[unknowns[k]] = x[k];
+            }
+        }
+    });
+
+    partStats = IncrementalStats();
+    for (size_t p = 0; p < count; p++) {
+        const IncrementalStats& part = dc ? dcParts[p].getStats() : acParts[p].getStats();
+        partStats.factorizations += part.factorizations;
+        partStats.updates += part.updates;
+        partStats.rank = std::max(partStats.rank, part.rank);
+    }
+    if (!profile) return;
+    profile->subnetworks = count;
+    for (const SolveStats& part : stats) {
+        for (size_t k = 0; k < SolveStats::phaseCount; k++) profile->seconds[k] += part.seconds[k];
+        profile->nonZeros += part.nonZeros;
+        profile->factorNonZeros += part.factorNonZeros;
+        profile->matrixAllocations += part.matrixAllocations;
+        profile->matrixBytes += part.matrixBytes;
+        profile->factorizations += part.factorizations;
+        profile->updates += part.updates;
+        profile->updateRank = std::max(profile->updateRank, part.updateRank);
+    }
+}
+
+// Labels for the structural report, node rows are KCL equations and branch rows the element equations
+
+std::string Circuit::elementName(int element) const {
+    const auto& handle = topology->elementHandles()[element];
+    if (auto component = std::dynamic_pointer_cast<Component>(handle)) return component->getSym();
+    if (auto twoPort = std::dynamic_pointer_cast<TwoPort>(handle)) return twoPort->getSym();
+    if (auto device = std::dynamic_pointer_cast<NonlinearDevice>(handle)) return device->getSym();
+    if (auto subcircuit = std::dynamic_pointer_cast<Subcircuit>(handle)) return subcircuit->getSym();
+    if (auto macro = std::dynamic_pointer_cast<MacroModel>(handle)) return macro->getSym();
+    return "element #" + std::to_string(element);
+}
+
+std::string Circuit::unknownName(int idx, bool equation) const {
+    const auto& nodes = topology->nodeHandles();
+    if (idx >= 0 && idx < static_cast<int>(nodes.size())) return (equation ? "KCL at " : "voltage of ") + nodes[idx]->getSym();
+    for (const auto& element : topology->elementHandles()) {
+        int first = element->getBranchIndex();
+        if (first == -1 || idx < first || idx >= first + static_cast<int>(element->branchCount())) continue;
+        std::string name = elementName(element->getElementIndex());
+        if (element->branchCount() > 1) name += "[" + std::to_string(idx - first) + "]";
+        return (equation ? "branch equation of " : "current of ") + name;
+    }
+    return "#" + std::to_string(idx);
+}
+
+ACSweepResult Circuit::sweepAC(SweepType type, size_t points, double fstart, double fstop,
+    const std::vector<std::shared_ptr<Node>>& probeNodes,
+    const std::vector<std::shared_ptr<CircuitElement>>& probeBranches, unsigned threads) {
+    if (!hasNumericValues()) {
+        throw std::logic_error("AC sweep needs numeric component values.");
+    }
+
+    NumericSystem sys = stampNumeric();
+    auto devices = nonlinearDevices();
+    if (!devices.empty()) {
+        operatingPoint(sys, devices, nullptr);
+        sys = stampNumeric();
+    }
+    return runACSweep(sys, sweepFrequencies(type, points, fstart, fstop), probeIndices(probeNodes, probeBranches), threads);
+}
+
+TransientResult Circuit::transient(const TransientOptions& options,
+    const std::vector<std::shared_ptr<Node>>& probeNodes,
+    const std::vector<std::shared_ptr<CircuitElement>>& probeBranches) {
+    if (!hasNumericValues()) {
+        throw std::logic_error("Transient analysis needs numeric component values.");
+    }
+    if (!nonlinearDevices().empty()) {
+        throw std::logic_error("Transient analysis of nonlinear devices isn't supported, only their DC and AC solves.");
+    }
+
+    NumericSystem sys = stampNumeric();
+    return runTransient(sys, options, probeIndices(probeNodes, probeBranches));
+}
+
+// Model reduction works on the linear numeric stamps
+
+ReducedModel Circuit::reduce(const std::vector<std::shared_ptr<Node>>& ports, const ReductionOptions& options) {
+    if (!hasNumericValues()) throw std::logic_error("Model reduction needs numeric component values.");
+    if (!nonlinearDevices().empty()) throw std::logic_error("Model reduction needs a linear network.");
+
+    NumericSystem sys = stampNumeric();
+    return reduceNetwork(sys, nodeCount(), probeIndices(ports, {}), options);
+}
+
+ReductionError Circuit::reductionError(const std::vector<std::shared_ptr<Node>>& ports, const ReducedModel& model,
+    const std::vector<double>& frequencies) {
+    if (!hasNumericValues()) throw std::logic_error("Model reduction needs numeric component values.");
+    if (!nonlinearDevices().empty()) throw std::logic_error("Model reduction needs a linear network.");
+
+    NumericSystem sys = stampNumeric();
+    return compareReduced(sys, probeIndices(ports, {}), model, frequencies);
+}
+
+// Pole-zero analysis linearizes at the operating point like an AC solve
+
+PoleZeroResult Circuit::poles(const PoleZeroOptions& options) {
+    return poleZero(nullptr, nullptr, options);
+}
+
+PoleZeroResult Circuit::poleZero(const std::shared_ptr<CircuitElement>& input, const std::shared_ptr<Node>& output,
+    const PoleZeroOptions& options) {
+    if (!hasNumericValues()) throw std::logic_error("Pole-zero analysis needs numeric component values.");
+
+    NumericSystem sys = stampNumeric();
+    auto devices = nonlinearDevices();
+    if (!devices.empty()) {
+        operatingPoint(sys, devices, nullptr);
+        sys = stampNumeric();
+    }
+
+    std::vector<double> b(sys.size(), 0.0);
+    int out = -1;
+    if (input || output) {
+        if (!input || !output) throw std::invalid_argument("Zeros need both an input source and an output node.");
+        b = sourceVector(input, sys.size(), "Pole-zero");
+        out = probeIndices({ output }, {}).front();
+        if (out < 0) throw std::invalid_argument("Pole-zero output can't be the ground node.");
+    }
+
+    SparseMatrix<double> G = SparseMatrix<double>::fromTriplets(sys.G), C = SparseMatrix<double>::fromTriplets(sys.C);
+    return poleZeroAnalysis(G, C, b, out, options);
+}
+
+// Newton's operating point is the DC forward solution, AC points solve the small signal system
+
+SensitivityResult Circuit::sensitivity(const std::vector<std::shared_ptr<Node>>& outputs,
+    const std::vector<double>& frequencies, unsigned threads) {
+    if (!hasNumericValues()) throw std::logic_error("Sensitivity analysis needs numeric component values.");
+    if (analysisType == AnalysisType::Transient) throw std::logic_error("Sensitivities are DC or AC.");
+
+    std::vector<double> points = frequencies;
+    if (points.empty() && analysisType == AnalysisType::AC) {
+        if (!omega) throw std::logic_error("AC sensitivities need a frequency, see setFrequency().");
+        points.push_back(*omega / (2.0 * std::acos(-1.0)));
+    }
+
+    NumericSystem sys = stampNumeric();
+    std::vector<double> x;
+    auto devices = nonlinearDevices();
+    if (!devices.empty()) {
+        x = operatingPoint(sys, devices, nullptr);
+        sys = stampNumeric();
+        if (!points.empty()) x.clear();
+    }
+    return adjointSensitivity(sys, topology->elementHandles(), probeIndices(outputs, {}), points, x, threads);
+}
+
+// The adjoint system is solved once, shared by every parameter, only the derivative stamps differ
+
+std::vector<ex> Circuit::symbolicSensitivity(const std::shared_ptr<Node>& output, const std::vector<symbol>& parameters,
+    SymbolicStats* stats) {
+    if (!output) throw std::invalid_argument("Sensitivity needs an output node.");
+    if (analysisType == AnalysisType::Transient) throw std::logic_error("Sensitivities are DC or AC.");
+
+    matrix G, I;
+    stampSymbolic(G, I, analysisType);
+    int out = probeIndices({ output }, {}).front();
+    if (out < 0) return std::vector<ex>(parameters.size(), ex(0)); // Ground
+
+    size_t n = G.rows();
+    matrix e(n, 1);
+    e(out, 0) = 1;
+    std::vector<ex> x = SymbolicSolver(G, I).solveAll();
+    SymbolicSolver adjoint(G.transpose(), e);
+    std::vector<ex> lambda = adjoint.solveAll();
+    if (stats) *stats = adjoint.getStats();
+
+    std::vector<ex> result;
+    result.reserve(parameters.size());
+    for (const symbol& p : parameters) {
+        ex sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (lambda[i].is_zero()) continue;
+            ex row = I(i, 0).diff(p);
+            for (size_t j = 0; j < n; j++) {
+                ex d = G(i, j).diff(p);
+                if (!d.is_zero()) row -= d * x[j];
+            }
+            sum += lambda[i] * row;
+        }
+        result.push_back(normal(sum));
+    }
+    return result;
+}
+
+// rhs of the unit input source, valid after assignIndices()
+
+std::vector<double> Circuit::sourceVector(const std::shared_ptr<CircuitElement>& input, size_t size, const std::string& analysis) const {
+    const auto& elements = topology->elementHandles();
+    int id = input->getElementIndex();
+    if (id < 0 || id >= static_cast<int>(elements.size()) || elements[id] != input) {
+        throw std::invalid_argument(analysis + " input is not part of the circuit.");
+    }
+
+    std::vector<double> b(size, 0.0);
+    if (auto source = std::dynamic_pointer_cast<VoltageSource>(input)) {
+        b[source->getBranchIndex()] = 1;
+    }
+    else if (auto source = std::dynamic_pointer_cast<CurrentSource>(input)) {
+        int i = source->getInput()->getIndex(), j = source->getOutput()->getIndex();
+        if (i >= 0) b[i] = -1; // As its stamp, the current leaves node i
+        if (j >= 0) b[j] = 1;
+    }
+    else {
+        throw std::invalid_argument(analysis + " input has to be a voltage or current source.");
+    }
+    return b;
+}
+
+// Devices stamp and generate noise at the operating point
+
+NoiseResult Circuit::noise(const std::shared_ptr<Node>& output, SweepType type, size_t points, double fstart, double fstop,
+    const std::shared_ptr<CircuitElement>& input, const NoiseOptions& options) {
+    if (!hasNumericValues()) throw std::logic_error("Noise analysis needs numeric component values.");
+    if (!output) throw std::invalid_argument("Noise analysis needs an output node.");
+
+    NumericSystem sys = stampNumeric();
+    auto devices = nonlinearDevices();
+    if (!devices.empty()) {
+        operatingPoint(sys, devices, nullptr);
+        sys = stampNumeric();
+    }
+    int out = probeIndices({ output }, {}).front();
+    if (out < 0) throw std::invalid_argument("Noise output can't be the ground node.");
+    std::vector<double> b;
+    if (input) b = sourceVector(input, sys.size(), "Noise");
+    return runNoise(sys, topology->elementHandles(), out, b, sweepFrequencies(type, points, fstart, fstop), options);
+}
+
+// MNA unknowns of the probed node voltages and branch currents, valid after assignIndices()
+
+std::vector<int> Circuit::probeIndices(const std::vector<std::shared_ptr<Node>>& probeNodes,
+    const std::vector<std::shared_ptr<CircuitElement>>& probeBranches) const {
+    std::vector<int> outputs;
+    const auto& nodes = topology->nodeHandles();
+    for (const auto& node : probeNodes) {
+        int idx = node->getIndex();
+        if (idx != -1 && (idx < 0 || idx >= static_cast<int>(nodes.size()) || nodes[idx] != node)) {
+            throw std::invalid_argument("Probe node " + node->getSym() + " is not part of the circuit.");
+        }
+        outputs.push_back(node->getIndex());
+    }
+    for (const auto& element : probeBranches) {
+        if (element->branchCount() == 0) {
+            throw std::invalid_argument("Element has no branch current unknown.");
+        }
+        outputs.push_back(element->getBranchIndex());
+    }
+    return outputs;
+}
+
+// AC programs keep s as a variable, evaluate them with s = jω
+
+CompiledCircuit Circuit::compile() {
+    matrix G, I;
+    stampSymbolic(G, I, analysisType);
+    return CompiledCircuit(G, I);
+}
+
+// Stamps are compiled once for DC, the samples only bind the parameters
+
+BatchResult Circuit::solveBatch(const ParameterSamples& samples, const std::vector<std::shared_ptr<Node>>& probeNodes,
+    const std::vector<std::shared_ptr<CircuitElement>>& probeBranches, const BatchOptions& options) {
+    matrix G, I;
+    stampSymbolic(G, I, AnalysisType::DC);
+    CompiledCircuit program(G, I);
+    return runBatch(program, samples, probeIndices(probeNodes, probeBranches), options);
+}
+
+// H(s) from the Laplace domain stamps, only the two node voltages are back substituted
+
+ex Circuit::transferFunction(const std::shared_ptr<Node>& out, const std::shared_ptr<Node>& in, SymbolicStats* stats) {
+    if (!out || !in) throw std::invalid_argument("Transfer function needs two nodes.");
+    if (in->getIndex() == -1) throw std::invalid_argument("Transfer function input can't be the ground node.");
+
+    matrix G, I;
+    stampSymbolic(G, I, AnalysisType::AC);
+    std::vector<int> unknowns = probeIndices({ in, out }, {});
+    if (unknowns[1] == -1) unknowns.pop_back(); // Output on ground, H = 0
+
+    SymbolicSolver solver(G, I);
+    std::vector<ex> values = solver.solve(unknowns);
+    if (stats) *stats = solver.getStats();
+
+    if (values[0].is_zero()) {
+        throw std::runtime_error("Voltage of " + in->getSym() + " is zero, the input needs a source.");
+    }
+    return values.size() == 1 ? ex(0) : normal(values[1] / values[0]);
+}
+
+ex Circuit::transferFunction(std::string_view out, std::string_view in, SymbolicStats* stats) {
+    auto out_node = findNode(out), in_node = findNode(in);
+    if (!out_node) throw std::invalid_argument("Unknown node " + std::string(out) + ".");
+    if (!in_node) throw std::invalid_argument("Unknown node " + std::string(in) + ".");
+    return transferFunction(out_node, in_node, stats);
 }
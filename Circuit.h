@@ -2,32 +2,238 @@
 #include "Node.h"
 #include "DiscreteComponents.h"
 #include "TwoPorts.h"
+#include "CompiledCircuit.h"
+#include "ACSweep.h"
+#include "Transient.h"
+#include "Topology.h"
+#include "SymbolicSolver.h"
+#include "MonteCarlo.h"
+#include "Incremental.h"
+#include "Newton.h"
+#include "ModelReduction.h"
+#include "PoleZero.h"
+#include "Connectivity.h"
+#include "Sensitivity.h"
+#include "Noise.h"
+#include "Arena.h"
+#include "Krylov.h"
+#include "SolveStats.h"
+#include <memory>
+#include <string_view>
 #include <vector>
+#include <complex>
+#include <optional>
 #include <ginac/ginac.h>
 
-enum class AnalysisType
-{
-    DC,
-    AC,
-    Transient
-};
-
-extern GiNaC::symbol s; // Laplace vairable where s = j * w
-extern GiNaC::symbol w; // Omega, angular velocity
-
 class Circuit
 {
-    std::vector<std::shared_ptr<Component>> components;
-    std::vector<std::shared_ptr<Node>> nodes;
+    friend class SubcircuitDefinition; // Stamps the inner circuit
+    std::shared_ptr<Topology> topology = std::make_shared<Topology>(); // Shared with the handles as a weak_ptr
+    std::shared_ptr<ElementArena> arena = std::make_shared<ElementArena>(); // Elements made by emplace(), owned by their handles
     AnalysisType analysisType = AnalysisType::DC;
+    std::optional<double> omega; // Angular frequency for numeric AC solves
+
+    std::vector<std::complex<double>> solution; // Node voltages then branch currents, numeric backend only
+    std::vector<ex> symbolicSolution;           // Same layout, symbolic backend only
+
+    bool incremental = false;
+    IncrementalSolver<double> dcSolver; // Factors of the last numeric solves, kept in incremental mode
+    IncrementalSolver<std::complex<double>> acSolver;
+
+    bool profiling = false;
+    SolveStats solveStats;
+
+    unsigned assemblyThreads = 1;
+
+    size_t domainParts = 0; // Domain decomposition, see setDomainDecomposition()
+    unsigned domainThreads = 0;
+    std::shared_ptr<const std::vector<int>> domainSplit; // Domain of every unknown at domainRevision
+    size_t domainRevision = 0;
+
+    bool connectivityChecked = false; // Preflight passed for checkedRevision and checkedType
+    size_t checkedRevision = 0;
+    AnalysisType checkedType = AnalysisType::DC;
+
+    unsigned subnetworkThreads = 0;
+    std::unique_ptr<Subnetworks> subnetworks; // Independent parts at subnetworkRevision, see Connectivity.h
+    size_t subnetworkRevision = 0;
+    std::vector<IncrementalSolver<double>> dcParts; // One solver per part
+    std::vector<IncrementalSolver<std::complex<double>>> acParts;
+    bool splitSolve = false; // The last numeric solve went through the parts
+    IncrementalStats partStats;
+
+    bool iterative = false; // Krylov DC solves, see setIterativeSolver()
+    KrylovOptions krylovOptions;
+    KrylovStats krylovStats;
+    std::vector<double> krylovGuess; // Last iterative solution, the start of the next
+
+    NewtonOptions newtonOptions;
+    NewtonStats newtonStats;
+    std::vector<double> lastOperatingPoint; // Initial guess of the next Newton run
+    size_t operatingRevision = 0;           // Topology revision it belongs to
+
+    size_t nodeCount() const;
+    size_t assignIndices();
+    void stampSymbolic(matrix& G, matrix& I, AnalysisType analysis, SolveStats* profile = nullptr);
+    bool hasNumericValues() const;
+    bool isNumeric() const;
+    NumericSystem stampNumeric(SolveStats* profile = nullptr);
+    void solveNumeric(SolveStats* profile);
+    void solveSymbolic(SolveStats* profile);
+    void updateDomains(size_t unknowns, SolveStats* profile);
+    void preflight();
+    void updateSubnetworks(size_t unknowns);
+    void solveSubnetworks(const NumericSystem& sys, size_t structure, const std::vector<int>& changed, SolveStats* profile);
+    std::vector<std::shared_ptr<NonlinearDevice>> nonlinearDevices() const;
+    std::vector<double> operatingPoint(const NumericSystem& sys, const std::vector<std::shared_ptr<NonlinearDevice>>& devices,
+        SolveStats* profile);
+    std::string elementName(int element) const;
+    std::string unknownName(int idx, bool equation) const;
+    std::vector<double> sourceVector(const std::shared_ptr<CircuitElement>& input, size_t size, const std::string& analysis) const;
+    std::vector<int> probeIndices(const std::vector<std::shared_ptr<Node>>& probeNodes,
+        const std::vector<std::shared_ptr<CircuitElement>>& probeBranches) const;
 
 public:
     Circuit() = default;
+    Circuit(const Circuit&) = delete; // Nodes and elements belong to one circuit
+    Circuit& operator=(const Circuit&) = delete;
+    Circuit(Circuit&&) = default;
+    Circuit& operator=(Circuit&&) = default;
 
-    void addComponent(std::shared_ptr<Component>);
+    // Both are safe to call from several threads, terminals of a component are added with it
+    void addComponent(std::shared_ptr<CircuitElement>);
     void addNode(std::shared_ptr<Node>);
+
+    // Makes the element and adds it, like addComponent(std::make_shared<T>(args...)). Resistors, capacitors,
+    // inductors, independent and controlled sources live in one arena array per type and stamp numerically in
+    // a loop per type without virtual calls, see Arena.h. The handle keeps the arena alive as long as it is held
+    template <typename T, typename... Args>
+    std::shared_ptr<T> emplace(Args&&... args) {
+        std::shared_ptr<T> element;
+        if constexpr (ElementArena::holds<T>) {
+            auto [object, slot] = arena->create<T>(std::forward<Args>(args)...);
+            element = std::shared_ptr<T>(arena, object);
+            addComponent(element);
+            arena->bind<T>(element->getElementIndex(), slot);
+        }
+        else {
+            element = std::make_shared<T>(std::forward<Args>(args)...);
+            addComponent(element);
+        }
+        return element;
+    }
+
     void connect(std::shared_ptr<Component>, std::shared_ptr<Component>);
     void setAnalysisType(AnalysisType type) { analysisType = type; }
-    
+    void setFrequency(double angular) { omega = angular; }
+    void clearFrequency() { omega.reset(); }
+
+    // Picks the numeric sparse backend when every value is a number, otherwise the GiNaC path
+    // Circuits that are singular by their connections alone (floating nodes, no DC path to ground, loops of
+    // voltage sources) throw std::runtime_error naming the nodes or elements before any stamping
     void solve();
+
+    // Numeric solves keep their factorization and update the solution when a few element values
+    // change (Sherman-Morrison / Woodbury), refactoring once the changes add up to more than
+    // rankLimit matrix columns or the topology, analysis type or frequency changes. See Incremental.h
+    void setIncremental(bool enabled, size_t rankLimit = 16);
+    const IncrementalStats& getIncrementalStats() const {
+        if (splitSolve) return partStats;
+        return analysisType == AnalysisType::DC ? dcSolver.getStats() : acSolver.getStats();
+    }
+
+    // Nonlinear devices (Semiconductors.h) make numeric DC solves Newton iterations, see Newton.h. AC solves
+    // and sweeps first find the operating point and then stamp the devices linearized around it
+    void setNewtonOptions(const NewtonOptions& options) { newtonOptions = options; }
+    const NewtonStats& getNewtonStats() const { return newtonStats; }
+
+    // Numeric stamping and triplet to CSC assembly on several threads, 1 (default) is serial and 0 one
+    // per hardware thread. Small circuits stay serial. The system is bit for bit the serial one
+    // The symbolic backend always stamps serially, GiNaC isn't thread safe
+    void setAssemblyThreads(unsigned threads);
+
+    // Numeric solves of large systems split the node graph into `parts` domains by multilevel bisection and
+    // factor the bordered block diagonal form, one domain per worker of `threads` (0 is one per hardware
+    // thread) and the interface Schur complement last. 0 or 1 parts factor the whole matrix at once, as do
+    // systems of less than a few thousand unknowns. See Partition.h and DomainSolver.h
+    void setDomainDecomposition(size_t parts, unsigned threads = 0);
+
+    // Numeric solves of larger circuits whose parts only share ground solve every part as a system of its
+    // own, on `threads` workers (0, the default, is one per hardware thread). Not with domain decomposition
+    void setSubnetworkThreads(unsigned threads) { subnetworkThreads = threads; }
+
+    // Linear DC solves by preconditioned CG or GMRES instead of a factorization, for resistive meshes whose
+    // LU fill-in doesn't fit in memory. Every solve starts from the last iterative solution of the same size.
+    // Circuits with nonlinear devices and AC solves still factor. solve() throws std::runtime_error if the
+    // iteration doesn't converge, the stats of the run are kept either way. See Krylov.h
+    void setIterativeSolver(bool enabled, const KrylovOptions& options = {});
+    const KrylovStats& getKrylovStats() const { return krylovStats; }
+
+    // Phase times and counters of every solve() while enabled, see SolveStats.h
+    // Off by default, SolveStats::writeJSON() dumps them
+    void setProfiling(bool enabled) { profiling = enabled; }
+    const SolveStats& getSolveStats() const { return solveStats; }
+
+    // Parallel .ac sweep over numeric component values
+    // Outputs are the voltages of the given nodes followed by the branch currents of the given elements
+    ACSweepResult sweepAC(SweepType type, size_t points, double fstart, double fstop,
+        const std::vector<std::shared_ptr<Node>>& probeNodes,
+        const std::vector<std::shared_ptr<CircuitElement>>& probeBranches = {}, unsigned threads = 0);
+
+    // Time domain run over numeric component values, outputs as for sweepAC
+    TransientResult transient(const TransientOptions& options,
+        const std::vector<std::shared_ptr<Node>>& probeNodes,
+        const std::vector<std::shared_ptr<CircuitElement>>& probeBranches = {});
+
+    // DC operating point for every parameter sample (Monte Carlo, corners), outputs as for sweepAC
+    // Element values may be expressions of the sampled symbols, see MonteCarlo.h
+    BatchResult solveBatch(const ParameterSamples& samples, const std::vector<std::shared_ptr<Node>>& probeNodes,
+        const std::vector<std::shared_ptr<CircuitElement>>& probeBranches = {}, const BatchOptions& options = {});
+
+    // H(s) = V(out) / V(in) as a normalized rational function, from the Laplace domain stamps
+    // The input node has to be driven by a source. Names are looked up case insensitively
+    ex transferFunction(const std::shared_ptr<Node>& out, const std::shared_ptr<Node>& in, SymbolicStats* stats = nullptr);
+    ex transferFunction(std::string_view out, std::string_view in, SymbolicStats* stats = nullptr);
+
+    // PRIMA reduced order model of the network between the port nodes and ground, see ModelReduction.h
+    // The model stamps into other circuits through MacroModel, for fast sweeps and transient runs
+    ReducedModel reduce(const std::vector<std::shared_ptr<Node>>& ports, const ReductionOptions& options = {});
+
+    // Port impedance error of a reduced model against this circuit, frequencies in Hz
+    ReductionError reductionError(const std::vector<std::shared_ptr<Node>>& ports, const ReducedModel& model,
+        const std::vector<double>& frequencies);
+
+    // Numeric poles of the network, around the operating point if it has nonlinear devices, see PoleZero.h
+    PoleZeroResult poles(const PoleZeroOptions& options = {});
+
+    // Poles, and the zeros of V(output) / value of the input source (a voltage or current source)
+    PoleZeroResult poleZero(const std::shared_ptr<CircuitElement>& input, const std::shared_ptr<Node>& output,
+        const PoleZeroOptions& options = {});
+
+    // Output noise spectrum of V(output) from the thermal noise of resistors, the shot and channel noise of
+    // nonlinear devices at the operating point and the noise densities set on sources, one adjoint solve per
+    // frequency, see Noise.h. Frequencies as for sweepAC. With an input (a voltage or current source) the
+    // result also holds the gain for the input referred noise
+    NoiseResult noise(const std::shared_ptr<Node>& output, SweepType type, size_t points, double fstart, double fstop,
+        const std::shared_ptr<CircuitElement>& input = nullptr, const NoiseOptions& options = {});
+
+    // dV(output) / dp for the value p of every resistor, capacitor, inductor, source, transformer, gyrator and
+    // controlled source, one adjoint solve per output node, see Sensitivity.h. Frequencies in Hz, none is the
+    // current analysis (DC, or AC at the set frequency). Nonlinear devices enter linearized at the operating point
+    SensitivityResult sensitivity(const std::vector<std::shared_ptr<Node>>& outputs,
+        const std::vector<double>& frequencies = {}, unsigned threads = 0);
+
+    // dV(output) / dp for every parameter symbol p in the element values, as normalized expressions
+    // One transposed symbolic solve G^T λ = e_out, then dV / dp = λ^T (dI/dp - dG/dp x). AC results are in s
+    std::vector<ex> symbolicSensitivity(const std::shared_ptr<Node>& output, const std::vector<symbol>& parameters,
+        SymbolicStats* stats = nullptr);
+
+    // Lower the symbolic stamps once, for repeated solves with different parameter values
+    CompiledCircuit compile();
+
+    const std::vector<std::complex<double>>& getSolution() const { return solution; }
+    const std::vector<ex>& getSymbolicSolution() const { return symbolicSolution; }
+
+    const Topology& getTopology() const { return *topology; }
+    std::shared_ptr<Node> findNode(std::string_view name) const { return topology->findNode(name); }
 };
@@ -0,0 +1,258 @@
+#include "CompiledCircuit.h"
+#include "Component.h"
+#include "SparseLU.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+
+// Lower the symbolic system
+// Entries are deduplicated up to sign, so the four cells of a two-terminal stamp share one program
+
+CompiledCircuit::CompiledCircuit(const matrix& G, const matrix& I) : n(G.rows()) {
+    if (G.rows() != G.cols() || I.rows() != G.rows()) {
+        throw std::invalid_argument("Stamp program needs a square G and a matching I.");
+    }
+
+    std::map<ex, int, ex_is_less> seen;
+    auto program_for = [&](const ex& e, double& sign) {
+        sign = 1.0;
+        auto it = seen.find(e);
+        if (it != seen.end()) return it->second;
+        it = seen.find(-e);
+        if (it != seen.end()) {
+            sign = -1.0;
+            return it->second;
+        }
+        int begin = static_cast<int>(code.size());
+        lower(e, 0);
+        programs.push_back({ begin, static_cast<int>(code.size()) });
+        int idx = static_cast<int>(programs.size()) - 1;
+        seen.emplace(e, idx);
+        return idx;
+    };
+
+    // Column major walk gives the CSC pattern directly
+    col_ptr.assign(n + 1, 0);
+    for (size_t j = 0; j < n; j++) {
+        for (size_t i = 0; i < n; i++) {
+            const ex& entry = G(i, j);
+            if (entry.is_zero()) continue;
+            double sign;
+            int value = program_for(entry, sign);
+            g_ops.push_back({ static_cast<int>(row_idx.size()), value, sign });
+            row_idx.push_back(static_cast<int>(i));
+        }
+        col_ptr[j + 1] = static_cast<int>(row_idx.size());
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const ex& entry = I(i, 0);
+        if (entry.is_zero()) continue;
+        double sign;
+        int value = program_for(entry, sign);
+        rhs_ops.push_back({ static_cast<int>(i), value, sign });
+    }
+}
+
+int CompiledCircuit::emit(OpCode op, int arg, int depth, int pops, int pushes) {
+    code.push_back({ op, arg });
+    depth += pushes - pops;
+    if (depth > max_stack) max_stack = depth;
+    return depth;
+}
+
+// Post order walk of the expression tree, returns the stack depth after the subtree
+
+int CompiledCircuit::lower(const ex& e, int depth) {
+    if (is_a<numeric>(e)) {
+        const numeric& num = ex_to<numeric>(e);
+        if (!num.is_real()) {
+            throw std::invalid_argument("Complex constant in a stamp, use s for frequency dependence.");
+        }
+        constants.push_back(num.to_double());
+        return emit(OpCode::Const, static_cast<int>(constants.size()) - 1, depth, 0, 1);
+    }
+
+    if (is_a<symbol>(e)) {
+        if (e.is_equal(s)) return emit(OpCode::S, 0, depth, 0, 1);
+        int idx = parameterIndex(ex_to<symbol>(e));
+        if (idx == -1) {
+            parameters.push_back(ex_to<symbol>(e));
+            idx = static_cast<int>(parameters.size()) - 1;
+        }
+        return emit(OpCode::Param, idx, depth, 0, 1);
+    }
+
+    if (is_a<add>(e) || is_a<mul>(e)) {
+        OpCode op = is_a<add>(e) ? OpCode::Add : OpCode::Mul;
+        depth = lower(e.op(0), depth);
+        for (size_t k = 1; k < e.nops(); k++) {
+            depth = lower(e.op(k), depth);
+            depth = emit(op, 0, depth, 2, 1);
+        }
+        return depth;
+    }
+
+    if (is_a<power>(e)) {
+        ex exponent = e.op(1);
+        depth = lower(e.op(0), depth);
+        if (is_a<numeric>(exponent) && ex_to<numeric>(exponent).is_integer()) {
+            long k = ex_to<numeric>(exponent).to_long();
+            if (k == -1) return emit(OpCode::Inv, 0, depth, 1, 1);
+            return emit(OpCode::PowInt, static_cast<int>(k), depth, 1, 1);
+        }
+        depth = lower(exponent, depth);
+        return emit(OpCode::Pow, 0, depth, 2, 1);
+    }
+
+    // Constants like Pi and anything else that folds to a number
+    ex folded = e.evalf();
+    if (is_a<numeric>(folded)) return lower(folded, depth);
+
+    throw std::invalid_argument("Unsupported expression in a stamp program.");
+}
+
+int CompiledCircuit::parameterIndex(const symbol& sym) const {
+    for (size_t k = 0; k < parameters.size(); k++) {
+        if (parameters[k].is_equal(sym)) return static_cast<int>(k);
+    }
+    return -1;
+}
+
+// The interpreter, one small stack reused for every program
+
+template <typename T>
+void CompiledCircuit::run(const std::vector<double>& bindings, T s_value, std::vector<T>& values) const {
+    if (bindings.size() != parameters.size()) {
+        throw std::invalid_argument("Wrong number of bindings for the stamp program.");
+    }
+
+    std::vector<T> stack(max_stack + 1);
+    values.resize(programs.size());
+
+    for (size_t p = 0; p < programs.size(); p++) {
+        int top = -1;
+        for (int pc = programs[p].begin; pc < programs[p].end; pc++) {
+            const Instr& in = code[pc];
+            switch (in.op) {
+            case OpCode::Const: stack[++top] = T(constants[in.arg]); break;
+            case OpCode::Param: stack[++top] = T(bindings[in.arg]); break;
+            case OpCode::S: stack[++top] = s_value; break;
+            case OpCode::Add: stack[top - 1] += stack[top]; top--; break;
+            case OpCode::Mul: stack[top - 1] *= stack[top]; top--; break;
+            case OpCode::Inv: stack[top] = T(1) / stack[top]; break;
+            case OpCode::PowInt: {
+                T base = stack[top], result = T(1);
+                for (int k = std::abs(in.arg); k > 0; k--) result *= base;
+                stack[top] = in.arg < 0 ? T(1) / result : result;
+                break;
+            }
+            case OpCode::Pow: stack[top - 1] = std::pow(stack[top - 1], stack[top]); top--; break;
+            }
+        }
+        values[p] = stack[0];
+    }
+}
+
+template <typename T>
+void CompiledCircuit::fill(const std::vector<double>& bindings, T s_value, SparseMatrix<T>& G, std::vector<T>& rhs) const {
+    std::vector<T> values;
+    run(bindings, s_value, values);
+
+    if (G.nonZeros() != row_idx.size() || G.rows() != n) {
+        G = SparseMatrix<T>(n, n, col_ptr, row_idx);
+    }
+    auto& gx = G.getValues();
+    for (const auto& op : g_ops) gx[op.slot] = op.sign * values[op.value];
+
+    rhs.assign(n, T(0));
+    for (const auto& op : rhs_ops) rhs[op.slot] = op.sign * values[op.value];
+}
+
+void CompiledCircuit::evaluate(const std::vector<double>& bindings, SparseMatrix<double>& G, std::vector<double>& rhs) const {
+    fill(bindings, 0.0, G, rhs);
+}
+
+void CompiledCircuit::evaluate(const std::vector<double>& bindings, std::complex<double> s_value,
+    SparseMatrix<std::complex<double>>& G, std::vector<std::complex<double>>& rhs) const {
+    fill(bindings, s_value, G, rhs);
+}
+
+// Same interpreter, every stack slot holds one value per lane
+// The dispatch is paid once per instruction instead of once per instruction and sample
+
+void CompiledCircuit::evaluateBatch(const std::vector<double>& bindings, size_t lanes,
+    std::vector<double>& g_values, std::vector<double>& rhs) const {
+    if (lanes == 0 || bindings.size() != parameters.size() * lanes) {
+        throw std::invalid_argument("Wrong number of bindings for the batch stamp program.");
+    }
+
+    std::vector<double> stack((max_stack + 1) * lanes), values(programs.size() * lanes);
+    for (size_t p = 0; p < programs.size(); p++) {
+        int top = -1;
+        for (int pc = programs[p].begin; pc < programs[p].end; pc++) {
+            const Instr& in = code[pc];
+            if (in.op == OpCode::Const || in.op == OpCode::Param || in.op == OpCode::S) top++;
+            double* a = stack.data() + top * lanes; // Top of the stack after a push
+            double* b = top > 0 ? a - lanes : a;    // Left operand of the binary ops
+            switch (in.op) {
+            case OpCode::Const:
+                for (size_t l = 0; l < lanes; l++) a[l] = constants[in.arg];
+                break;
+            case OpCode::Param: {
+                const double* param = bindings.data() + in.arg * lanes;
+                for (size_t l = 0; l < lanes; l++) a[l] = param[l];
+                break;
+            }
+            case OpCode::S:
+                for (size_t l = 0; l < lanes; l++) a[l] = 0.0;
+                break;
+            case OpCode::Add:
+                for (size_t l = 0; l < lanes; l++) b[l] += a[l];
+                top--;
+                break;
+            case OpCode::Mul:
+                for (size_t l = 0; l < lanes; l++) b[l] *= a[l];
+                top--;
+                break;
+            case OpCode::Inv:
+                for (size_t l = 0; l < lanes; l++) a[l] = 1.0 / a[l];
+                break;
+            case OpCode::PowInt:
+                for (size_t l = 0; l < lanes; l++) {
+                    double base = a[l], result = 1.0;
+                    for (int k = std::abs(in.arg); k > 0; k--) result *= base;
+                    a[l] = in.arg < 0 ? 1.0 / result : result;
+                }
+                break;
+            case OpCode::Pow:
+                for (size_t l = 0; l < lanes; l++) b[l] = std::pow(b[l], a[l]);
+                top--;
+                break;
+            }
+        }
+        std::copy(stack.begin(), stack.begin() + lanes, values.begin() + p * lanes);
+    }
+
+    g_values.assign(row_idx.size() * lanes, 0.0);
+    for (const auto& op : g_ops) {
+        for (size_t l = 0; l < lanes; l++) g_values[op.slot * lanes + l] = op.sign * values[op.value * lanes + l];
+    }
+    rhs.assign(n * lanes, 0.0);
+    for (const auto& op : rhs_ops) {
+        for (size_t l = 0; l < lanes; l++) rhs[op.slot * lanes + l] = op.sign * values[op.value * lanes + l];
+    }
+}
+
+std::vector<double> CompiledCircuit::solve(const std::vector<double>& bindings) const {
+    SparseMatrix<double> G;
+    std::vector<double> rhs;
+    evaluate(bindings, G, rhs);
+
+    SparseLU<double> lu;
+    lu.factorize(G);
+    lu.solve(rhs);
+    return rhs;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "SparseMatrix.h"
+#include <vector>
+#include <complex>
+#include <ginac/ginac.h>
+
+using namespace GiNaC;
+
+// Stamp program
+// Every nonzero entry of the symbolic G and I is lowered once into stack bytecode,
+// re-evaluating the system for new parameter values is then a numeric loop without GiNaC allocations
+
+class CompiledCircuit
+{
+public:
+	enum class OpCode : unsigned char
+	{
+		Const,  // Push constants[arg]
+		Param,  // Push bindings[arg]
+		S,      // Push the Laplace variable
+		Add,    // Pop two, push sum
+		Mul,    // Pop two, push product
+		Inv,    // 1 / top
+		PowInt, // top ^ arg
+		Pow     // Pop exponent and base, push base ^ exponent
+	};
+
+	struct Instr
+	{
+		OpCode op;
+		int arg;
+	};
+
+private:
+	struct Program { int begin, end; }; // Range in code, leaves one value
+	struct EntryOp { int slot; int value; double sign; }; // slot is the CSC position in G or the row in I
+
+	size_t n = 0;
+	std::vector<int> col_ptr, row_idx; // Pattern of G
+	std::vector<symbol> parameters;
+	std::vector<double> constants;
+	std::vector<Instr> code;
+	std::vector<Program> programs; // One per distinct entry expression
+	std::vector<EntryOp> g_ops, rhs_ops;
+	int max_stack = 0;
+
+	int lower(const ex& e, int depth);
+	int emit(OpCode op, int arg, int depth, int pops, int pushes);
+
+	template <typename T>
+	void run(const std::vector<double>& bindings, T s_value, std::vector<T>& values) const;
+
+	template <typename T>
+	void fill(const std::vector<double>& bindings, T s_value, SparseMatrix<T>& G, std::vector<T>& rhs) const;
+
+public:
+	CompiledCircuit() = default;
+	CompiledCircuit(const matrix& G, const matrix& I);
+
+	// Free symbols found in the stamps, bindings are given in this order. s is not a parameter
+	const std::vector<symbol>& getParameters() const { return parameters; }
+	int parameterIndex(const symbol& sym) const; // -1 if the symbol doesn't appear
+
+	size_t size() const { return n; }
+	size_t nonZeros() const { return row_idx.size(); }
+	size_t instructions() const { return code.size(); }
+
+	// Evaluate G and I for new bindings, G keeps its pattern between calls
+	void evaluate(const std::vector<double>& bindings, SparseMatrix<double>& G, std::vector<double>& rhs) const;
+	void evaluate(const std::vector<double>& bindings, std::complex<double> s_value,
+		SparseMatrix<std::complex<double>>& G, std::vector<std::complex<double>>& rhs) const;
+
+	// Evaluate many parameter sets at once at s = 0, lane by lane so the inner loops vectorize
+	// bindings[p * lanes + l] is parameter p of set l, the outputs are laid out the same way:
+	// g_values[k * lanes + l] for the CSC entry k of G, rhs[i * lanes + l] for row i
+	void evaluateBatch(const std::vector<double>& bindings, size_t lanes, std::vector<double>& g_values, std::vector<double>& rhs) const;
+
+	// Evaluate and solve with the sparse LU
+	std::vector<double> solve(const std::vector<double>& bindings) const;
+};
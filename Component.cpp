@@ -1 +1,30 @@
 #include "Component.h"
+#include "Connectivity.h"
+#include "Topology.h"
+#include <stdexcept>
+
+bool isNumericValue(const ex& value) {
+    ex v = value.evalf();
+    return is_a<numeric>(v) && ex_to<numeric>(v).is_real();
+}
+
+double toDouble(const ex& value) {
+    ex v = value.evalf();
+    if (!is_a<numeric>(v) || !ex_to<numeric>(v).is_real()) {
+        throw std::invalid_argument("Value is not a real number.");
+    }
+    return ex_to<numeric>(v).to_double();
+}
+
+void CircuitElement::terminalsChanged() const {
+    if (auto owner = topology.lock()) owner->reconnect(*this);
+}
+
+void CircuitElement::valuesChanged() const {
+    if (auto owner = topology.lock()) owner->valuesChanged(*this);
+}
+
+void CircuitElement::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    size_t count = getTerminals().size();
+    for (size_t t = 0; t < count; t++) links.join(static_cast<int>(t), TerminalLinks::ground);
+}
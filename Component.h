@@ -1,16 +1,99 @@
 #pragma once
 #include "Node.h"
+#include "Topology.h"
+#include <stdexcept>
 #include <string>
 #include <memory>
+#include <vector>
 #include <ginac/ginac.h>
 
 using namespace GiNaC;
 
+enum class AnalysisType
+{
+    DC,
+    AC,
+    Transient
+};
+
+extern GiNaC::symbol s; // Laplace vairable where s = j * w
+extern GiNaC::symbol w; // Omega, angular velocity
+
+class NumericSystem; // Forward declaration
+class TerminalLinks;
+struct NoiseSource;
+
+// Helpers for the numeric backend
+
+bool isNumericValue(const ex& value); // True if value evaluates to a real number
+double toDouble(const ex& value); // Throws if value is not a real number
+
+// Element value converted once when it is set, next to its expression
+// Numeric stamps only read the double and never touch GiNaC, so they can run on several threads
+class NumericValue
+{
+	bool real = false;
+	double number = 0;
+
+public:
+	NumericValue() = default;
+	explicit NumericValue(const ex& value) : real(isNumericValue(value)), number(real ? toDouble(value) : 0.0) {}
+
+	bool isNumeric() const { return real; }
+	double value() const {
+		if (!real) throw std::invalid_argument("Value is not a real number.");
+		return number;
+	}
+};
+
 class CircuitElement {
+	friend class Topology;
+
+	std::weak_ptr<Topology> topology; // Owning circuit, see Node
+	int id = -1;
+	int branch = -1; // First extra MNA unknown of this element, assigned by the circuit
+
+protected:
+	void terminalsChanged() const; // Setters of the terminals call it to keep the topology current
+	void valuesChanged() const;    // Value setters call it, incremental solves only redo what changed
+
 public:
 	CircuitElement() = default;
+	CircuitElement(const CircuitElement&) = delete; // A copy would carry the id of the original
+	CircuitElement& operator=(const CircuitElement&) = delete;
 	virtual ~CircuitElement() = default;
+
+	int getElementIndex() const { return id; } // Dense id in the owning circuit, -1 before it is added
+
+	// Nodes the element connects, in a fixed order and count per element
+	virtual std::vector<std::shared_ptr<Node>> getTerminals() const = 0;
+
+	// Number of extra branch current unknowns the element adds to the MNA system
+	// Counted before assembly so G and I are allocated once
+	virtual size_t branchCount() const { return 0; }
+	void setBranchIndex(int idx) { branch = idx; }
+	int getBranchIndex() const { return branch; }
+
+	// Stamps add (+=) into matrices already sized for every node and branch
 	virtual void stamp(matrix &G, matrix& I, AnalysisType analysis) const = 0;
+
+	// Numeric stamping into G + s * C, see NumericSystem
+	// Runs on the assembly threads of Circuit::setAssemblyThreads(): it only reads doubles converted when the
+	// values were set (NumericValue) or during branchCount(), and never evaluates or copies a GiNaC expression
+	virtual void stampNumeric(NumericSystem& sys) const = 0;
+	virtual bool isNumeric() const = 0;
+
+	// dG, dC and drhs by the element's value (resistance, capacitance, inductance, source value, ratio or
+	// gain) at the numeric value, for adjoint sensitivities, see Sensitivity.h. False if it has no such value
+	virtual bool stampDerivative(NumericSystem& sys) const { return false; }
+
+	// Noise generators of the element at `temperature` (K) for the small signal noise analysis, appended to
+	// `sources`. See Noise.h, noiseless by default
+	virtual void noiseSources(std::vector<NoiseSource>& sources, double temperature) const {}
+
+	// Terminals the equations tie together, for the preflight check, see Connectivity.h
+	// By default every terminal is tied to ground, which never reports an error
+	virtual void linkTerminals(AnalysisType analysis, TerminalLinks& links) const;
 };
 
 class Component : public CircuitElement
@@ -26,8 +109,10 @@ public:
 	std::shared_ptr<Node> getInput() const  { return in; }
 	std::shared_ptr<Node> getOutput() const { return out; }
 
-	void setInput(std::shared_ptr<Node> input) { in = input; }
-	void setOutput(std::shared_ptr<Node> output) { out = output; }
+	void setInput(std::shared_ptr<Node> input) { in = input; terminalsChanged(); }
+	void setOutput(std::shared_ptr<Node> output) { out = output; terminalsChanged(); }
+
+	std::vector<std::shared_ptr<Node>> getTerminals() const override { return { in, out }; }
 
 	std::string getSym() const { return symbol; }
     void setSym(const std::string& sym) { symbol = sym; }
@@ -0,0 +1,252 @@
+#include "Connectivity.h"
+#include "Node.h"
+#include "Topology.h"
+#include <stdexcept>
+
+DisjointSets::DisjointSets(size_t n) : parent(n), weight(n, 1) {
+    for (size_t v = 0; v < n; v++) parent[v] = static_cast<int>(v);
+}
+
+int DisjointSets::find(int v) {
+    while (parent[v] != v) {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+bool DisjointSets::unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return false;
+    if (weight[a] < weight[b]) std::swap(a, b);
+    parent[b] = a;
+    weight[a] += weight[b];
+    return true;
+}
+
+// One pass over the links of every element
+// Node ids are the vertices, ground is vertex n. Fixed voltages and free currents keep the edges that
+// joined two sets, a later edge inside one set closes a loop, which is then traced along those edges
+
+class ConnectivityCheck
+{
+    struct Edge { int a, b, element; };
+
+    const Topology& topology;
+    const std::function<std::string(int)>& name;
+    size_t n;
+    IndexRange terminals;
+    std::vector<Edge> voltage_edges, current_edges;
+
+    int vertex(int element, int t) const {
+        if (t == TerminalLinks::ground) return static_cast<int>(n);
+        if (t < 0 || t >= static_cast<int>(terminals.size())) throw std::logic_error("Link to a terminal the element doesn't have.");
+        int node = terminals[t];
+        if (node == Topology::unconnected) {
+            throw std::runtime_error("Terminal " + std::to_string(t + 1) + " of " + name(element) + " is not connected.");
+        }
+        return node < 0 ? static_cast<int>(n) : node;
+    }
+
+    // Elements on the forest path from a to b, breadth first over the kept edges
+    std::vector<int> path(const std::vector<Edge>& edges, int a, int b) const {
+        std::vector<int> ptr(n + 2, 0), adj(2 * edges.size());
+        for (const Edge& edge : edges) {
+            ptr[edge.a + 1]++;
+            ptr[edge.b + 1]++;
+        }
+        for (size_t v = 0; v <= n; v++) ptr[v + 1] += ptr[v];
+        std::vector<int> next(ptr.begin(), ptr.end() - 1);
+        for (size_t k = 0; k < edges.size(); k++) {
+            adj[next[edges[k].a]++] = static_cast<int>(k);
+            adj[next[edges[k].b]++] = static_cast<int>(k);
+        }
+
+        std::vector<int> via(n + 1, -2), queue{ a };
+        via[a] = -1;
+        for (size_t head = 0; head < queue.size() && via[b] == -2; head++) {
+            int v = queue[head];
+            for (int p = ptr[v]; p < ptr[v + 1]; p++) {
+                const Edge& edge = edges[adj[p]];
+                int u = edge.a == v ? edge.b : edge.a;
+                if (via[u] != -2) continue;
+                via[u] = adj[p];
+                queue.push_back(u);
+            }
+        }
+        std::vector<int> elements;
+        for (int v = b; via[v] >= 0;) {
+            const Edge& edge = edges[via[v]];
+            elements.push_back(edge.element);
+            v = edge.a == v ? edge.b : edge.a;
+        }
+        return elements;
+    }
+
+    std::string loop(const std::vector<Edge>& edges, const Edge& closing) const {
+        std::string list = name(closing.element);
+        for (int e : path(edges, closing.a, closing.b)) list += ", " + name(e);
+        return list;
+    }
+
+    void close(DisjointSets& sets, std::vector<Edge>& edges, int element, int a, int b, bool voltage) {
+        Edge edge{ vertex(element, a), vertex(element, b), element };
+        if (sets.unite(edge.a, edge.b)) {
+            edges.push_back(edge);
+            return;
+        }
+        if (voltage) throw std::runtime_error("Loop of fixed voltages through " + loop(edges, edge) + ", its equations are dependent.");
+        throw std::runtime_error("Loop of voltage sources through " + loop(edges, edge) + ", the current around it is not determined.");
+    }
+
+public:
+    DisjointSets potentials, voltages, currents;
+
+    ConnectivityCheck(const Topology& graph, const std::function<std::string(int)>& label)
+        : topology(graph), name(label), n(graph.nodeCount()), potentials(n + 1), voltages(n + 1), currents(n + 1) {}
+
+    void join(int element, int a, int b) {
+        potentials.unite(vertex(element, a), vertex(element, b));
+    }
+
+    void fixVoltage(int element, int a, int b) {
+        join(element, a, b);
+        close(voltages, voltage_edges, element, a, b, true);
+    }
+
+    void freeCurrent(int element, int a, int b) {
+        join(element, a, b);
+        close(currents, current_edges, element, a, b, false);
+    }
+
+    void run(AnalysisType analysis) {
+        const auto& elements = topology.elementHandles();
+        for (size_t e = 0; e < elements.size(); e++) {
+            terminals = topology.terminalsOf(static_cast<int>(e));
+            TerminalLinks links(this, static_cast<int>(e));
+            elements[e]->linkTerminals(analysis, links);
+        }
+    }
+};
+
+void TerminalLinks::join(int a, int b) {
+    check->join(element, a, b);
+}
+
+void TerminalLinks::fixVoltage(int a, int b) {
+    check->fixVoltage(element, a, b);
+}
+
+void TerminalLinks::freeCurrent(int a, int b) {
+    check->freeCurrent(element, a, b);
+}
+
+void checkConnectivity(const Topology& topology, AnalysisType analysis, const std::function<std::string(int)>& elementName) {
+    ConnectivityCheck check(topology, elementName);
+    check.run(analysis);
+
+    // The first floating island, by its lowest node
+    int n = static_cast<int>(topology.nodeCount());
+    int ground = check.potentials.find(n), root = -1;
+    for (int v = 0; v < n && root < 0; v++) {
+        if (check.potentials.find(v) != ground) root = check.potentials.find(v);
+    }
+    if (root < 0) return;
+
+    const auto& nodes = topology.nodeHandles();
+    std::string list;
+    int count = 0, first = -1;
+    for (int v = 0; v < n; v++) {
+        if (check.potentials.find(v) != root) continue;
+        if (first < 0) first = v;
+        if (count++ < 8) list += (count > 1 ? ", " : "") + nodes[v]->getSym();
+    }
+    if (count > 8) list += " and " + std::to_string(count - 8) + " more";
+
+    // At DC the island may only hang on capacitors
+    if (analysis == AnalysisType::DC) {
+        ConnectivityCheck ac(topology, elementName);
+        ac.run(AnalysisType::AC);
+        if (ac.potentials.find(first) == ac.potentials.find(n)) {
+            throw std::runtime_error("No DC path to ground from " + list + ", only capacitors connect them.");
+        }
+    }
+    throw std::runtime_error("Floating nodes " + list + ", no element ties their potential to ground.");
+}
+
+Subnetworks splitSubnetworks(const Topology& topology, size_t unknowns) {
+    size_t n = topology.nodeCount();
+    const auto& elements = topology.elementHandles();
+    DisjointSets sets(n);
+    for (size_t e = 0; e < elements.size(); e++) {
+        int first = -1;
+        for (int t : topology.terminalsOf(static_cast<int>(e))) {
+            if (t < 0) continue;
+            if (first < 0) first = t;
+            else sets.unite(first, t);
+        }
+    }
+
+    // Parts numbered by their lowest node, elements without a node terminal make their own part
+    Subnetworks parts;
+    parts.unknown_part.assign(unknowns, -1);
+    parts.element_part.assign(elements.size(), -1);
+    std::vector<int> part_of_root(n, -1);
+    size_t count = 0;
+    for (size_t v = 0; v < n; v++) {
+        int root = sets.find(static_cast<int>(v));
+        if (part_of_root[root] < 0) part_of_root[root] = static_cast<int>(count++);
+        parts.unknown_part[v] = part_of_root[root];
+    }
+    for (size_t e = 0; e < elements.size(); e++) {
+        int part = -1;
+        for (int t : topology.terminalsOf(static_cast<int>(e))) {
+            if (t >= 0) {
+                part = parts.unknown_part[t];
+                break;
+            }
+        }
+        size_t branches = elements[e]->branchCount();
+        if (part < 0) part = branches || count == 0 ? static_cast<int>(count++) : 0;
+        parts.element_part[e] = part;
+        int branch = elements[e]->getBranchIndex();
+        for (size_t k = 0; k < branches; k++) parts.unknown_part[branch + k] = part;
+    }
+
+    parts.unknowns.resize(count);
+    parts.elements.resize(count);
+    for (size_t k = 0; k < unknowns; k++) parts.unknowns[parts.unknown_part[k]].push_back(static_cast<int>(k));
+    for (size_t e = 0; e < elements.size(); e++) parts.elements[parts.element_part[e]].push_back(static_cast<int>(e));
+    return parts;
+}
+
+std::vector<NumericSystem> extractSubnetworks(const NumericSystem& sys, const Subnetworks& parts) {
+    std::vector<int> local(sys.size());
+    std::vector<NumericSystem> systems;
+    systems.reserve(parts.count());
+    for (const auto& unknowns : parts.unknowns) {
+        systems.emplace_back(unknowns.size());
+        for (size_t k = 0; k < unknowns.size(); k++) {
+            local[unknowns[k]] = static_cast<int>(k);
+            systems.back().rhs[k] = sys.rhs[unknowns[k]];
+        }
+    }
+
+    for (size_t e = 0; e + 1 < sys.element_g.size(); e++) {
+        NumericSystem& part = systems[parts.element_part[e]];
+        part.element_g.push_back(part.G.entries());
+        part.element_c.push_back(part.C.entries());
+        for (size_t k = sys.element_g[e]; k < sys.element_g[e + 1]; k++) {
+            part.G.add(local[sys.G.row(k)], local[sys.G.col(k)], sys.G.value(k));
+        }
+        for (size_t k = sys.element_c[e]; k < sys.element_c[e + 1]; k++) {
+            part.C.add(local[sys.C.row(k)], local[sys.C.col(k)], sys.C.value(k));
+        }
+    }
+    for (auto& part : systems) {
+        part.element_g.push_back(part.G.entries());
+        part.element_c.push_back(part.C.entries());
+    }
+    return systems;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "Component.h"
+#include "NumericSystem.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Topology;
+class ConnectivityCheck;
+
+// Union-find over dense ids, path halving and union by size, O(α(n)) per operation
+class DisjointSets
+{
+	std::vector<int> parent, weight;
+
+public:
+	explicit DisjointSets(size_t n = 0);
+
+	int find(int v);
+	bool unite(int a, int b); // False if a and b were in one set already
+	size_t size() const { return parent.size(); }
+};
+
+// What an element's equations tie together, reported by CircuitElement::linkTerminals()
+// Terminals are positions in getTerminals(), `ground` is the ground node. The preflight (checkConnectivity)
+// finds structurally singular circuits from these links alone:
+//  - nodes whose potentials no link ties to ground can all move by one constant, the matrix is singular
+//  - a loop of fixed voltages has dependent equations, a loop of free currents an undetermined current
+
+class TerminalLinks
+{
+	friend class ConnectivityCheck;
+	ConnectivityCheck* check;
+	int element;
+
+	TerminalLinks(ConnectivityCheck* owner, int e) : check(owner), element(e) {}
+
+public:
+	static constexpr int ground = -1;
+
+	// The equations see the potentials of a and b only through V(a) - V(b)
+	void join(int a, int b);
+
+	// V(a) - V(b) is fixed by an equation without any other unknown (sources, inductors at DC, current probes)
+	void fixVoltage(int a, int b);
+
+	// Branch current from a to b that no equation but the two KCL rows reads (sources, inductors at DC,
+	// VCVS and CCVS outputs)
+	void freeCurrent(int a, int b);
+};
+
+// Throws std::runtime_error naming the floating nodes, the loop or the unconnected terminal if the links
+// of the elements make the MNA system singular for any element values. Linear in the circuit size
+// `elementName` labels elements in the message
+void checkConnectivity(const Topology& topology, AnalysisType analysis, const std::function<std::string(int)>& elementName);
+
+// Parts of the circuit that only share ground, their MNA systems are independent
+struct Subnetworks
+{
+	std::vector<std::vector<int>> unknowns; // MNA unknowns of every part, ascending
+	std::vector<std::vector<int>> elements; // Element ids of every part, ascending
+	std::vector<int> unknown_part, element_part; // Part of every unknown and element
+
+	size_t count() const { return unknowns.size(); }
+};
+
+// Every element couples all of its terminals, branch unknowns join the part of their element. Branch
+// indices have to be assigned
+Subnetworks splitSubnetworks(const Topology& topology, size_t unknowns);
+
+// Stamps of every part on its own unknowns, local index k is parts.unknowns[p][k] and the element
+// offsets follow parts.elements[p]
+std::vector<NumericSystem> extractSubnetworks(const NumericSystem& sys, const Subnetworks& parts);
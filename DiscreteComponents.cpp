@@ -1,5 +1,8 @@
 #include "DiscreteComponents.h"
 #include "Component.h"
+#include "Connectivity.h"
+#include "Noise.h"
+#include "NumericSystem.h"
 #include <complex>
 #include <optional>
 #include <stdexcept>
@@ -7,30 +10,12 @@
 
 using namespace GiNaC;
 
-// Method to resize symbolic matrix
-// This function resizes the matrix to the new dimensions and fills in the new elements with zeros
+// Add a value to M(row, col)
+// Entries on the ground node (idx == -1) are skipped, the matrices only hold the non-ground unknowns
 
-matrix resize_matrix(const GiNaC::matrix& original, size_t new_rows, size_t new_cols) {
-    // Check if we need to resize
-    if (original.rows() == new_rows && original.cols() == new_cols) {
-        return original; // No need to resize
-    }
-
-    // Initialize new matrix with desired parameters
-    matrix resized(new_rows, new_cols);
-
-    // Calculate the number of rows and cols to copy
-    size_t copy_rows = std::min(static_cast<size_t>(original.rows()), new_rows);
-    size_t copy_cols = std::min(static_cast<size_t>(original.cols()), new_cols);
-
-    // Copy
-    for (int i = 0; i < copy_rows; i++) {
-        for (int j = 0; j < copy_cols; j++) {
-            resized(i, j) = original(i, j);
-        }
-    }
-
-    return resized;
+void stampEntry(matrix& M, int row, int col, const ex& value) {
+    if (row == -1 || col == -1) return;
+    M(row, col) += value;
 }
 
 // Linear Resistor stamping
@@ -54,18 +39,14 @@ void Resistor::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
 
 void VoltageSource::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
     int i = getInput()->getIndex(), j = getOutput()->getIndex();
-    int vs_row = G.rows(); // Add a new vairable for current flow
-
-    // Resize the matrices if necessary
-    G = resize_matrix(G, vs_row + 1, vs_row + 1);
-    I = resize_matrix(I, vs_row + 1, 1);
+    int k = getBranchIndex(); // Current through the source
 
     // V_i - V_j = voltage
-    G(vs_row, i) = 1;
-    G(vs_row, j) = -1;
-    G(i, vs_row) = 1;
-    G(j, vs_row) = -1;
-    I(vs_row, 0) = voltage; // Set the voltage source value
+    stampEntry(G, k, i, 1);
+    stampEntry(G, k, j, -1);
+    stampEntry(G, i, k, 1);
+    stampEntry(G, j, k, -1);
+    stampEntry(I, k, 0, voltage);
 }
 
 // Independent Current SourceTable B.8
@@ -91,46 +72,221 @@ void Capacitor::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
     // AC: Lapalace domain Z = 1 / (jw * C)
     else if (analysis == AnalysisType::AC) {
         ex Y = s * capacitance; // Conductance in laplace domain
-        G(i, i) += Y;
-        G(j, j) += Y;
-        G(i, j) -= Y;
-        G(j, i) -= Y;
+        stampEntry(G, i, i, Y);
+        stampEntry(G, j, j, Y);
+        stampEntry(G, i, j, -Y);
+        stampEntry(G, j, i, -Y);
     }
 
-    else if (analysis == AnalysisType::Transient) {
-        // TODO: Implement transient analysis for capacitor
-    }
+    // Transient: companion models are formed on the numeric G + sC system, see Transient.h
 }
 
 // Inductor (Laplace Domain, Table B.4)
+// The branch current is kept in every analysis so the MNA layout doesn't depend on it
+// V_i - V_j - s * L * I_L = 0
 
 void Inductor::stamp(matrix&G, matrix& I, AnalysisType analysis) const {
     int i = getInput()->getIndex(), j = getOutput()->getIndex();
+    int k = getBranchIndex();
+
+    stampEntry(G, k, i, 1);
+    stampEntry(G, k, j, -1);
+    stampEntry(G, i, k, 1);
+    stampEntry(G, j, k, -1);
 
     if (analysis == AnalysisType::DC) {
-        // Short circuit
-        int vs_row = G.rows();
-        G = resize_matrix(G, vs_row + 1, vs_row + 1);
-        I = resize_matrix(I, vs_row + 1, 1);
-
-        G(vs_row, i) += 1;
-        G(vs_row, j) -= 1;
-        G(i, vs_row) += 1;
-        G(j, vs_row) -= 1;
-        // I(vs_row, 0) = 0; no current flowing
+        // Short circuit, I(k, 0) = 0
     }
 
     if (analysis == AnalysisType::AC) {
         // Laplace domain Z = jw * L
-        ex Y = 1 / (s * inductance); // Conductance 1 / Z = 1 / (s * L) where s = j * w is the Laplace variable
-
-        G(i, i) += Y;
-        G(j, j) += Y;
-        G(i, j) -= Y;
-        G(j, i) -= Y;
+        stampEntry(G, k, k, -s * inductance);
     }
 
-    if (analysis == AnalysisType::Transient) {
-        // TODO: Implement transient analysis for inductor
+    // Transient: companion models are formed on the numeric G + sC system, see Transient.h
+}
+
+// Generic dynamic component, Y = 1 / Z(s)
+
+void DynamicComponent::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
+    int i = getInput()->getIndex(), j = getOutput()->getIndex();
+
+    ex Y = 1 / impedance;
+
+    stampEntry(G, i, i, Y);
+    stampEntry(G, j, j, Y);
+    stampEntry(G, i, j, -Y);
+    stampEntry(G, j, i, -Y);
+}
+
+// Numeric stamps for the sparse backend
+// Same tables as above, split into G + s * C, in the stampAt() kernels of the header. Ground rows are
+// dropped by the triplet storage
+
+void Resistor::stampNumeric(NumericSystem& sys) const {
+    int nodes[] = { getInput()->getIndex(), getOutput()->getIndex() };
+    stampAt(sys, nodes);
+}
+
+bool Resistor::isNumeric() const {
+    return numeric.isNumeric();
+}
+
+void VoltageSource::stampNumeric(NumericSystem& sys) const {
+    int nodes[] = { getInput()->getIndex(), getOutput()->getIndex() };
+    stampAt(sys, nodes);
+}
+
+bool VoltageSource::isNumeric() const {
+    return numeric.isNumeric();
+}
+
+void CurrentSource::stampNumeric(NumericSystem& sys) const {
+    int nodes[] = { getInput()->getIndex(), getOutput()->getIndex() };
+    stampAt(sys, nodes);
+}
+
+bool CurrentSource::isNumeric() const {
+    return numeric.isNumeric();
+}
+
+// Y = 1 / Z(s) is split once when the impedance is set. Frequency independent impedances and
+// admittances like g + s * C of a parallel RC (a polynomial of degree 1 in s) can be stamped numerically
+
+void DynamicComponent::splitAdmittance() {
+    linear = false;
+    if (impedance.is_zero()) return;
+    ex Y = normal(1 / impedance);
+    if (!Y.is_polynomial(s) || Y.degree(s) > 1) return;
+    ex g0 = Y.coeff(s, 0), c1 = Y.coeff(s, 1);
+    if (!isNumericValue(g0) || !isNumericValue(c1)) return;
+    g = toDouble(g0);
+    c = toDouble(c1);
+    linear = true;
+}
+
+void DynamicComponent::stampNumeric(NumericSystem& sys) const {
+    if (!linear) throw std::invalid_argument("Admittance of " + getSym() + " is not g + s * c with real g and c.");
+    int i = getInput()->getIndex(), j = getOutput()->getIndex();
+
+    sys.G.add(i, i, g);
+    sys.G.add(j, j, g);
+    sys.G.add(i, j, -g);
+    sys.G.add(j, i, -g);
+    if (c == 0) return;
+    sys.C.add(i, i, c);
+    sys.C.add(j, j, c);
+    sys.C.add(i, j, -c);
+    sys.C.add(j, i, -c);
+}
+
+bool DynamicComponent::isNumeric() const {
+    return linear;
+}
+
+void Capacitor::stampNumeric(NumericSystem& sys) const {
+    int nodes[] = { getInput()->getIndex(), getOutput()->getIndex() };
+    stampAt(sys, nodes);
+}
+
+bool Capacitor::isNumeric() const {
+    return numeric.isNumeric();
+}
+
+void Inductor::stampNumeric(NumericSystem& sys) const {
+    int nodes[] = { getInput()->getIndex(), getOutput()->getIndex() };
+    stampAt(sys, nodes);
+}
+
+bool Inductor::isNumeric() const {
+    return numeric.isNumeric();
+}
+
+// Derivative stamps, the numeric stamps with every entry differentiated by the element's value
+// d(1 / R) / dR = -1 / R^2, the other values enter their stamps linearly
+
+bool Resistor::stampDerivative(NumericSystem& sys) const {
+    int i = getInput()->getIndex(), j = getOutput()->getIndex();
+    double r = numeric.value();
+    double dg = -1.0 / (r * r);
+
+    sys.G.add(i, i, dg);
+    sys.G.add(j, j, dg);
+    sys.G.add(i, j, -dg);
+    sys.G.add(j, i, -dg);
+    return true;
+}
+
+bool VoltageSource::stampDerivative(NumericSystem& sys) const {
+    sys.addRHS(getBranchIndex(), 1);
+    return true;
+}
+
+bool CurrentSource::stampDerivative(NumericSystem& sys) const {
+    sys.addRHS(getInput()->getIndex(), -1);
+    sys.addRHS(getOutput()->getIndex(), 1);
+    return true;
+}
+
+bool Capacitor::stampDerivative(NumericSystem& sys) const {
+    int i = getInput()->getIndex(), j = getOutput()->getIndex();
+
+    sys.C.add(i, i, 1);
+    sys.C.add(j, j, 1);
+    sys.C.add(i, j, -1);
+    sys.C.add(j, i, -1);
+    return true;
+}
+
+bool Inductor::stampDerivative(NumericSystem& sys) const {
+    int k = getBranchIndex();
+    sys.C.add(k, k, -1);
+    return true;
+}
+
+// Noise generators, see Noise.h. Thermal noise 4kT / R of a resistor, the sources carry a set density
+
+void Resistor::noiseSources(std::vector<NoiseSource>& sources, double temperature) const {
+    sources.push_back({ getInput()->getIndex(), getOutput()->getIndex(), 4 * boltzmann * temperature / numeric.value() });
+}
+
+void VoltageSource::noiseSources(std::vector<NoiseSource>& sources, double temperature) const {
+    if (noise > 0) sources.push_back({ -1, getBranchIndex(), noise });
+}
+
+void CurrentSource::noiseSources(std::vector<NoiseSource>& sources, double temperature) const {
+    if (noise > 0) sources.push_back({ getInput()->getIndex(), getOutput()->getIndex(), noise });
+}
+
+// Preflight links, see Connectivity.h. Terminal 0 is the input, 1 the output
+// A capacitor is open at DC and an inductor a short, so at DC only the inductor fixes a voltage
+
+void Resistor::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    links.join(0, 1);
+}
+
+void VoltageSource::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    links.fixVoltage(0, 1);
+    links.freeCurrent(0, 1);
+}
+
+void CurrentSource::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    // Only the rhs, nothing ties the potentials of its terminals
+}
+
+void DynamicComponent::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    links.join(0, 1);
+}
+
+void Capacitor::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    if (analysis != AnalysisType::DC) links.join(0, 1);
+}
+
+void Inductor::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    if (analysis != AnalysisType::DC) {
+        links.join(0, 1);
+        return;
     }
-}
\ No newline at end of file
+    links.fixVoltage(0, 1);
+    links.freeCurrent(0, 1);
+}
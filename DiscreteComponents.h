@@ -1,32 +1,49 @@
 #pragma once
 #include "Component.h"
+#include "NumericSystem.h"
 #include <complex>
 #include <stdexcept>
 #include <ginac/ginac.h>
-#include "Circuit.h"
 
 using namespace GiNaC;
 
-// Utility function used to resize symbolic matrices
+// Utility function used by the symbolic stamps, skips the ground node
 
-matrix resize_matrix(const GiNaC::matrix& original, size_t new_rows, size_t new_cols);
+void stampEntry(matrix& M, int row, int col, const ex& value);
 
 // Linear Resistor
 
 class Resistor : public Component
 {
 	ex resistance; // Purely resistive, no impedance or imaginary part
+	NumericValue numeric;
 
 public:
-	Resistor() : Component(), resistance(ex(0)) {}
+	Resistor() : Component(), resistance(ex(0)), numeric(resistance) {}
     Resistor(const std::string& sym, const ex& res, std::shared_ptr<Node> input = nullptr,
 		std::shared_ptr<Node> output = nullptr)
-        : Component("R" + sym, input, output), resistance(res) {}
+        : Component("R" + sym, input, output), resistance(res), numeric(res) {}
 
 	ex getResistance() const { return resistance; }
-    void setResistance(const ex& res) { resistance = res; }
+    void setResistance(const ex& res) { resistance = res; numeric = NumericValue(res); valuesChanged(); }
 
 	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	// Numeric stamp on the node ids of getTerminals(), stampNumeric() without the virtual call and the node
+	// handles. The element arena runs it type by type, see Arena.h
+	void stampAt(NumericSystem& sys, const int* nodes) const {
+		int i = nodes[0], j = nodes[1];
+		double g = 1.0 / numeric.value();
+
+		sys.G.add(i, i, g);
+		sys.G.add(j, j, g);
+		sys.G.add(i, j, -g);
+		sys.G.add(j, i, -g);
+	}
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	void noiseSources(std::vector<NoiseSource>& sources, double temperature) const override;
+	bool isNumeric() const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 // Ideal voltage source
@@ -34,87 +51,172 @@ public:
 class VoltageSource : public Component
 {
 	ex voltage;
+	NumericValue numeric;
+	double noise = 0; // V^2 / Hz
 
 public:
-	VoltageSource() : Component(), voltage(ex(0)) {}
+	VoltageSource() : Component(), voltage(ex(0)), numeric(voltage) {}
 	VoltageSource(const std::string& sym, ex &volt ,std::shared_ptr<Node> input = nullptr,
 		std::shared_ptr<Node> output = nullptr)
-        : Component("V" + sym, input, output), voltage(volt) {}
+        : Component("V" + sym, input, output), voltage(volt), numeric(volt) {}
 
 	ex getVoltage() const { return voltage; }
-	void setVoltage(ex volt) { voltage = volt; }
+	void setVoltage(ex volt) { voltage = volt; numeric = NumericValue(volt); valuesChanged(); }
+
+	// White noise in series with the source, V^2 / Hz. Only the noise analysis sees it
+	double getNoiseDensity() const { return noise; }
+	void setNoiseDensity(double density) { noise = density; }
+
+	size_t branchCount() const override { return 1; }
 
 	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampAt(NumericSystem& sys, const int* nodes) const {
+		int i = nodes[0], j = nodes[1], k = getBranchIndex();
+
+		sys.G.add(k, i, 1);
+		sys.G.add(k, j, -1);
+		sys.G.add(i, k, 1);
+		sys.G.add(j, k, -1);
+		sys.addRHS(k, numeric.value());
+	}
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	void noiseSources(std::vector<NoiseSource>& sources, double temperature) const override;
+	bool isNumeric() const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 
 };
 
 class CurrentSource : public Component
 {
 	ex current;
+	NumericValue numeric;
+	double noise = 0; // A^2 / Hz
 
 public:
-	CurrentSource() : Component(), current(ex(0)) {}
+	CurrentSource() : Component(), current(ex(0)), numeric(current) {}
 	CurrentSource(const std::string& sym, ex &curr, std::shared_ptr<Node> input = nullptr,
 		std::shared_ptr<Node> output = nullptr)
-		: Component("I" + sym, input, output), current(curr) {}
+		: Component("I" + sym, input, output), current(curr), numeric(curr) {}
 	ex getCurrent() { return current; }
-	void setCurrent(ex curr) { current = curr; }
+	void setCurrent(ex curr) { current = curr; numeric = NumericValue(curr); valuesChanged(); }
+
+	// White noise in parallel with the source, A^2 / Hz. Only the noise analysis sees it
+	double getNoiseDensity() const { return noise; }
+	void setNoiseDensity(double density) { noise = density; }
 
 	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampAt(NumericSystem& sys, const int* nodes) const {
+		double value = numeric.value();
+		sys.addRHS(nodes[0], -value); // Current leaves the input node
+		sys.addRHS(nodes[1], value);  // and enters the output node
+	}
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	void noiseSources(std::vector<NoiseSource>& sources, double temperature) const override;
+	bool isNumeric() const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 
 
 // Virtual base class for dynamic components
+// Numeric when the admittance 1 / Z(s) is g + s * c with real g and c, which stamps g into G and c into C
 
 class DynamicComponent : public Component
 {
 	ex impedance; // s*L, 1/(s*C), where s = j*w
+	bool linear = false; // Admittance of the form above, g + s * c
+	double g = 0, c = 0;
+
+	void splitAdmittance();
+
+protected:
+	// Capacitor and Inductor stamp their own value, they skip the admittance split
+	struct OwnStamps {};
+	DynamicComponent(OwnStamps, const std::string& sym, const ex& imp, std::shared_ptr<Node> input,
+		std::shared_ptr<Node> output)
+		: Component(sym, input, output), impedance(imp) {}
 
 public:
 	DynamicComponent() : Component(), impedance(ex(0)) {}
 	DynamicComponent(const std::string& sym, const ex& imp, std::shared_ptr<Node> input = nullptr,
 		std::shared_ptr<Node> output = nullptr)
-		: Component(sym, input, output), impedance(imp) {}
+		: Component(sym, input, output), impedance(imp) { splitAdmittance(); }
 	~DynamicComponent() override = default;
 
 	ex getImpedance() const { return impedance; }
-	void setImpedance(const ex& imp) { impedance = imp; }
+	void setImpedance(const ex& imp) { impedance = imp; splitAdmittance(); valuesChanged(); }
 
 	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampNumeric(NumericSystem& sys) const override;
+	bool isNumeric() const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 class Capacitor : public DynamicComponent
 {	
 	ex capacitance;
+	NumericValue numeric;
 
 public:
-	Capacitor() : DynamicComponent(), capacitance(ex(0)) {}
+	Capacitor() : DynamicComponent(), capacitance(ex(0)), numeric(capacitance) {}
 	Capacitor(const std::string& sym, const ex& C, std::shared_ptr<Node> input = nullptr,
 		std::shared_ptr<Node> output = nullptr)
-		: DynamicComponent("C" + sym, 1 / (s * C), input, output),
-		capacitance(C) {}
+		: DynamicComponent(OwnStamps(), "C" + sym, 1 / (s * C), input, output),
+		capacitance(C), numeric(C) {}
 	
 	ex getCapacitance() { return capacitance; }
-	void setCapacitance(ex& C) { capacitance = C; }
+	void setCapacitance(ex& C) { capacitance = C; numeric = NumericValue(C); valuesChanged(); }
 
 	// AC stamping for MNA
 	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	// Only contributes to C, so it drops out (open circuit) at DC
+	void stampAt(NumericSystem& sys, const int* nodes) const {
+		int i = nodes[0], j = nodes[1];
+		double c = numeric.value();
+
+		sys.C.add(i, i, c);
+		sys.C.add(j, j, c);
+		sys.C.add(i, j, -c);
+		sys.C.add(j, i, -c);
+	}
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	bool isNumeric() const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 class Inductor : public DynamicComponent
 {
 	ex inductance;
+	NumericValue numeric;
 
 public:
-	Inductor() : DynamicComponent(), inductance(ex(0)) {}
+	Inductor() : DynamicComponent(), inductance(ex(0)), numeric(inductance) {}
 	Inductor(const std::string& sym, const ex& L, std::shared_ptr<Node> input = nullptr,
 		std::shared_ptr<Node> output = nullptr)
-		: DynamicComponent("L" + sym, s * L, input, output),
-		inductance(L) {}
+		: DynamicComponent(OwnStamps(), "L" + sym, s * L, input, output),
+		inductance(L), numeric(L) {}
 
 	ex getInductance() { return inductance; }
-	void setInductance(ex& ind) { inductance = ind; }
+	void setInductance(ex& ind) { inductance = ind; numeric = NumericValue(ind); valuesChanged(); }
+
+	size_t branchCount() const override { return 1; }
 
 	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	// Same branch equation as the symbolic stamp, at DC the s term vanishes and leaves the short circuit
+	void stampAt(NumericSystem& sys, const int* nodes) const {
+		int i = nodes[0], j = nodes[1], k = getBranchIndex();
+
+		sys.G.add(k, i, 1);
+		sys.G.add(k, j, -1);
+		sys.G.add(i, k, 1);
+		sys.G.add(j, k, -1);
+		sys.C.add(k, k, -numeric.value());
+	}
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	bool isNumeric() const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
@@ -0,0 +1,310 @@
+#include "DomainSolver.h"
+#include "Ordering.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+// Symbolic phase
+// 1. unknowns that couple two domains in the pattern of A join the interface (controlled sources and
+//    elements that sense the branch current of another element aren't seen by the node graph)
+// 2. a block without a perfect matching gives its unmatched rows and columns to the interface, until
+//    every block is structurally nonsingular
+// 3. the blocks are analysed in parallel, S gets a dense border_rows x border_cols block per domain
+
+template <typename T>
+bool DomainSolver<T>::analyze(const SparseMatrix<T>& A, std::vector<int> domain) {
+    n = A.rows();
+    nnz = A.nonZeros();
+    domains.clear();
+    interface.clear();
+    interface_source.clear();
+    interface_pos.clear();
+    if (A.cols() != n || domain.size() != n) {
+        throw std::invalid_argument("Domain split does not match the matrix size.");
+    }
+    const auto& Ap = A.colPtr();
+    const auto& Ai = A.rowIdx();
+
+    for (size_t j = 0; j < n; j++) {
+        for (int p = Ap[j]; p < Ap[j + 1]; p++) {
+            int d = domain[Ai[p]];
+            if (d >= 0 && domain[j] >= 0 && d != domain[j]) domain[j] = -1;
+        }
+    }
+
+    size_t k = 0;
+    for (int d : domain) k = std::max(k, static_cast<size_t>(d + 1));
+    std::vector<int> local(n);
+    std::vector<std::vector<int>> members;
+    for (int round = 0;; round++) {
+        members.assign(k, {});
+        for (size_t j = 0; j < n; j++) {
+            if (domain[j] < 0) continue;
+            local[j] = static_cast<int>(members[domain[j]].size());
+            members[domain[j]].push_back(static_cast<int>(j));
+        }
+
+        std::vector<std::vector<int>> moved(k);
+        parallelFor(k, 1, threads, [&](size_t begin, size_t end, unsigned) {
+            std::vector<int> ptr, idx, match;
+            for (size_t d = begin; d < end; d++) {
+                const auto& unknowns = members[d];
+                size_t m = unknowns.size();
+                ptr.assign(1, 0);
+                idx.clear();
+                for (int j : unknowns) {
+                    for (int p = Ap[j]; p < Ap[j + 1]; p++) {
+                        if (domain[Ai[p]] == static_cast<int>(d)) idx.push_back(local[Ai[p]]);
+                    }
+                    ptr.push_back(static_cast<int>(idx.size()));
+                }
+                if (maximumTransversal(m, ptr, idx, match) == m) continue;
+
+                std::vector<char> matched(m, 0);
+                for (size_t j = 0; j < m; j++) {
+                    if (match[j] >= 0) matched[match[j]] = 1;
+                    else moved[d].push_back(unknowns[j]);
+                }
+                for (size_t i = 0; i < m; i++) {
+                    if (!matched[i]) moved[d].push_back(unknowns[i]);
+                }
+            }
+        });
+
+        bool changed = false;
+        for (const auto& list : moved) {
+            for (int j : list) domain[j] = -1;
+            changed = changed || !list.empty();
+        }
+        if (!changed) break;
+        if (round == 8) return false;
+    }
+
+    members.erase(std::remove_if(members.begin(), members.end(), [](const std::vector<int>& list) { return list.empty(); }),
+        members.end());
+    if (members.size() < 2) return false;
+    k = members.size();
+    for (size_t d = 0; d < k; d++) {
+        for (int j : members[d]) domain[j] = static_cast<int>(d);
+    }
+
+    std::vector<int> position(n, -1);
+    for (size_t j = 0; j < n; j++) {
+        if (domain[j] != -1) continue;
+        position[j] = static_cast<int>(interface.size());
+        interface.push_back(static_cast<int>(j));
+    }
+    size_t ni = interface.size();
+
+    // A_iΓ by interface column, and A_ΓΓ
+    struct Entry { int row, col, source; };
+    std::vector<std::vector<Entry>> right(k);
+    std::vector<Entry> inner;
+    for (size_t q = 0; q < ni; q++) {
+        int j = interface[q];
+        for (int p = Ap[j]; p < Ap[j + 1]; p++) {
+            int i = Ai[p], d = domain[i];
+            if (d >= 0) right[d].push_back({ local[i], static_cast<int>(q), p });
+            else inner.push_back({ position[i], static_cast<int>(q), p });
+        }
+    }
+
+    domains.resize(k);
+    std::atomic<bool> singular(false); // Set by any worker
+    parallelFor(k, 1, threads, [&](size_t begin, size_t end, unsigned) {
+        for (size_t d = begin; d < end; d++) {
+            Domain& dom = domains[d];
+            dom.unknowns = std::move(members[d]);
+            size_t m = dom.unknowns.size();
+
+            std::vector<int> ptr(1, 0), idx;
+            dom.bottom_ptr.assign(1, 0);
+            for (int j : dom.unknowns) {
+                for (int p = Ap[j]; p < Ap[j + 1]; p++) {
+                    int i = Ai[p];
+                    if (domain[i] == static_cast<int>(d)) {
+                        idx.push_back(local[i]);
+                        dom.block_source.push_back(p);
+                    }
+                    else {
+                        dom.bottom_idx.push_back(position[i]);
+                        dom.bottom_source.push_back(p);
+                    }
+                }
+                ptr.push_back(static_cast<int>(idx.size()));
+                dom.bottom_ptr.push_back(static_cast<int>(dom.bottom_idx.size()));
+            }
+            dom.border_rows = dom.bottom_idx;
+            std::sort(dom.border_rows.begin(), dom.border_rows.end());
+            dom.border_rows.erase(std::unique(dom.border_rows.begin(), dom.border_rows.end()), dom.border_rows.end());
+            for (int& row : dom.bottom_idx) {
+                row = static_cast<int>(std::lower_bound(dom.border_rows.begin(), dom.border_rows.end(), row) - dom.border_rows.begin());
+            }
+
+            dom.right_ptr.assign(1, 0);
+            for (size_t e = 0; e < right[d].size(); e++) {
+                const Entry& entry = right[d][e];
+                if (dom.border_cols.empty() || dom.border_cols.back() != entry.col) {
+                    if (!dom.border_cols.empty()) dom.right_ptr.push_back(static_cast<int>(e));
+                    dom.border_cols.push_back(entry.col);
+                }
+                dom.right_idx.push_back(entry.row);
+                dom.right_source.push_back(entry.source);
+            }
+            if (!dom.border_cols.empty()) dom.right_ptr.push_back(static_cast<int>(dom.right_idx.size()));
+
+            dom.block = SparseMatrix<T>(m, m, std::move(ptr), std::move(idx));
+            dom.lu.analyze(dom.block);
+            if (dom.lu.getAnalysis().isStructurallySingular()) singular = true; // Not after the matching above
+        }
+    });
+    if (singular) return false;
+    if (ni == 0) return true;
+
+    // Pattern of S, columns sorted so every contribution finds its entry by binary search
+    std::vector<std::vector<int>> columns(ni);
+    for (const Entry& entry : inner) columns[entry.col].push_back(entry.row);
+    for (const Domain& dom : domains) {
+        for (int c : dom.border_cols) columns[c].insert(columns[c].end(), dom.border_rows.begin(), dom.border_rows.end());
+    }
+    std::vector<int> ptr(1, 0), idx;
+    for (auto& column : columns) {
+        std::sort(column.begin(), column.end());
+        column.erase(std::unique(column.begin(), column.end()), column.end());
+        idx.insert(idx.end(), column.begin(), column.end());
+        ptr.push_back(static_cast<int>(idx.size()));
+        std::vector<int>().swap(column);
+    }
+    auto find = [&](int row, int col) {
+        return static_cast<int>(std::lower_bound(idx.begin() + ptr[col], idx.begin() + ptr[col + 1], row) - idx.begin());
+    };
+    for (const Entry& entry : inner) {
+        interface_source.push_back(entry.source);
+        interface_pos.push_back(find(entry.row, entry.col));
+    }
+    parallelFor(k, 1, threads, [&](size_t begin, size_t end, unsigned) {
+        for (size_t d = begin; d < end; d++) {
+            Domain& dom = domains[d];
+            dom.schur_pos.clear();
+            dom.schur_pos.reserve(dom.border_rows.size() * dom.border_cols.size());
+            for (int row : dom.border_rows) {
+                for (int col : dom.border_cols) dom.schur_pos.push_back(find(row, col));
+            }
+        }
+    });
+
+    schur = SparseMatrix<T>(ni, ni, std::move(ptr), std::move(idx));
+    schur_lu = BlockLU<T>();
+    schur_lu.analyze(schur);
+    return !schur_lu.getAnalysis().isStructurallySingular();
+}
+
+// A_ii is factored and its Schur part built from one solve per border column
+
+template <typename T>
+void DomainSolver<T>::factorDomain(Domain& dom, const std::vector<T>& Ax) const {
+    auto& values = dom.block.getValues();
+    for (size_t p = 0; p < values.size(); p++) values[p] = Ax[dom.block_source[p]];
+    dom.lu.factorize(dom.block);
+
+    dom.right_val.resize(dom.right_source.size());
+    for (size_t p = 0; p < dom.right_val.size(); p++) dom.right_val[p] = Ax[dom.right_source[p]];
+    dom.bottom_val.resize(dom.bottom_source.size());
+    for (size_t p = 0; p < dom.bottom_val.size(); p++) dom.bottom_val[p] = Ax[dom.bottom_source[p]];
+
+    size_t m = dom.unknowns.size(), cols = dom.border_cols.size();
+    dom.schur.assign(dom.border_rows.size() * cols, T(0));
+    std::vector<T> x(m);
+    for (size_t c = 0; c < cols; c++) {
+        std::fill(x.begin(), x.end(), T(0));
+        for (int p = dom.right_ptr[c]; p < dom.right_ptr[c + 1]; p++) x[dom.right_idx[p]] = dom.right_val[p];
+        dom.lu.solve(x);
+        for (size_t j = 0; j < m; j++) {
+            if (x[j] == T(0)) continue;
+            for (int p = dom.bottom_ptr[j]; p < dom.bottom_ptr[j + 1]; p++) {
+                dom.schur[dom.bottom_idx[p] * cols + c] -= dom.bottom_val[p] * x[j];
+            }
+        }
+    }
+}
+
+template <typename T>
+void DomainSolver<T>::factorize(const SparseMatrix<T>& A) {
+    if (A.rows() != n || A.cols() != n || A.nonZeros() != nnz) {
+        throw std::invalid_argument("Matrix does not have the analysed pattern.");
+    }
+    const auto& Ax = A.getValues();
+    parallelFor(domains.size(), 1, threads, [&](size_t begin, size_t end, unsigned) {
+        for (size_t d = begin; d < end; d++) factorDomain(domains[d], Ax);
+    });
+    if (interface.empty()) return;
+
+    auto& values = schur.getValues();
+    std::fill(values.begin(), values.end(), T(0));
+    for (size_t e = 0; e < interface_pos.size(); e++) values[interface_pos[e]] += Ax[interface_source[e]];
+    for (Domain& dom : domains) {
+        for (size_t e = 0; e < dom.schur.size(); e++) values[dom.schur_pos[e]] += dom.schur[e];
+        std::vector<T>().swap(dom.schur);
+    }
+    schur_lu.factorize(schur);
+}
+
+// y_i = A_ii^-1 b_i, S x_Γ = b_Γ - sum_i A_Γi y_i, then x_i = A_ii^-1 (b_i - A_iΓ x_Γ)
+
+template <typename T>
+void DomainSolver<T>::solve(std::vector<T>& b) const {
+    if (b.size() != n) {
+        throw std::invalid_argument("Right hand side size does not match the factorization.");
+    }
+    size_t k = domains.size();
+    std::vector<std::vector<T>> coupling(k);
+    parallelFor(k, 1, threads, [&](size_t begin, size_t end, unsigned) {
+        std::vector<T> y;
+        for (size_t d = begin; d < end; d++) {
+            const Domain& dom = domains[d];
+            y.resize(dom.unknowns.size());
+            for (size_t j = 0; j < y.size(); j++) y[j] = b[dom.unknowns[j]];
+            dom.lu.solve(y);
+            coupling[d].assign(dom.border_rows.size(), T(0));
+            for (size_t j = 0; j < y.size(); j++) {
+                for (int p = dom.bottom_ptr[j]; p < dom.bottom_ptr[j + 1]; p++) {
+                    coupling[d][dom.bottom_idx[p]] += dom.bottom_val[p] * y[j];
+                }
+            }
+        }
+    });
+
+    std::vector<T> g(interface.size());
+    for (size_t q = 0; q < g.size(); q++) g[q] = b[interface[q]];
+    for (size_t d = 0; d < k; d++) {
+        for (size_t r = 0; r < coupling[d].size(); r++) g[domains[d].border_rows[r]] -= coupling[d][r];
+    }
+    if (!g.empty()) schur_lu.solve(g);
+
+    parallelFor(k, 1, threads, [&](size_t begin, size_t end, unsigned) {
+        std::vector<T> y;
+        for (size_t d = begin; d < end; d++) {
+            const Domain& dom = domains[d];
+            y.resize(dom.unknowns.size());
+            for (size_t j = 0; j < y.size(); j++) y[j] = b[dom.unknowns[j]];
+            for (size_t c = 0; c < dom.border_cols.size(); c++) {
+                T value = g[dom.border_cols[c]];
+                for (int p = dom.right_ptr[c]; p < dom.right_ptr[c + 1]; p++) y[dom.right_idx[p]] -= dom.right_val[p] * value;
+            }
+            dom.lu.solve(y);
+            for (size_t j = 0; j < y.size(); j++) b[dom.unknowns[j]] = y[j];
+        }
+    });
+    for (size_t q = 0; q < g.size(); q++) b[interface[q]] = g[q];
+}
+
+template <typename T>
+size_t DomainSolver<T>::factorNonZeros() const {
+    size_t count = interface.empty() ? 0 : schur_lu.factorNonZeros();
+    for (const Domain& dom : domains) count += dom.lu.factorNonZeros();
+    return count;
+}
+
+template class DomainSolver<double>;
+template class DomainSolver<std::complex<double>>;
@@ -0,0 +1,67 @@
+#pragma once
+#include "BlockLU.h"
+#include "SparseMatrix.h"
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// Bordered block diagonal solver for large flat circuits
+// The unknowns are split into domains D_1 .. D_k and an interface Γ that holds every unknown coupling two
+// domains (see Partition.h), which puts the system into the form
+//   [A_11            A_1Γ] [x_1]   [b_1]
+//   [      ...        ...] [...] = [...]
+//   [           A_kk A_kΓ] [x_k]   [b_k]
+//   [A_Γ1  ...  A_Γk A_ΓΓ] [x_Γ]   [b_Γ]
+// Every diagonal block is analysed and factored by its own BlockLU on a worker thread, which also adds its
+// part of the interface Schur complement
+//   S = A_ΓΓ - sum_i A_Γi A_ii^-1 A_iΓ
+// S is sparse (a dense block per domain border) and factored last on the calling thread. Solves run the
+// domains in parallel as well. Domain parts are summed in domain order, the result doesn't depend on the
+// thread count.
+
+template <typename T>
+class DomainSolver
+{
+	struct Domain
+	{
+		std::vector<int> unknowns;                   // Global index of every local unknown, ascending
+		SparseMatrix<T> block;                       // A_ii
+		std::vector<int> block_source;               // Entry of A behind every value of the block
+		BlockLU<T> lu;
+		std::vector<int> border_cols, border_rows;   // Interface positions of the columns of A_iΓ, rows of A_Γi
+		std::vector<int> right_ptr, right_idx, right_source;    // A_iΓ, CSC over border_cols, local rows
+		std::vector<int> bottom_ptr, bottom_idx, bottom_source; // A_Γi, CSC over local columns, rows index border_rows
+		std::vector<T> right_val, bottom_val;
+		std::vector<int> schur_pos;                  // Entry of S for every border_rows x border_cols position
+		std::vector<T> schur;                        // -A_Γi A_ii^-1 A_iΓ, row major, only during factorize()
+	};
+
+	size_t n = 0, nnz = 0;
+	std::vector<Domain> domains;
+	std::vector<int> interface;                       // Global index of every interface unknown
+	std::vector<int> interface_source, interface_pos; // A_ΓΓ entries of A and their place in S
+	SparseMatrix<T> schur;
+	BlockLU<T> schur_lu;
+
+	void factorDomain(Domain& domain, const std::vector<T>& Ax) const;
+
+public:
+	unsigned threads = 0; // Workers for the domains, 0 is one per hardware thread
+
+	// Builds the blocks for the split `domain` (one entry per unknown, -1 is the interface). Unknowns
+	// coupling two domains in the pattern of A and those that leave their block structurally singular move
+	// to the interface first. Returns false if no split with at least two domains is left, or if S is
+	// structurally singular
+	bool analyze(const SparseMatrix<T>& A, std::vector<int> domain);
+
+	// Throws std::runtime_error if a block or S is numerically singular. A has to have the analysed pattern
+	void factorize(const SparseMatrix<T>& A);
+
+	// Solves A * x = b in place
+	void solve(std::vector<T>& b) const;
+
+	size_t size() const { return n; }
+	size_t domainCount() const { return domains.size(); }
+	size_t interfaceSize() const { return interface.size(); }
+	size_t factorNonZeros() const;
+};
@@ -0,0 +1,237 @@
+#include "Incremental.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+template <typename T>
+SparseMatrix<T> assemble(const NumericSystem& sys, T s, unsigned threads) {
+    size_t n = sys.size();
+    TripletMatrix<T> A(n, n);
+    A.reserve(sys.G.entries() + (s != T(0) ? sys.C.entries() : 0));
+    for (size_t k = 0; k < sys.G.entries(); k++) A.add(sys.G.row(k), sys.G.col(k), T(sys.G.value(k)));
+    if (s != T(0)) {
+        for (size_t k = 0; k < sys.C.entries(); k++) A.add(sys.C.row(k), sys.C.col(k), s * sys.C.value(k));
+    }
+    return SparseMatrix<T>::fromTriplets(A, threads);
+}
+
+// G + s * C on the merged pattern
+void fill(const FrequencyPattern& pattern, double s, SparseMatrix<double>& A) {
+    pattern.combine(s, A);
+}
+
+void fill(const FrequencyPattern& pattern, std::complex<double> s, SparseMatrix<std::complex<double>>& A) {
+    pattern.assemble(s, A);
+}
+
+// Dense Gaussian elimination with partial pivoting for the small capacitance matrix, b is replaced by
+// the solution. False if a pivot vanishes against the size of the matrix
+template <typename T>
+bool solveDense(std::vector<T>& S, std::vector<T>& b, size_t k) {
+    double scale = 0;
+    for (const T& v : S) scale = std::max(scale, std::abs(v));
+    double tiny = scale * k * std::numeric_limits<double>::epsilon();
+
+    for (size_t c = 0; c < k; c++) {
+        size_t p = c;
+        for (size_t r = c + 1; r < k; r++) {
+            if (std::abs(S[r * k + c]) > std::abs(S[p * k + c])) p = r;
+        }
+        if (!(std::abs(S[p * k + c]) > tiny)) return false;
+        if (p != c) {
+            for (size_t j = 0; j < k; j++) std::swap(S[p * k + j], S[c * k + j]);
+            std::swap(b[p], b[c]);
+        }
+        for (size_t r = c + 1; r < k; r++) {
+            T f = S[r * k + c] / S[c * k + c];
+            if (f == T(0)) continue;
+            for (size_t j = c; j < k; j++) S[r * k + j] -= f * S[c * k + j];
+            b[r] -= f * b[c];
+        }
+    }
+    for (size_t c = k; c-- > 0;) {
+        for (size_t j = c + 1; j < k; j++) b[c] -= S[c * k + j] * b[j];
+        b[c] /= S[c * k + c];
+    }
+    return true;
+}
+
+} // namespace
+
+template <typename T>
+bool IncrementalSolver<T>::update(const NumericSystem& sys, std::vector<T>& x) {
+    // A - A0 from the stamps of the changed elements only, by column
+    std::map<int, std::map<int, T>> delta;
+    auto add = [&](const NumericSystem& from, size_t e, double sign) {
+        for (size_t k = from.element_g[e]; k < from.element_g[e + 1]; k++) {
+            delta[from.G.col(k)][from.G.row(k)] += T(sign * from.G.value(k));
+        }
+        if (s_value == T(0)) return;
+        for (size_t k = from.element_c[e]; k < from.element_c[e + 1]; k++) {
+            delta[from.C.col(k)][from.C.row(k)] += sign * s_value * from.C.value(k);
+        }
+    };
+    for (size_t e = 0; e < dirty.size(); e++) {
+        if (!dirty[e]) continue;
+        add(sys, e, 1.0);
+        add(*base, e, -1.0);
+    }
+
+    // Elements set to the value they already had cancel exactly
+    std::vector<int> cols;
+    std::vector<std::vector<std::pair<int, T>>> U;
+    for (const auto& column : delta) {
+        std::vector<std::pair<int, T>> entries;
+        for (const auto& entry : column.second) {
+            if (entry.second != T(0)) entries.emplace_back(entry.first, entry.second);
+        }
+        if (entries.empty()) continue;
+        cols.push_back(column.first);
+        U.push_back(std::move(entries));
+    }
+
+    size_t k = cols.size(), n = sys.size();
+    if (k > rankLimit) return false;
+
+    x.assign(sys.rhs.begin(), sys.rhs.end());
+    solveFactored(x);
+    stats.rank = k;
+    if (k == 0) return true;
+
+    std::vector<std::vector<T>> Z(k, std::vector<T>(n, T(0)));
+    for (size_t j = 0; j < k; j++) {
+        for (const auto& entry : U[j]) Z[j][entry.first] = entry.second;
+        solveFactored(Z[j]);
+    }
+
+    // I + Z(K, :) and y(K)
+    std::vector<T> S(k * k), w(k);
+    for (size_t a = 0; a < k; a++) {
+        for (size_t b = 0; b < k; b++) S[a * k + b] = (a == b ? T(1) : T(0)) + Z[b][cols[a]];
+        w[a] = x[cols[a]];
+    }
+    if (!solveDense(S, w, k)) return false; // Singular after the change, the full factorization reports it
+
+    for (size_t j = 0; j < k; j++) {
+        if (w[j] == T(0)) continue;
+        for (size_t i = 0; i < n; i++) x[i] -= Z[j][i] * w[j];
+    }
+    return true;
+}
+
+template <typename T>
+void IncrementalSolver<T>::solve(const NumericSystem& sys, T s, size_t structure, const std::vector<int>& changed,
+    std::vector<T>& x, const std::function<std::string(int, bool)>& name, SolveStats* profile) {
+    if (sys.element_g.empty() || sys.element_c.size() != sys.element_g.size()) {
+        throw std::invalid_argument("Incremental solve needs the element offsets of the stamps.");
+    }
+
+    bool reuse = base && revision == structure && s_value == s && base->size() == sys.size() &&
+        base->element_g.size() == sys.element_g.size();
+    if (reuse) {
+        for (int e : changed) dirty[e] = 1;
+        PhaseTimer timer(profile, SolvePhase::Update);
+        if (update(sys, x)) {
+            stats.updates++;
+            if (profile) {
+                profile->updates++;
+                profile->updateRank = stats.rank;
+            }
+            return;
+        }
+    }
+
+    // Same pattern at another s or with new values: no sorting, ordering or structural checks
+    std::unique_ptr<FrequencyPattern> previous = std::move(pattern);
+    bool analysed = factored && previous && s != T(0) && revision == structure && split == domains;
+    base.reset();
+    factored = false;
+    if (analysed) {
+        {
+            PhaseTimer timer(profile, SolvePhase::Assembly);
+            analysed = previous->refill(sys);
+            if (analysed) fill(*previous, s, matrix);
+        }
+        if (analysed) {
+            PhaseTimer timer(profile, SolvePhase::Factorization);
+            try {
+                if (decomposed) domain.factorize(matrix);
+                else if (!lu.refactor(matrix)) lu.factorize(matrix); // Pivot became too small, search again
+            }
+            catch (const std::runtime_error&) {
+                analysed = false; // Numerically singular with the old pivots, start over below
+            }
+        }
+        if (analysed) pattern = std::move(previous);
+    }
+
+    // The symbolic phase catches voltage source loops and floating nodes before any arithmetic
+    if (!analysed) {
+        {
+            PhaseTimer timer(profile, SolvePhase::Assembly);
+            if (s != T(0)) {
+                pattern = std::make_unique<FrequencyPattern>(sys, threads);
+                matrix = SparseMatrix<T>(sys.size(), sys.size(), pattern->colPtr(), pattern->rowIdx());
+                fill(*pattern, s, matrix);
+            }
+            else matrix = assemble(sys, s, threads);
+        }
+        decomposed = false;
+        split = domains;
+        if (domains && domains->size() == sys.size()) {
+            {
+                PhaseTimer timer(profile, SolvePhase::Analysis);
+                domain.threads = domainThreads;
+                decomposed = domain.analyze(matrix, *domains);
+            }
+            if (decomposed) {
+                PhaseTimer timer(profile, SolvePhase::Factorization);
+                try {
+                    domain.factorize(matrix);
+                }
+                catch (const std::runtime_error&) {
+                    decomposed = false; // A singular block, the whole matrix decides below
+                }
+            }
+        }
+        if (!decomposed) {
+            {
+                PhaseTimer timer(profile, SolvePhase::Analysis);
+                lu.analyze(matrix);
+            }
+            if (lu.getAnalysis().isStructurallySingular()) throw std::runtime_error(lu.getAnalysis().structuralReport(name));
+            PhaseTimer timer(profile, SolvePhase::Factorization);
+            lu.factorize(matrix);
+        }
+    }
+
+    base = std::make_unique<NumericSystem>(sys);
+    factored = true;
+    s_value = s;
+    revision = structure;
+    dirty.assign(sys.element_g.size() - 1, 0);
+    stats.factorizations++;
+    stats.rank = 0;
+    if (profile) {
+        profile->factorizations++;
+        profile->nonZeros = matrix.nonZeros();
+        profile->factorNonZeros = decomposed ? domain.factorNonZeros() : lu.factorNonZeros();
+        profile->domains = decomposed ? domain.domainCount() : 0;
+        profile->interfaceUnknowns = decomposed ? domain.interfaceSize() : 0;
+        if (!analysed) {
+            profile->matrixAllocations++;
+            profile->matrixBytes += matrix.nonZeros() * (sizeof(T) + sizeof(int)) + (matrix.cols() + 1) * sizeof(int);
+        }
+    }
+
+    PhaseTimer timer(profile, SolvePhase::Solve);
+    x.assign(sys.rhs.begin(), sys.rhs.end());
+    solveFactored(x);
+}
+
+template class IncrementalSolver<double>;
+template class IncrementalSolver<std::complex<double>>;
@@ -0,0 +1,68 @@
+#pragma once
+#include "ACSweep.h"
+#include "BlockLU.h"
+#include "DomainSolver.h"
+#include "NumericSystem.h"
+#include "SolveStats.h"
+#include <complex>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct IncrementalStats
+{
+	size_t factorizations = 0; // Factorizations, full or refactored on the analysed pattern
+	size_t updates = 0;        // Solves answered from the cached factors
+	size_t rank = 0;           // Rank of the correction in the last update
+};
+
+// Re-solves (G + s * C) * x = rhs after value changes of a few elements without refactoring
+// The factored matrix A0 is kept with the stamps it came from. A later matrix differs from it in the
+// columns K stamped by the changed elements, A = A0 + U * E_K^T with U = (A - A0)(:, K), and Woodbury gives
+//   x = y - Z * (I + Z(K, :))^-1 * y(K),   y = A0^-1 * rhs,   Z = A0^-1 * U
+// which costs |K| + 1 solves with the old factors. A resistor between two nodes changes two columns.
+// Changes accumulate until their rank passes rankLimit, then the next solve refactors.
+// For s != 0 the factors keep the merged pattern of G and C (ACSweep.h). A new s, or changes past the
+// limit, on the same topology refill its values and refactor on the analysed pattern, without sorting
+// triplets or ordering again.
+
+template <typename T>
+class IncrementalSolver
+{
+	BlockLU<T> lu;
+	DomainSolver<T> domain;
+	bool decomposed = false; // The factors are in `domain` instead of `lu`
+	bool factored = false;   // The factors belong to `pattern`, the topology `revision` and `split`
+	std::shared_ptr<const std::vector<int>> split;
+	std::unique_ptr<NumericSystem> base; // Stamps of the factored matrix
+	std::unique_ptr<FrequencyPattern> pattern; // G and C the factors were analysed on, s != 0 only
+	SparseMatrix<T> matrix;
+	T s_value = T(0);
+	size_t revision = 0;
+	std::vector<char> dirty; // Elements whose stamps may differ from base, by id
+	IncrementalStats stats;
+
+	bool update(const NumericSystem& sys, std::vector<T>& x);
+	void solveFactored(std::vector<T>& x) const { decomposed ? domain.solve(x) : lu.solve(x); }
+
+public:
+	size_t rankLimit = 16; // Most columns corrected before refactoring, 0 refactors on every change
+	unsigned threads = 1;  // For the triplet to CSC assembly, 0 is one per hardware thread
+
+	// Domain of every unknown for the bordered block diagonal solver (DomainSolver.h), with domainThreads
+	// workers. Unset, or a split the solver can't use, factors the whole matrix with one BlockLU
+	std::shared_ptr<const std::vector<int>> domains;
+	unsigned domainThreads = 0;
+
+	// Solution of the system at s, G only for s = 0
+	// `structure` is the topology revision the stamps belong to and `changed` the elements with new
+	// values since the previous call. `name` labels unknowns in the report of a structurally singular system
+	void solve(const NumericSystem& sys, T s, size_t structure, const std::vector<int>& changed,
+		std::vector<T>& x, const std::function<std::string(int, bool)>& name, SolveStats* profile = nullptr);
+
+	// Drops the stamps updates start from, the analysed pattern stays for the next s
+	void reset() { base.reset(); }
+	const IncrementalStats& getStats() const { return stats; }
+};
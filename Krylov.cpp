@@ -0,0 +1,725 @@
+#include "Krylov.h"
+#include "BlockLU.h"
+#include "Ordering.h"
+#include "Parallel.h"
+#include "SparseMatrix.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <utility>
+
+namespace {
+
+constexpr size_t vector_block = 4096; // Blocks of the parallel vector loops, fixed so sums don't depend on the thread count
+
+// Compressed sparse rows, column indices ascending within a row
+
+struct RowMatrix
+{
+    size_t n = 0;
+    std::vector<int> ptr, idx;
+    std::vector<double> val;
+
+    // y = A * x
+    void multiply(const std::vector<double>& x, std::vector<double>& y, unsigned threads) const {
+        y.resize(n);
+        parallelFor(n, vector_block, threads, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                double sum = 0;
+                for (int p = ptr[i]; p < ptr[i + 1]; p++) sum += val[p] * x[idx[p]];
+                y[i] = sum;
+            }
+        });
+    }
+
+    double diagonal(size_t i) const {
+        for (int p = ptr[i]; p < ptr[i + 1]; p++) {
+            if (idx[p] == static_cast<int>(i)) return val[p];
+        }
+        return 0;
+    }
+};
+
+// Rows of a square CSC matrix, or the columns of a CSR one
+RowMatrix transpose(size_t n, const std::vector<int>& ptr, const std::vector<int>& idx, const std::vector<double>& val) {
+    RowMatrix T;
+    T.n = n;
+    T.ptr.assign(n + 1, 0);
+    for (int i : idx) T.ptr[i + 1]++;
+    for (size_t i = 0; i < n; i++) T.ptr[i + 1] += T.ptr[i];
+    T.idx.resize(idx.size());
+    T.val.resize(idx.size());
+    std::vector<int> next(T.ptr.begin(), T.ptr.end() - 1);
+    for (size_t j = 0; j < n; j++) {
+        for (int p = ptr[j]; p < ptr[j + 1]; p++) {
+            int q = next[idx[p]]++;
+            T.idx[q] = static_cast<int>(j);
+            T.val[q] = val[p];
+        }
+    }
+    return T;
+}
+
+RowMatrix toRows(const SparseMatrix<double>& A) {
+    return transpose(A.cols(), A.colPtr(), A.rowIdx(), A.getValues());
+}
+
+SparseMatrix<double> toColumns(const RowMatrix& A) {
+    RowMatrix T = transpose(A.n, A.ptr, A.idx, A.val);
+    SparseMatrix<double> M(A.n, A.n, std::move(T.ptr), std::move(T.idx));
+    M.getValues() = std::move(T.val);
+    return M;
+}
+
+double dot(const std::vector<double>& a, const std::vector<double>& b, unsigned threads) {
+    std::vector<double> partial((a.size() + vector_block - 1) / vector_block, 0.0);
+    parallelFor(a.size(), vector_block, threads, [&](size_t begin, size_t end, unsigned) {
+        double sum = 0;
+        for (size_t i = begin; i < end; i++) sum += a[i] * b[i];
+        partial[begin / vector_block] = sum;
+    });
+    double sum = 0;
+    for (double part : partial) sum += part;
+    return sum;
+}
+
+// Grounded sources out of the system, see Krylov.h
+
+struct Reduction
+{
+    std::vector<int> free;                    // Full index of every reduced unknown
+    std::vector<int> position;                // Reduced index of every full unknown, -1 if eliminated
+    std::vector<std::pair<int, int>> fixed;   // Branch unknown and node of every eliminated source
+    RowMatrix A;
+    std::vector<double> b;
+};
+
+Reduction reduce(const SparseMatrix<double>& columns, const RowMatrix& rows, const std::vector<double>& rhs, std::vector<double>& x) {
+    size_t n = rows.n;
+    const auto& col_ptr = columns.colPtr();
+    const auto& row_idx = columns.rowIdx();
+
+    // Branch r whose row holds only a_rc x_c = b_r and whose current only enters row c
+    Reduction reduced;
+    std::vector<char> eliminated(n, 0);
+    for (size_t r = 0; r < n; r++) {
+        if (rows.ptr[r + 1] - rows.ptr[r] != 1 || col_ptr[r + 1] - col_ptr[r] != 1) continue;
+        int c = rows.idx[rows.ptr[r]];
+        double a = rows.val[rows.ptr[r]];
+        if (c == static_cast<int>(r) || a == 0 || eliminated[r] || eliminated[c]) continue;
+        if (row_idx[col_ptr[r]] != c || columns.getValues()[col_ptr[r]] == 0) continue;
+        eliminated[r] = eliminated[c] = 1;
+        reduced.fixed.emplace_back(static_cast<int>(r), c);
+        x[c] = rhs[r] / a;
+    }
+
+    reduced.position.assign(n, -1);
+    for (size_t i = 0; i < n; i++) {
+        if (eliminated[i]) continue;
+        reduced.position[i] = static_cast<int>(reduced.free.size());
+        reduced.free.push_back(static_cast<int>(i));
+    }
+
+    // Fixed voltages move to the rhs
+    size_t m = reduced.free.size();
+    RowMatrix& A = reduced.A;
+    A.n = m;
+    A.ptr.assign(1, 0);
+    reduced.b.resize(m);
+    for (size_t k = 0; k < m; k++) {
+        int i = reduced.free[k];
+        double b = rhs[i];
+        for (int p = rows.ptr[i]; p < rows.ptr[i + 1]; p++) {
+            int j = reduced.position[rows.idx[p]];
+            if (j >= 0) {
+                A.idx.push_back(j);
+                A.val.push_back(rows.val[p]);
+            }
+            else {
+                b -= rows.val[p] * x[rows.idx[p]];
+            }
+        }
+        reduced.b[k] = b;
+        A.ptr.push_back(static_cast<int>(A.idx.size()));
+    }
+    return reduced;
+}
+
+// Branch currents of the eliminated sources from the KCL rows of their nodes
+void recover(const Reduction& reduced, const RowMatrix& rows, const std::vector<double>& rhs, std::vector<double>& x) {
+    for (const auto& [r, c] : reduced.fixed) {
+        double sum = rhs[c], a = 0;
+        for (int p = rows.ptr[c]; p < rows.ptr[c + 1]; p++) {
+            if (rows.idx[p] == r) a = rows.val[p];
+            else sum -= rows.val[p] * x[rows.idx[p]];
+        }
+        x[r] = sum / a;
+    }
+}
+
+// Symmetric up to rounding, with a positive diagonal
+bool isSymmetricPositive(const RowMatrix& A) {
+    RowMatrix T = transpose(A.n, A.ptr, A.idx, A.val);
+    if (T.ptr != A.ptr || T.idx != A.idx) return false;
+    for (size_t p = 0; p < A.val.size(); p++) {
+        double scale = std::max(std::abs(A.val[p]), std::abs(T.val[p]));
+        if (std::abs(A.val[p] - T.val[p]) > 1e-12 * scale) return false;
+    }
+    for (size_t i = 0; i < A.n; i++) {
+        if (!(A.diagonal(i) > 0)) return false;
+    }
+    return true;
+}
+
+// Branch rows of floating and controlled sources have no diagonal, ILU would divide by zero on them
+// A maximum transversal puts a nonzero on every diagonal position by reordering the equations, which leaves
+// x and the residual norm as they are. Returns false if there was nothing to do or no full transversal
+bool matchDiagonal(RowMatrix& A, std::vector<double>& b) {
+    bool missing = false;
+    for (size_t i = 0; i < A.n && !missing; i++) missing = A.diagonal(i) == 0;
+    if (!missing) return false;
+
+    SparseMatrix<double> columns = toColumns(A);
+    std::vector<int> match;
+    if (maximumTransversal(A.n, columns.colPtr(), columns.rowIdx(), match) < A.n) return false;
+
+    RowMatrix P;
+    P.n = A.n;
+    P.ptr.assign(1, 0);
+    std::vector<double> c(A.n);
+    for (size_t j = 0; j < A.n; j++) {
+        int i = match[j]; // Row i becomes row j, A(i, j) on the diagonal
+        P.idx.insert(P.idx.end(), A.idx.begin() + A.ptr[i], A.idx.begin() + A.ptr[i + 1]);
+        P.val.insert(P.val.end(), A.val.begin() + A.ptr[i], A.val.begin() + A.ptr[i + 1]);
+        P.ptr.push_back(static_cast<int>(P.idx.size()));
+        c[j] = b[i];
+    }
+    A = std::move(P);
+    b = std::move(c);
+    return true;
+}
+
+class Preconditioner
+{
+public:
+    virtual ~Preconditioner() = default;
+    virtual void apply(const std::vector<double>& r, std::vector<double>& z) const = 0; // z = M^-1 r
+    virtual size_t nonZeros() const = 0;
+};
+
+class JacobiPreconditioner : public Preconditioner
+{
+    std::vector<double> inverse;
+    unsigned threads;
+
+public:
+    JacobiPreconditioner(const RowMatrix& A, unsigned workers) : inverse(A.n), threads(workers) {
+        for (size_t i = 0; i < A.n; i++) {
+            double d = A.diagonal(i);
+            inverse[i] = d != 0 ? 1.0 / d : 1.0;
+        }
+    }
+
+    void apply(const std::vector<double>& r, std::vector<double>& z) const override {
+        z.resize(r.size());
+        parallelFor(r.size(), vector_block, threads, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) z[i] = inverse[i] * r[i];
+        });
+    }
+
+    size_t nonZeros() const override { return inverse.size(); }
+};
+
+// ILU(k), L (unit diagonal, not stored) and U in one CSR, diag[i] is the position of U(i, i)
+// The level of an entry of A is 0, a fill entry made by pivot row k has level lev(i, k) + lev(k, j) + 1
+
+class IncompleteLU : public Preconditioner
+{
+    size_t n = 0;
+    std::vector<int> ptr, idx, diag;
+    std::vector<double> val;
+
+    // Pattern of ILU(fill), false once it passes `limit` entries
+    bool analyze(const RowMatrix& A, size_t fill, size_t limit) {
+        n = A.n;
+        ptr.assign(1, 0);
+        idx.clear();
+        diag.assign(n, 0);
+        std::vector<int> levels;                // Level of every stored entry, for the later rows
+        std::vector<int> next(n + 1), level(n); // Sorted linked list of the row being built, n ends it
+        for (size_t i = 0; i < n; i++) {
+            int head = static_cast<int>(n);
+            int tail = -1;
+            bool has_diagonal = false;
+            for (int p = A.ptr[i]; p < A.ptr[i + 1]; p++) {
+                int j = A.idx[p];
+                if (j > static_cast<int>(i) && !has_diagonal) { // A missing diagonal goes in with level 0
+                    int d = static_cast<int>(i);
+                    level[d] = 0;
+                    if (tail < 0) head = d;
+                    else next[tail] = d;
+                    tail = d;
+                    has_diagonal = true;
+                }
+                if (j == static_cast<int>(i)) has_diagonal = true;
+                level[j] = 0;
+                if (tail < 0) head = j;
+                else next[tail] = j;
+                tail = j;
+            }
+            if (!has_diagonal) {
+                int d = static_cast<int>(i);
+                level[d] = 0;
+                if (tail < 0) head = d;
+                else next[tail] = d;
+                tail = d;
+            }
+            next[tail] = static_cast<int>(n);
+
+            // Fill from every pivot row k < i, in column order; new entries land after k
+            for (int k = head; k < static_cast<int>(i); k = next[k]) {
+                int lk = level[k];
+                if (static_cast<size_t>(lk) >= fill) continue; // Any fill from k would pass the level
+                int at = k;
+                for (int p = diag[k] + 1; p < ptr[k + 1]; p++) {
+                    int j = idx[p];
+                    int lj = lk + levels[p] + 1;
+                    if (static_cast<size_t>(lj) > fill) continue;
+                    while (next[at] < j) at = next[at];
+                    if (next[at] == j) {
+                        level[j] = std::min(level[j], lj);
+                    }
+                    else {
+                        level[j] = lj;
+                        next[j] = next[at];
+                        next[at] = j;
+                    }
+                    at = j;
+                }
+            }
+
+            for (int j = head; j < static_cast<int>(n); j = next[j]) {
+                if (j == static_cast<int>(i)) diag[i] = static_cast<int>(idx.size());
+                idx.push_back(j);
+                levels.push_back(level[j]);
+            }
+            ptr.push_back(static_cast<int>(idx.size()));
+            if (idx.size() > limit) return false;
+        }
+        return true;
+    }
+
+public:
+    size_t fill = 0;
+    size_t shifted = 0;
+
+    IncompleteLU(const RowMatrix& A, size_t k, double fillLimit) {
+        size_t limit = static_cast<size_t>(fillLimit * static_cast<double>(A.idx.size() + A.n));
+        fill = k;
+        while (!analyze(A, fill, fill > 0 ? limit : std::numeric_limits<size_t>::max())) fill--; // ILU(0) always fits
+
+        // Row by row (IKJ), w holds row i scattered by column
+        val.assign(idx.size(), 0.0);
+        std::vector<double> w(n, 0.0);
+        std::vector<int> in_row(n, -1);
+        for (size_t i = 0; i < n; i++) {
+            double scale = 0;
+            for (int p = ptr[i]; p < ptr[i + 1]; p++) in_row[idx[p]] = static_cast<int>(i);
+            for (int p = A.ptr[i]; p < A.ptr[i + 1]; p++) {
+                w[A.idx[p]] = A.val[p];
+                scale = std::max(scale, std::abs(A.val[p]));
+            }
+            for (int p = ptr[i]; p < diag[i]; p++) {
+                int k = idx[p];
+                double l = w[k] / val[diag[k]];
+                w[k] = l;
+                if (l == 0) continue;
+                for (int q = diag[k] + 1; q < ptr[k + 1]; q++) {
+                    if (in_row[idx[q]] == static_cast<int>(i)) w[idx[q]] -= l * val[q];
+                }
+            }
+            for (int p = ptr[i]; p < ptr[i + 1]; p++) {
+                val[p] = w[idx[p]];
+                w[idx[p]] = 0;
+            }
+            // Branch rows of sources have no diagonal, a pivot of the size of the row keeps the factors bounded
+            double& pivot = val[diag[i]];
+            if (scale == 0) scale = 1;
+            if (std::abs(pivot) < 1e-8 * scale) {
+                pivot = pivot < 0 ? -scale : scale;
+                shifted++;
+            }
+        }
+    }
+
+    void apply(const std::vector<double>& r, std::vector<double>& z) const override {
+        z = r;
+        for (size_t i = 0; i < n; i++) {
+            double sum = z[i];
+            for (int p = ptr[i]; p < diag[i]; p++) sum -= val[p] * z[idx[p]];
+            z[i] = sum;
+        }
+        for (size_t i = n; i-- > 0;) {
+            double sum = z[i];
+            for (int p = diag[i] + 1; p < ptr[i + 1]; p++) sum -= val[p] * z[idx[p]];
+            z[i] = sum / val[diag[i]];
+        }
+    }
+
+    size_t nonZeros() const override { return val.size(); }
+};
+
+// Plain aggregation AMG: every unknown belongs to one aggregate of the next level, P is 1 at (i, aggregate(i))
+// and the coarse matrix is P^T A P. One V-cycle per application, symmetric so CG can use it
+
+class Multigrid : public Preconditioner
+{
+    static constexpr double strength = 0.08; // |a_ij| >= strength * sqrt(a_ii a_jj) couples i and j strongly
+
+    struct Level
+    {
+        RowMatrix A;
+        std::vector<int> aggregate; // Of every unknown on the next level, empty on the coarsest
+        mutable std::vector<double> x, b, r;
+    };
+
+    std::vector<Level> levels;
+    std::unique_ptr<BlockLU<double>> coarse;
+
+    static std::vector<int> aggregates(const RowMatrix& A, size_t& count) {
+        size_t n = A.n;
+        std::vector<double> d(n);
+        for (size_t i = 0; i < n; i++) d[i] = std::abs(A.diagonal(i));
+        auto strong = [&](size_t i, int p) {
+            int j = A.idx[p];
+            return j != static_cast<int>(i) && std::abs(A.val[p]) >= strength * std::sqrt(d[i] * d[j]);
+        };
+
+        // Unknowns whose strong neighbours are all free seed an aggregate with them
+        std::vector<int> aggregate(n, -1);
+        count = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (aggregate[i] >= 0) continue;
+            bool free = true, coupled = false;
+            for (int p = A.ptr[i]; p < A.ptr[i + 1] && free; p++) {
+                if (!strong(i, p)) continue;
+                coupled = true;
+                free = aggregate[A.idx[p]] < 0;
+            }
+            if (!free || !coupled) continue;
+            aggregate[i] = static_cast<int>(count);
+            for (int p = A.ptr[i]; p < A.ptr[i + 1]; p++) {
+                if (strong(i, p)) aggregate[A.idx[p]] = static_cast<int>(count);
+            }
+            count++;
+        }
+
+        // The rest joins the aggregate it is most strongly coupled to, or makes one of its own
+        std::vector<int> seeded = aggregate;
+        for (size_t i = 0; i < n; i++) {
+            if (aggregate[i] >= 0) continue;
+            double best = 0;
+            for (int p = A.ptr[i]; p < A.ptr[i + 1]; p++) {
+                if (strong(i, p) && seeded[A.idx[p]] >= 0 && std::abs(A.val[p]) > best) {
+                    best = std::abs(A.val[p]);
+                    aggregate[i] = seeded[A.idx[p]];
+                }
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (aggregate[i] < 0) aggregate[i] = static_cast<int>(count++);
+        }
+        return aggregate;
+    }
+
+    // Forward sweep, or backward for the post smoothing so the cycle stays symmetric
+    static void smooth(const RowMatrix& A, const std::vector<double>& b, std::vector<double>& x, bool backward) {
+        for (size_t s = 0; s < A.n; s++) {
+            size_t i = backward ? A.n - 1 - s : s;
+            double sum = b[i], d = 0;
+            for (int p = A.ptr[i]; p < A.ptr[i + 1]; p++) {
+                if (A.idx[p] == static_cast<int>(i)) d = A.val[p];
+                else sum -= A.val[p] * x[A.idx[p]];
+            }
+            x[i] = sum / d;
+        }
+    }
+
+    void cycle(size_t l) const {
+        const Level& level = levels[l];
+        if (l + 1 == levels.size()) {
+            level.x = level.b;
+            coarse->solve(level.x);
+            return;
+        }
+        const RowMatrix& A = level.A;
+        const Level& next = levels[l + 1];
+        level.x.assign(A.n, 0.0);
+        smooth(A, level.b, level.x, false);
+
+        A.multiply(level.x, level.r, 1);
+        next.b.assign(next.A.n, 0.0);
+        for (size_t i = 0; i < A.n; i++) next.b[level.aggregate[i]] += level.b[i] - level.r[i];
+        cycle(l + 1);
+        for (size_t i = 0; i < A.n; i++) level.x[i] += next.x[level.aggregate[i]];
+
+        smooth(A, level.b, level.x, true);
+    }
+
+public:
+    Multigrid(RowMatrix A, size_t coarseSize) {
+        levels.emplace_back();
+        levels.back().A = std::move(A);
+        while (levels.size() < 25 && levels.back().A.n > coarseSize) {
+            const RowMatrix& fine = levels.back().A;
+            size_t count = 0;
+            std::vector<int> aggregate = aggregates(fine, count);
+            if (count * 10 > fine.n * 9) break; // Barely coarsening, factor this level instead
+
+            TripletMatrix<double> triplets(count, count);
+            for (size_t i = 0; i < fine.n; i++) {
+                for (int p = fine.ptr[i]; p < fine.ptr[i + 1]; p++) triplets.add(aggregate[i], aggregate[fine.idx[p]], fine.val[p]);
+            }
+            levels.back().aggregate = std::move(aggregate);
+            levels.emplace_back();
+            levels.back().A = toRows(SparseMatrix<double>::fromTriplets(triplets));
+        }
+
+        SparseMatrix<double> last = toColumns(levels.back().A);
+        coarse = std::make_unique<BlockLU<double>>(std::make_shared<const LUAnalysis>(analyzePattern(last.cols(), last.colPtr(), last.rowIdx())));
+        coarse->factorize(last);
+    }
+
+    void apply(const std::vector<double>& r, std::vector<double>& z) const override {
+        levels[0].b = r;
+        cycle(0);
+        z = levels[0].x;
+    }
+
+    size_t nonZeros() const override {
+        size_t sum = coarse->factorNonZeros();
+        for (const auto& level : levels) sum += level.A.idx.size();
+        return sum;
+    }
+
+    size_t levelCount() const { return levels.size(); }
+};
+
+// Both return the relative residual of the last iteration and count the iterations in `iterations`
+
+double conjugateGradient(const RowMatrix& A, const std::vector<double>& b, std::vector<double>& x, const Preconditioner& M,
+    const KrylovOptions& options, double norm_b, size_t& iterations) {
+    unsigned threads = options.threads;
+    size_t n = A.n;
+    std::vector<double> r(n), z, p, q;
+    A.multiply(x, q, threads);
+    for (size_t i = 0; i < n; i++) r[i] = b[i] - q[i];
+    double residual = std::sqrt(dot(r, r, threads)) / norm_b;
+    if (residual <= options.tolerance) return residual;
+
+    M.apply(r, z);
+    p = z;
+    double rz = dot(r, z, threads);
+    std::vector<double> partial((n + vector_block - 1) / vector_block);
+    while (iterations < options.maxIterations) {
+        iterations++;
+        A.multiply(p, q, threads);
+        double alpha = rz / dot(p, q, threads);
+
+        // x += alpha p and r -= alpha q in one pass, with the blocks of ||r||^2
+        parallelFor(n, vector_block, threads, [&](size_t begin, size_t end, unsigned) {
+            double sum = 0;
+            for (size_t i = begin; i < end; i++) {
+                x[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+                sum += r[i] * r[i];
+            }
+            partial[begin / vector_block] = sum;
+        });
+        double rr = 0;
+        for (double part : partial) rr += part;
+        residual = std::sqrt(rr) / norm_b;
+        if (residual <= options.tolerance) break;
+
+        M.apply(r, z);
+        double rz_next = dot(r, z, threads);
+        double beta = rz_next / rz;
+        rz = rz_next;
+        parallelFor(n, vector_block, threads, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) p[i] = z[i] + beta * p[i];
+        });
+    }
+    return residual;
+}
+
+// Right preconditioned GMRES(m), modified Gram-Schmidt, the Givens rotated residual is the true one
+double gmres(const RowMatrix& A, const std::vector<double>& b, std::vector<double>& x, const Preconditioner& M,
+    const KrylovOptions& options, double norm_b, size_t& iterations) {
+    unsigned threads = options.threads;
+    size_t n = A.n;
+    size_t m = std::max<size_t>(1, options.restart);
+    std::vector<std::vector<double>> V(m + 1, std::vector<double>(n));
+    std::vector<double> H((m + 1) * m), cs(m), sn(m), g(m + 1), y(m), z, w;
+    double residual = 0;
+
+    while (true) {
+        A.multiply(x, w, threads);
+        for (size_t i = 0; i < n; i++) V[0][i] = b[i] - w[i];
+        double beta = std::sqrt(dot(V[0], V[0], threads));
+        residual = beta / norm_b;
+        if (residual <= options.tolerance || iterations >= options.maxIterations) return residual;
+        for (double& v : V[0]) v /= beta;
+        std::fill(g.begin(), g.end(), 0.0);
+        g[0] = beta;
+
+        size_t k = 0;
+        while (k < m && iterations < options.maxIterations) {
+            iterations++;
+            M.apply(V[k], z);
+            A.multiply(z, w, threads);
+            for (size_t j = 0; j <= k; j++) {
+                double h = dot(w, V[j], threads);
+                H[j * m + k] = h;
+                const auto& v = V[j];
+                parallelFor(n, vector_block, threads, [&](size_t begin, size_t end, unsigned) {
+                    for (size_t i = begin; i < end; i++) w[i] -= h * v[i];
+                });
+            }
+            double h = std::sqrt(dot(w, w, threads));
+            H[(k + 1) * m + k] = h;
+            if (h != 0) {
+                for (size_t i = 0; i < n; i++) V[k + 1][i] = w[i] / h;
+            }
+
+            for (size_t j = 0; j < k; j++) {
+                double a = H[j * m + k], c = H[(j + 1) * m + k];
+                H[j * m + k] = cs[j] * a + sn[j] * c;
+                H[(j + 1) * m + k] = -sn[j] * a + cs[j] * c;
+            }
+            double a = H[k * m + k], c = H[(k + 1) * m + k];
+            double r = std::hypot(a, c);
+            cs[k] = r != 0 ? a / r : 1.0;
+            sn[k] = r != 0 ? c / r : 0.0;
+            H[k * m + k] = r;
+            H[(k + 1) * m + k] = 0;
+            g[k + 1] = -sn[k] * g[k];
+            g[k] = cs[k] * g[k];
+            k++;
+
+            residual = std::abs(g[k]) / norm_b;
+            if (residual <= options.tolerance || h == 0) break;
+        }
+
+        // x += M^-1 V y with H y = g
+        for (size_t i = k; i-- > 0;) {
+            double sum = g[i];
+            for (size_t j = i + 1; j < k; j++) sum -= H[i * m + j] * y[j];
+            y[i] = sum / H[i * m + i];
+        }
+        std::vector<double> update(n, 0.0);
+        for (size_t j = 0; j < k; j++) {
+            for (size_t i = 0; i < n; i++) update[i] += y[j] * V[j][i];
+        }
+        M.apply(update, z);
+        for (size_t i = 0; i < n; i++) x[i] += z[i];
+        if (residual <= options.tolerance) {
+            // The rotated residual can drift from the true one, a restart checks it
+            A.multiply(x, w, threads);
+            double rr = 0;
+            for (size_t i = 0; i < n; i++) rr += (b[i] - w[i]) * (b[i] - w[i]);
+            residual = std::sqrt(rr) / norm_b;
+            if (residual <= options.tolerance) return residual;
+        }
+    }
+}
+
+}
+
+KrylovStats solveKrylov(const NumericSystem& sys, std::vector<double>& x, const KrylovOptions& options, SolveStats* profile) {
+    auto start = std::chrono::steady_clock::now();
+    KrylovOptions run = options;
+    if (run.threads == 0) run.threads = hardwareThreads();
+    KrylovStats stats;
+    size_t n = sys.size();
+    if (x.size() != n) x.assign(n, 0.0);
+
+    SparseMatrix<double> columns;
+    {
+        PhaseTimer timer(profile, SolvePhase::Assembly);
+        columns = SparseMatrix<double>::fromTriplets(sys.G, run.threads);
+    }
+
+    RowMatrix rows;
+    Reduction reduced;
+    {
+        PhaseTimer timer(profile, SolvePhase::Analysis);
+        rows = toRows(columns);
+        reduced = reduce(columns, rows, sys.rhs, x);
+        stats.unknowns = reduced.free.size();
+        stats.fixedNodes = reduced.fixed.size();
+        stats.symmetric = isSymmetricPositive(reduced.A);
+    }
+
+    stats.method = run.method;
+    if (stats.method == KrylovMethod::Auto) stats.method = stats.symmetric ? KrylovMethod::CG : KrylovMethod::GMRES;
+    stats.preconditioner = run.preconditioner;
+    if (stats.preconditioner == KrylovPreconditioner::Auto) {
+        stats.preconditioner = stats.method == KrylovMethod::CG ? KrylovPreconditioner::Multigrid : KrylovPreconditioner::ILU;
+    }
+    if (stats.preconditioner == KrylovPreconditioner::Multigrid && !stats.symmetric) stats.preconditioner = KrylovPreconditioner::ILU;
+
+    std::unique_ptr<Preconditioner> M;
+    {
+        PhaseTimer timer(profile, SolvePhase::Factorization);
+        if (!stats.symmetric) matchDiagonal(reduced.A, reduced.b);
+        if (stats.preconditioner == KrylovPreconditioner::Jacobi) {
+            M = std::make_unique<JacobiPreconditioner>(reduced.A, run.threads);
+        }
+        else if (stats.preconditioner == KrylovPreconditioner::ILU) {
+            auto ilu = std::make_unique<IncompleteLU>(reduced.A, run.fill, run.fillLimit);
+            stats.fill = ilu->fill;
+            stats.shiftedPivots = ilu->shifted;
+            M = std::move(ilu);
+        }
+        else {
+            auto multigrid = std::make_unique<Multigrid>(reduced.A, run.coarseSize);
+            stats.levels = multigrid->levelCount();
+            M = std::move(multigrid);
+        }
+        stats.preconditionerNonZeros = M->nonZeros();
+    }
+    auto iterating = std::chrono::steady_clock::now();
+    stats.setupSeconds = std::chrono::duration<double>(iterating - start).count();
+
+    {
+        PhaseTimer timer(profile, SolvePhase::Solve);
+        std::vector<double> y(reduced.free.size());
+        for (size_t k = 0; k < y.size(); k++) y[k] = x[reduced.free[k]];
+        double norm_b = std::sqrt(dot(reduced.b, reduced.b, run.threads));
+        if (norm_b == 0) {
+            std::fill(y.begin(), y.end(), 0.0); // Zero is the exact solution
+            stats.residual = 0;
+        }
+        else if (stats.method == KrylovMethod::CG) {
+            stats.residual = conjugateGradient(reduced.A, reduced.b, y, *M, run, norm_b, stats.iterations);
+        }
+        else {
+            stats.residual = gmres(reduced.A, reduced.b, y, *M, run, norm_b, stats.iterations);
+        }
+        stats.converged = stats.residual <= run.tolerance;
+        for (size_t k = 0; k < y.size(); k++) x[reduced.free[k]] = y[k];
+        recover(reduced, rows, sys.rhs, x);
+    }
+    stats.iterationSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - iterating).count();
+
+    if (profile) {
+        profile->nonZeros = columns.nonZeros();
+        profile->factorNonZeros = stats.preconditionerNonZeros;
+        profile->iterations = stats.iterations;
+        profile->matrixAllocations += 2; // Columns and rows of G
+        profile->matrixBytes += 2 * (columns.nonZeros() * (sizeof(double) + sizeof(int)) + (n + 1) * sizeof(int));
+    }
+    return stats;
+}
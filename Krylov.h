@@ -0,0 +1,72 @@
+#pragma once
+#include "NumericSystem.h"
+#include "SolveStats.h"
+#include <cstddef>
+#include <vector>
+
+// Preconditioned Krylov solver for DC systems too large to factor, power grids and other resistive meshes
+// Voltage sources and DC shorted inductors from a node to ground fix the voltage of their node: the node and
+// the branch unknown leave the system together with their two equations, and the branch current comes back
+// from the node's KCL row after the solve. A mesh of resistors and current sources is left with a symmetric
+// positive definite conductance matrix, solved by conjugate gradients. Anything else left in the reduced
+// system (floating sources, controlled sources) makes it nonsymmetric or indefinite and takes restarted
+// GMRES instead, with the equations reordered by a maximum transversal so no diagonal entry is zero.
+// Preconditioners are
+//   - ILU(k): incomplete LU with fill up to level k. On a symmetric matrix U = D L^T, it is IC(k)
+//   - Multigrid: plain aggregation algebraic multigrid, one V-cycle with symmetric Gauss-Seidel smoothing
+//     and an LU on the coarsest level. Only for the symmetric case, the solver falls back to ILU(k) otherwise
+//   - Jacobi
+// Memory is the matrix, the preconditioner (its fill bounded by fillLimit) and a few vectors, restart + 1
+// more for GMRES. Products and vector updates run on `threads` workers over fixed blocks, so the result
+// doesn't depend on the thread count. The triangular solves and the smoother are serial.
+
+enum class KrylovMethod
+{
+	Auto, // CG for a symmetric reduced system with a positive diagonal, GMRES otherwise
+	CG,
+	GMRES
+};
+
+enum class KrylovPreconditioner
+{
+	Auto, // Multigrid where CG runs, ILU(k) otherwise
+	Jacobi,
+	ILU,
+	Multigrid
+};
+
+struct KrylovOptions
+{
+	KrylovMethod method = KrylovMethod::Auto;
+	KrylovPreconditioner preconditioner = KrylovPreconditioner::Auto;
+	size_t fill = 0;           // k of ILU(k)
+	double fillLimit = 4;      // ILU(k) entries at most this many times those of the matrix, k is lowered to fit
+	size_t coarseSize = 1000;  // Multigrid levels are added until one has at most this many unknowns
+	double tolerance = 1e-10;  // On ||b - A x|| / ||b|| of the reduced system
+	size_t maxIterations = 1000;
+	size_t restart = 50;       // GMRES basis size
+	unsigned threads = 0;      // 0 is one per hardware thread
+};
+
+struct KrylovStats
+{
+	KrylovMethod method = KrylovMethod::Auto;                     // The ones that ran
+	KrylovPreconditioner preconditioner = KrylovPreconditioner::Auto;
+	bool converged = false;
+	bool symmetric = false;        // Reduced system symmetric with a positive diagonal
+	size_t iterations = 0;
+	double residual = 0;           // Relative, of the last iteration
+	size_t unknowns = 0;           // Reduced system
+	size_t fixedNodes = 0;         // Eliminated with their source
+	size_t preconditionerNonZeros = 0;
+	size_t fill = 0;               // Level of the ILU(k) that fit into fillLimit
+	size_t levels = 0;             // Multigrid levels, the finest included
+	size_t shiftedPivots = 0;      // Zero or tiny ILU pivots replaced to keep the factors finite
+	double setupSeconds = 0;       // Reduction and preconditioner
+	double iterationSeconds = 0;
+};
+
+// Solves G x = rhs of sys. x is the initial guess on entry when it has sys.size() entries (else zero) and the
+// solution on return, also if the iteration didn't converge within maxIterations (see KrylovStats::converged)
+KrylovStats solveKrylov(const NumericSystem& sys, std::vector<double>& x, const KrylovOptions& options = {},
+	SolveStats* profile = nullptr);
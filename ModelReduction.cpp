@@ -0,0 +1,287 @@
+#include "ModelReduction.h"
+#include "ACSweep.h"
+#include "BlockLU.h"
+#include "DiscreteComponents.h"
+#include "SparseMatrix.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+using Complex = std::complex<double>;
+
+double dot(const std::vector<double>& a, const std::vector<double>& b) {
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); i++) sum += a[i] * b[i];
+    return sum;
+}
+
+// Solves A * Y = B in place for the small reduced matrices, A is n x n and B n x cols, row major
+void solveDense(std::vector<Complex>& A, std::vector<Complex>& B, size_t n, size_t cols) {
+    for (size_t c = 0; c < n; c++) {
+        size_t p = c;
+        for (size_t r = c + 1; r < n; r++) {
+            if (std::abs(A[r * n + c]) > std::abs(A[p * n + c])) p = r;
+        }
+        if (A[p * n + c] == Complex(0)) throw std::runtime_error("Reduced model is singular at this frequency.");
+        if (p != c) {
+            for (size_t j = 0; j < n; j++) std::swap(A[p * n + j], A[c * n + j]);
+            for (size_t j = 0; j < cols; j++) std::swap(B[p * cols + j], B[c * cols + j]);
+        }
+        for (size_t r = c + 1; r < n; r++) {
+            Complex f = A[r * n + c] / A[c * n + c];
+            if (f == Complex(0)) continue;
+            for (size_t j = c; j < n; j++) A[r * n + j] -= f * A[c * n + j];
+            for (size_t j = 0; j < cols; j++) B[r * cols + j] -= f * B[c * cols + j];
+        }
+    }
+    for (size_t c = n; c-- > 0;) {
+        for (size_t j = 0; j < cols; j++) {
+            Complex sum = B[c * cols + j];
+            for (size_t k = c + 1; k < n; k++) sum -= A[c * n + k] * B[k * cols + j];
+            B[c * cols + j] = sum / A[c * n + c];
+        }
+    }
+}
+
+void checkPorts(size_t size, const std::vector<int>& ports) {
+    if (ports.empty()) throw std::invalid_argument("Model reduction needs at least one port.");
+    for (size_t p = 0; p < ports.size(); p++) {
+        if (ports[p] < 0 || ports[p] >= static_cast<int>(size)) throw std::invalid_argument("Port outside of the system, ports can't be ground.");
+        for (size_t q = 0; q < p; q++) {
+            if (ports[q] == ports[p]) throw std::invalid_argument("Port node given twice.");
+        }
+    }
+}
+
+// Z of the full system from one factorization, m solves with unit port currents
+std::vector<Complex> fullImpedance(BlockLU<Complex>& lu, size_t n, const std::vector<int>& ports) {
+    size_t m = ports.size();
+    std::vector<Complex> Z(m * m), x;
+    for (size_t q = 0; q < m; q++) {
+        x.assign(n, Complex(0));
+        x[ports[q]] = 1;
+        lu.solve(x);
+        for (size_t p = 0; p < m; p++) Z[p * m + q] = x[ports[p]];
+    }
+    return Z;
+}
+
+} // namespace
+
+ReducedModel reduceNetwork(const NumericSystem& sys, size_t nodes, const std::vector<int>& ports, const ReductionOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    size_t n = sys.size(), m = ports.size();
+    checkPorts(nodes, ports);
+    if (options.order < m) throw std::invalid_argument("Reduced order has to be at least the port count.");
+    if (options.expansion < 0) throw std::invalid_argument("Expansion point has to be s0 >= 0.");
+
+    // Branch rows negated, see ModelReduction.h
+    auto sign = [&](int row) { return row >= static_cast<int>(nodes) ? -1.0 : 1.0; };
+    TripletMatrix<double> g(n, n), c(n, n), shifted(n, n);
+    for (size_t k = 0; k < sys.G.entries(); k++) {
+        double value = sign(sys.G.row(k)) * sys.G.value(k);
+        g.add(sys.G.row(k), sys.G.col(k), value);
+        shifted.add(sys.G.row(k), sys.G.col(k), value);
+    }
+    for (size_t k = 0; k < sys.C.entries(); k++) {
+        double value = sign(sys.C.row(k)) * sys.C.value(k);
+        c.add(sys.C.row(k), sys.C.col(k), value);
+        if (options.expansion != 0) shifted.add(sys.C.row(k), sys.C.col(k), options.expansion * value);
+    }
+    SparseMatrix<double> G = SparseMatrix<double>::fromTriplets(g), C = SparseMatrix<double>::fromTriplets(c);
+    SparseMatrix<double> M = SparseMatrix<double>::fromTriplets(shifted);
+
+    BlockLU<double> lu;
+    lu.analyze(M);
+    try {
+        lu.factorize(M);
+    }
+    catch (const std::runtime_error& error) {
+        throw std::runtime_error(std::string(error.what()) +
+            "\nG + s0 C is singular, a network without a DC path to ground needs an expansion point s0 > 0.");
+    }
+
+    // Block Arnoldi, modified Gram-Schmidt done twice, deflated vectors are dropped
+    std::vector<std::vector<double>> X;
+    auto append = [&](std::vector<double>& w) {
+        double before = std::sqrt(dot(w, w));
+        if (before == 0) return;
+        for (int pass = 0; pass < 2; pass++) {
+            for (const auto& x : X) {
+                double h = dot(x, w);
+                for (size_t i = 0; i < n; i++) w[i] -= h * x[i];
+            }
+        }
+        double after = std::sqrt(dot(w, w));
+        if (after <= options.deflation * before) return;
+        for (double& value : w) value /= after;
+        X.push_back(std::move(w));
+    };
+
+    std::vector<double> w;
+    for (int port : ports) {
+        w.assign(n, 0.0);
+        w[port] = 1;
+        lu.solve(w);
+        append(w);
+    }
+    for (size_t begin = 0; X.size() < options.order;) {
+        size_t end = X.size();
+        if (begin == end) break; // The Krylov space is exhausted, the model is exact
+        for (size_t j = begin; j < end && X.size() < options.order; j++) {
+            C.multiply(X[j], w);
+            lu.solve(w);
+            append(w);
+        }
+        begin = end;
+    }
+
+    ReducedModel model;
+    size_t q = X.size();
+    model.ports = m;
+    model.order = q;
+    model.expansion = options.expansion;
+    model.G.resize(q * q);
+    model.C.resize(q * q);
+    model.B.resize(q * m);
+    std::vector<double> gx, cx;
+    for (size_t b = 0; b < q; b++) {
+        G.multiply(X[b], gx);
+        C.multiply(X[b], cx);
+        for (size_t a = 0; a < q; a++) {
+            model.G[a * q + b] = dot(X[a], gx);
+            model.C[a * q + b] = dot(X[a], cx);
+        }
+    }
+    for (size_t a = 0; a < q; a++) {
+        for (size_t p = 0; p < m; p++) model.B[a * m + p] = X[a][ports[p]];
+    }
+    model.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return model;
+}
+
+std::vector<std::complex<double>> ReducedModel::impedance(double omega) const {
+    std::vector<Complex> K(order * order), Y(B.begin(), B.end());
+    for (size_t k = 0; k < K.size(); k++) K[k] = Complex(G[k], omega * C[k]);
+    solveDense(K, Y, order, ports);
+
+    std::vector<Complex> Z(ports * ports, Complex(0));
+    for (size_t p = 0; p < ports; p++) {
+        for (size_t q = 0; q < ports; q++) {
+            for (size_t a = 0; a < order; a++) Z[p * ports + q] += B[a * ports + p] * Y[a * ports + q];
+        }
+    }
+    return Z;
+}
+
+std::vector<std::complex<double>> portImpedance(const NumericSystem& sys, const std::vector<int>& ports, double omega) {
+    checkPorts(sys.size(), ports);
+    FrequencyPattern pattern(sys);
+    SparseMatrix<Complex> A = pattern.makeMatrix();
+    pattern.assemble(omega, A);
+    BlockLU<Complex> lu;
+    lu.analyze(A);
+    lu.factorize(A);
+    return fullImpedance(lu, sys.size(), ports);
+}
+
+// One ordering for every point of the full model, as in runACSweep
+
+ReductionError compareReduced(const NumericSystem& sys, const std::vector<int>& ports, const ReducedModel& model,
+    const std::vector<double>& frequencies) {
+    checkPorts(sys.size(), ports);
+    if (model.ports != ports.size()) throw std::invalid_argument("Reduced model has a different port count.");
+    const double two_pi = 2.0 * std::acos(-1.0);
+
+    FrequencyPattern pattern(sys);
+    SparseMatrix<Complex> A = pattern.makeMatrix();
+    auto analysis = std::make_shared<const LUAnalysis>(analyzePattern(pattern.size(), pattern.colPtr(), pattern.rowIdx()));
+    BlockLU<Complex> lu(analysis);
+
+    ReductionError result;
+    for (double f : frequencies) {
+        auto start = std::chrono::steady_clock::now();
+        pattern.assemble(two_pi * f, A);
+        lu.factorize(A);
+        std::vector<Complex> full = fullImpedance(lu, sys.size(), ports);
+        auto middle = std::chrono::steady_clock::now();
+        std::vector<Complex> reduced = model.impedance(two_pi * f);
+        auto end = std::chrono::steady_clock::now();
+        result.fullSeconds += std::chrono::duration<double>(middle - start).count();
+        result.reducedSeconds += std::chrono::duration<double>(end - middle).count();
+
+        double norm = 0, error = 0;
+        for (size_t k = 0; k < full.size(); k++) {
+            norm += std::norm(full[k]);
+            error += std::norm(full[k] - reduced[k]);
+        }
+        double relative = norm > 0 ? std::sqrt(error / norm) : std::sqrt(error);
+        if (relative >= result.maxRelative) {
+            result.maxRelative = relative;
+            result.worstFrequency = f;
+        }
+    }
+    return result;
+}
+
+MacroModel::MacroModel(const std::string& sym, std::shared_ptr<const ReducedModel> reduced, std::vector<std::shared_ptr<Node>> nodes)
+    : symbol("XM" + sym), model(std::move(reduced)), terminals(std::move(nodes)) {
+    if (!model) throw std::invalid_argument("Macro model " + symbol + " needs a reduced model.");
+    for (const auto& node : terminals) {
+        if (!node) throw std::invalid_argument("Macro model " + symbol + " has an unconnected port.");
+    }
+    if (terminals.size() != model->ports) {
+        throw std::invalid_argument("Macro model " + symbol + " connects " + std::to_string(terminals.size()) +
+            " nodes to " + std::to_string(model->ports) + " ports.");
+    }
+}
+
+// z rows first, then one row per port current
+
+void MacroModel::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
+    size_t q = model->order, m = model->ports;
+    int z = getBranchIndex(), i = z + static_cast<int>(q);
+    for (size_t a = 0; a < q; a++) {
+        for (size_t b = 0; b < q; b++) {
+            ex value = model->G[a * q + b];
+            if (analysis == AnalysisType::AC) value += s * model->C[a * q + b];
+            if (!value.is_zero()) stampEntry(G, z + static_cast<int>(a), z + static_cast<int>(b), value);
+        }
+    }
+    for (size_t p = 0; p < m; p++) {
+        int port = terminals[p]->getIndex(), row = i + static_cast<int>(p);
+        for (size_t a = 0; a < q; a++) {
+            double b = model->B[a * m + p];
+            if (b == 0) continue;
+            stampEntry(G, z + static_cast<int>(a), row, -b);
+            stampEntry(G, row, z + static_cast<int>(a), b);
+        }
+        stampEntry(G, row, port, -1);
+        stampEntry(G, port, row, 1);
+    }
+}
+
+void MacroModel::stampNumeric(NumericSystem& sys) const {
+    size_t q = model->order, m = model->ports;
+    int z = getBranchIndex(), i = z + static_cast<int>(q);
+    for (size_t a = 0; a < q; a++) {
+        for (size_t b = 0; b < q; b++) {
+            if (model->G[a * q + b] != 0) sys.G.add(z + static_cast<int>(a), z + static_cast<int>(b), model->G[a * q + b]);
+            if (model->C[a * q + b] != 0) sys.C.add(z + static_cast<int>(a), z + static_cast<int>(b), model->C[a * q + b]);
+        }
+    }
+    for (size_t p = 0; p < m; p++) {
+        int port = terminals[p]->getIndex(), row = i + static_cast<int>(p);
+        for (size_t a = 0; a < q; a++) {
+            double b = model->B[a * m + p];
+            if (b == 0) continue;
+            sys.G.add(z + static_cast<int>(a), row, -b);
+            sys.G.add(row, z + static_cast<int>(a), b);
+        }
+        sys.G.add(row, port, -1);
+        sys.G.add(port, row, 1);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "Component.h"
+#include "NumericSystem.h"
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ginac/ginac.h>
+
+using namespace GiNaC;
+
+// Krylov model order reduction (PRIMA) of a linear network seen from a few port nodes
+// With a unit current injected at every port, B = [e_p1 .. e_pm], the network is
+//   (G + s C) x = B u,   v = B^T x,   Z(s) = B^T (G + s C)^-1 B
+// Block Arnoldi builds an orthonormal basis X of the block Krylov space of
+//   A = (G + s0 C)^-1 C,   R = (G + s0 C)^-1 B
+// and the congruence Gr = X^T G X, Cr = X^T C X, Br = X^T B matches order / m block moments of Z about s0.
+// Branch rows (sources, inductors) are negated first. That puts the MNA stamps of an RLC network into the
+// form G + G^T >= 0, C >= 0, which the congruence keeps, so the reduced model is passive.
+// Independent sources count as zero (voltage sources short, current sources open), only the ports drive
+// the network. Ports are between a node and ground.
+
+struct ReductionOptions
+{
+	size_t order = 20;      // Columns of X, at least the port count
+	double expansion = 0;   // s0 in rad/s, > 0 for networks without a DC path to ground
+	double deflation = 1e-10; // Krylov vectors that lose more of their norm to the basis are dropped
+};
+
+// Dense reduced matrices, row major
+struct ReducedModel
+{
+	size_t ports = 0, order = 0;
+	double expansion = 0;
+	std::vector<double> G, C; // order x order
+	std::vector<double> B;    // order x ports
+	double seconds = 0;       // Reduction time
+
+	// Port impedance matrix Z(jω), ports x ports row major
+	std::vector<std::complex<double>> impedance(double omega) const;
+};
+
+// Largest relative error of Z over a set of frequencies, in the Frobenius norm of the full Z at every point
+struct ReductionError
+{
+	double maxRelative = 0;
+	double worstFrequency = 0;  // Hz
+	double fullSeconds = 0;     // Evaluating every point on the full and on the reduced model
+	double reducedSeconds = 0;
+};
+
+// `nodes` is the number of node voltage unknowns of sys, ports are node unknowns. Throw std::invalid_argument
+// for bad ports and std::runtime_error if G + s0 C is singular
+ReducedModel reduceNetwork(const NumericSystem& sys, size_t nodes, const std::vector<int>& ports,
+	const ReductionOptions& options = {});
+
+// Z(jω) of the full system, same layout as ReducedModel::impedance()
+std::vector<std::complex<double>> portImpedance(const NumericSystem& sys, const std::vector<int>& ports, double omega);
+
+// Frequencies in Hz
+ReductionError compareReduced(const NumericSystem& sys, const std::vector<int>& ports, const ReducedModel& model,
+	const std::vector<double>& frequencies);
+
+// Reduced model as a circuit element, the exported macro model of the network
+// The reduced state z and the port currents i are its branch unknowns:
+//   (Gr + s Cr) z - Br i = 0,   Br^T z = v(ports),   i leaves every port node into the model
+
+class MacroModel : public CircuitElement
+{
+	std::string symbol;
+	std::shared_ptr<const ReducedModel> model;
+	std::vector<std::shared_ptr<Node>> terminals;
+
+public:
+	// Throws std::invalid_argument if the node count differs from the port count
+	MacroModel(const std::string& sym, std::shared_ptr<const ReducedModel> reduced, std::vector<std::shared_ptr<Node>> nodes);
+
+	std::string getSym() const { return symbol; }
+	const ReducedModel& getModel() const { return *model; }
+
+	std::vector<std::shared_ptr<Node>> getTerminals() const override { return terminals; }
+	size_t branchCount() const override { return model->order + model->ports; }
+
+	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampNumeric(NumericSystem& sys) const override;
+	bool isNumeric() const override { return true; }
+};
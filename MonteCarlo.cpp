@@ -0,0 +1,288 @@
+#include "MonteCarlo.h"
+#include "BlockLU.h"
+#include "Parallel.h"
+#include "SparseLU.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+void ParameterSamples::set(const symbol& sym, std::vector<double> values) {
+    if (values.size() != count) {
+        throw std::invalid_argument("Samples of " + sym.get_name() + " don't match the sample count.");
+    }
+    int k = find(sym);
+    if (k == -1) {
+        symbols.push_back(sym);
+        columns.push_back(std::move(values));
+    }
+    else {
+        columns[k] = std::move(values);
+    }
+}
+
+int ParameterSamples::find(const symbol& sym) const {
+    for (size_t k = 0; k < symbols.size(); k++) {
+        if (symbols[k].is_equal(sym)) return static_cast<int>(k);
+    }
+    return -1;
+}
+
+ParameterSamples ParameterSamples::corners(const std::vector<symbol>& syms, const std::vector<double>& nominal, double tolerance) {
+    if (syms.size() != nominal.size()) throw std::invalid_argument("Every corner symbol needs a nominal value.");
+    if (syms.size() > 24) throw std::invalid_argument("Too many symbols for a full corner run.");
+
+    size_t count = size_t(1) << syms.size();
+    ParameterSamples result(count);
+    for (size_t k = 0; k < syms.size(); k++) {
+        std::vector<double> values(count);
+        for (size_t c = 0; c < count; c++) values[c] = nominal[k] * (((c >> k) & 1) ? 1 + tolerance : 1 - tolerance);
+        result.set(syms[k], std::move(values));
+    }
+    return result;
+}
+
+namespace {
+
+constexpr size_t lanes = 8; // Samples per group, one AVX-512 or two AVX2 registers of doubles
+
+// Running mean and variance (Welford), partial results merge with Chan's formula
+struct Moments
+{
+    size_t count = 0;
+    double mean = 0, m2 = 0;
+    double min = std::numeric_limits<double>::infinity(), max = -std::numeric_limits<double>::infinity();
+
+    void add(double x) {
+        count++;
+        double d = x - mean;
+        mean += d / count;
+        m2 += d * (x - mean);
+        min = std::min(min, x);
+        max = std::max(max, x);
+    }
+
+    void merge(const Moments& other) {
+        if (other.count == 0) return;
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        double total = static_cast<double>(count + other.count);
+        double d = other.mean - mean;
+        mean += d * other.count / total;
+        m2 += other.m2 + d * d * count * other.count / total;
+        count += other.count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+// SparseLU::refactor() and solve() on `lanes` matrices of one pattern at once
+// Every value is stored lane-interleaved, so each update of the elimination is a short fixed length loop
+
+class LaneLU
+{
+    const LUPattern& pattern;
+    std::vector<double> l_val, u_val, u_diag, x;
+
+public:
+    explicit LaneLU(const LUPattern& p)
+        : pattern(p), l_val(p.l_idx.size() * lanes), u_val(p.u_idx.size() * lanes), u_diag(p.n * lanes), x(p.n * lanes, 0.0) {}
+
+    // ok[l] is cleared for the lanes where a reused pivot became too small (same test as SparseLU)
+    void factor(const std::vector<int>& Ap, const std::vector<int>& Ai, const std::vector<double>& a, bool* ok) {
+        const auto& P = pattern;
+        std::fill(ok, ok + lanes, true);
+
+        for (size_t k = 0; k < P.n; k++) {
+            int col = P.q[k];
+            for (int p = Ap[col]; p < Ap[col + 1]; p++) {
+                double* xr = &x[P.pinv[Ai[p]] * lanes];
+                const double* ap = &a[p * lanes];
+                for (size_t l = 0; l < lanes; l++) xr[l] += ap[l];
+            }
+
+            for (int p = P.u_ptr[k]; p < P.u_ptr[k + 1]; p++) {
+                double* xj = &x[P.u_idx[p] * lanes];
+                double* up = &u_val[p * lanes];
+                for (size_t l = 0; l < lanes; l++) {
+                    up[l] = xj[l];
+                    xj[l] = 0.0;
+                }
+                int j = P.u_idx[p];
+                for (int r = P.l_ptr[j]; r < P.l_ptr[j + 1]; r++) {
+                    double* xr = &x[P.l_idx[r] * lanes];
+                    const double* lr = &l_val[r * lanes];
+                    for (size_t l = 0; l < lanes; l++) xr[l] -= lr[l] * up[l];
+                }
+            }
+
+            double largest[lanes] = {};
+            for (int p = P.l_ptr[k]; p < P.l_ptr[k + 1]; p++) {
+                const double* xr = &x[P.l_idx[p] * lanes];
+                for (size_t l = 0; l < lanes; l++) largest[l] = std::max(largest[l], std::abs(xr[l]));
+            }
+
+            double* xk = &x[k * lanes];
+            double* dk = &u_diag[k * lanes];
+            for (size_t l = 0; l < lanes; l++) {
+                dk[l] = xk[l];
+                xk[l] = 0.0;
+                if (!(std::abs(dk[l]) >= 1e-4 * largest[l]) || dk[l] == 0.0) ok[l] = false; // NaN fails too
+            }
+
+            for (int p = P.l_ptr[k]; p < P.l_ptr[k + 1]; p++) {
+                double* xr = &x[P.l_idx[p] * lanes];
+                double* lp = &l_val[p * lanes];
+                for (size_t l = 0; l < lanes; l++) {
+                    lp[l] = xr[l] / dk[l];
+                    xr[l] = 0.0;
+                }
+            }
+        }
+    }
+
+    // b holds n x lanes right hand sides on entry and the solutions on return
+    void solve(std::vector<double>& b) {
+        const auto& P = pattern;
+        for (size_t i = 0; i < P.n; i++) {
+            for (size_t l = 0; l < lanes; l++) x[P.pinv[i] * lanes + l] = b[i * lanes + l];
+        }
+
+        for (size_t k = 0; k < P.n; k++) {
+            const double* xk = &x[k * lanes];
+            for (int p = P.l_ptr[k]; p < P.l_ptr[k + 1]; p++) {
+                double* xr = &x[P.l_idx[p] * lanes];
+                const double* lp = &l_val[p * lanes];
+                for (size_t l = 0; l < lanes; l++) xr[l] -= lp[l] * xk[l];
+            }
+        }
+
+        for (size_t k = P.n; k-- > 0;) {
+            double* xk = &x[k * lanes];
+            const double* dk = &u_diag[k * lanes];
+            for (size_t l = 0; l < lanes; l++) xk[l] /= dk[l];
+            for (int p = P.u_ptr[k]; p < P.u_ptr[k + 1]; p++) {
+                double* xr = &x[P.u_idx[p] * lanes];
+                const double* up = &u_val[p * lanes];
+                for (size_t l = 0; l < lanes; l++) xr[l] -= up[l] * xk[l];
+            }
+        }
+
+        for (size_t k = 0; k < P.n; k++) {
+            for (size_t l = 0; l < lanes; l++) {
+                b[P.q[k] * lanes + l] = x[k * lanes + l];
+                x[k * lanes + l] = 0.0; // factor() expects a clean work vector
+            }
+        }
+    }
+};
+
+} // namespace
+
+BatchResult runBatch(const CompiledCircuit& program, const ParameterSamples& samples,
+    const std::vector<int>& outputs, const BatchOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    size_t n = program.size(), m = outputs.size(), count = samples.size();
+    for (int idx : outputs) {
+        if (idx >= static_cast<int>(n)) throw std::out_of_range("Batch output outside of the system.");
+    }
+
+    // Sample columns in the binding order of the program
+    const auto& parameters = program.getParameters();
+    std::vector<const std::vector<double>*> columns;
+    for (const auto& parameter : parameters) {
+        int k = samples.find(parameter);
+        if (k == -1) throw std::invalid_argument("No samples given for " + parameter.get_name() + ".");
+        columns.push_back(&samples.column(k));
+    }
+    auto bind = [&](size_t sample, std::vector<double>& bindings) {
+        bindings.resize(columns.size());
+        for (size_t p = 0; p < columns.size(); p++) bindings[p] = (*columns[p])[sample];
+    };
+
+    BatchResult result;
+    result.samples = count;
+    result.outputs = outputs;
+    result.stats.resize(m);
+    if (options.keepSamples) result.values.assign(count * m, 0.0);
+    if (count == 0) return result;
+
+    // Ordering and pivot sequence from the first sample
+    SparseMatrix<double> G0;
+    std::vector<double> rhs0, bindings0;
+    bind(0, bindings0);
+    program.evaluate(bindings0, G0, rhs0);
+    LUAnalysis analysis = analyzePattern(n, G0.colPtr(), G0.rowIdx());
+    if (analysis.isStructurallySingular()) throw std::runtime_error(analysis.structuralReport());
+    SparseLU<double> nominal;
+    nominal.factorize(G0, analysis.col_perm);
+    const LUPattern pattern = nominal.pattern();
+    const bool laned = nominal.factorNonZeros() <= options.laneLimit;
+
+    const size_t chunk = laned ? 16 * lanes : 64;
+    const size_t chunks = (count + chunk - 1) / chunk;
+    std::vector<std::vector<Moments>> partial(chunks, std::vector<Moments>(m));
+    std::vector<size_t> fallbacks(chunks, 0);
+
+    parallelFor(count, chunk, options.threads, [&](size_t begin, size_t end, unsigned) {
+        size_t c = begin / chunk;
+        auto& moments = partial[c];
+        SparseLU<double> lu = nominal;
+        SparseMatrix<double> G;
+        std::vector<double> rhs, bindings;
+
+        auto record = [&](size_t sample, const double* x, size_t stride) {
+            for (size_t k = 0; k < m; k++) {
+                double v = outputs[k] >= 0 ? x[outputs[k] * stride] : 0.0;
+                moments[k].add(v);
+                if (options.keepSamples) result.values[sample * m + k] = v;
+            }
+        };
+
+        auto single = [&](size_t sample, bool reuse) {
+            bind(sample, bindings);
+            program.evaluate(bindings, G, rhs);
+            if (!reuse || !lu.refactor(G)) {
+                lu.factorize(G, pattern.q);
+                fallbacks[c]++;
+            }
+            lu.solve(rhs);
+            record(sample, rhs.data(), 1);
+        };
+
+        if (!laned) {
+            for (size_t sample = begin; sample < end; sample++) single(sample, true);
+            return;
+        }
+
+        LaneLU lane(pattern);
+        std::vector<double> lane_bindings(columns.size() * lanes), g, b;
+        bool ok[lanes];
+        for (size_t first = begin; first < end; first += lanes) {
+            size_t width = std::min(lanes, end - first);
+            for (size_t p = 0; p < columns.size(); p++) {
+                for (size_t l = 0; l < lanes; l++) lane_bindings[p * lanes + l] = (*columns[p])[first + std::min(l, width - 1)];
+            }
+            program.evaluateBatch(lane_bindings, lanes, g, b);
+            lane.factor(G0.colPtr(), G0.rowIdx(), g, ok);
+            lane.solve(b);
+            for (size_t l = 0; l < width; l++) {
+                if (ok[l]) record(first + l, &b[l], lanes);
+                else single(first + l, false);
+            }
+        }
+    });
+
+    for (size_t k = 0; k < m; k++) {
+        Moments total;
+        for (size_t c = 0; c < chunks; c++) total.merge(partial[c][k]);
+        result.stats[k] = { total.mean, total.count > 1 ? std::sqrt(total.m2 / (total.count - 1)) : 0.0, total.min, total.max };
+    }
+    for (size_t f : fallbacks) result.fallbacks += f;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
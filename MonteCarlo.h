@@ -0,0 +1,67 @@
+#pragma once
+#include "CompiledCircuit.h"
+#include <cstddef>
+#include <vector>
+#include <ginac/ginac.h>
+
+using namespace GiNaC;
+
+// Parameter samples as a structure of arrays, one column of values per symbol
+// Every free symbol of the circuit needs a column, fix() gives a constant one
+
+class ParameterSamples
+{
+	size_t count = 0;
+	std::vector<symbol> symbols;
+	std::vector<std::vector<double>> columns;
+
+public:
+	ParameterSamples() = default;
+	explicit ParameterSamples(size_t samples) : count(samples) {}
+
+	// Throws std::invalid_argument if the number of values differs from size()
+	void set(const symbol& sym, std::vector<double> values);
+	void fix(const symbol& sym, double value) { set(sym, std::vector<double>(count, value)); }
+
+	// Every combination of nominal * (1 -+ tolerance), 2^k samples for k symbols
+	static ParameterSamples corners(const std::vector<symbol>& syms, const std::vector<double>& nominal, double tolerance);
+
+	size_t size() const { return count; }
+	int find(const symbol& sym) const; // Column of the symbol, -1 if it has none
+	const std::vector<double>& column(size_t k) const { return columns[k]; }
+};
+
+struct BatchOptions
+{
+	bool keepSamples = true;  // Per sample outputs, otherwise only the statistics
+	unsigned threads = 0;     // 0 is one per hardware thread
+	size_t laneLimit = 20000; // Largest factor (entries) solved lane-wise, bigger circuits go sample by sample
+};
+
+struct OutputStats
+{
+	double mean = 0, stddev = 0, min = 0, max = 0;
+};
+
+// DC solutions of every sample, values are sample major
+
+struct BatchResult
+{
+	size_t samples = 0;
+	std::vector<int> outputs;    // MNA unknown of every column, -1 is ground
+	std::vector<double> values;  // Empty unless keepSamples
+	std::vector<OutputStats> stats;
+	size_t fallbacks = 0;        // Samples that needed their own pivot search
+	double seconds = 0;
+
+	double at(size_t sample, size_t output) const { return values[sample * outputs.size() + output]; }
+	double samplesPerSecond() const { return seconds > 0 ? samples / seconds : 0; }
+};
+
+// One fixed topology, many parameter sets
+// The pivot sequence comes from the first sample. Small circuits are then evaluated and factored
+// for a group of samples at once, with the samples in the innermost (SIMD) loop; larger ones
+// refactor sample by sample. Chunks of samples are spread over threads either way and the
+// statistics are merged in chunk order, so the result doesn't depend on the thread count.
+BatchResult runBatch(const CompiledCircuit& program, const ParameterSamples& samples,
+	const std::vector<int>& outputs, const BatchOptions& options = {});
@@ -0,0 +1,156 @@
+#include "NameTable.h"
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+inline char lower(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c; }
+
+inline void prefetch(const void* address) {
+#ifdef _MSC_VER
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    __builtin_prefetch(address);
+#endif
+}
+
+} // namespace
+
+bool NameTable::equal(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); k++) {
+        if (lower(a[k]) != lower(b[k])) return false;
+    }
+    return true;
+}
+
+// Eight bytes at a time, lower cased in register so the hash agrees with equal()
+
+uint64_t NameTable::hash(std::string_view name) {
+    auto lower_word = [](uint64_t x) {
+        uint64_t heptets = x & 0x7f7f7f7f7f7f7f7full;
+        uint64_t from_a = heptets + 0x3f3f3f3f3f3f3f3full; // Top bit set from 'A' up
+        uint64_t past_z = heptets + 0x2525252525252525ull; // Top bit set past 'Z'
+        uint64_t upper = from_a & ~past_z & ~x & 0x8080808080808080ull;
+        return x | (upper >> 2);
+    };
+
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    uint64_t h = name.size() * m;
+    size_t k = 0;
+    for (; k + 8 <= name.size(); k += 8) {
+        uint64_t word;
+        std::memcpy(&word, name.data() + k, 8);
+        h = (h ^ lower_word(word)) * m;
+        h ^= h >> 29;
+    }
+    if (k < name.size()) {
+        uint64_t word = 0;
+        std::memcpy(&word, name.data() + k, name.size() - k);
+        h = (h ^ lower_word(word)) * m;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Slot of the name, or of the empty slot where it would go
+int NameTable::lookup(std::string_view name, uint64_t h, size_t& slot) const {
+    size_t mask = slots.size() - 1;
+    uint32_t tag = static_cast<uint32_t>(h >> 32);
+    for (slot = h & mask; slots[slot].id != -1; slot = (slot + 1) & mask) {
+        if (slots[slot].tag == tag && equal(view(slots[slot].span), name)) return slots[slot].id;
+    }
+    return -1;
+}
+
+void NameTable::place(int id) {
+    size_t mask = slots.size() - 1;
+    size_t slot = hashes[id] & mask;
+    while (slots[slot].id != -1) slot = (slot + 1) & mask;
+    slots[slot] = { static_cast<uint32_t>(hashes[id] >> 32), id, spans[id] };
+}
+
+void NameTable::grow() {
+    reserve(slots.empty() ? 32 : slots.size());
+}
+
+void NameTable::reserve(size_t count, size_t characters) {
+    spans.reserve(count);
+    hashes.reserve(count);
+    text.reserve(characters);
+    size_t capacity = 64;
+    while (capacity < 2 * count) capacity *= 2;
+    if (capacity <= slots.size()) return;
+    slots.assign(capacity, Slot{ 0, -1, 0 });
+    for (size_t id = 0; id < spans.size(); id++) place(static_cast<int>(id));
+}
+
+void NameTable::prefetchSlot(uint64_t h) const {
+    if (!slots.empty()) prefetch(&slots[h & (slots.size() - 1)]);
+}
+
+void NameTable::prefetchName(uint64_t h) const {
+    if (slots.empty()) return;
+    const Slot& slot = slots[h & (slots.size() - 1)];
+    if (slot.id != -1 && slot.tag == static_cast<uint32_t>(h >> 32)) prefetch(text.data() + (slot.span >> 16));
+}
+
+int NameTable::store(std::string_view name) {
+    if (name.size() > 0xffff) throw std::runtime_error("Name longer than 65535 characters.");
+    spans.push_back(static_cast<uint64_t>(text.size()) << 16 | name.size());
+    text.insert(text.end(), name.begin(), name.end());
+    return static_cast<int>(spans.size()) - 1;
+}
+
+int NameTable::find(std::string_view name) const {
+    if (slots.empty()) return -1;
+    size_t slot;
+    return lookup(name, hash(name), slot);
+}
+
+int NameTable::intern(std::string_view name, uint64_t h) {
+    if ((spans.size() + 1) * 2 > slots.size()) grow();
+    size_t slot;
+    int id = lookup(name, h, slot);
+    if (id != -1) return id;
+
+    id = store(name);
+    hashes.push_back(h);
+    slots[slot] = { static_cast<uint32_t>(h >> 32), id, spans[id] };
+    return id;
+}
+
+int NameTable::add(std::string_view name) {
+    return store(name);
+}
+
+void NameTable::rename(int id, std::string_view name) {
+    int stored = store(name);
+    spans[id] = spans[stored];
+    spans.pop_back();
+}
+
+int NameTable::reindex() {
+    size_t capacity = 64;
+    while (capacity < 2 * (spans.size() + 1)) capacity *= 2;
+    slots.assign(capacity, Slot{ 0, -1, 0 });
+    hashes.resize(spans.size());
+
+    int repeated = -1;
+    for (size_t id = 0; id < spans.size(); id++) {
+        hashes[id] = hash(name(static_cast<int>(id)));
+        size_t slot;
+        if (lookup(name(static_cast<int>(id)), hashes[id], slot) != -1) {
+            if (repeated == -1) repeated = static_cast<int>(id);
+            continue;
+        }
+        slots[slot] = { static_cast<uint32_t>(hashes[id] >> 32), static_cast<int>(id), spans[id] };
+    }
+    return repeated;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Case insensitive name interning, names are copied once into one text buffer and then referred to by index
+// add() only stores a name, reindex() builds the lookup for tables filled that way
+
+class NameTable
+{
+	struct Slot
+	{
+		uint32_t tag;  // High hash bits, most misses are rejected without touching the text
+		int id;        // -1 is empty
+		uint64_t span; // offset << 16 | length, a hit reads the text without going through spans
+	};
+
+	std::vector<char> text;
+	std::vector<uint64_t> spans, hashes;
+	std::vector<Slot> slots; // Open addressing, load factor at most 1/2
+
+	std::string_view view(uint64_t span) const { return std::string_view(text.data() + (span >> 16), span & 0xffff); }
+	int lookup(std::string_view name, uint64_t h, size_t& slot) const;
+	void place(int id);
+	void grow();
+	int store(std::string_view name);
+
+public:
+	static uint64_t hash(std::string_view name);
+	static bool equal(std::string_view a, std::string_view b); // ASCII case insensitive
+	void reserve(size_t count, size_t characters = 0);
+
+	// Two stage prefetch for batched lookups: the slot first, then the text of a likely hit
+	void prefetchSlot(uint64_t h) const;
+	void prefetchName(uint64_t h) const;
+
+	int intern(std::string_view name) { return intern(name, hash(name)); } // Existing or new index
+	int intern(std::string_view name, uint64_t h);
+	int add(std::string_view name);    // Always a new index, not visible to find() until reindex()
+	void rename(int id, std::string_view name); // As add(), the new name needs a reindex()
+	int reindex();                     // Returns the first name that repeats an earlier one, -1 if none
+	int find(std::string_view name) const; // -1 if unknown
+
+	std::string_view name(int id) const { return view(spans[id]); } // Valid until the next add/intern
+	size_t size() const { return spans.size(); }
+};
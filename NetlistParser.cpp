@@ -0,0 +1,543 @@
+#include "NetlistParser.h"
+#include "Circuit.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Mapping
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        throw std::runtime_error("Cannot open netlist " + path + ".");
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    length = static_cast<size_t>(file_size.QuadPart);
+    if (length == 0) return;
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!bytes) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Cannot map netlist " + path + ".");
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open netlist " + path + ".");
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat netlist " + path + ".");
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length == 0) return;
+
+    void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Cannot map netlist " + path + ".");
+    }
+    madvise(view, length, MADV_SEQUENTIAL);
+    bytes = static_cast<const char*>(view);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+    if (fd >= 0) close(fd);
+}
+
+#endif
+
+// Helpers
+
+namespace {
+
+inline char lower(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c; }
+
+// SPICE number with an optional scale suffix, trailing units are ignored (10uF, 1kOhm)
+bool parseValue(std::string_view token, double& value) {
+    const char* begin = token.data();
+    const char* end = begin + token.size();
+    if (begin < end && *begin == '+') begin++;
+    auto parsed = std::from_chars(begin, end, value);
+    if (parsed.ec != std::errc() || parsed.ptr == begin) return false;
+
+    const char* suffix = parsed.ptr;
+    if (suffix == end) return true;
+    switch (lower(*suffix)) {
+    case 't': value *= 1e12; break;
+    case 'g': value *= 1e9; break;
+    case 'k': value *= 1e3; break;
+    case 'u': value *= 1e-6; break;
+    case 'n': value *= 1e-9; break;
+    case 'p': value *= 1e-12; break;
+    case 'f': value *= 1e-15; break;
+    case 'a': value *= 1e-18; break;
+    case 'm':
+        if (end - suffix >= 3 && lower(suffix[1]) == 'e' && lower(suffix[2]) == 'g') value *= 1e6;
+        else if (end - suffix >= 3 && lower(suffix[1]) == 'i' && lower(suffix[2]) == 'l') value *= 25.4e-6;
+        else value *= 1e-3;
+        break;
+    default: break;
+    }
+    return true;
+}
+
+bool isGround(std::string_view name) {
+    return name == "0" || NameTable::equal(name, "gnd");
+}
+
+// Fields 1 .. nodeFields - 1 of a card are node names
+size_t nodeFields(char type, size_t count) {
+    switch (lower(type)) {
+    case 'r': case 'c': case 'l': case 'v': case 'i': case 'f': case 'h': return std::min<size_t>(count, 3);
+    case 'e': case 'g': return std::min<size_t>(count, 5);
+    case 'x': return count > 1 ? count - 1 : 1;
+    default: return 1;
+    }
+}
+
+[[noreturn]] void fail(int line, const std::string& what) {
+    throw std::runtime_error("Netlist line " + std::to_string(line) + ": " + what);
+}
+
+} // namespace
+
+// Parsing
+
+NetlistParser::NetlistParser(NetlistOptions opts) : options(opts), scopes(1) {
+    scopes[0].defined = true;
+}
+
+void NetlistParser::parseFile(const std::string& path) {
+    MappedFile file(path);
+    parseBuffer(file.data(), file.size());
+}
+
+// Tokens end at blanks, commas, parentheses and '=', a card continues on lines starting with '+'
+// Comments: lines starting with '*', and the rest of a line after ';' or '$'
+// Cards are handled in batches: the node name lookups are random accesses into a table much larger
+// than the cache, so every name of the batch is hashed and prefetched before the first one is interned
+
+void NetlistParser::parseBuffer(const char* data, size_t size) {
+    constexpr size_t batch_cards = 64;
+    auto start = std::chrono::steady_clock::now();
+    const char* p = data;
+    const char* end = data + size;
+    int scope = 0, line = 0;
+    bool title = options.firstLineIsTitle;
+
+    struct Pending { size_t first; int line; };
+    std::vector<std::string_view> tokens;
+    std::vector<uint64_t> hashes;
+    std::vector<Pending> batch;
+    tokens.reserve(batch_cards * 8);
+    batch.reserve(batch_cards + 1);
+
+    // Extracted netlists have about one card and one new node per few dozen bytes, reserving
+    // for that avoids regrowing (and copying) the biggest arrays. Untouched capacity costs no memory
+    Scope& top = scopes[0];
+    top.nodes.reserve(top.nodes.size() + size / 32, size / 4);
+    top.elements.reserve(top.elements.size() + size / 24, size / 4);
+    top.cards.reserve(top.cards.size() + size / 24);
+    top.node_ids.reserve(top.node_ids.size() + size / 8);
+
+    static const auto blank = [] {
+        std::array<bool, 256> table{};
+        for (unsigned char c : std::string_view(" \t\r,()=")) table[c] = true;
+        return table;
+    }();
+    auto is_blank = [](char c) { return blank[static_cast<unsigned char>(c)]; };
+
+    auto flush = [&] {
+        hashes.resize(tokens.size());
+        batch.push_back({ tokens.size(), 0 });
+        const NameTable& names = scopes[scope].nodes;
+        for (size_t c = 0; c + 1 < batch.size(); c++) {
+            size_t first = batch[c].first, last = first + nodeFields(tokens[first][0], batch[c + 1].first - first);
+            for (size_t k = first + 1; k < last; k++) {
+                hashes[k] = NameTable::hash(tokens[k]);
+                names.prefetchSlot(hashes[k]);
+            }
+        }
+        for (size_t c = 0; c + 1 < batch.size(); c++) {
+            size_t first = batch[c].first, last = first + nodeFields(tokens[first][0], batch[c + 1].first - first);
+            for (size_t k = first + 1; k < last; k++) names.prefetchName(hashes[k]);
+        }
+
+        for (size_t c = 0; c + 1 < batch.size(); c++) {
+            size_t first = batch[c].first;
+            parseCard(&tokens[first], &hashes[first], batch[c + 1].first - first, batch[c].line, scope);
+        }
+        tokens.clear();
+        batch.clear();
+    };
+
+    while (p < end) {
+        // Start of a physical line
+        line++;
+        if (title) {
+            title = false;
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            p = nl ? nl + 1 : end;
+            continue;
+        }
+
+        bool continuation = *p == '+';
+        if (continuation) p++;
+        else if (*p == '*') {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            p = nl ? nl + 1 : end;
+            continue;
+        }
+
+        size_t first = tokens.size();
+        if (!continuation) batch.push_back({ first, line });
+
+        while (p < end && *p != '\n') {
+            char c = *p;
+            if (is_blank(c)) { p++; continue; }
+            if (c == ';' || c == '$') {
+                while (p < end && *p != '\n') p++;
+                break;
+            }
+            const char* token = p;
+            while (p < end && *p != '\n' && !is_blank(*p) && *p != ';') p++;
+            tokens.emplace_back(token, p - token);
+        }
+        if (p < end) p++; // '\n'
+
+        // The card is complete unless the next line continues it
+        if (p < end && *p == '+') continue;
+        if (batch.empty()) continue; // Stray continuation before the first card
+        if (tokens.size() == batch.back().first) {
+            batch.pop_back(); // Blank line
+            continue;
+        }
+        if (NameTable::equal(tokens[batch.back().first], ".end")) {
+            // May have been the only card of the batch, after a flush or right after the title
+            tokens.resize(batch.back().first);
+            batch.pop_back();
+            flush();
+            break;
+        }
+        // Subcircuit boundaries change the scope the prefetches are for
+        std::string_view head = tokens[batch.back().first];
+        if (batch.size() == batch_cards || NameTable::equal(head, ".subckt") || NameTable::equal(head, ".ends")) flush();
+    }
+    if (!batch.empty()) flush();
+
+    if (scope != 0) fail(line, "missing .ends");
+
+    stats.bytes += size;
+    stats.lines += line;
+    stats.parseSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int NetlistParser::scopeFor(std::string_view subckt) {
+    int id = subckt_names.intern(subckt);
+    if (id + 1 >= static_cast<int>(scopes.size())) scopes.resize(id + 2);
+    return id + 1;
+}
+
+void NetlistParser::parseCard(const std::string_view* tokens, const uint64_t* hashes, size_t count, int line, int& scope) {
+    std::string_view head = tokens[0];
+    Scope* sc = &scopes[scope];
+
+    auto node_id = [&](size_t k) { return isGround(tokens[k]) ? -1 : sc->nodes.intern(tokens[k], hashes[k]); };
+    auto need = [&](size_t fields) {
+        if (count < fields) fail(line, "too few fields for " + std::string(head) + ".");
+    };
+    auto number = [&](size_t k) {
+        double value;
+        if (k >= count || !parseValue(tokens[k], value)) fail(line, "bad value for " + std::string(head) + ".");
+        return value;
+    };
+
+    if (head[0] == '.') {
+        if (NameTable::equal(head, ".subckt")) {
+            need(2);
+            if (scope != 0) fail(line, "nested .subckt definitions are not supported.");
+            scope = scopeFor(tokens[1]);
+            sc = &scopes[scope];
+            if (sc->defined) fail(line, "subcircuit " + std::string(tokens[1]) + " defined twice.");
+            sc->defined = true;
+            // Ports are the first nodes of the scope, parameters (name=value) end the list
+            for (size_t k = 2; k < count; k++) {
+                if (NameTable::equal(tokens[k], "params:")) break;
+                if (isGround(tokens[k])) fail(line, "ground can't be a subcircuit port.");
+                sc->nodes.intern(tokens[k]);
+            }
+            sc->ports = sc->nodes.size();
+            stats.subcircuits++;
+        }
+        else if (NameTable::equal(head, ".ends")) {
+            if (scope == 0) fail(line, ".ends without .subckt.");
+            scope = 0;
+        }
+        else {
+            stats.skipped++;
+        }
+        return;
+    }
+
+    Card card{ 0.0, static_cast<int>(sc->node_ids.size()), line, -1, 0, lower(head[0]) };
+    sc->elements.add(head);
+
+    switch (card.type) {
+    case 'r': case 'c': case 'l':
+        need(4);
+        card.count = 2;
+        sc->node_ids.push_back(node_id(1));
+        sc->node_ids.push_back(node_id(2));
+        card.value = number(3);
+        break;
+
+    case 'v': case 'i': {
+        need(3);
+        card.count = 2;
+        sc->node_ids.push_back(node_id(1));
+        sc->node_ids.push_back(node_id(2));
+        // [DC] value [AC mag [phase]], transient functions are ignored
+        double dc = 0, ac = 0;
+        for (size_t k = 3; k < count; k++) {
+            if (NameTable::equal(tokens[k], "dc")) {
+                dc = number(++k);
+            }
+            else if (NameTable::equal(tokens[k], "ac")) {
+                ac = 1.0; // Magnitude defaults to one
+                if (k + 1 < count && parseValue(tokens[k + 1], ac)) k++;
+            }
+            else if (k == 3) {
+                parseValue(tokens[k], dc);
+            }
+        }
+        card.value = options.useACValues ? ac : dc;
+        break;
+    }
+
+    case 'e': case 'g':
+        need(6);
+        card.count = 4;
+        for (size_t k = 1; k <= 4; k++) sc->node_ids.push_back(node_id(k));
+        card.value = number(5);
+        break;
+
+    case 'f': case 'h':
+        need(5);
+        card.count = 2;
+        sc->node_ids.push_back(node_id(1));
+        sc->node_ids.push_back(node_id(2));
+        if (lower(tokens[3][0]) != 'v') fail(line, std::string(head) + " must be controlled by a voltage source.");
+        card.ref = sc->controls.add(tokens[3]);
+        card.value = number(4);
+        break;
+
+    case 'x': {
+        need(2);
+        // Connections, then the subcircuit name
+        size_t last = count - 1;
+        if (last - 1 > 0xffff) fail(line, "too many connections for " + std::string(head) + ".");
+        card.count = static_cast<uint16_t>(last - 1);
+        for (size_t k = 1; k < last; k++) sc->node_ids.push_back(node_id(k));
+        std::string_view subckt = tokens[last];
+        int target = scopeFor(subckt); // May resize scopes
+        sc = &scopes[scope];
+        card.ref = target;
+        stats.instances++;
+        break;
+    }
+
+    default:
+        fail(line, "unsupported element " + std::string(head) + ".");
+    }
+
+    sc->cards.push_back(card);
+    stats.cards++;
+}
+
+// Building
+
+// Element names are only looked up from here on, duplicates and F/H controls are checked once per scope
+
+void NetlistParser::resolve(Scope& sc) {
+    if (sc.resolved) return;
+    int repeated = sc.elements.reindex();
+    if (repeated != -1) {
+        fail(sc.cards[repeated].line, "duplicate element " + std::string(sc.elements.name(repeated)) + ".");
+    }
+    for (auto& card : sc.cards) {
+        if (card.type != 'f' && card.type != 'h') continue;
+        std::string_view control = sc.controls.name(card.ref);
+        card.ref = sc.elements.find(control);
+        if (card.ref == -1 || sc.cards[card.ref].type != 'v') {
+            fail(card.line, "controlling source " + std::string(control) + " not found.");
+        }
+    }
+    sc.resolved = true;
+}
+
+void NetlistParser::expand(Circuit& circuit, int scope, const std::vector<std::shared_ptr<Node>>& ports,
+    const std::string& path, int depth, std::vector<std::shared_ptr<CircuitElement>>* elements) {
+    if (depth > 64) throw std::runtime_error("Subcircuit nesting too deep (recursive definition?).");
+    const Scope& sc = scopes[scope];
+    auto ground = Node::getGround();
+
+    auto qualified = [&](std::string_view name) {
+        std::string out(name);
+        if (!path.empty()) out += ":" + path;
+        return out;
+    };
+
+    // Local nodes: ports come from the caller, the rest are new
+    std::vector<std::shared_ptr<Node>> local(sc.nodes.size());
+    for (size_t k = 0; k < sc.nodes.size(); k++) {
+        if (k < ports.size()) {
+            local[k] = ports[k];
+            continue;
+        }
+        local[k] = std::make_shared<Node>();
+        local[k]->setSym(qualified(sc.nodes.name(static_cast<int>(k))));
+        circuit.addNode(local[k]);
+        stats.nodes++;
+    }
+    auto at = [&](const Card& card, int k) {
+        int id = sc.node_ids[card.first + k];
+        return id == -1 ? ground : local[id];
+    };
+
+    // Zero volt probes for F/H, chained in series with the positive terminal of the controlling source
+    std::vector<std::vector<std::shared_ptr<Node>>> probes(sc.cards.size());
+    for (const auto& card : sc.cards) {
+        if (card.type != 'f' && card.type != 'h') continue;
+        auto probe = std::make_shared<Node>();
+        probe->setSym(qualified(std::string(sc.elements.name(card.ref)) + "#probe" + std::to_string(probes[card.ref].size())));
+        circuit.addNode(probe);
+        probes[card.ref].push_back(probe);
+        stats.nodes++;
+    }
+    std::vector<size_t> probes_used(sc.cards.size(), 0);
+
+    for (size_t c = 0; c < sc.cards.size(); c++) {
+        const Card& card = sc.cards[c];
+        std::string_view name = sc.elements.name(static_cast<int>(c));
+        std::string sym = qualified(name.substr(1));
+        std::shared_ptr<CircuitElement> element;
+        ex value(card.value);
+
+        switch (card.type) {
+        case 'r': element = circuit.emplace<Resistor>(sym, value, at(card, 0), at(card, 1)); break;
+        case 'c': element = circuit.emplace<Capacitor>(sym, value, at(card, 0), at(card, 1)); break;
+        case 'l': element = circuit.emplace<Inductor>(sym, value, at(card, 0), at(card, 1)); break;
+        case 'i': element = circuit.emplace<CurrentSource>(sym, value, at(card, 0), at(card, 1)); break;
+        case 'v': {
+            auto& chain = probes[c];
+            auto positive = chain.empty() ? at(card, 0) : chain.back();
+            element = circuit.emplace<VoltageSource>(sym, value, positive, at(card, 1));
+            break;
+        }
+        case 'e': element = circuit.emplace<VCVS>(sym, at(card, 0), at(card, 1), at(card, 2), at(card, 3), value); break;
+        case 'g': element = circuit.emplace<VCCS>(sym, at(card, 0), at(card, 1), at(card, 2), at(card, 3), value); break;
+        case 'f': case 'h': {
+            auto& chain = probes[card.ref];
+            size_t k = probes_used[card.ref]++;
+            auto from = k == 0 ? at(sc.cards[card.ref], 0) : chain[k - 1];
+            if (card.type == 'f') element = circuit.emplace<CCCS>(sym, at(card, 0), at(card, 1), from, chain[k], value);
+            else element = circuit.emplace<CCVS>(sym, at(card, 0), at(card, 1), from, chain[k], value);
+            break;
+        }
+        case 'x': {
+            const Scope& target = scopes[card.ref];
+            if (!target.defined) {
+                fail(card.line, "unknown subcircuit " + std::string(subckt_names.name(card.ref - 1)) + ".");
+            }
+            if (static_cast<size_t>(card.count) != target.ports) {
+                fail(card.line, std::string(name) + " connects " + std::to_string(card.count) + " nodes to a "
+                    + std::to_string(target.ports) + " port subcircuit.");
+            }
+            std::vector<std::shared_ptr<Node>> connections;
+            for (int k = 0; k < card.count; k++) connections.push_back(at(card, k));
+            std::string inner(name);
+            if (!path.empty()) inner += "." + path;
+            expand(circuit, card.ref, connections, inner, depth + 1, nullptr);
+            if (elements) elements->push_back(nullptr);
+            continue;
+        }
+        }
+
+        stats.elements++; // Added by emplace()
+        if (elements) elements->push_back(element);
+    }
+}
+
+void NetlistParser::build(Circuit& circuit) {
+    auto start = std::chrono::steady_clock::now();
+    for (auto& sc : scopes) {
+        if (sc.defined) resolve(sc);
+    }
+    const Scope& top = scopes[0];
+
+    circuit.addNode(Node::getGround());
+    top_nodes.clear();
+    for (size_t k = 0; k < top.nodes.size(); k++) {
+        auto node = std::make_shared<Node>();
+        node->setSym(std::string(top.nodes.name(static_cast<int>(k))));
+        circuit.addNode(node);
+        top_nodes.push_back(node);
+        stats.nodes++;
+    }
+
+    top_elements.clear();
+    top_elements.reserve(top.cards.size());
+    expand(circuit, 0, top_nodes, "", 0, &top_elements);
+
+    stats.buildSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::shared_ptr<Node> NetlistParser::node(std::string_view name) const {
+    if (isGround(name)) return Node::getGround();
+    int id = scopes[0].nodes.find(name);
+    return id == -1 || id >= static_cast<int>(top_nodes.size()) ? nullptr : top_nodes[id];
+}
+
+std::shared_ptr<CircuitElement> NetlistParser::element(std::string_view name) const {
+    int card = scopes[0].resolved ? scopes[0].elements.find(name) : -1;
+    return card == -1 || card >= static_cast<int>(top_elements.size()) ? nullptr : top_elements[card];
+}
+
+Circuit loadNetlist(const std::string& path, NetlistStats* stats) {
+    NetlistParser parser;
+    parser.parseFile(path);
+    Circuit circuit;
+    parser.build(circuit);
+    if (stats) *stats = parser.getStats();
+    return circuit;
+}
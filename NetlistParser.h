@@ -0,0 +1,113 @@
+#pragma once
+#include "Node.h"
+#include "Component.h"
+#include "NameTable.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Circuit;
+
+// Read only view of a whole file (mmap / file mapping), the parser tokenizes straight out of it
+
+class MappedFile
+{
+	const char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+
+public:
+	explicit MappedFile(const std::string& path); // Throws std::runtime_error if the file can't be mapped
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const { return bytes; }
+	size_t size() const { return length; }
+};
+
+struct NetlistOptions
+{
+	bool firstLineIsTitle = true; // SPICE convention, the first line is never a card
+	bool useACValues = false;     // Take the AC magnitude of V and I sources instead of the DC value
+};
+
+struct NetlistStats
+{
+	size_t bytes = 0, lines = 0, cards = 0;
+	size_t elements = 0, nodes = 0;     // After subcircuit expansion
+	size_t subcircuits = 0, instances = 0;
+	size_t skipped = 0;                 // Dot commands without an effect on the topology (.tran, .model, ...)
+	double parseSeconds = 0, buildSeconds = 0;
+
+	double megabytesPerSecond() const { return parseSeconds > 0 ? bytes / parseSeconds * 1e-6 : 0; }
+};
+
+// Streaming SPICE subset loader
+// Cards: R C L V I E F G H X, .subckt/.ends, .end. Other dot commands are counted and skipped.
+// Parsing is one pass over the mapped bytes into compact cards with interned node and element names,
+// build() then instantiates the components (and expands subcircuits) into a Circuit.
+// F and H refer to the current of a voltage source, a zero volt probe is put in series with that source.
+// Names inside a subcircuit instance get the instance path appended, R1 in X2 becomes R1:X2
+
+class NetlistParser
+{
+	struct Card
+	{
+		double value;
+		int first;      // Nodes in the scope's node list
+		int line;
+		int ref;        // F/H: name of the controlling source, then its card after build(). X: subcircuit
+		uint16_t count;
+		char type;      // Lower case element letter, the element name has the index of the card
+	};
+
+	struct Scope
+	{
+		NameTable nodes;
+		NameTable elements, controls; // Only stored while parsing, element names are indexed in build()
+		std::vector<Card> cards;
+		std::vector<int> node_ids; // -1 is ground
+		size_t ports = 0;
+		bool defined = false, resolved = false;
+	};
+
+	NetlistOptions options;
+	std::vector<Scope> scopes; // 0 is the top level
+	NameTable subckt_names;    // Subcircuit name -> scope - 1
+	NetlistStats stats;
+
+	std::vector<std::shared_ptr<Node>> top_nodes;
+	std::vector<std::shared_ptr<CircuitElement>> top_elements;
+
+	void parseCard(const std::string_view* tokens, const uint64_t* hashes, size_t count, int line, int& scope);
+	int scopeFor(std::string_view subckt);
+	void resolve(Scope& sc);
+	void expand(Circuit& circuit, int scope, const std::vector<std::shared_ptr<Node>>& ports,
+		const std::string& path, int depth, std::vector<std::shared_ptr<CircuitElement>>* elements);
+
+public:
+	explicit NetlistParser(NetlistOptions opts = {});
+
+	void parseFile(const std::string& path);
+	void parseBuffer(const char* data, size_t size);
+
+	// Adds every node and element of the top level (subcircuits expanded) to the circuit
+	void build(Circuit& circuit);
+
+	// Top level lookups after build(), nullptr if unknown
+	std::shared_ptr<Node> node(std::string_view name) const;
+	std::shared_ptr<CircuitElement> element(std::string_view name) const;
+
+	const NetlistStats& getStats() const { return stats; }
+};
+
+// Parse and build in one go
+Circuit loadNetlist(const std::string& path, NetlistStats* stats = nullptr);
@@ -0,0 +1,282 @@
+#include "Newton.h"
+#include "BlockLU.h"
+#include "SparseMatrix.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+struct DeviceState
+{
+    const NonlinearDevice* device;
+    std::vector<int> unknowns;  // Per terminal, -1 is ground
+    std::vector<int> positions; // Per terminal pair in the pattern, -1 on a ground row or column
+    std::vector<double> v, current, conductance; // Last evaluation
+    bool evaluated = false;
+};
+
+class NewtonEngine
+{
+    const NumericSystem& sys;
+    const NewtonOptions& options;
+    SolveStats* profile;
+    size_t n, nodes;
+
+    std::vector<double> linear; // G of the linear elements on the pattern
+    std::vector<int> diagonal;  // Pattern positions of the node diagonal
+    std::vector<DeviceState> devices;
+    BlockLU<double> lu;
+    SparseMatrix<double> A;
+    bool factored = false;  // lu holds the pivots of an earlier factorization
+    bool current = false;   // ... and the factors of the values in A
+    double factored_gmin = -1;
+    std::vector<double> rhs, trial, v;
+
+    bool factor();
+
+public:
+    NewtonStats stats;
+
+    NewtonEngine(const NumericSystem& system, size_t node_count, const std::vector<std::shared_ptr<NonlinearDevice>>& list,
+        const NewtonOptions& opts, const std::function<std::string(int, bool)>& name, SolveStats* prof);
+
+    // One Newton run from x at the given node shunt and source scale, x is the last iterate on return
+    bool run(std::vector<double>& x, double gmin, double scale);
+
+    // Forget the evaluation points, the next run starts without limiting against them
+    void restart() {
+        for (auto& d : devices) d.evaluated = false;
+    }
+};
+
+NewtonEngine::NewtonEngine(const NumericSystem& system, size_t node_count,
+    const std::vector<std::shared_ptr<NonlinearDevice>>& list, const NewtonOptions& opts,
+    const std::function<std::string(int, bool)>& name, SolveStats* prof)
+    : sys(system), options(opts), profile(prof), n(system.size()), nodes(node_count) {
+    size_t elements = sys.element_g.empty() ? 0 : sys.element_g.size() - 1;
+    std::vector<char> device_entry(sys.G.entries(), 0);
+    for (const auto& device : list) {
+        int e = device->getElementIndex();
+        if (e < 0 || static_cast<size_t>(e) >= elements) {
+            throw std::invalid_argument(device->getSym() + " has no stamps in the system.");
+        }
+        std::fill(device_entry.begin() + sys.element_g[e], device_entry.begin() + sys.element_g[e + 1], 1);
+    }
+
+    // Pattern: linear G, every device terminal pair and the node diagonal
+    TripletMatrix<double> pattern(n, n);
+    for (size_t k = 0; k < sys.G.entries(); k++) pattern.add(sys.G.row(k), sys.G.col(k), 0.0);
+    for (size_t i = 0; i < nodes; i++) pattern.add(static_cast<int>(i), static_cast<int>(i), 0.0);
+    for (const auto& device : list) {
+        DeviceState d;
+        d.device = device.get();
+        for (const auto& terminal : device->getTerminals()) d.unknowns.push_back(terminal->getIndex());
+        for (int row : d.unknowns) {
+            for (int col : d.unknowns) pattern.add(row, col, 0.0);
+        }
+        size_t k = d.unknowns.size();
+        d.v.assign(k, 0.0);
+        d.current.assign(k, 0.0);
+        d.conductance.assign(k * k, 0.0);
+        devices.push_back(std::move(d));
+    }
+    A = SparseMatrix<double>::fromTriplets(pattern);
+    const auto& col_ptr = A.colPtr();
+    const auto& row_idx = A.rowIdx();
+
+    // Columns are short, a linear scan finds an entry
+    auto position = [&](int i, int j) {
+        if (i < 0 || j < 0) return -1;
+        for (int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+            if (row_idx[p] == i) return p;
+        }
+        throw std::logic_error("Entry missing from the Newton pattern.");
+    };
+    linear.assign(row_idx.size(), 0.0);
+    for (size_t k = 0; k < sys.G.entries(); k++) {
+        if (!device_entry[k]) linear[position(sys.G.row(k), sys.G.col(k))] += sys.G.value(k);
+    }
+    for (size_t i = 0; i < nodes; i++) diagonal.push_back(position(static_cast<int>(i), static_cast<int>(i)));
+    for (auto& d : devices) {
+        for (int row : d.unknowns) {
+            for (int col : d.unknowns) d.positions.push_back(position(row, col));
+        }
+    }
+
+    {
+        PhaseTimer timer(profile, SolvePhase::Analysis);
+        lu.analyze(A);
+    }
+    if (lu.getAnalysis().isStructurallySingular()) throw std::runtime_error(lu.getAnalysis().structuralReport(name));
+    if (profile) {
+        profile->nonZeros = A.nonZeros();
+        profile->matrixAllocations++;
+        profile->matrixBytes += A.nonZeros() * (sizeof(double) + sizeof(int)) + (n + 1) * sizeof(int);
+    }
+    rhs.resize(n);
+    trial.resize(n);
+}
+
+// The pivots of the first factorization are kept as long as they hold up. A numerically singular
+// matrix (devices in cutoff, floating gates) fails the run, stepping adds the shunts it needs
+bool NewtonEngine::factor() {
+    PhaseTimer timer(profile, SolvePhase::Factorization);
+    try {
+        if (factored && lu.refactor(A)) {
+            stats.refactorizations++;
+        }
+        else {
+            lu.factorize(A);
+            stats.factorizations++;
+        }
+    }
+    catch (const std::runtime_error&) {
+        factored = current = false;
+        return false;
+    }
+    factored = current = true;
+    if (profile) {
+        profile->factorizations++;
+        profile->factorNonZeros = lu.factorNonZeros();
+    }
+    return true;
+}
+
+bool NewtonEngine::run(std::vector<double>& x, double gmin, double scale) {
+    for (size_t iteration = 0; iteration < options.maxIterations; iteration++) {
+        bool changed = false, limited = false;
+        {
+            PhaseTimer timer(profile, SolvePhase::Stamping);
+            for (auto& d : devices) {
+                size_t k = d.unknowns.size();
+                v.resize(k);
+                for (size_t t = 0; t < k; t++) v[t] = d.unknowns[t] >= 0 ? x[d.unknowns[t]] : 0.0;
+
+                if (d.evaluated) {
+                    bool close = options.bypass;
+                    for (size_t t = 0; close && t < k; t++) close = std::abs(v[t] - d.v[t]) <= options.bypassTolerance;
+                    if (close) {
+                        stats.bypassed++;
+                        continue;
+                    }
+                    limited |= d.device->limit(d.v.data(), v.data());
+                }
+                d.v = v;
+                d.device->evaluate(d.v.data(), d.current.data(), d.conductance.data());
+                d.evaluated = true;
+                changed = true;
+                stats.evaluations++;
+            }
+        }
+
+        // All devices bypassed at the same shunt: the matrix is the one already factored
+        if (changed || gmin != factored_gmin || !current) {
+            {
+                PhaseTimer timer(profile, SolvePhase::Assembly);
+                auto& values = A.getValues();
+                std::copy(linear.begin(), linear.end(), values.begin());
+                for (int p : diagonal) values[p] += gmin;
+                for (const auto& d : devices) {
+                    for (size_t e = 0; e < d.positions.size(); e++) {
+                        if (d.positions[e] >= 0) values[d.positions[e]] += d.conductance[e];
+                    }
+                }
+            }
+            factored_gmin = gmin;
+            if (!factor()) return false;
+        }
+
+        {
+            PhaseTimer timer(profile, SolvePhase::Solve);
+            for (size_t i = 0; i < n; i++) trial[i] = scale * sys.rhs[i];
+            for (const auto& d : devices) {
+                size_t k = d.unknowns.size();
+                for (size_t a = 0; a < k; a++) {
+                    if (d.unknowns[a] < 0) continue;
+                    double source = -d.current[a]; // G v0 - i(v0)
+                    for (size_t b = 0; b < k; b++) source += d.conductance[a * k + b] * d.v[b];
+                    trial[d.unknowns[a]] += source;
+                }
+            }
+            lu.solve(trial);
+        }
+        stats.iterations++;
+
+        bool converged = !limited;
+        for (size_t i = 0; i < n; i++) {
+            if (!std::isfinite(trial[i])) return false;
+            double tolerance = options.reltol * std::max(std::abs(trial[i]), std::abs(x[i])) +
+                (i < nodes ? options.vntol : options.abstol);
+            if (std::abs(trial[i] - x[i]) > tolerance) converged = false;
+        }
+        x.swap(trial);
+        if (converged) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+NewtonStats solveOperatingPoint(const NumericSystem& sys, size_t nodes,
+    const std::vector<std::shared_ptr<NonlinearDevice>>& devices, std::vector<double>& x,
+    const NewtonOptions& options, const std::function<std::string(int, bool)>& name, SolveStats* profile) {
+    if (sys.element_g.empty()) throw std::invalid_argument("Newton needs the element offsets of the stamps.");
+    if (x.size() != sys.size()) x.assign(sys.size(), 0.0);
+
+    NewtonEngine engine(sys, nodes, devices, options, name, profile);
+    auto done = [&](NewtonStrategy strategy) {
+        engine.stats.converged = true;
+        engine.stats.strategy = strategy;
+        return engine.stats;
+    };
+
+    std::vector<double> start = x;
+    if (engine.run(x, options.gmin, 1.0)) return done(NewtonStrategy::Newton);
+
+    // Large shunts make the system nearly linear, each decade starts from the one before
+    if (options.gminStepping) {
+        x = start;
+        engine.restart();
+        bool stepped = true;
+        for (double gmin = std::max(options.gminStart, options.gmin);; gmin = std::max(gmin / 10, options.gmin)) {
+            engine.stats.gminSteps++;
+            if (!engine.run(x, gmin, 1.0)) {
+                stepped = false;
+                break;
+            }
+            if (gmin <= options.gmin) break;
+        }
+        if (stepped) return done(NewtonStrategy::GminStepping);
+    }
+
+    // With every source at zero the devices are at rest, the sources then ramp up to full value
+    if (options.sourceStepping) {
+        x.assign(sys.size(), 0.0);
+        engine.restart();
+        double scale = 0, initial = 1.0 / std::max<size_t>(1, options.sourceSteps), step = initial;
+        std::vector<double> accepted = x;
+        while (scale < 1 && step >= options.minSourceStep) {
+            double next = std::min(1.0, scale + step);
+            engine.stats.sourceSteps++;
+            if (engine.run(x, options.gmin, next)) {
+                scale = next;
+                accepted = x;
+                step = std::min(initial, step * 2);
+            }
+            else {
+                x = accepted;
+                engine.restart();
+                step /= 2;
+            }
+        }
+        if (scale >= 1) return done(NewtonStrategy::SourceStepping);
+    }
+
+    x = start;
+    std::string tried = "Newton";
+    if (options.gminStepping) tried += ", gmin stepping";
+    if (options.sourceStepping) tried += ", source stepping";
+    throw std::runtime_error("No DC operating point, none of " + tried + " converged within " +
+        std::to_string(options.maxIterations) + " iterations.");
+}
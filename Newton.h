@@ -0,0 +1,65 @@
+#pragma once
+#include "NumericSystem.h"
+#include "Semiconductors.h"
+#include "SolveStats.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Newton-Raphson DC operating point of the linear stamps plus nonlinear devices
+// Every iteration stamps the devices as their companion models around the last solution and solves
+//   (G + J(x_k)) x_k+1 = rhs + J(x_k) x_k - i(x_k)
+// The matrix pattern (linear G, every device terminal pair, the node diagonal) is fixed, so the ordering
+// is computed once and iterations only refactor with the pivots of the first factorization. Devices whose
+// terminal voltages moved less than bypassTolerance keep their last evaluation (bypass), and an iteration
+// in which no device was reevaluated solves with the factors it already has.
+// If plain Newton fails, gmin stepping (a shunt from every node to ground, lowered decade by decade) and
+// then source stepping (independent sources ramped up from zero) are tried, each continuing from the
+// last converged point.
+
+struct NewtonOptions
+{
+	size_t maxIterations = 100; // Per Newton run, every gmin or source step is one run
+	double reltol = 1e-3;
+	double vntol = 1e-6;         // Absolute tolerance of node voltages
+	double abstol = 1e-12;       // Absolute tolerance of branch currents
+	double gmin = 1e-12;         // Always present shunt from every node to ground
+	bool bypass = true;
+	double bypassTolerance = 1e-7; // Volts, on every terminal of a device
+
+	bool gminStepping = true;
+	double gminStart = 1e-2;
+	bool sourceStepping = true;
+	size_t sourceSteps = 10;       // Initial ramp, failed steps are halved
+	double minSourceStep = 1e-4;
+};
+
+enum class NewtonStrategy
+{
+	Newton,
+	GminStepping,
+	SourceStepping
+};
+
+struct NewtonStats
+{
+	bool converged = false;
+	NewtonStrategy strategy = NewtonStrategy::Newton; // The one that converged
+	size_t iterations = 0;      // Linear solves, over every run
+	size_t evaluations = 0;     // Device model evaluations
+	size_t bypassed = 0;        // Evaluations skipped by the bypass
+	size_t factorizations = 0;  // With pivot search
+	size_t refactorizations = 0; // With the pivots of an earlier factorization
+	size_t gminSteps = 0, sourceSteps = 0;
+};
+
+// x is the initial guess on entry (resized to zero if its size differs) and the solution on return
+// sys holds every stamp, the device ranges (element_g) are left out of the linear part. `nodes` is the number
+// of node voltage unknowns. Throws std::runtime_error with the structural report if the pattern is
+// singular, and if no strategy converges
+NewtonStats solveOperatingPoint(const NumericSystem& sys, size_t nodes,
+	const std::vector<std::shared_ptr<NonlinearDevice>>& devices, std::vector<double>& x,
+	const NewtonOptions& options = {}, const std::function<std::string(int, bool)>& name = {},
+	SolveStats* profile = nullptr);
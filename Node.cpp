@@ -1,27 +1,36 @@
 #include "Node.h"
+#include "Component.h"
+#include "Topology.h"
 #include <stdexcept>
 #include <memory>
 #include <vector>
 
-std::shared_ptr<Node> Node::groundNode = nullptr; // Initialize static member
-int Node::globalIndex = 0; // Initialize static global index
-
-void Node::addConnection(const std::shared_ptr<Component>& comp) {
-    connections.push_back(comp);
-}
-
-void Node::removeConnection(const std::shared_ptr<Component>& comp) {
-    connections.erase(std::remove_if(connections.begin(), connections.end(),
-        [&comp](const std::weak_ptr<Component>& c) { return c.lock() == comp; }), connections.end());
+std::shared_ptr<Node> Node::getGround() {
+    // Initialized once even with several circuits built in parallel
+    static const std::shared_ptr<Node> groundNode = [] {
+        auto node = std::make_shared<Node>("0");
+        node->index = -1; // Give ground node idx -1
+        node->potential = ex(0); // Set potential to 0
+        return node;
+    }();
+    return groundNode;
 }
 
 std::vector<std::shared_ptr<Component>> Node::getConnections() const {
     std::vector<std::shared_ptr<Component>> connectedComponents;
-    for (const auto& weakComp : connections) {
-        if (auto comp = weakComp.lock()) {
-            connectedComponents.push_back(comp);
+    auto owner = topology.lock();
+    if (!owner) return connectedComponents; // Ground is in no single circuit, ask the topology for it
+
+    const auto& elements = owner->elementHandles();
+    for (int element : owner->elementsAt(index)) {
+        if (auto comp = std::dynamic_pointer_cast<Component>(elements[element])) {
+            if (connectedComponents.empty() || connectedComponents.back() != comp) connectedComponents.push_back(comp);
         }
     }
     return connectedComponents;
 }
 
+void Node::setSym(const std::string& sym) {
+    symbol = sym;
+    if (auto owner = topology.lock()) owner->rename(*this);
+}
@@ -1,50 +1,40 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <string>
 #include <stdexcept>
 #include <ginac/ginac.h>
 
 using namespace GiNaC;
 
 class Component; // Forward declaration
+class Topology;
+
+// Handle of a node in the topology of the circuit it was added to
+// The id is given by the circuit (dense, in the order of adding), ground is -1 everywhere
 
 class Node
 {
-    std::vector<std::weak_ptr<Component>> connections;
-    ex potential;
-    std::string symbol;
-    int index;
-    static int globalIndex; // Keeping global count of nodes for indexing
+    friend class Topology;
 
-    static std::shared_ptr<Node> groundNode; // Singleton
+    std::weak_ptr<Topology> topology; // Owning circuit, empty until the node is added
+    ex potential;
+    std::string symbol; // "V" + id unless named before it is added
+    int index = -2;
 
 public:
-    static std::shared_ptr<Node> getGround() {
-        if (!groundNode) {
-            groundNode = std::shared_ptr<Node>(new Node()); // Initialize ground node
-            groundNode->index = -1; // Give ground node idx -1
-            groundNode->potential = ex(0); // Set potential to 0
-        }
-        return groundNode;
-    }
-
-    // Regular node constructor
-    Node() : index(globalIndex++) {
-        symbol = "V" + std::to_string(index);
-    }
-
-    void addConnection(const std::shared_ptr<Component>& comp);
-    void removeConnection(const std::shared_ptr<Component>& comp);
+    static std::shared_ptr<Node> getGround(); // Singleton, thread safe
+
+    Node() = default;
+    explicit Node(const std::string& sym) : symbol(sym) {}
+
+    // Elements connected to the node, read from the adjacency of the owning circuit
     std::vector<std::shared_ptr<Component>> getConnections() const;
 
     void setPotential(const ex& newPot) { potential = newPot; }
     ex getPotential() const { return potential; }
 
-    void setIndex(int idx) { 
-        if (index == -1) {
-            throw std::logic_error("Cannot modify the index of the ground node."); // Don't touch the ground
-        }
-        index = idx; 
-    }
     int getIndex() const { return index; }
+    std::string getSym() const { return symbol; }
+    void setSym(const std::string& sym);
 };
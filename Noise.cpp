@@ -0,0 +1,83 @@
+#include "Noise.h"
+#include "ACSweep.h"
+#include "BlockLU.h"
+#include "Parallel.h"
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+double NoiseResult::integratedOutput() const {
+    double sum = 0;
+    for (size_t k = 1; k < frequencies.size(); k++) {
+        sum += (frequencies[k] - frequencies[k - 1]) * (output[k] + output[k - 1]) / 2;
+    }
+    return std::sqrt(sum);
+}
+
+NoiseResult runNoise(const NumericSystem& sys, const std::vector<std::shared_ptr<CircuitElement>>& elements,
+    int output, const std::vector<double>& input, const std::vector<double>& frequencies, const NoiseOptions& options) {
+    const double two_pi = 2.0 * std::acos(-1.0);
+    auto start = std::chrono::steady_clock::now();
+
+    if (output < 0 || output >= static_cast<int>(sys.size())) throw std::out_of_range("Noise output outside of the system.");
+    if (!input.empty() && input.size() != sys.size()) throw std::invalid_argument("Noise input size does not match the system.");
+
+    // Generators of every element, source[k] belongs to column owner[k] of the result
+    NoiseResult result;
+    std::vector<NoiseSource> sources;
+    std::vector<int> owner;
+    for (const auto& element : elements) {
+        size_t first = sources.size();
+        element->noiseSources(sources, options.temperature);
+        if (sources.size() == first) continue;
+        owner.resize(sources.size(), static_cast<int>(result.elements.size()));
+        result.elements.push_back(element->getElementIndex());
+    }
+
+    size_t columns = result.elements.size();
+    result.frequencies = frequencies;
+    result.contributions.assign(frequencies.size() * columns, 0.0);
+    result.output.assign(frequencies.size(), 0.0);
+    if (!input.empty()) result.gain.assign(frequencies.size(), 0.0);
+    if (frequencies.empty()) return result;
+
+    FrequencyPattern pattern(sys);
+    auto analysis = std::make_shared<const LUAnalysis>(analyzePattern(pattern.size(), pattern.colPtr(), pattern.rowIdx()));
+    constexpr size_t chunk = 16;
+    SweepFactors factors(pattern, analysis, two_pi * frequencies[0], frequencies.size(), chunk, options.threads);
+    std::vector<std::vector<std::complex<double>>> adjoints(factors.lus.size());
+
+    parallelFor(frequencies.size(), chunk, options.threads, [&](size_t begin, size_t end, unsigned id) {
+        auto& lu = factors.lus[id];
+        auto& A = factors.matrices[id];
+        auto& lambda = adjoints[id];
+        for (size_t k = begin; k < end; k++) {
+            pattern.assemble(two_pi * frequencies[k], A);
+            if (!lu.refactor(A)) lu.factorize(A);
+
+            lambda.assign(sys.size(), 0.0);
+            lambda[output] = 1;
+            lu.solveTransposed(lambda);
+
+            double* row = result.contributions.data() + k * columns;
+            for (size_t g = 0; g < sources.size(); g++) {
+                const NoiseSource& source = sources[g];
+                std::complex<double> transfer = (source.to >= 0 ? lambda[source.to] : 0.0) - (source.from >= 0 ? lambda[source.from] : 0.0);
+                row[owner[g]] += std::norm(transfer) * source.density;
+            }
+            double total = 0;
+            for (size_t e = 0; e < columns; e++) total += row[e];
+            result.output[k] = total;
+
+            if (!input.empty()) {
+                std::complex<double> h = 0;
+                for (size_t i = 0; i < input.size(); i++) h += lambda[i] * input[i];
+                result.gain[k] = std::abs(h);
+            }
+        }
+    });
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
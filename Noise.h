@@ -0,0 +1,57 @@
+#pragma once
+#include "Component.h"
+#include "NumericSystem.h"
+#include <memory>
+#include <vector>
+
+// Small signal noise analysis, like SPICE .noise
+// Every noise generator is a current u injected into the rhs, -u at row `from` and +u at row `to` (a
+// current from `from` to `to` through the generator, or a voltage in series with a source when the row is
+// its branch equation). The output voltage moves by (λ[to] - λ[from]) u, with (G + jωC)^T λ = e_out, so one
+// transposed solve per frequency gives the transfer of every generator at once:
+//   S_out(f) = sum |λ[to] - λ[from]|^2 S_u(f)
+// Generators are uncorrelated.
+
+// White noise generator of one element, rows are MNA unknowns and -1 is ground
+// density is A^2 / Hz for currents between nodes and V^2 / Hz for branch equation rows
+
+struct NoiseSource
+{
+	int from = -1, to = -1;
+	double density = 0;
+};
+
+constexpr double boltzmann = 1.380649e-23;            // J / K
+constexpr double elementary_charge = 1.602176634e-19; // C
+
+struct NoiseOptions
+{
+	double temperature = 300; // K, the thermal voltage of the device models is at 300 K as well
+	unsigned threads = 0;     // Frequency points in parallel, 0 is one per hardware thread
+};
+
+// Frequency x element, row major
+
+struct NoiseResult
+{
+	std::vector<double> frequencies;   // Hz
+	std::vector<int> elements;         // Element ids with noise generators, in id order
+	std::vector<double> contributions; // Output noise of every element, V^2 / Hz
+	std::vector<double> output;        // Total output noise, V^2 / Hz
+	std::vector<double> gain;          // |V(out) / input|, empty without an input source
+	double seconds = 0;
+
+	double contribution(size_t point, size_t element) const { return contributions[point * elements.size() + element]; }
+
+	// Output noise referred to the input source, V^2 / Hz or A^2 / Hz
+	double inputNoise(size_t point) const { return output[point] / (gain[point] * gain[point]); }
+
+	// RMS output noise over the swept band, trapezoidal rule in f
+	double integratedOutput() const;
+};
+
+// Noise of the node voltage `output` over `frequencies`, with the generators of every element at their
+// last operating point. `input` is the rhs of a unit input source for the gain, empty for none. The
+// ordering and pivots come from the first point, as in runACSweep()
+NoiseResult runNoise(const NumericSystem& sys, const std::vector<std::shared_ptr<CircuitElement>>& elements,
+	int output, const std::vector<double>& input, const std::vector<double>& frequencies, const NoiseOptions& options = {});
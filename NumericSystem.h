@@ -0,0 +1,45 @@
+#pragma once
+#include "SparseMatrix.h"
+#include <utility>
+#include <vector>
+
+// Numeric MNA system (G + s * C) * x = rhs
+// Used instead of the symbolic GiNaC matrices when every component value is a plain number
+// Unknowns are the node voltages followed by the branch currents of sources, inductors and two-ports
+
+class NumericSystem
+{
+	size_t unknowns;
+	bool deferred = false; // Stamp buffer, rhs terms are kept in order instead of summed
+
+	NumericSystem(size_t size, bool buffered)
+		: unknowns(size), deferred(buffered), G(size, size), C(size, size), rhs(buffered ? 0 : size, 0.0) {}
+
+public:
+	TripletMatrix<double> G; // Frequency independent part
+	TripletMatrix<double> C; // Part multiplied by s (capacitors, inductor branches)
+	std::vector<double> rhs;
+
+	// Triplet offsets per element, filled by Circuit::stampNumeric. Element e stamped the G entries
+	// element_g[e] .. element_g[e + 1] - 1 and likewise for C
+	std::vector<size_t> element_g, element_c;
+
+	// Buffer mode only: (row, value) per addRHS call, replayed in order when buffers are merged so the
+	// sums come out as in a serial stamp
+	std::vector<std::pair<int, double>> rhs_terms;
+
+	// Sized once from the counting pass in Circuit, stamps use the branch indices assigned there
+	explicit NumericSystem(size_t size)
+		: NumericSystem(size, false) {}
+
+	// Stamp buffer of one worker in parallel assembly, without an rhs vector
+	static NumericSystem buffer(size_t size) { return NumericSystem(size, true); }
+
+	void addRHS(int row, double value) {
+		if (row < 0) return; // Skip ground
+		if (deferred) rhs_terms.emplace_back(row, value);
+		else rhs[row] += value;
+	}
+
+	size_t size() const { return unknowns; }
+};
@@ -0,0 +1,226 @@
+#include "Ordering.h"
+#include <algorithm>
+#include <set>
+#include <utility>
+
+// Depth first augmenting paths with a cheap assignment lookahead, iterative so long paths can't overflow the stack
+
+size_t maximumTransversal(size_t n, const std::vector<int>& col_ptr, const std::vector<int>& row_idx, std::vector<int>& match) {
+    std::vector<int> row_match(n, -1), cheap(col_ptr.begin(), col_ptr.end() - 1), next(n), visited(n, -1);
+    std::vector<int> stack, via; // Columns on the path, row used to reach each of them
+    match.assign(n, -1);
+    size_t rank = 0;
+
+    for (size_t start = 0; start < n; start++) {
+        int j0 = static_cast<int>(start);
+        stack.assign(1, j0);
+        via.assign(1, -1);
+        next[j0] = col_ptr[j0];
+        int free_row = -1;
+
+        while (!stack.empty() && free_row == -1) {
+            int j = stack.back();
+
+            // Lookahead for an unmatched row
+            for (; cheap[j] < col_ptr[j + 1]; cheap[j]++) {
+                if (row_match[row_idx[cheap[j]]] == -1) {
+                    free_row = row_idx[cheap[j]++];
+                    break;
+                }
+            }
+            if (free_row != -1) break;
+
+            // Go deeper through a matched row not seen in this search
+            bool pushed = false;
+            for (; next[j] < col_ptr[j + 1]; next[j]++) {
+                int i = row_idx[next[j]];
+                if (visited[i] == j0) continue;
+                visited[i] = j0;
+                int jj = row_match[i];
+                next[j]++;
+                next[jj] = col_ptr[jj];
+                stack.push_back(jj);
+                via.push_back(i);
+                pushed = true;
+                break;
+            }
+            if (!pushed) {
+                stack.pop_back();
+                via.pop_back();
+            }
+        }
+
+        if (free_row == -1) continue;
+
+        // Flip the path: the last column takes the free row, every other column the row that led onwards
+        int row = free_row;
+        for (size_t d = stack.size(); d-- > 0;) {
+            int j = stack[d];
+            match[j] = row;
+            row_match[row] = j;
+            row = via[d];
+        }
+        rank++;
+    }
+
+    return rank;
+}
+
+// Iterative Tarjan over the column graph (edge j -> i for every entry A(i, j))
+// Components come out sinks first, which for this edge direction is already block upper triangular order
+
+std::vector<int> stronglyConnectedBlocks(size_t n, const std::vector<int>& col_ptr, const std::vector<int>& row_idx,
+    std::vector<int>& block_ptr) {
+    std::vector<int> index(n, -1), low(n, 0), next(n), stack, call, order;
+    std::vector<char> on_stack(n, 0);
+    order.reserve(n);
+    block_ptr.assign(1, 0);
+    int counter = 0;
+
+    for (size_t root = 0; root < n; root++) {
+        if (index[root] != -1) continue;
+        call.assign(1, static_cast<int>(root));
+        index[root] = low[root] = counter++;
+        next[root] = col_ptr[root];
+        stack.push_back(static_cast<int>(root));
+        on_stack[root] = 1;
+
+        while (!call.empty()) {
+            int v = call.back();
+            if (next[v] < col_ptr[v + 1]) {
+                int w = row_idx[next[v]++];
+                if (index[w] == -1) {
+                    index[w] = low[w] = counter++;
+                    next[w] = col_ptr[w];
+                    stack.push_back(w);
+                    on_stack[w] = 1;
+                    call.push_back(w);
+                }
+                else if (on_stack[w]) {
+                    low[v] = std::min(low[v], index[w]);
+                }
+                continue;
+            }
+
+            call.pop_back();
+            if (!call.empty()) low[call.back()] = std::min(low[call.back()], low[v]);
+
+            if (low[v] == index[v]) {
+                int w;
+                do {
+                    w = stack.back();
+                    stack.pop_back();
+                    on_stack[w] = 0;
+                    order.push_back(w);
+                } while (w != v);
+                block_ptr.push_back(static_cast<int>(order.size()));
+            }
+        }
+    }
+
+    return order;
+}
+
+// Quotient graph minimum degree
+// Eliminated pivots become elements, a variable's neighbourhood is its remaining variable list A_i
+// plus the variable lists L_e of its elements. Elements adjacent to the pivot are absorbed into it,
+// and the degree is the AMD bound |A_i| + |L_p \ i| + sum |L_e \ L_p| instead of the exact count
+
+std::vector<int> approximateMinimumDegree(size_t n, const std::vector<int>& col_ptr, const std::vector<int>& row_idx) {
+    std::vector<std::vector<int>> A(n), E(n), L(n);
+    for (size_t j = 0; j < n; j++) {
+        for (int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+            int i = row_idx[p];
+            if (i == static_cast<int>(j)) continue;
+            A[i].push_back(static_cast<int>(j));
+            A[j].push_back(i);
+        }
+    }
+    for (auto& list : A) {
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    }
+
+    enum : char { Variable, Element, Absorbed };
+    std::vector<char> status(n, Variable);
+    std::vector<int> degree(n), mark(n, -1), wflag(n, -1), w(n, 0), order, Lp;
+    std::set<std::pair<int, int>> queue;
+    for (size_t v = 0; v < n; v++) {
+        degree[v] = static_cast<int>(A[v].size());
+        queue.emplace(degree[v], static_cast<int>(v));
+    }
+    order.reserve(n);
+
+    for (int k = 0; !queue.empty(); k++) {
+        int p = queue.begin()->second;
+        queue.erase(queue.begin());
+        order.push_back(p);
+
+        // L_p = A_p + every L_e of the pivot's elements, minus p
+        Lp.clear();
+        mark[p] = k;
+        for (int v : A[p]) {
+            if (status[v] == Variable && mark[v] != k) { mark[v] = k; Lp.push_back(v); }
+        }
+        for (int e : E[p]) {
+            if (status[e] != Element) continue;
+            for (int v : L[e]) {
+                if (status[v] == Variable && mark[v] != k) { mark[v] = k; Lp.push_back(v); }
+            }
+            status[e] = Absorbed;
+            std::vector<int>().swap(L[e]);
+        }
+        status[p] = Element;
+        std::vector<int>().swap(A[p]);
+        std::vector<int>().swap(E[p]);
+
+        // Prune the neighbours: variables in L_p are now reached through p
+        for (int i : Lp) {
+            auto& Ai = A[i];
+            Ai.erase(std::remove_if(Ai.begin(), Ai.end(),
+                [&](int v) { return mark[v] == k || status[v] != Variable; }), Ai.end());
+            auto& Ei = E[i];
+            Ei.erase(std::remove_if(Ei.begin(), Ei.end(),
+                [&](int e) { return status[e] != Element; }), Ei.end());
+            Ei.push_back(p);
+        }
+
+        // |L_e \ L_p| for every other element touching L_p
+        for (int i : Lp) {
+            for (int e : E[i]) {
+                if (e == p) continue;
+                if (wflag[e] != k) { wflag[e] = k; w[e] = static_cast<int>(L[e].size()); }
+                w[e]--;
+            }
+        }
+
+        int remaining = static_cast<int>(n) - k - 1;
+        int lp_size = static_cast<int>(Lp.size());
+        for (int i : Lp) {
+            long bound = static_cast<long>(A[i].size()) + lp_size - 1;
+            auto& Ei = E[i];
+            for (size_t q = 0; q < Ei.size();) {
+                int e = Ei[q];
+                if (e != p && w[e] <= 0) {
+                    // L_e is inside L_p, absorb it
+                    status[e] = Absorbed;
+                    std::vector<int>().swap(L[e]);
+                    Ei[q] = Ei.back();
+                    Ei.pop_back();
+                    continue;
+                }
+                if (e != p) bound += w[e];
+                q++;
+            }
+            int d = static_cast<int>(std::min<long>({ bound, remaining - 1L, static_cast<long>(degree[i]) + lp_size - 1 }));
+            d = std::max(d, 0);
+            queue.erase({ degree[i], i });
+            degree[i] = d;
+            queue.emplace(d, i);
+        }
+
+        L[p] = Lp;
+    }
+
+    return order;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Fill-reducing orderings for the sparse LU
+// Work on the pattern of A + A^T, the diagonal is ignored
+
+// Maximum transversal (MC21 style augmenting paths)
+// match[j] is the row matched to column j, -1 if none. Returns the structural rank
+size_t maximumTransversal(size_t n, const std::vector<int>& col_ptr, const std::vector<int>& row_idx, std::vector<int>& match);
+
+// Strongly connected components of a pattern with a zero-free diagonal (Tarjan)
+// Returns the nodes in block order, block_ptr[b]..block_ptr[b + 1] is block b.
+// Permuting rows and columns symmetrically by that order gives block upper triangular form
+std::vector<int> stronglyConnectedBlocks(size_t n, const std::vector<int>& col_ptr, const std::vector<int>& row_idx,
+	std::vector<int>& block_ptr);
+
+// Approximate minimum degree (quotient graph with element absorption and the AMD degree bound)
+std::vector<int> approximateMinimumDegree(size_t n, const std::vector<int>& col_ptr, const std::vector<int>& row_idx);
@@ -0,0 +1,62 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Minimal thread pool free parallel loop
+// Workers grab chunks of [0, count) from a shared counter, body(begin, end, worker) runs per chunk
+// The first exception thrown by a worker is rethrown on the calling thread
+
+inline unsigned hardwareThreads() {
+    unsigned threads = std::thread::hardware_concurrency();
+    return threads ? threads : 1;
+}
+
+// Workers parallelFor(count, chunk, threads) runs (at least 1), for sizing per worker state
+inline unsigned parallelWorkers(size_t count, size_t chunk, unsigned threads) {
+    if (threads == 0) threads = hardwareThreads();
+    if (chunk == 0) chunk = 1;
+    size_t chunks = (count + chunk - 1) / chunk;
+    return static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, chunks)));
+}
+
+template <typename Body>
+void parallelFor(size_t count, size_t chunk, unsigned threads, Body body) {
+    if (chunk == 0) chunk = 1;
+    size_t chunks = (count + chunk - 1) / chunk;
+    threads = parallelWorkers(count, chunk, threads);
+
+    if (threads <= 1) {
+        for (size_t begin = 0; begin < count; begin += chunk) body(begin, std::min(count, begin + chunk), 0u);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_lock;
+
+    auto worker = [&](unsigned id) {
+        try {
+            for (size_t c = next++; c < chunks; c = next++) {
+                size_t begin = c * chunk;
+                body(begin, std::min(count, begin + chunk), id);
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> guard(error_lock);
+            if (!error) error = std::current_exception();
+            next = chunks; // Stop handing out work
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned id = 1; id < threads; id++) pool.emplace_back(worker, id);
+    worker(0);
+    for (auto& t : pool) t.join();
+
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,358 @@
+#include "Partition.h"
+#include "Component.h"
+#include "Topology.h"
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <utility>
+
+namespace {
+
+struct Graph
+{
+    std::vector<int> ptr{ 0 }, adj, edge; // CSR, edge weights next to the neighbours
+    std::vector<int> weight;              // Vertex weights
+
+    size_t size() const { return weight.size(); }
+    long total() const { return std::accumulate(weight.begin(), weight.end(), 0L); }
+};
+
+constexpr size_t coarsest = 100; // Coarsening stops below this many vertices
+
+// Heavy edge matching in random order, map[v] is the coarse vertex of v. Pairs heavier than maxWeight
+// stay apart so the coarse graph can still be balanced
+Graph coarsen(const Graph& g, std::mt19937& random, std::vector<int>& map, int maxWeight) {
+    size_t n = g.size();
+    std::vector<int> order(n), members;
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random);
+    map.assign(n, -1);
+    members.reserve(2 * n);
+
+    int next = 0;
+    for (int v : order) {
+        if (map[v] != -1) continue;
+        int best = -1, heaviest = 0;
+        for (int p = g.ptr[v]; p < g.ptr[v + 1]; p++) {
+            int u = g.adj[p];
+            if (map[u] != -1 || g.weight[v] + g.weight[u] > maxWeight) continue;
+            if (g.edge[p] > heaviest) {
+                best = u;
+                heaviest = g.edge[p];
+            }
+        }
+        map[v] = next;
+        members.push_back(v);
+        if (best != -1) map[best] = next;
+        members.push_back(best);
+        next++;
+    }
+
+    // Parallel edges between coarse vertices add up, slot[u] is the position of u in the current row
+    Graph c;
+    c.weight.assign(next, 0);
+    std::vector<int> slot(next, -1);
+    for (int k = 0; k < next; k++) {
+        int start = static_cast<int>(c.adj.size());
+        for (int h = 0; h < 2; h++) {
+            int v = members[2 * k + h];
+            if (v < 0) continue;
+            c.weight[k] += g.weight[v];
+            for (int p = g.ptr[v]; p < g.ptr[v + 1]; p++) {
+                int u = map[g.adj[p]];
+                if (u == k) continue;
+                if (slot[u] < start) {
+                    slot[u] = static_cast<int>(c.adj.size());
+                    c.adj.push_back(u);
+                    c.edge.push_back(g.edge[p]);
+                }
+                else {
+                    c.edge[slot[u]] += g.edge[p];
+                }
+            }
+        }
+        c.ptr.push_back(static_cast<int>(c.adj.size()));
+    }
+    return c;
+}
+
+long cutWeight(const Graph& g, const std::vector<char>& side) {
+    long cut = 0;
+    for (size_t v = 0; v < g.size(); v++) {
+        for (int p = g.ptr[v]; p < g.ptr[v + 1]; p++) {
+            if (side[g.adj[p]] != side[v]) cut += g.edge[p];
+        }
+    }
+    return cut / 2;
+}
+
+// Fiduccia-Mattheyses passes, side 0 should weigh target +- slack
+// Every pass moves the vertex of largest gain that keeps the balance, locks it, and in the end rolls back
+// to the best cut seen. A pass gives up after a run of moves without improvement
+long refine(const Graph& g, std::vector<char>& side, long target, long slack) {
+    size_t n = g.size();
+    long weight0 = 0;
+    for (size_t v = 0; v < n; v++) {
+        if (side[v] == 0) weight0 += g.weight[v];
+    }
+    long cut = cutWeight(g, side);
+    auto excess = [&](long w) { return std::max(0L, std::abs(w - target) - slack); };
+
+    std::vector<long> gain(n);
+    std::vector<char> locked(n);
+    std::vector<int> moves;
+    for (int pass = 0; pass < 8; pass++) {
+        std::priority_queue<std::pair<long, int>> heap;
+        for (size_t v = 0; v < n; v++) {
+            long external = 0, internal = 0;
+            for (int p = g.ptr[v]; p < g.ptr[v + 1]; p++) {
+                (side[g.adj[p]] != side[v] ? external : internal) += g.edge[p];
+            }
+            gain[v] = external - internal;
+            if (external > 0 || excess(weight0) > 0) heap.emplace(gain[v], static_cast<int>(v));
+        }
+        std::fill(locked.begin(), locked.end(), 0);
+        moves.clear();
+
+        long bestCut = cut, bestExcess = excess(weight0);
+        size_t best = 0, idle = 0;
+        while (!heap.empty() && idle < 100) {
+            auto [value, v] = heap.top();
+            heap.pop();
+            if (locked[v] || value != gain[v]) continue; // Stale entry
+            long moved = weight0 + (side[v] == 0 ? -g.weight[v] : g.weight[v]);
+            if (excess(moved) > 0 && excess(moved) >= excess(weight0)) continue;
+
+            side[v] ^= 1;
+            locked[v] = 1;
+            weight0 = moved;
+            cut -= gain[v];
+            moves.push_back(v);
+            for (int p = g.ptr[v]; p < g.ptr[v + 1]; p++) {
+                int u = g.adj[p];
+                if (locked[u]) continue;
+                gain[u] += side[u] == side[v] ? -2L * g.edge[p] : 2L * g.edge[p];
+                heap.emplace(gain[u], u);
+            }
+
+            long e = excess(weight0);
+            if (e < bestExcess || (e == bestExcess && cut < bestCut)) {
+                bestCut = cut;
+                bestExcess = e;
+                best = moves.size();
+                idle = 0;
+            }
+            else {
+                idle++;
+            }
+        }
+
+        for (size_t k = moves.size(); k-- > best;) {
+            int v = moves[k];
+            side[v] ^= 1;
+            weight0 += side[v] == 0 ? g.weight[v] : -g.weight[v];
+        }
+        cut = bestCut;
+        if (best == 0) break;
+    }
+    return cut;
+}
+
+// Greedy graph growing from a seed: side 0 takes the frontier vertex of largest gain until it weighs
+// target. Disconnected graphs continue from the next vertex of the random order
+std::vector<char> grow(const Graph& g, long target, const std::vector<int>& order, size_t seed) {
+    size_t n = g.size();
+    std::vector<char> side(n, 1);
+    std::vector<long> gain(n);
+    for (size_t v = 0; v < n; v++) {
+        gain[v] = 0;
+        for (int p = g.ptr[v]; p < g.ptr[v + 1]; p++) gain[v] -= g.edge[p];
+    }
+
+    std::priority_queue<std::pair<long, int>> heap;
+    long weight0 = 0;
+    size_t next = seed;
+    for (size_t tried = 0; weight0 < target && tried <= n;) {
+        if (heap.empty()) {
+            int v = order[next];
+            next = (next + 1) % n;
+            tried++;
+            if (side[v] == 1) heap.emplace(gain[v], v);
+            continue;
+        }
+        auto [value, v] = heap.top();
+        heap.pop();
+        if (side[v] == 0 || value != gain[v]) continue;
+        side[v] = 0;
+        weight0 += g.weight[v];
+        for (int p = g.ptr[v]; p < g.ptr[v + 1]; p++) {
+            int u = g.adj[p];
+            if (side[u] == 0) continue;
+            gain[u] += 2L * g.edge[p];
+            heap.emplace(gain[u], u);
+        }
+    }
+    return side;
+}
+
+// Multilevel bisection, side 0 gets `fraction` of the vertex weight
+std::vector<char> bisect(const Graph& g, double fraction, std::mt19937& random) {
+    long total = g.total();
+    int maxWeight = static_cast<int>(std::max(1L, total / 20));
+
+    std::vector<Graph> levels;
+    std::vector<std::vector<int>> maps;
+    const Graph* current = &g;
+    while (current->size() > coarsest) {
+        std::vector<int> map;
+        Graph coarse = coarsen(*current, random, map, maxWeight);
+        if (coarse.size() > current->size() * 19 / 20) break; // Matching stalled (stars, heavy vertices)
+        maps.push_back(std::move(map));
+        levels.push_back(std::move(coarse));
+        current = &levels.back();
+    }
+
+    long target = static_cast<long>(total * fraction + 0.5);
+    auto slack = [&](const Graph& level) {
+        return std::max(total / 100, static_cast<long>(*std::max_element(level.weight.begin(), level.weight.end())));
+    };
+
+    // A few seeds on the coarsest graph, the best refined cut wins
+    std::vector<int> order(current->size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random);
+    std::vector<char> side;
+    long bestCut = -1;
+    for (size_t t = 0; t < std::min<size_t>(4, order.size()); t++) {
+        std::vector<char> candidate = grow(*current, target, order, t * order.size() / 4);
+        long cut = refine(*current, candidate, target, slack(*current));
+        if (bestCut < 0 || cut < bestCut) {
+            bestCut = cut;
+            side.swap(candidate);
+        }
+    }
+
+    for (size_t level = levels.size(); level-- > 0;) {
+        const Graph& fine = level ? levels[level - 1] : g;
+        std::vector<char> projected(fine.size());
+        for (size_t v = 0; v < fine.size(); v++) projected[v] = side[maps[level][v]];
+        side.swap(projected);
+        refine(fine, side, target, slack(fine));
+    }
+    return side;
+}
+
+// Recursive bisection, ids are the vertices of the input graph behind the vertices of g
+void split(const Graph& g, const std::vector<int>& ids, size_t parts, int first, std::mt19937& random,
+    std::vector<int>& part) {
+    if (parts <= 1 || g.size() <= 1) {
+        for (int id : ids) part[id] = first;
+        return;
+    }
+    size_t left = parts / 2;
+    std::vector<char> side = bisect(g, static_cast<double>(left) / parts, random);
+
+    std::vector<int> local(g.size());
+    for (char s = 0; s < 2; s++) {
+        Graph sub;
+        std::vector<int> subIds;
+        for (size_t v = 0; v < g.size(); v++) {
+            if (side[v] != s) continue;
+            local[v] = static_cast<int>(subIds.size());
+            subIds.push_back(ids[v]);
+        }
+        for (size_t v = 0; v < g.size(); v++) {
+            if (side[v] != s) continue;
+            sub.weight.push_back(g.weight[v]);
+            for (int p = g.ptr[v]; p < g.ptr[v + 1]; p++) {
+                if (side[g.adj[p]] != s) continue;
+                sub.adj.push_back(local[g.adj[p]]);
+                sub.edge.push_back(g.edge[p]);
+            }
+            sub.ptr.push_back(static_cast<int>(sub.adj.size()));
+        }
+        split(sub, subIds, s ? parts - left : left, s ? first + static_cast<int>(left) : first, random, part);
+    }
+}
+
+} // namespace
+
+std::vector<int> partitionGraph(size_t n, const std::vector<int>& adj_ptr, const std::vector<int>& adj,
+    size_t parts, const std::vector<int>& weights) {
+    Graph g;
+    g.ptr = adj_ptr;
+    g.adj = adj;
+    g.edge.assign(adj.size(), 1);
+    g.weight = weights.empty() ? std::vector<int>(n, 1) : weights;
+
+    std::vector<int> ids(n), part(n, 0);
+    std::iota(ids.begin(), ids.end(), 0);
+    std::mt19937 random(12345);
+    split(g, ids, std::max<size_t>(parts, 1), 0, random, part);
+    return part;
+}
+
+void separateParts(size_t n, const std::vector<int>& adj_ptr, const std::vector<int>& adj, std::vector<int>& part) {
+    std::vector<int> cut(n, 0), order(n);
+    for (size_t v = 0; v < n; v++) {
+        for (int p = adj_ptr[v]; p < adj_ptr[v + 1]; p++) {
+            if (part[adj[p]] != part[v]) cut[v]++;
+        }
+    }
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return cut[a] > cut[b]; });
+
+    for (int v : order) {
+        if (cut[v] == 0) break;
+        for (int p = adj_ptr[v]; p < adj_ptr[v + 1]; p++) {
+            int u = adj[p];
+            if (part[u] >= 0 && part[u] != part[v]) {
+                part[v] = -1;
+                break;
+            }
+        }
+    }
+}
+
+void nodeGraph(const Topology& topology, std::vector<int>& adj_ptr, std::vector<int>& adj) {
+    size_t n = topology.nodeCount();
+    adj_ptr.assign(1, 0);
+    adj.clear();
+    std::vector<int> mark(n, -1);
+    for (size_t v = 0; v < n; v++) {
+        int node = static_cast<int>(v);
+        for (int e : topology.elementsAt(node)) {
+            for (int t : topology.terminalsOf(e)) {
+                if (t < 0 || t == node || mark[t] == node) continue;
+                mark[t] = node;
+                adj.push_back(t);
+            }
+        }
+        adj_ptr.push_back(static_cast<int>(adj.size()));
+    }
+}
+
+std::vector<int> unknownDomains(const Topology& topology, size_t unknowns, size_t parts) {
+    std::vector<int> adj_ptr, adj;
+    nodeGraph(topology, adj_ptr, adj);
+    size_t n = topology.nodeCount();
+    std::vector<int> part = partitionGraph(n, adj_ptr, adj, parts);
+    separateParts(n, adj_ptr, adj, part);
+
+    std::vector<int> domain(unknowns, -1);
+    std::copy(part.begin(), part.end(), domain.begin());
+    const auto& elements = topology.elementHandles();
+    for (size_t e = 0; e < elements.size(); e++) {
+        int branch = elements[e]->getBranchIndex();
+        if (branch < 0) continue;
+        int d = -2; // No domain terminal yet
+        for (int t : topology.terminalsOf(static_cast<int>(e))) {
+            if (t < 0 || part[t] < 0) continue;
+            d = d == -2 || d == part[t] ? part[t] : -1;
+        }
+        for (size_t k = 0; k < elements[e]->branchCount(); k++) domain[branch + k] = std::max(d, -1);
+    }
+    return domain;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class Topology;
+
+// Multilevel graph partitioning for the domain decomposition solver (DomainSolver.h)
+// Recursive bisection: heavy edge matching coarsens the graph to about a hundred vertices, greedy graph
+// growing splits the coarsest graph, and boundary Fiduccia-Mattheyses passes refine the cut on every level
+// on the way back. Graphs are symmetric CSR adjacency lists without self loops. A fixed seed makes the
+// result depend on the graph only.
+
+// Part of every vertex in [0, parts), parts of about equal vertex weight (no weights count 1 each)
+std::vector<int> partitionGraph(size_t n, const std::vector<int>& adj_ptr, const std::vector<int>& adj,
+	size_t parts, const std::vector<int>& weights = {});
+
+// Turns the edge cut into a vertex separator: one end of every cut edge moves to part -1, the vertex
+// with more cut edges first
+void separateParts(size_t n, const std::vector<int>& adj_ptr, const std::vector<int>& adj, std::vector<int>& part);
+
+// Node graph of a circuit, the terminals of every element form a clique, ground is left out
+void nodeGraph(const Topology& topology, std::vector<int>& adj_ptr, std::vector<int>& adj);
+
+// Domain of every MNA unknown, -1 for the interface. Nodes are partitioned and separated as above, the
+// branch unknowns of an element join the domain of its terminals, or the interface if they only touch
+// separator nodes and ground. Branch indices have to be assigned
+std::vector<int> unknownDomains(const Topology& topology, size_t unknowns, size_t parts);
@@ -0,0 +1,251 @@
+#include "PoleZero.h"
+#include "BlockLU.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+using Complex = std::complex<double>;
+
+constexpr double breakdown = 1e-10; // Arnoldi vector that keeps less of its norm: the space is invariant
+
+double dot(const std::vector<double>& a, const std::vector<double>& b) {
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); i++) sum += a[i] * b[i];
+    return sum;
+}
+
+// Eigenvalues of an upper Hessenberg matrix (m x m, row major), explicitly shifted QR with Givens
+// rotations, Wilkinson shifts and deflation at negligible subdiagonal entries
+std::vector<Complex> hessenbergEigenvalues(std::vector<Complex> H, size_t m) {
+    const double eps = std::numeric_limits<double>::epsilon();
+    auto at = [&](size_t i, size_t j) -> Complex& { return H[i * m + j]; };
+    std::vector<Complex> values(m);
+    std::vector<double> cs(m);
+    std::vector<Complex> sn(m);
+
+    size_t hi = m, iterations = 0;
+    while (hi > 0) {
+        size_t last = hi - 1, lo = last;
+        while (lo > 0 && std::abs(at(lo, lo - 1)) > eps * (std::abs(at(lo - 1, lo - 1)) + std::abs(at(lo, lo)))) lo--;
+        if (lo == last) {
+            values[last] = at(last, last);
+            hi--;
+            iterations = 0;
+            continue;
+        }
+        if (++iterations > 60) throw std::runtime_error("Eigenvalues of the Hessenberg matrix did not converge.");
+
+        // Eigenvalue of the trailing 2 x 2 block closest to its last entry, now and then an exceptional shift
+        Complex a = at(last - 1, last - 1), b = at(last - 1, last), c = at(last, last - 1), d = at(last, last);
+        Complex half = (a + d) / 2.0, root = std::sqrt(half * half - (a * d - b * c));
+        Complex shift = std::abs(half + root - d) < std::abs(half - root - d) ? half + root : half - root;
+        if (iterations % 11 == 10) shift = d + std::abs(c) * 0.75;
+
+        for (size_t k = lo; k <= last; k++) at(k, k) -= shift;
+        for (size_t k = lo; k < last; k++) {
+            Complex x = at(k, k), y = at(k + 1, k);
+            double r = std::sqrt(std::norm(x) + std::norm(y));
+            if (r == 0) {
+                cs[k] = 1;
+                sn[k] = 0;
+                continue;
+            }
+            if (x == Complex(0)) {
+                cs[k] = 0;
+                sn[k] = 1;
+            }
+            else {
+                cs[k] = std::abs(x) / r;
+                sn[k] = x / std::abs(x) * std::conj(y) / r;
+            }
+            for (size_t j = k; j <= last; j++) {
+                Complex u = at(k, j), v = at(k + 1, j);
+                at(k, j) = cs[k] * u + sn[k] * v;
+                at(k + 1, j) = -std::conj(sn[k]) * u + cs[k] * v;
+            }
+        }
+        for (size_t k = lo; k < last; k++) {
+            for (size_t i = lo; i <= std::min(k + 2, last); i++) {
+                Complex u = at(i, k), v = at(i, k + 1);
+                at(i, k) = cs[k] * u + std::conj(sn[k]) * v;
+                at(i, k + 1) = -sn[k] * u + cs[k] * v;
+            }
+        }
+        for (size_t k = lo; k <= last; k++) at(k, k) += shift;
+    }
+    return values;
+}
+
+// Last entry of the normalized eigenvector of H for θ, one step of inverse iteration on the Hessenberg
+// matrix (Gaussian elimination with pivoting between neighbouring rows)
+double lastComponent(const std::vector<Complex>& H, size_t m, Complex theta) {
+    std::vector<Complex> A(H);
+    Complex perturbed = theta + std::abs(theta) * 1e-10;
+    for (size_t k = 0; k < m; k++) A[k * m + k] -= perturbed;
+    std::vector<Complex> y(m, Complex(1));
+    for (size_t k = 0; k + 1 < m; k++) {
+        if (std::abs(A[(k + 1) * m + k]) > std::abs(A[k * m + k])) {
+            for (size_t j = k; j < m; j++) std::swap(A[k * m + j], A[(k + 1) * m + j]);
+            std::swap(y[k], y[k + 1]);
+        }
+        if (A[k * m + k] == Complex(0)) continue;
+        Complex f = A[(k + 1) * m + k] / A[k * m + k];
+        for (size_t j = k; j < m; j++) A[(k + 1) * m + j] -= f * A[k * m + j];
+        y[k + 1] -= f * y[k];
+    }
+    for (size_t k = m; k-- > 0;) {
+        for (size_t j = k + 1; j < m; j++) y[k] -= A[k * m + j] * y[j];
+        y[k] = A[k * m + k] == Complex(0) ? Complex(1) : y[k] / A[k * m + k];
+    }
+    double norm = 0;
+    for (const auto& value : y) norm += std::norm(value);
+    return norm > 0 ? std::abs(y[m - 1]) / std::sqrt(norm) : 0;
+}
+
+bool byMagnitude(const Complex& a, const Complex& b) {
+    if (std::abs(a) != std::abs(b)) return std::abs(a) < std::abs(b);
+    return a.imag() < b.imag();
+}
+
+} // namespace
+
+std::vector<std::complex<double>> generalizedEigenvalues(const SparseMatrix<double>& G, const SparseMatrix<double>& C,
+    const PoleZeroOptions& options, size_t* dimension, bool* converged) {
+    size_t n = G.rows();
+    if (G.cols() != n || C.rows() != n || C.cols() != n) throw std::invalid_argument("Pole-zero analysis needs square G and C of one size.");
+    if (dimension) *dimension = 0;
+    if (converged) *converged = true;
+    if (n == 0) return {};
+
+    // G + σ C on the union of both patterns
+    TripletMatrix<double> shifted(n, n);
+    for (size_t j = 0; j < n; j++) {
+        for (int p = G.colPtr()[j]; p < G.colPtr()[j + 1]; p++) shifted.add(G.rowIdx()[p], static_cast<int>(j), G.getValues()[p]);
+        for (int p = C.colPtr()[j]; p < C.colPtr()[j + 1]; p++) {
+            shifted.add(C.rowIdx()[p], static_cast<int>(j), options.shift * C.getValues()[p]);
+        }
+    }
+    SparseMatrix<double> M = SparseMatrix<double>::fromTriplets(shifted);
+    BlockLU<double> lu;
+    lu.analyze(M);
+    try {
+        lu.factorize(M);
+    }
+    catch (const std::runtime_error& error) {
+        throw std::runtime_error(std::string(error.what()) + "\nG + σC is singular at the shift, choose another shift.");
+    }
+    auto apply = [&](const std::vector<double>& x, std::vector<double>& y) {
+        C.multiply(x, y);
+        lu.solve(y);
+    };
+
+    // Fixed seed, the same circuit gives the same Krylov space
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::vector<double> r(n), w;
+    for (double& value : r) value = uniform(random);
+    for (int k = 0; k < 3; k++) {
+        apply(r, w);
+        r.swap(w);
+    }
+    double start = std::sqrt(dot(r, r));
+    if (start == 0) return {}; // C = 0, no finite poles
+    for (double& value : r) value /= start;
+
+    size_t limit = options.maxDimension ? std::min(options.maxDimension, n) : n;
+    size_t target = options.count ? std::min(limit, std::max(2 * options.count + 1, options.count + 20)) : limit;
+    std::vector<std::vector<double>> V = { r };
+    std::vector<std::vector<double>> h; // h[j] is column j, j + 2 entries
+
+    auto ritz = [&](size_t m) {
+        std::vector<Complex> H(m * m, Complex(0));
+        for (size_t j = 0; j < m; j++) {
+            for (size_t i = 0; i < std::min(m, j + 2); i++) H[i * m + j] = h[j][i];
+        }
+        return H;
+    };
+
+    std::vector<Complex> mu;
+    while (true) {
+        size_t j = V.size() - 1;
+        apply(V[j], w);
+        double before = std::sqrt(dot(w, w));
+        std::vector<double> column(j + 2, 0.0);
+        for (int pass = 0; pass < 2; pass++) {
+            for (size_t i = 0; i <= j; i++) {
+                double c = dot(V[i], w);
+                column[i] += c;
+                for (size_t k = 0; k < n; k++) w[k] -= c * V[i][k];
+            }
+        }
+        double beta = std::sqrt(dot(w, w));
+        column[j + 1] = beta;
+        h.push_back(column);
+        size_t m = j + 1;
+
+        bool invariant = beta <= breakdown * before;
+        if (invariant || m >= target) {
+            std::vector<Complex> H = ritz(m);
+            mu = hessenbergEigenvalues(H, m);
+            std::sort(mu.begin(), mu.end(), [](const Complex& a, const Complex& b) { return std::abs(a) > std::abs(b); });
+            if (dimension) *dimension = m;
+            if (invariant || !options.count || m >= limit) {
+                if (options.count && !invariant && converged) *converged = false;
+                break;
+            }
+
+            // The wanted Ritz values are accepted when |β y_m| <= tolerance |μ|
+            bool done = true;
+            for (size_t k = 0; k < std::min(options.count, mu.size()) && done; k++) {
+                done = beta * lastComponent(H, m, mu[k]) <= options.tolerance * std::abs(mu[k]);
+            }
+            if (done) break;
+            target = std::min(limit, 2 * target);
+        }
+        for (double& value : w) value /= beta;
+        V.push_back(w);
+    }
+
+    // μ = 0 are infinite poles, roundoff leaves them at a tiny fraction of the largest μ
+    double largest = mu.empty() ? 0 : std::abs(mu.front());
+    std::vector<Complex> values;
+    for (const Complex& value : mu) {
+        if (std::abs(value) <= 1e-12 * largest) continue;
+        values.push_back(options.shift - 1.0 / value);
+        if (options.count && values.size() == options.count) break;
+    }
+    std::sort(values.begin(), values.end(), byMagnitude);
+    return values;
+}
+
+PoleZeroResult poleZeroAnalysis(const SparseMatrix<double>& G, const SparseMatrix<double>& C,
+    const std::vector<double>& b, int output, const PoleZeroOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    size_t n = G.rows();
+    PoleZeroResult result;
+    bool converged = true;
+    result.poles = generalizedEigenvalues(G, C, options, &result.poleDimension, &converged);
+    result.converged = converged;
+
+    if (output >= 0) {
+        if (b.size() != n || output >= static_cast<int>(n)) throw std::invalid_argument("Pole-zero input or output outside of the system.");
+        TripletMatrix<double> g(n + 1, n + 1), c(n + 1, n + 1);
+        int u = static_cast<int>(n);
+        for (size_t j = 0; j < n; j++) {
+            for (int p = G.colPtr()[j]; p < G.colPtr()[j + 1]; p++) g.add(G.rowIdx()[p], static_cast<int>(j), G.getValues()[p]);
+            for (int p = C.colPtr()[j]; p < C.colPtr()[j + 1]; p++) c.add(C.rowIdx()[p], static_cast<int>(j), C.getValues()[p]);
+            if (b[j] != 0) g.add(static_cast<int>(j), u, -b[j]);
+        }
+        g.add(u, output, 1);
+        result.zeros = generalizedEigenvalues(SparseMatrix<double>::fromTriplets(g), SparseMatrix<double>::fromTriplets(c),
+            options, &result.zeroDimension, &converged);
+        result.converged = result.converged && converged;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
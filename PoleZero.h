@@ -0,0 +1,43 @@
+#pragma once
+#include "SparseMatrix.h"
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// Numeric pole-zero analysis on the split stamps G + s C
+// Poles are the finite s with det(G + s C) = 0, a generalized eigenvalue problem. With the shift σ,
+//   A = (G + σ C)^-1 C,   A x = μ x   <=>   (G + s C) x = 0,   s = σ - 1 / μ
+// so the poles closest to σ are the largest eigenvalues of A, and the infinite eigenvalues of the pencil
+// (C is singular in MNA) are μ = 0. Arnoldi on A starts from A^3 r, which has no component along the
+// μ = 0 Jordan chains up to length 3 (index 2 MNA, one more for the bordered pencil of the zeros), so
+// without a pole count it stops once the Krylov space holds every finite pole (at most the rank of C,
+// roughly the number of reactive elements). The eigenvalues of the Hessenberg matrix come from a complex
+// shifted QR, with a count only the Ritz values closest to σ are checked and the space grows until they
+// converge.
+// Zeros of V(out) / u(in) are the poles of the bordered pencil
+//   [G  -b; e_out^T  0] + s [C  0; 0  0]
+// with b the unit excitation of the input source.
+
+struct PoleZeroOptions
+{
+	size_t count = 0;        // 0 finds every finite pole (zero), otherwise the `count` closest to the shift
+	double shift = 0;        // σ in rad/s, set it when G is singular (no DC path to ground)
+	double tolerance = 1e-8; // Relative residual of an accepted pole
+	size_t maxDimension = 0; // Largest Krylov space, 0 is the matrix size
+};
+
+struct PoleZeroResult
+{
+	std::vector<std::complex<double>> poles, zeros; // rad/s, by magnitude
+	size_t poleDimension = 0, zeroDimension = 0;    // Krylov spaces used
+	bool converged = true;   // False if a count was asked for and maxDimension ran out first
+	double seconds = 0;
+};
+
+// s with det(G + s C) = 0, by magnitude. Throws std::runtime_error if G + σ C is singular
+std::vector<std::complex<double>> generalizedEigenvalues(const SparseMatrix<double>& G, const SparseMatrix<double>& C,
+	const PoleZeroOptions& options, size_t* dimension = nullptr, bool* converged = nullptr);
+
+// Poles of G + s C, and zeros from input excitation b to the output unknown when output >= 0
+PoleZeroResult poleZeroAnalysis(const SparseMatrix<double>& G, const SparseMatrix<double>& C,
+	const std::vector<double>& b, int output, const PoleZeroOptions& options = {});
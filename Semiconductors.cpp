@@ -0,0 +1,239 @@
+#include "Semiconductors.h"
+#include "Connectivity.h"
+#include "Noise.h"
+#include "NumericSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr double max_exponent = 80; // exp() continues linearly past this, wild Newton steps stay finite
+
+double junctionExp(double x, double& derivative) {
+    if (x > max_exponent) {
+        derivative = std::exp(max_exponent);
+        return derivative * (1 + x - max_exponent);
+    }
+    derivative = std::exp(x);
+    return derivative;
+}
+
+// SPICE pnjlim: above the critical voltage a junction moves on the log of the predicted current
+double pnjlim(double vnew, double vold, double vt, double vcrit, bool& limited) {
+    if (vnew <= vcrit || std::abs(vnew - vold) <= 2 * vt) return vnew;
+    limited = true;
+    if (vold > 0) {
+        double arg = 1 + (vnew - vold) / vt;
+        return arg > 0 ? vold + vt * std::log(arg) : vcrit;
+    }
+    return vt * std::log(vnew / vt);
+}
+
+double criticalVoltage(double vt, double is) {
+    return vt * std::log(vt / (std::sqrt(2.0) * is));
+}
+
+// SPICE fetlim, simplified: the gate overdrive moves by at most 2 |vold - vto| + 2 per iteration
+double fetlim(double vnew, double vold, double vto) {
+    double span = 2 * std::abs(vold - vto) + 2;
+    return std::clamp(vnew, vold - span, vold + span);
+}
+
+// SPICE limvds
+double limvds(double vnew, double vold) {
+    if (vold >= 3.5) {
+        if (vnew > vold) return std::min(vnew, 3 * vold + 2);
+        return vnew < 3.5 ? std::max(vnew, 2.0) : vnew;
+    }
+    return vnew > vold ? std::min(vnew, 4.0) : std::max(vnew, -0.5);
+}
+
+} // namespace
+
+void NonlinearDevice::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
+    throw std::logic_error(symbol + " is nonlinear and needs the numeric backend.");
+}
+
+// Small signal conductances at the last operating point, at zero volts before the first solve
+// Every terminal pair is stamped, zeros included, so the pattern doesn't depend on the bias
+
+void NonlinearDevice::evaluateOperatingPoint(std::vector<double>& current, std::vector<double>& conductance) const {
+    size_t k = terminals.size();
+    std::vector<double> v = operating.size() == k ? operating : std::vector<double>(k, 0.0);
+    current.resize(k);
+    conductance.resize(k * k);
+    evaluate(v.data(), current.data(), conductance.data());
+}
+
+void NonlinearDevice::stampNumeric(NumericSystem& sys) const {
+    size_t k = terminals.size();
+    std::vector<double> current, conductance;
+    evaluateOperatingPoint(current, conductance);
+
+    for (size_t a = 0; a < k; a++) {
+        for (size_t b = 0; b < k; b++) sys.G.add(terminals[a]->getIndex(), terminals[b]->getIndex(), conductance[a * k + b]);
+    }
+}
+
+void Diode::evaluate(const double* v, double* current, double* conductance) const {
+    double nvt = model.n * model.Vt, slope;
+    double id = model.Is * (junctionExp((v[0] - v[1]) / nvt, slope) - 1);
+    double gd = model.Is * slope / nvt;
+
+    current[0] = id;
+    current[1] = -id;
+    conductance[0] = gd;
+    conductance[1] = -gd;
+    conductance[2] = -gd;
+    conductance[3] = gd;
+}
+
+bool Diode::limit(const double* previous, double* v) const {
+    double nvt = model.n * model.Vt;
+    bool limited = false;
+    double vd = pnjlim(v[0] - v[1], previous[0] - previous[1], nvt, criticalVoltage(nvt, model.Is), limited);
+    if (limited) v[0] = v[1] + vd;
+    return limited;
+}
+
+// Transport model, junction voltages in the polarity of the device
+//   I_F = Is (exp(vbe / Vt) - 1),   I_R = Is (exp(vbc / Vt) - 1)
+//   ic = I_F - I_R (1 + 1 / betaR),   ib = I_F / betaF + I_R / betaR,   ie = -(ic + ib)
+// A PNP flips the voltages and the currents, the Jacobian keeps its sign
+
+void BJT::evaluate(const double* v, double* current, double* conductance) const {
+    double p = model.pnp ? -1 : 1;
+    double slope_f, slope_r;
+    double i_f = model.Is * (junctionExp(p * (v[1] - v[2]) / model.Vt, slope_f) - 1);
+    double i_r = model.Is * (junctionExp(p * (v[1] - v[0]) / model.Vt, slope_r) - 1);
+    double g_f = model.Is * slope_f / model.Vt, g_r = model.Is * slope_r / model.Vt;
+
+    double ic = i_f - i_r * (1 + 1 / model.betaR);
+    double ib = i_f / model.betaF + i_r / model.betaR;
+    current[0] = p * ic;
+    current[1] = p * ib;
+    current[2] = -p * (ic + ib);
+
+    // Derivatives by vbe and vbc, then by the terminal voltages (vc, vb, ve)
+    double d_be[3] = { g_f, g_f / model.betaF, 0 };
+    double d_bc[3] = { -g_r * (1 + 1 / model.betaR), g_r / model.betaR, 0 };
+    d_be[2] = -(d_be[0] + d_be[1]);
+    d_bc[2] = -(d_bc[0] + d_bc[1]);
+    for (int k = 0; k < 3; k++) {
+        conductance[k * 3 + 0] = -d_bc[k];
+        conductance[k * 3 + 1] = d_be[k] + d_bc[k];
+        conductance[k * 3 + 2] = -d_be[k];
+    }
+}
+
+bool BJT::limit(const double* previous, double* v) const {
+    double p = model.pnp ? -1 : 1, vcrit = criticalVoltage(model.Vt, model.Is);
+    bool limited = false;
+    double vbe = pnjlim(p * (v[1] - v[2]), p * (previous[1] - previous[2]), model.Vt, vcrit, limited);
+    double vbc = pnjlim(p * (v[1] - v[0]), p * (previous[1] - previous[0]), model.Vt, vcrit, limited);
+    if (limited) {
+        v[2] = v[1] - p * vbe;
+        v[0] = v[1] - p * vbc;
+    }
+    return limited;
+}
+
+// Level 1 drain current in the polarity of the device, vds >= 0
+//   cutoff      vgs <= Vto:        0
+//   triode      vds < vgs - Vto:   beta (vov vds - vds^2 / 2)(1 + lambda vds)
+//   saturation                     beta / 2 vov^2 (1 + lambda vds)
+// With vds < 0 drain and source trade places
+
+void MOSFET::evaluate(const double* v, double* current, double* conductance) const {
+    double p = model.pmos ? -1 : 1, vto = p * model.Vto, beta = model.Kp * model.W / model.L;
+    double vds = p * (v[0] - v[2]);
+    bool reversed = vds < 0;
+    int d = reversed ? 2 : 0, s = reversed ? 0 : 2; // Terminals acting as drain and source
+    double vgs = p * (v[1] - v[s]);
+    vds = std::abs(vds);
+
+    double vov = vgs - vto, id = 0, gm = 0, gds = 0;
+    double clm = 1 + model.lambda * vds;
+    if (vov > 0 && vds < vov) {
+        double core = vov * vds - vds * vds / 2;
+        id = beta * core * clm;
+        gm = beta * vds * clm;
+        gds = beta * (vov - vds) * clm + beta * core * model.lambda;
+    }
+    else if (vov > 0) {
+        id = beta / 2 * vov * vov * clm;
+        gm = beta * vov * clm;
+        gds = beta / 2 * vov * vov * model.lambda;
+    }
+
+    std::fill(conductance, conductance + 9, 0.0);
+    current[d] = p * id;
+    current[1] = 0;
+    current[s] = -p * id;
+    conductance[d * 3 + d] = gds;
+    conductance[d * 3 + 1] = gm;
+    conductance[d * 3 + s] = -gm - gds;
+    conductance[s * 3 + d] = -gds;
+    conductance[s * 3 + 1] = -gm;
+    conductance[s * 3 + s] = gm + gds;
+}
+
+bool MOSFET::limit(const double* previous, double* v) const {
+    double p = model.pmos ? -1 : 1, vto = p * model.Vto;
+    double vgs_old = p * (previous[1] - previous[2]), vds_old = p * (previous[0] - previous[2]);
+    double vgs = p * (v[1] - v[2]), vds = p * (v[0] - v[2]);
+    double vgd = vgs - vds, vgs_new, vds_new;
+
+    // Untouched voltages are passed on as they are, recombining them would round
+    if (vds_old >= 0) {
+        vgs_new = fetlim(vgs, vgs_old, vto);
+        vds_new = limvds(vgs_new == vgs ? vds : vgs_new - vgd, vds_old);
+    }
+    else {
+        double vgd_new = fetlim(vgd, vgs_old - vds_old, vto);
+        vds_new = -limvds(-(vgd_new == vgd ? vds : vgs - vgd_new), -vds_old);
+        vgs_new = vgd_new == vgd && vds_new == vds ? vgs : vgd_new + vds_new;
+    }
+
+    if (vgs_new == vgs && vds_new == vds) return false;
+    v[1] = v[2] + p * vgs_new;
+    v[0] = v[2] + p * vds_new;
+    return true;
+}
+
+// Terminal currents depend on the voltages between the terminals only, see Connectivity.h
+
+void NonlinearDevice::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    for (size_t t = 1; t < terminals.size(); t++) links.join(0, static_cast<int>(t));
+}
+
+// Noise generators at the operating point, see Noise.h
+// Shot noise 2q|I| of the junction currents, channel thermal noise 8kT gm / 3 of a saturated long channel
+// MOSFET (the gate has no current and no noise). Flicker noise isn't modelled
+
+void Diode::noiseSources(std::vector<NoiseSource>& sources, double temperature) const {
+    std::vector<double> current, conductance;
+    evaluateOperatingPoint(current, conductance);
+    auto nodes = getTerminals();
+    sources.push_back({ nodes[0]->getIndex(), nodes[1]->getIndex(), 2 * elementary_charge * std::abs(current[0]) });
+}
+
+void BJT::noiseSources(std::vector<NoiseSource>& sources, double temperature) const {
+    std::vector<double> current, conductance;
+    evaluateOperatingPoint(current, conductance);
+    auto nodes = getTerminals();
+    int emitter = nodes[2]->getIndex();
+    sources.push_back({ nodes[0]->getIndex(), emitter, 2 * elementary_charge * std::abs(current[0]) });
+    sources.push_back({ nodes[1]->getIndex(), emitter, 2 * elementary_charge * std::abs(current[1]) });
+}
+
+// d i_drain / d v_gate is gm with the drain and source either way round
+
+void MOSFET::noiseSources(std::vector<NoiseSource>& sources, double temperature) const {
+    std::vector<double> current, conductance;
+    evaluateOperatingPoint(current, conductance);
+    auto nodes = getTerminals();
+    double gm = std::abs(conductance[1]);
+    sources.push_back({ nodes[0]->getIndex(), nodes[2]->getIndex(), 8 * boltzmann * temperature * gm / 3 });
+}
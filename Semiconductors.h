@@ -0,0 +1,133 @@
+#pragma once
+#include "Component.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <ginac/ginac.h>
+
+using namespace GiNaC;
+
+// Nonlinear devices for the DC operating point
+// A device is its terminal currents i(v), positive into the device, and their Jacobian di/dv. Around the
+// voltages v0 of a Newton iteration it stamps the companion model
+//   G = di/dv(v0),   rhs = G * v0 - i(v0)
+// see Newton.h. Outside of Newton (AC, sweeps) stampNumeric() stamps the small signal conductances at the
+// operating point of the last solve. There is no symbolic model, stamp() throws std::logic_error.
+
+class NonlinearDevice : public CircuitElement
+{
+	std::string symbol;
+	std::vector<std::shared_ptr<Node>> terminals;
+	std::vector<double> operating; // Terminal voltages of the last operating point, empty before
+
+public:
+	NonlinearDevice(const std::string& sym, std::vector<std::shared_ptr<Node>> nodes)
+		: symbol(sym), terminals(std::move(nodes)) {}
+
+	std::string getSym() const { return symbol; }
+	void setTerminal(size_t k, std::shared_ptr<Node> node) { terminals.at(k) = std::move(node); terminalsChanged(); }
+	std::vector<std::shared_ptr<Node>> getTerminals() const override { return terminals; }
+	size_t terminalCount() const { return terminals.size(); }
+
+	// current[k] and conductance[k * terminals + j] = d current[k] / d v[j] at the terminal voltages v
+	virtual void evaluate(const double* v, double* current, double* conductance) const = 0;
+
+	// Limits the step from the previous evaluation point to v between two iterations (junction
+	// voltages of exponentials, gate overdrive). True if v was changed
+	virtual bool limit(const double* previous, double* v) const { return false; }
+
+	const std::vector<double>& getOperatingPoint() const { return operating; }
+	void setOperatingPoint(std::vector<double> v) { operating = std::move(v); valuesChanged(); }
+
+	// evaluate() at the operating point, at zero volts before the first solve
+	void evaluateOperatingPoint(std::vector<double>& current, std::vector<double>& conductance) const;
+
+	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampNumeric(NumericSystem& sys) const override;
+	bool isNumeric() const override { return true; }
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
+};
+
+// Junction diode, Shockley equation
+// Anode is the input, cathode the output
+
+struct DiodeModel
+{
+	double Is = 1e-14;     // Saturation current
+	double n = 1.0;        // Emission coefficient
+	double Vt = 0.025852;  // Thermal voltage, 300 K
+};
+
+class Diode : public NonlinearDevice
+{
+	DiodeModel model;
+
+public:
+	Diode(const std::string& sym, const DiodeModel& m, std::shared_ptr<Node> anode, std::shared_ptr<Node> cathode)
+		: NonlinearDevice("D" + sym, { anode, cathode }), model(m) {}
+
+	const DiodeModel& getModel() const { return model; }
+	void setModel(const DiodeModel& m) { model = m; valuesChanged(); }
+
+	void evaluate(const double* v, double* current, double* conductance) const override;
+	bool limit(const double* previous, double* v) const override;
+	void noiseSources(std::vector<NoiseSource>& sources, double temperature) const override;
+};
+
+// Bipolar transistor, Ebers-Moll transport model
+// Terminals are collector, base and emitter
+
+struct BJTModel
+{
+	double Is = 1e-16;
+	double betaF = 100;   // Forward common emitter gain
+	double betaR = 1;     // Reverse gain
+	double Vt = 0.025852;
+	bool pnp = false;
+};
+
+class BJT : public NonlinearDevice
+{
+	BJTModel model;
+
+public:
+	BJT(const std::string& sym, const BJTModel& m, std::shared_ptr<Node> collector, std::shared_ptr<Node> base,
+		std::shared_ptr<Node> emitter)
+		: NonlinearDevice("Q" + sym, { collector, base, emitter }), model(m) {}
+
+	const BJTModel& getModel() const { return model; }
+	void setModel(const BJTModel& m) { model = m; valuesChanged(); }
+
+	void evaluate(const double* v, double* current, double* conductance) const override;
+	bool limit(const double* previous, double* v) const override;
+	void noiseSources(std::vector<NoiseSource>& sources, double temperature) const override;
+};
+
+// MOSFET, Shichman-Hodges (SPICE level 1) with the bulk tied to the source
+// Terminals are drain, gate and source. Drain and source swap when the channel is reversed
+
+struct MOSFETModel
+{
+	double Vto = 0.7;     // Threshold voltage, negative for an enhancement PMOS as in SPICE
+	double Kp = 2e-5;     // Transconductance parameter, A / V^2
+	double W = 1e-6, L = 1e-6;
+	double lambda = 0;    // Channel length modulation, 1 / V
+	bool pmos = false;
+};
+
+class MOSFET : public NonlinearDevice
+{
+	MOSFETModel model;
+
+public:
+	MOSFET(const std::string& sym, const MOSFETModel& m, std::shared_ptr<Node> drain, std::shared_ptr<Node> gate,
+		std::shared_ptr<Node> source)
+		: NonlinearDevice("M" + sym, { drain, gate, source }), model(m) {}
+
+	const MOSFETModel& getModel() const { return model; }
+	void setModel(const MOSFETModel& m) { model = m; valuesChanged(); }
+
+	void evaluate(const double* v, double* current, double* conductance) const override;
+	bool limit(const double* previous, double* v) const override;
+	void noiseSources(std::vector<NoiseSource>& sources, double temperature) const override;
+};
@@ -0,0 +1,123 @@
+#include "Sensitivity.h"
+#include "ACSweep.h"
+#include "BlockLU.h"
+#include "Parallel.h"
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Derivative stamps of every element with a value, stamped once since they don't depend on the frequency
+// Entries of element k are g_ptr[k] .. g_ptr[k + 1] - 1 in G and likewise for C and the rhs terms
+
+struct DerivativeStamps
+{
+    NumericSystem stamps;
+    std::vector<int> elements;
+    std::vector<size_t> g_ptr, c_ptr, rhs_ptr;
+
+    DerivativeStamps(size_t n, const std::vector<std::shared_ptr<CircuitElement>>& all) : stamps(NumericSystem::buffer(n)) {
+        g_ptr.push_back(0);
+        c_ptr.push_back(0);
+        rhs_ptr.push_back(0);
+        for (const auto& element : all) {
+            if (!element->stampDerivative(stamps)) continue;
+            elements.push_back(element->getElementIndex());
+            g_ptr.push_back(stamps.G.entries());
+            c_ptr.push_back(stamps.C.entries());
+            rhs_ptr.push_back(stamps.rhs_terms.size());
+        }
+    }
+
+    // λ^T (db/dp - (dG/dp + s * dC/dp) x) of every element
+    template <typename T>
+    void terms(T s, const std::vector<T>& x, const std::vector<T>& lambda, std::complex<double>* out) const {
+        const auto& G = stamps.G;
+        const auto& C = stamps.C;
+        for (size_t e = 0; e < elements.size(); e++) {
+            T sum = 0, dc = 0;
+            for (size_t k = g_ptr[e]; k < g_ptr[e + 1]; k++) sum -= lambda[G.row(k)] * G.value(k) * x[G.col(k)];
+            for (size_t k = c_ptr[e]; k < c_ptr[e + 1]; k++) dc += lambda[C.row(k)] * C.value(k) * x[C.col(k)];
+            for (size_t k = rhs_ptr[e]; k < rhs_ptr[e + 1]; k++) sum += lambda[stamps.rhs_terms[k].first] * stamps.rhs_terms[k].second;
+            out[e] = sum - s * dc;
+        }
+    }
+};
+
+// Forward solve unless x already holds the solution, then one transposed solve per output
+
+template <typename T>
+void solvePoint(const BlockLU<T>& lu, T s, const NumericSystem& sys, const DerivativeStamps& stamps,
+    const std::vector<int>& outputs, bool solved, std::vector<T>& x, std::vector<T>& lambda,
+    std::complex<double>* responses, std::complex<double>* values) {
+    if (!solved) {
+        x.assign(sys.rhs.begin(), sys.rhs.end());
+        lu.solve(x);
+    }
+    for (size_t o = 0; o < outputs.size(); o++) {
+        if (outputs[o] < 0) continue; // Ground, zero response and derivatives
+        responses[o] = x[outputs[o]];
+        lambda.assign(sys.size(), T(0));
+        lambda[outputs[o]] = 1;
+        lu.solveTransposed(lambda);
+        stamps.terms(s, x, lambda, values + o * stamps.elements.size());
+    }
+}
+
+}
+
+SensitivityResult adjointSensitivity(const NumericSystem& sys, const std::vector<std::shared_ptr<CircuitElement>>& elements,
+    const std::vector<int>& outputs, const std::vector<double>& frequencies,
+    const std::vector<double>& operatingPoint, unsigned threads) {
+    const double two_pi = 2.0 * std::acos(-1.0);
+    auto start = std::chrono::steady_clock::now();
+
+    for (int idx : outputs) {
+        if (idx >= static_cast<int>(sys.size())) throw std::out_of_range("Sensitivity output outside of the system.");
+    }
+    if (!operatingPoint.empty() && operatingPoint.size() != sys.size()) {
+        throw std::invalid_argument("Operating point size does not match the system.");
+    }
+
+    DerivativeStamps stamps(sys.size(), elements);
+    SensitivityResult result;
+    result.frequencies = frequencies.empty() ? std::vector<double>{ 0.0 } : frequencies;
+    result.outputs = outputs;
+    result.elements = stamps.elements;
+    result.responses.assign(result.frequencies.size() * outputs.size(), 0.0);
+    result.values.assign(result.responses.size() * stamps.elements.size(), 0.0);
+
+    FrequencyPattern pattern(sys);
+    auto analysis = std::make_shared<const LUAnalysis>(analyzePattern(pattern.size(), pattern.colPtr(), pattern.rowIdx()));
+
+    if (frequencies.empty()) {
+        SparseMatrix<double> A = pattern.combine(0.0);
+        BlockLU<double> lu(analysis);
+        lu.factorize(A);
+        std::vector<double> x = operatingPoint, lambda;
+        solvePoint(lu, 0.0, sys, stamps, outputs, !x.empty(), x, lambda, result.responses.data(), result.values.data());
+    }
+    else {
+        // Pivots from the first point, the workers only refactor
+        constexpr size_t chunk = 4;
+        SweepFactors factors(pattern, analysis, two_pi * frequencies[0], frequencies.size(), chunk, threads);
+        std::vector<std::vector<std::complex<double>>> xs(factors.lus.size()), lambdas(factors.lus.size());
+        size_t stride = outputs.size() * stamps.elements.size();
+
+        parallelFor(frequencies.size(), chunk, threads, [&](size_t begin, size_t end, unsigned id) {
+            auto& lu = factors.lus[id];
+            auto& A = factors.matrices[id];
+            for (size_t k = begin; k < end; k++) {
+                std::complex<double> s(0.0, two_pi * frequencies[k]);
+                pattern.assemble(s, A);
+                if (!lu.refactor(A)) lu.factorize(A);
+                solvePoint(lu, s, sys, stamps, outputs, false, xs[id], lambdas[id],
+                    result.responses.data() + k * outputs.size(), result.values.data() + k * stride);
+            }
+        });
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
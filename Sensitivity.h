@@ -0,0 +1,38 @@
+#pragma once
+#include "Component.h"
+#include "NumericSystem.h"
+#include <complex>
+#include <memory>
+#include <vector>
+
+// Adjoint sensitivity analysis
+// For (G + s * C) x = b and an output x_o = e_o^T x, the derivative by the value p of one element is
+//   dx_o / dp = λ^T (db/dp - (dG/dp + s * dC/dp) x),   (G + s * C)^T λ = e_o
+// One transposed solve per output on the factors of the forward solve then covers every element, whose
+// term only reads its derivative stamps (CircuitElement::stampDerivative()) at its own rows and columns.
+// Plain transpose, not the conjugate: the derivatives are complex like the response.
+
+// Frequency x output x element, row major
+
+struct SensitivityResult
+{
+	std::vector<double> frequencies; // Hz, a single 0 for DC
+	std::vector<int> outputs;        // MNA unknown of every output, -1 is ground
+	std::vector<int> elements;       // Element ids with a value, in id order
+	std::vector<std::complex<double>> responses; // x_o, frequency x output
+	std::vector<std::complex<double>> values;    // dx_o / dp
+	double seconds = 0;
+
+	std::complex<double> response(size_t point, size_t output) const { return responses[point * outputs.size() + output]; }
+	std::complex<double> at(size_t point, size_t output, size_t element) const {
+		return values[(point * outputs.size() + output) * elements.size() + element];
+	}
+};
+
+// DC sensitivities when `frequencies` is empty, otherwise one AC point per frequency on `threads` workers
+// (0 is one per hardware thread) sharing the ordering and pivots of the first point, as in runACSweep()
+// `operatingPoint` replaces the DC forward solve for circuits with nonlinear devices, sys then holds their
+// linearized stamps (the Newton Jacobian). AC points keep the operating point fixed
+SensitivityResult adjointSensitivity(const NumericSystem& sys, const std::vector<std::shared_ptr<CircuitElement>>& elements,
+	const std::vector<int>& outputs, const std::vector<double>& frequencies = {},
+	const std::vector<double>& operatingPoint = {}, unsigned threads = 0);
@@ -0,0 +1,40 @@
+#include "SolveStats.h"
+#include <sstream>
+
+const char* phaseName(SolvePhase phase) {
+    switch (phase) {
+    case SolvePhase::Preflight: return "preflight";
+    case SolvePhase::Indexing: return "indexing";
+    case SolvePhase::Stamping: return "stamping";
+    case SolvePhase::Assembly: return "assembly";
+    case SolvePhase::Analysis: return "analysis";
+    case SolvePhase::Factorization: return "factorization";
+    case SolvePhase::Update: return "update";
+    case SolvePhase::Solve: return "solve";
+    case SolvePhase::Elimination: return "elimination";
+    case SolvePhase::Substitution: return "substitution";
+    case SolvePhase::Writeback: return "writeback";
+    default: return "unknown";
+    }
+}
+
+void SolveStats::writeJSON(std::ostream& out) const {
+    out << "{\"backend\": \"" << (numeric ? "numeric" : "symbolic") << "\", \"unknowns\": " << unknowns
+        << ", \"stamp_entries\": " << stampEntries << ", \"nonzeros\": " << nonZeros
+        << ", \"factor_nonzeros\": " << factorNonZeros << ", \"domains\": " << domains
+        << ", \"interface\": " << interfaceUnknowns << ", \"subnetworks\": " << subnetworks
+        << ", \"matrix_allocations\": " << matrixAllocations
+        << ", \"matrix_bytes\": " << matrixBytes << ", \"factorizations\": " << factorizations
+        << ", \"updates\": " << updates << ", \"update_rank\": " << updateRank << ", \"iterations\": " << iterations
+        << ", \"stamp_nodes\": " << stampNodes << ", \"result_nodes\": " << resultNodes << ", \"seconds\": {";
+    for (size_t k = 0; k < phaseCount; k++) {
+        out << (k ? ", \"" : "\"") << phaseName(static_cast<SolvePhase>(k)) << "\": " << seconds[k];
+    }
+    out << "}, \"total_seconds\": " << totalSeconds << "}";
+}
+
+std::string SolveStats::toJSON() const {
+    std::ostringstream out;
+    writeJSON(out);
+    return out.str();
+}
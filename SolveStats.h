@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Phases of Circuit::solve, numeric and symbolic paths together
+enum class SolvePhase
+{
+	Preflight,     // Connectivity check before stamping, see Connectivity.h
+	Indexing,      // Branch unknowns and matrix allocation
+	Stamping,      // Element stamps, triplets or GiNaC entries
+	Assembly,      // Triplets to compressed columns
+	Analysis,      // Ordering and block structure
+	Factorization,
+	Update,        // Low rank correction of cached factors, see Incremental.h
+	Solve,         // Triangular solves
+	Elimination,   // Fraction-free symbolic elimination, see SymbolicSolver.h
+	Substitution,  // s = jω into the symbolic solution
+	Writeback,     // Node potentials
+	Count
+};
+
+const char* phaseName(SolvePhase phase);
+
+// Times and counters of the last Circuit::solve, collected while profiling is on
+// Expression sizes walk the GiNaC trees and are only counted then as well
+
+struct SolveStats
+{
+	static constexpr size_t phaseCount = static_cast<size_t>(SolvePhase::Count);
+
+	bool numeric = false;
+	size_t unknowns = 0;
+	size_t stampEntries = 0;      // Numeric triplets, or nonzero entries of the symbolic G
+	size_t nonZeros = 0;          // Assembled numeric matrix
+	size_t factorNonZeros = 0;    // L + U, when this solve factored
+	size_t domains = 0;           // Diagonal blocks of a domain decomposition solve, see DomainSolver.h
+	size_t interfaceUnknowns = 0; // Size of its Schur complement
+	size_t subnetworks = 0;       // Independent parts solved on their own, their phase times add up over the workers
+	size_t matrixAllocations = 0; // System matrices and vectors allocated
+	size_t matrixBytes = 0;       // Their size, GiNaC entries count as one handle each
+	size_t factorizations = 0;
+	size_t updates = 0;
+	size_t updateRank = 0;
+	size_t iterations = 0;        // Krylov iterations, see Krylov.h
+	size_t stampNodes = 0;        // Expression nodes of the symbolic stamps
+	size_t resultNodes = 0;       // Expression nodes of the symbolic solution
+	double seconds[phaseCount] = {};
+	double totalSeconds = 0;
+
+	double phaseSeconds(SolvePhase phase) const { return seconds[static_cast<size_t>(phase)]; }
+
+	void writeJSON(std::ostream& out) const;
+	std::string toJSON() const;
+};
+
+// Adds the time of its scope to one phase, a null stats pointer turns it into a no-op
+class PhaseTimer
+{
+	SolveStats* stats;
+	SolvePhase phase;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	PhaseTimer(SolveStats* target, SolvePhase timed) : stats(target), phase(timed) {
+		if (stats) start = std::chrono::steady_clock::now();
+	}
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator=(const PhaseTimer&) = delete;
+	~PhaseTimer() {
+		if (stats) {
+			stats->seconds[static_cast<size_t>(phase)] +=
+				std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+};
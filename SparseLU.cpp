@@ -0,0 +1,247 @@
+#include "SparseLU.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+// Numeric factorization, one column at a time
+// Column k of L and U comes from a sparse triangular solve L \ A(:, k),
+// the nonzero pattern of that solve is the set of nodes reachable in the graph of L
+
+template <typename T>
+void SparseLU<T>::factorize(const SparseMatrix<T>& A, const std::vector<int>& col_order) {
+    if (A.rows() != A.cols()) {
+        throw std::invalid_argument("SparseLU needs a square matrix.");
+    }
+
+    n = A.rows();
+    if (col_order.empty()) {
+        q.resize(n);
+        for (size_t k = 0; k < n; k++) q[k] = static_cast<int>(k);
+    }
+    else if (col_order.size() == n) {
+        q = col_order;
+    }
+    else {
+        throw std::invalid_argument("Column order size does not match the matrix.");
+    }
+    pinv.assign(n, -1);
+    l_ptr.assign(1, 0);
+    u_ptr.assign(1, 0);
+    l_idx.clear(); l_val.clear();
+    u_idx.clear(); u_val.clear();
+    u_diag.assign(n, T(0));
+    l_idx.reserve(A.nonZeros()); l_val.reserve(A.nonZeros());
+    u_idx.reserve(A.nonZeros()); u_val.reserve(A.nonZeros());
+
+    std::vector<T> x(n, T(0));
+    std::vector<int> marks(n, -1), topo, dfs_stack, dfs_pos;
+    topo.reserve(n);
+
+    const auto& Ap = A.colPtr();
+    const auto& Ai = A.rowIdx();
+    const auto& Ax = A.getValues();
+
+    for (size_t k = 0; k < n; k++) {
+        int col = q[k];
+
+        // Depth first search from every nonzero of A(:, k), post order gives a topological order
+        topo.clear();
+        for (int p = Ap[col]; p < Ap[col + 1]; p++) {
+            int start = Ai[p];
+            if (marks[start] == col) continue;
+            marks[start] = col;
+            dfs_stack.assign(1, start);
+            dfs_pos.assign(1, 0);
+            while (!dfs_stack.empty()) {
+                int i = dfs_stack.back();
+                int J = pinv[i];
+                bool pushed = false;
+                if (J >= 0) {
+                    for (int r = l_ptr[J] + dfs_pos.back(); r < l_ptr[J + 1]; r++) {
+                        dfs_pos.back()++;
+                        int child = l_idx[r];
+                        if (marks[child] != col) {
+                            marks[child] = col;
+                            dfs_stack.push_back(child);
+                            dfs_pos.push_back(0);
+                            pushed = true;
+                            break;
+                        }
+                    }
+                }
+                if (!pushed) {
+                    topo.push_back(i);
+                    dfs_stack.pop_back();
+                    dfs_pos.pop_back();
+                }
+            }
+        }
+
+        // Scatter A(:, k) and eliminate with the already computed columns of L
+        for (int p = Ap[col]; p < Ap[col + 1]; p++) x[Ai[p]] += Ax[p];
+        for (auto it = topo.rbegin(); it != topo.rend(); ++it) {
+            int j = *it;
+            int J = pinv[j];
+            if (J < 0) continue;
+            T xj = x[j];
+            for (int r = l_ptr[J]; r < l_ptr[J + 1]; r++) {
+                x[l_idx[r]] -= l_val[r] * xj;
+            }
+        }
+
+        // Pick the pivot among the rows not yet pivoted, store the rest of the column in U
+        int ipiv = -1;
+        double largest = -1;
+        for (int i : topo) {
+            if (pinv[i] < 0) {
+                double mag = std::abs(x[i]);
+                if (mag > largest) {
+                    largest = mag;
+                    ipiv = i;
+                }
+            }
+            else {
+                u_idx.push_back(pinv[i]);
+                u_val.push_back(x[i]);
+            }
+        }
+        if (ipiv == -1 || largest <= 0) {
+            throw std::runtime_error("Singular matrix, no pivot in column " + std::to_string(k) + ".");
+        }
+        if (pinv[col] < 0 && marks[col] == col && std::abs(x[col]) >= pivot_tolerance * largest) {
+            ipiv = col; // Diagonal pivoting keeps MNA fill low
+        }
+
+        T pivot = x[ipiv];
+        u_diag[k] = pivot;
+        pinv[ipiv] = static_cast<int>(k);
+
+        for (int i : topo) {
+            if (pinv[i] < 0) {
+                l_idx.push_back(i);
+                l_val.push_back(x[i] / pivot);
+            }
+            x[i] = T(0);
+        }
+        l_ptr.push_back(static_cast<int>(l_idx.size()));
+        u_ptr.push_back(static_cast<int>(u_idx.size()));
+    }
+
+    // Renumber L rows into pivot order
+    for (auto& i : l_idx) i = pinv[i];
+
+    // Sort U columns by row, refactor() eliminates in that order
+    std::vector<std::pair<int, T>> column;
+    for (size_t k = 0; k < n; k++) {
+        column.clear();
+        for (int p = u_ptr[k]; p < u_ptr[k + 1]; p++) column.emplace_back(u_idx[p], u_val[p]);
+        std::sort(column.begin(), column.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (int p = u_ptr[k]; p < u_ptr[k + 1]; p++) {
+            u_idx[p] = column[p - u_ptr[k]].first;
+            u_val[p] = column[p - u_ptr[k]].second;
+        }
+    }
+}
+
+template <typename T>
+bool SparseLU<T>::refactor(const SparseMatrix<T>& A) {
+    if (A.rows() != n || A.cols() != n) {
+        throw std::invalid_argument("Refactor needs the matrix of the last factorization.");
+    }
+
+    const auto& Ap = A.colPtr();
+    const auto& Ai = A.rowIdx();
+    const auto& Ax = A.getValues();
+    std::vector<T> x(n, T(0)); // Indexed by pivot row
+
+    for (size_t k = 0; k < n; k++) {
+        int col = q[k];
+        double largest = 0;
+        for (int p = Ap[col]; p < Ap[col + 1]; p++) x[pinv[Ai[p]]] += Ax[p];
+
+        // U(:, k) in increasing row order, each row is final before it is used
+        for (int p = u_ptr[k]; p < u_ptr[k + 1]; p++) {
+            int j = u_idx[p];
+            T xj = x[j];
+            u_val[p] = xj;
+            x[j] = T(0);
+            for (int r = l_ptr[j]; r < l_ptr[j + 1]; r++) x[l_idx[r]] -= l_val[r] * xj;
+        }
+
+        T pivot = x[k];
+        x[k] = T(0);
+        for (int p = l_ptr[k]; p < l_ptr[k + 1]; p++) {
+            double mag = std::abs(x[l_idx[p]]);
+            if (mag > largest) largest = mag;
+        }
+        if (std::abs(pivot) == 0 || std::abs(pivot) < 1e-3 * pivot_tolerance * largest) {
+            return false;
+        }
+
+        u_diag[k] = pivot;
+        for (int p = l_ptr[k]; p < l_ptr[k + 1]; p++) {
+            l_val[p] = x[l_idx[p]] / pivot;
+            x[l_idx[p]] = T(0);
+        }
+    }
+
+    return true;
+}
+
+template <typename T>
+void SparseLU<T>::solve(std::vector<T>& b) const {
+    if (b.size() != n) {
+        throw std::invalid_argument("Right hand side size does not match the factorization.");
+    }
+
+    std::vector<T> x(n);
+    for (size_t i = 0; i < n; i++) x[pinv[i]] = b[i];
+
+    // L * y = P * b
+    for (size_t k = 0; k < n; k++) {
+        T xk = x[k];
+        for (int p = l_ptr[k]; p < l_ptr[k + 1]; p++) x[l_idx[p]] -= l_val[p] * xk;
+    }
+
+    // U * z = y
+    for (size_t k = n; k-- > 0;) {
+        x[k] /= u_diag[k];
+        T xk = x[k];
+        for (int p = u_ptr[k]; p < u_ptr[k + 1]; p++) x[u_idx[p]] -= u_val[p] * xk;
+    }
+
+    // Undo the column order
+    for (size_t k = 0; k < n; k++) b[q[k]] = x[k];
+}
+
+// A^T = Q * U^T * L^T * P: U^T is lower triangular, L^T upper with unit diagonal, both read by columns of U and L
+
+template <typename T>
+void SparseLU<T>::solveTransposed(std::vector<T>& b) const {
+    if (b.size() != n) {
+        throw std::invalid_argument("Right hand side size does not match the factorization.");
+    }
+
+    std::vector<T> x(n);
+    for (size_t k = 0; k < n; k++) x[k] = b[q[k]];
+
+    // U^T * z = Q^T * b
+    for (size_t k = 0; k < n; k++) {
+        T sum = x[k];
+        for (int p = u_ptr[k]; p < u_ptr[k + 1]; p++) sum -= u_val[p] * x[u_idx[p]];
+        x[k] = sum / u_diag[k];
+    }
+
+    // L^T * y = z
+    for (size_t k = n; k-- > 0;) {
+        T sum = x[k];
+        for (int p = l_ptr[k]; p < l_ptr[k + 1]; p++) sum -= l_val[p] * x[l_idx[p]];
+        x[k] = sum;
+    }
+
+    for (size_t i = 0; i < n; i++) b[i] = x[pinv[i]];
+}
+
+template class SparseLU<double>;
+template class SparseLU<std::complex<double>>;
@@ -0,0 +1,53 @@
+#pragma once
+#include "SparseMatrix.h"
+#include <vector>
+#include <complex>
+
+// Left-looking sparse LU with partial pivoting (Gilbert-Peierls)
+// P * A * Q = L * U, L has unit diagonal and is stored without it
+// Q is a fill-reducing column order given by the caller, see Ordering.h
+
+// Pivot sequence and factor patterns, enough to replay the elimination on other values (see MonteCarlo.cpp)
+
+struct LUPattern
+{
+	size_t n = 0;
+	std::vector<int> pinv, q;
+	std::vector<int> l_ptr, l_idx, u_ptr, u_idx; // l_idx in pivot order, U columns sorted by row
+};
+
+template <typename T>
+class SparseLU
+{
+	size_t n = 0;
+	std::vector<int> pinv; // Row i of A is pivot row pinv[i]
+	std::vector<int> q;    // Column k of the factors is column q[k] of A
+	std::vector<int> l_ptr, l_idx, u_ptr, u_idx;
+	std::vector<T> l_val, u_val, u_diag;
+	double pivot_tolerance = 0.1; // Prefer the diagonal if it is within this fraction of the largest candidate
+
+public:
+	SparseLU() = default;
+
+	void setPivotTolerance(double tol) { pivot_tolerance = tol; }
+
+	// Throws std::runtime_error if the matrix is singular
+	// An empty column order means the natural one
+	void factorize(const SparseMatrix<T>& A, const std::vector<int>& col_order = {});
+
+	// Numeric refactorization of a matrix with the same pattern as the last factorize()
+	// Reuses the pivot sequence and the patterns of L and U, no graph search or pivot search
+	// Returns false if a reused pivot became too small, factorize() again in that case
+	bool refactor(const SparseMatrix<T>& A);
+
+	// Solves A * x = b in place
+	void solve(std::vector<T>& b) const;
+
+	// Solves A^T * x = b in place, plain transpose for complex T (adjoint systems, see Sensitivity.h)
+	void solveTransposed(std::vector<T>& b) const;
+
+	LUPattern pattern() const { return { n, pinv, q, l_ptr, l_idx, u_ptr, u_idx }; }
+
+	size_t size() const { return n; }
+	size_t factorNonZeros() const { return l_val.size() + u_val.size() + u_diag.size(); }
+};
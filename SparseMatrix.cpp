@@ -0,0 +1,183 @@
+#include "SparseMatrix.h"
+#include "Parallel.h"
+#include <stdexcept>
+
+// Build CSC storage from triplets
+// Counting sort by column, then duplicates inside each column are merged
+
+template <typename T>
+SparseMatrix<T> SparseMatrix<T>::fromTriplets(const TripletMatrix<T>& triplets) {
+    SparseMatrix<T> A(triplets.rows(), triplets.cols());
+    size_t nz = triplets.entries();
+
+    std::vector<int> count(A.n_cols + 1, 0);
+    for (size_t k = 0; k < nz; k++) {
+        if (triplets.row(k) >= static_cast<int>(A.n_rows) || triplets.col(k) >= static_cast<int>(A.n_cols)) {
+            throw std::out_of_range("Triplet index outside of the matrix.");
+        }
+        count[triplets.col(k) + 1]++;
+    }
+    for (size_t j = 0; j < A.n_cols; j++) count[j + 1] += count[j];
+
+    std::vector<int> rows(nz);
+    std::vector<T> vals(nz);
+    std::vector<int> next(count.begin(), count.end() - 1);
+    for (size_t k = 0; k < nz; k++) {
+        int p = next[triplets.col(k)]++;
+        rows[p] = triplets.row(k);
+        vals[p] = triplets.value(k);
+    }
+
+    // Sum duplicates, marker remembers where a row was last written in the current column
+    std::vector<int> marker(A.n_rows, -1);
+    A.row_idx.reserve(nz);
+    A.values.reserve(nz);
+    for (size_t j = 0; j < A.n_cols; j++) {
+        int start = static_cast<int>(A.values.size());
+        for (int p = count[j]; p < count[j + 1]; p++) {
+            int i = rows[p];
+            if (marker[i] >= start) {
+                A.values[marker[i]] += vals[p];
+            }
+            else {
+                marker[i] = static_cast<int>(A.values.size());
+                A.row_idx.push_back(i);
+                A.values.push_back(vals[p]);
+            }
+        }
+        A.col_ptr[j + 1] = static_cast<int>(A.values.size());
+    }
+
+    return A;
+}
+
+namespace {
+
+constexpr size_t parallel_min_entries = 1 << 16; // Below this the serial build wins
+constexpr size_t triplet_chunk = 1 << 15;
+
+} // namespace
+
+// Parallel build, bit for bit the serial result
+// Triplets are bucketed by column block with a stable scatter (per chunk histograms, block major prefix
+// sums), so every block sees its triplets in their original order. Each block then runs the serial
+// counting sort and duplicate merge on its own columns, which keeps the order of the additions.
+
+template <typename T>
+SparseMatrix<T> SparseMatrix<T>::fromTriplets(const TripletMatrix<T>& triplets, unsigned threads) {
+    if (threads == 0) threads = hardwareThreads();
+    size_t nz = triplets.entries(), n_rows = triplets.rows(), n_cols = triplets.cols();
+    if (threads <= 1 || nz < parallel_min_entries || n_cols < threads) return fromTriplets(triplets);
+
+    size_t blocks = std::min<size_t>(n_cols, threads * 4);
+    std::vector<size_t> first_col(blocks + 1);
+    std::vector<int> block_of(n_cols);
+    for (size_t b = 0; b <= blocks; b++) first_col[b] = b * n_cols / blocks;
+    for (size_t b = 0; b < blocks; b++) {
+        std::fill(block_of.begin() + first_col[b], block_of.begin() + first_col[b + 1], static_cast<int>(b));
+    }
+
+    size_t chunks = (nz + triplet_chunk - 1) / triplet_chunk;
+    std::vector<size_t> next(chunks * blocks, 0); // Counts, then scatter positions, per chunk and block
+    parallelFor(nz, triplet_chunk, threads, [&](size_t begin, size_t end, unsigned) {
+        size_t* count = &next[begin / triplet_chunk * blocks];
+        for (size_t k = begin; k < end; k++) {
+            if (triplets.row(k) >= static_cast<int>(n_rows) || triplets.col(k) >= static_cast<int>(n_cols)) {
+                throw std::out_of_range("Triplet index outside of the matrix.");
+            }
+            count[block_of[triplets.col(k)]]++;
+        }
+    });
+
+    std::vector<size_t> block_start(blocks + 1, 0);
+    size_t total = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        block_start[b] = total;
+        for (size_t c = 0; c < chunks; c++) {
+            size_t count = next[c * blocks + b];
+            next[c * blocks + b] = total;
+            total += count;
+        }
+    }
+    block_start[blocks] = total;
+
+    std::vector<int> rows(nz), cols(nz);
+    std::vector<T> vals(nz);
+    parallelFor(nz, triplet_chunk, threads, [&](size_t begin, size_t end, unsigned) {
+        size_t* position = &next[begin / triplet_chunk * blocks];
+        for (size_t k = begin; k < end; k++) {
+            size_t p = position[block_of[triplets.col(k)]]++;
+            rows[p] = triplets.row(k);
+            cols[p] = triplets.col(k);
+            vals[p] = triplets.value(k);
+        }
+    });
+
+    // Blocks own disjoint columns, so the per column counts go straight into col_ptr
+    // Every worker keeps one row marker; it takes blocks in increasing order, so positions only grow
+    SparseMatrix<T> A(n_rows, n_cols);
+    std::vector<std::vector<int>> part_rows(blocks);
+    std::vector<std::vector<T>> part_vals(blocks);
+    std::vector<std::vector<int>> markers(std::min<size_t>(threads, blocks));
+    parallelFor(blocks, 1, threads, [&](size_t b, size_t, unsigned worker) {
+        auto& marker = markers[worker];
+        if (marker.empty()) marker.assign(n_rows, -1);
+        size_t c0 = first_col[b], width = first_col[b + 1] - c0;
+        size_t lo = block_start[b], hi = block_start[b + 1];
+
+        std::vector<size_t> count(width + 1, 0);
+        for (size_t p = lo; p < hi; p++) count[cols[p] - c0 + 1]++;
+        for (size_t j = 0; j < width; j++) count[j + 1] += count[j];
+        std::vector<int> sorted_rows(hi - lo);
+        std::vector<T> sorted_vals(hi - lo);
+        std::vector<size_t> slot(count.begin(), count.end() - 1);
+        for (size_t p = lo; p < hi; p++) {
+            size_t q = slot[cols[p] - c0]++;
+            sorted_rows[q] = rows[p];
+            sorted_vals[q] = vals[p];
+        }
+
+        auto& out_rows = part_rows[b];
+        auto& out_vals = part_vals[b];
+        out_rows.reserve(hi - lo);
+        out_vals.reserve(hi - lo);
+        for (size_t j = 0; j < width; j++) {
+            int start = static_cast<int>(lo + out_vals.size());
+            for (size_t q = count[j]; q < count[j + 1]; q++) {
+                int i = sorted_rows[q];
+                if (marker[i] >= start) {
+                    out_vals[marker[i] - lo] += sorted_vals[q];
+                }
+                else {
+                    marker[i] = static_cast<int>(lo + out_vals.size());
+                    out_rows.push_back(i);
+                    out_vals.push_back(sorted_vals[q]);
+                }
+            }
+            A.col_ptr[c0 + j + 1] = static_cast<int>(lo + out_vals.size()) - start;
+        }
+    });
+
+    for (size_t j = 0; j < n_cols; j++) A.col_ptr[j + 1] += A.col_ptr[j];
+    A.row_idx.resize(A.col_ptr[n_cols]);
+    A.values.resize(A.col_ptr[n_cols]);
+    parallelFor(blocks, 1, threads, [&](size_t b, size_t, unsigned) {
+        int at = A.col_ptr[first_col[b]];
+        std::copy(part_rows[b].begin(), part_rows[b].end(), A.row_idx.begin() + at);
+        std::copy(part_vals[b].begin(), part_vals[b].end(), A.values.begin() + at);
+    });
+    return A;
+}
+
+template <typename T>
+void SparseMatrix<T>::multiply(const std::vector<T>& x, std::vector<T>& y) const {
+    y.assign(n_rows, T(0));
+    for (size_t j = 0; j < n_cols; j++) {
+        for (int p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+            y[row_idx[p]] += values[p] * x[j];
+        }
+    }
+}
+
+template class SparseMatrix<double>;
+template class SparseMatrix<std::complex<double>>;
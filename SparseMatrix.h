@@ -0,0 +1,89 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <complex>
+#include <cstddef>
+#include <utility>
+
+// Coordinate (triplet) storage used while stamping
+// Entries on the ground node (idx == -1) are dropped, so stamps don't need to check for it
+
+template <typename T>
+class TripletMatrix
+{
+	size_t n_rows = 0, n_cols = 0;
+	std::vector<int> row_idx, col_idx;
+	std::vector<T> values;
+
+public:
+	TripletMatrix() = default;
+	TripletMatrix(size_t rows, size_t cols) : n_rows(rows), n_cols(cols) {}
+
+	void add(int row, int col, T value) {
+		if (row < 0 || col < 0) return; // Ground
+		row_idx.push_back(row);
+		col_idx.push_back(col);
+		values.push_back(value);
+	}
+
+	void resize(size_t rows, size_t cols) { n_rows = rows; n_cols = cols; }
+	void reserve(size_t nnz) { row_idx.reserve(nnz); col_idx.reserve(nnz); values.reserve(nnz); }
+	void clear() { row_idx.clear(); col_idx.clear(); values.clear(); }
+
+	// Merging stamp buffers: size the storage once, then every part is copied to its own offset
+	void resizeEntries(size_t nnz) { row_idx.resize(nnz); col_idx.resize(nnz); values.resize(nnz); }
+	void place(size_t offset, const TripletMatrix& part) {
+		std::copy(part.row_idx.begin(), part.row_idx.end(), row_idx.begin() + offset);
+		std::copy(part.col_idx.begin(), part.col_idx.end(), col_idx.begin() + offset);
+		std::copy(part.values.begin(), part.values.end(), values.begin() + offset);
+	}
+	void place(size_t offset, const TripletMatrix& part, size_t begin, size_t end) { // Entries begin .. end - 1 of part
+		std::copy(part.row_idx.begin() + begin, part.row_idx.begin() + end, row_idx.begin() + offset);
+		std::copy(part.col_idx.begin() + begin, part.col_idx.begin() + end, col_idx.begin() + offset);
+		std::copy(part.values.begin() + begin, part.values.begin() + end, values.begin() + offset);
+	}
+
+	size_t rows() const { return n_rows; }
+	size_t cols() const { return n_cols; }
+	size_t entries() const { return values.size(); }
+
+	int row(size_t k) const { return row_idx[k]; }
+	int col(size_t k) const { return col_idx[k]; }
+	T value(size_t k) const { return values[k]; }
+};
+
+// Compressed sparse column matrix, duplicate triplets are summed
+
+template <typename T>
+class SparseMatrix
+{
+	size_t n_rows = 0, n_cols = 0;
+	std::vector<int> col_ptr, row_idx;
+	std::vector<T> values;
+
+public:
+	SparseMatrix() = default;
+	SparseMatrix(size_t rows, size_t cols) : n_rows(rows), n_cols(cols), col_ptr(cols + 1, 0) {}
+
+	// Fixed pattern with zero values, filled in later through getValues()
+	SparseMatrix(size_t rows, size_t cols, std::vector<int> ptr, std::vector<int> idx)
+		: n_rows(rows), n_cols(cols), col_ptr(std::move(ptr)), row_idx(std::move(idx)), values(row_idx.size(), T(0)) {}
+
+	static SparseMatrix fromTriplets(const TripletMatrix<T>& triplets);
+
+	// Same result bit for bit, sorted and summed in parallel over column blocks
+	// threads = 0 is one per hardware thread
+	static SparseMatrix fromTriplets(const TripletMatrix<T>& triplets, unsigned threads);
+
+	size_t rows() const { return n_rows; }
+	size_t cols() const { return n_cols; }
+	size_t nonZeros() const { return values.size(); }
+
+	const std::vector<int>& colPtr() const { return col_ptr; }
+	const std::vector<int>& rowIdx() const { return row_idx; }
+	const std::vector<T>& getValues() const { return values; }
+	std::vector<T>& getValues() { return values; }
+
+	// y = A * x
+	void multiply(const std::vector<T>& x, std::vector<T>& y) const;
+};
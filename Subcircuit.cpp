@@ -0,0 +1,342 @@
+#include "Subcircuit.h"
+#include "BlockLU.h"
+#include "SymbolicSolver.h"
+#include <optional>
+#include <stdexcept>
+
+SubcircuitDefinition::SubcircuitDefinition(std::string def_name, Circuit inner, std::vector<std::shared_ptr<Node>> port_nodes)
+    : name(std::move(def_name)), circuit(std::move(inner)), ports(std::move(port_nodes)) {
+    const auto& nodes = circuit.getTopology().nodeHandles();
+    for (const auto& port : ports) {
+        if (!port) throw std::invalid_argument("Subcircuit " + name + " has a null port.");
+        int idx = port->getIndex();
+        if (idx == -1) throw std::invalid_argument("Ground can't be a port of subcircuit " + name + ".");
+        if (idx < 0 || idx >= static_cast<int>(nodes.size()) || nodes[idx] != port) {
+            throw std::invalid_argument("Port " + port->getSym() + " is not a node of subcircuit " + name + ".");
+        }
+        for (const auto& other : ports) {
+            if (&other != &port && other == port) throw std::invalid_argument("Port " + port->getSym() + " is listed twice.");
+        }
+    }
+}
+
+bool SubcircuitDefinition::isNumeric() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return circuit.hasNumericValues();
+}
+
+// Ports first, internal unknowns get positions in inner order
+// The pattern comes from the numeric stamps when there are numbers, from the GiNaC ones otherwise
+
+const SubcircuitDefinition::Layout& SubcircuitDefinition::currentLayout() const {
+    auto& topology = *circuit.topology;
+    size_t revision = topology.revision(), values = topology.valueRevision();
+    if (layout.valid && layout.revision == revision && layout.values == values) return layout;
+
+    for (const auto& element : topology.elementHandles()) {
+        if (std::dynamic_pointer_cast<NonlinearDevice>(element)) {
+            throw std::logic_error("Subcircuit " + name + " holds nonlinear devices, add them to the outer circuit.");
+        }
+    }
+
+    Layout l;
+    l.valid = true;
+    l.revision = revision;
+    l.values = values;
+
+    // No GiNaC object on the numeric path, instances stamp from the assembly threads (even the default
+    // constructed matrix copies the shared zero)
+    bool numeric = circuit.hasNumericValues();
+    std::unique_ptr<NumericSystem> sys;
+    std::optional<matrix> G;
+    size_t n;
+    if (numeric) {
+        sys = std::make_unique<NumericSystem>(circuit.stampNumeric());
+        n = sys->size();
+    }
+    else {
+        G.emplace();
+        matrix I;
+        circuit.stampSymbolic(*G, I, AnalysisType::AC);
+        n = G->rows();
+    }
+
+    std::vector<int> port_of(n, -1);
+    for (size_t p = 0; p < ports.size(); p++) port_of[ports[p]->getIndex()] = static_cast<int>(p);
+    l.local.resize(n);
+    for (size_t i = 0; i < n; i++) l.local[i] = port_of[i] >= 0 ? -1 - port_of[i] : static_cast<int>(l.internal++);
+
+    // A_II has to be structurally nonsingular for the port model
+    TripletMatrix<double> pattern(l.internal, l.internal);
+    auto internal = [&](int row, int col) {
+        if (l.local[row] >= 0 && l.local[col] >= 0) pattern.add(l.local[row], l.local[col], 1.0);
+    };
+    bool ports_only_c = true;
+    if (numeric) {
+        for (size_t k = 0; k < sys->G.entries(); k++) internal(sys->G.row(k), sys->G.col(k));
+        for (size_t k = 0; k < sys->C.entries(); k++) {
+            internal(sys->C.row(k), sys->C.col(k));
+            if (l.local[sys->C.row(k)] >= 0 || l.local[sys->C.col(k)] >= 0) ports_only_c = false;
+        }
+    }
+    else {
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                if (!(*G)(i, j).is_zero()) internal(static_cast<int>(i), static_cast<int>(j));
+            }
+        }
+    }
+    auto A = SparseMatrix<double>::fromTriplets(pattern);
+    l.reduced = ports_only_c && !analyzePattern(l.internal, A.colPtr(), A.rowIdx()).isStructurallySingular();
+
+    if (numeric) {
+        if (l.reduced) reduceNumeric(l, *sys);
+        if (!l.reduced) l.inner = std::move(sys);
+    }
+
+    layout = std::move(l);
+    return layout;
+}
+
+// Dense port block, one solve with the internal factors per port and one for b_I
+// A numerically singular A_II falls back to the whole inner system
+
+void SubcircuitDefinition::reduceNumeric(Layout& l, const NumericSystem& sys) const {
+    size_t P = ports.size(), m = l.internal;
+    l.Y.assign(P * P, 0.0);
+    l.C.assign(P * P, 0.0);
+    l.J.assign(P, 0.0);
+
+    struct Coupling { int port, internal; double value; };
+    std::vector<Coupling> api;                        // A_PI
+    std::vector<std::vector<std::pair<int, double>>> aip(P); // A_IP by port column
+    TripletMatrix<double> aii(m, m);
+    for (size_t k = 0; k < sys.G.entries(); k++) {
+        int r = l.local[sys.G.row(k)], c = l.local[sys.G.col(k)];
+        double v = sys.G.value(k);
+        if (r < 0 && c < 0) l.Y[(-1 - r) * P + (-1 - c)] += v;
+        else if (r < 0) api.push_back({ -1 - r, c, v });
+        else if (c < 0) aip[-1 - c].emplace_back(r, v);
+        else aii.add(r, c, v);
+    }
+    for (size_t k = 0; k < sys.C.entries(); k++) {
+        l.C[(-1 - l.local[sys.C.row(k)]) * P + (-1 - l.local[sys.C.col(k)])] += sys.C.value(k);
+    }
+    std::vector<double> b(m, 0.0);
+    for (size_t i = 0; i < sys.size(); i++) {
+        if (l.local[i] < 0) l.J[-1 - l.local[i]] += sys.rhs[i];
+        else b[l.local[i]] = sys.rhs[i];
+    }
+    if (m == 0) return;
+
+    BlockLU<double> lu;
+    try {
+        auto A = SparseMatrix<double>::fromTriplets(aii);
+        lu.analyze(A);
+        lu.factorize(A);
+    }
+    catch (const std::runtime_error&) {
+        l.reduced = false;
+        return;
+    }
+
+    std::vector<double> x(m);
+    for (size_t q = 0; q < P; q++) {
+        std::fill(x.begin(), x.end(), 0.0);
+        for (const auto& entry : aip[q]) x[entry.first] += entry.second;
+        lu.solve(x);
+        for (const auto& c : api) l.Y[c.port * P + q] -= c.value * x[c.internal];
+    }
+    lu.solve(b);
+    for (const auto& c : api) l.J[c.port] -= c.value * b[c.internal];
+}
+
+std::pair<size_t, size_t> SubcircuitDefinition::revisions() const {
+    const auto& topology = *circuit.topology;
+    return { topology.revision(), topology.valueRevision() };
+}
+
+size_t SubcircuitDefinition::extraUnknowns() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Layout& l = currentLayout();
+    return l.reduced ? 0 : l.internal;
+}
+
+// Symbolic port model, A_II is solved once per port column with the fraction-free solver,
+// only for the internal unknowns that couple back to a port
+
+void SubcircuitDefinition::stamp(matrix& G, matrix& I, AnalysisType analysis, const std::vector<int>& terminals, int branch) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Layout& l = currentLayout();
+    auto outer = [&](int i) { return l.local[i] < 0 ? terminals[-1 - l.local[i]] : branch + l.local[i]; };
+
+    if (!l.reduced) {
+        matrix Gi, Ii;
+        circuit.stampSymbolic(Gi, Ii, analysis);
+        for (size_t i = 0; i < Gi.rows(); i++) {
+            int r = outer(static_cast<int>(i));
+            if (r < 0) continue;
+            for (size_t j = 0; j < Gi.cols(); j++) {
+                int c = outer(static_cast<int>(j));
+                if (c >= 0 && !Gi(i, j).is_zero()) G(r, c) += Gi(i, j);
+            }
+            if (!Ii(i, 0).is_zero()) I(r, 0) += Ii(i, 0);
+        }
+        return;
+    }
+
+    SymbolicModel& model = symbolic[analysis == AnalysisType::DC ? 0 : 1];
+    if (!model.valid || model.revision != l.revision || model.values != l.values) {
+        matrix Gi, Ii;
+        circuit.stampSymbolic(Gi, Ii, analysis);
+        size_t n = Gi.rows(), P = ports.size(), m = l.internal;
+
+        matrix Y(P, P), J(P, 1), Aii(m, m), bi(m, 1);
+        std::vector<int> coupled; // Internal unknowns with an entry in A_PI
+        std::vector<char> seen(m, 0);
+        std::vector<size_t> inner_of(m);
+        for (size_t i = 0; i < n; i++) {
+            if (l.local[i] >= 0) inner_of[l.local[i]] = i;
+        }
+        for (size_t i = 0; i < n; i++) {
+            int r = l.local[i];
+            for (size_t j = 0; j < n; j++) {
+                int c = l.local[j];
+                if (Gi(i, j).is_zero()) continue;
+                if (r < 0 && c < 0) Y(-1 - r, -1 - c) = Gi(i, j);
+                else if (r >= 0 && c >= 0) Aii(r, c) = Gi(i, j);
+                else if (r < 0 && !seen[c]) {
+                    seen[c] = 1;
+                    coupled.push_back(c);
+                }
+            }
+            if (r < 0) J(-1 - r, 0) = Ii(i, 0);
+            else bi(r, 0) = Ii(i, 0);
+        }
+
+        // x = A_II^-1 * rhs on the coupled unknowns, then subtract A_PI * x from column `col` of the model
+        auto eliminate = [&](const matrix& rhs, matrix& target, size_t col) {
+            if (coupled.empty()) return;
+            SymbolicSolver solver(Aii, rhs);
+            std::vector<ex> x = solver.solve(coupled);
+            for (size_t i = 0; i < n; i++) {
+                if (l.local[i] >= 0) continue;
+                ex sum = 0;
+                for (size_t k = 0; k < coupled.size(); k++) {
+                    const ex& a = Gi(i, inner_of[coupled[k]]);
+                    if (!a.is_zero()) sum += a * x[k];
+                }
+                size_t p = -1 - l.local[i];
+                target(p, col) = normal(target(p, col) - sum);
+            }
+        };
+        for (size_t q = 0; q < P; q++) {
+            matrix column(m, 1);
+            int j = ports[q]->getIndex();
+            for (size_t i = 0; i < n; i++) {
+                if (l.local[i] >= 0) column(l.local[i], 0) = Gi(i, j);
+            }
+            eliminate(column, Y, q);
+        }
+        bool sources = false;
+        for (size_t r = 0; r < m; r++) sources = sources || !bi(r, 0).is_zero();
+        if (sources) eliminate(bi, J, 0);
+
+        model = { true, l.revision, l.values, Y, J };
+    }
+
+    size_t P = ports.size();
+    for (size_t p = 0; p < P; p++) {
+        int r = terminals[p];
+        if (r < 0) continue;
+        for (size_t q = 0; q < P; q++) {
+            int c = terminals[q];
+            if (c >= 0 && !model.Y(p, q).is_zero()) G(r, c) += model.Y(p, q);
+        }
+        if (!model.J(p, 0).is_zero()) I(r, 0) += model.J(p, 0);
+    }
+}
+
+void SubcircuitDefinition::stampNumeric(NumericSystem& sys, const std::vector<int>& terminals, int branch) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Layout& l = currentLayout();
+    if (!l.inner && !l.reduced) throw std::logic_error("Subcircuit " + name + " has symbolic values.");
+
+    if (l.reduced) {
+        size_t P = ports.size();
+        for (size_t p = 0; p < P; p++) {
+            for (size_t q = 0; q < P; q++) {
+                if (l.Y[p * P + q] != 0.0) sys.G.add(terminals[p], terminals[q], l.Y[p * P + q]);
+                if (l.C[p * P + q] != 0.0) sys.C.add(terminals[p], terminals[q], l.C[p * P + q]);
+            }
+            sys.addRHS(terminals[p], l.J[p]);
+        }
+        return;
+    }
+
+    auto outer = [&](int i) { return l.local[i] < 0 ? terminals[-1 - l.local[i]] : branch + l.local[i]; };
+    const NumericSystem& inner = *l.inner;
+    for (size_t k = 0; k < inner.G.entries(); k++) sys.G.add(outer(inner.G.row(k)), outer(inner.G.col(k)), inner.G.value(k));
+    for (size_t k = 0; k < inner.C.entries(); k++) sys.C.add(outer(inner.C.row(k)), outer(inner.C.col(k)), inner.C.value(k));
+    for (size_t i = 0; i < inner.size(); i++) sys.addRHS(outer(static_cast<int>(i)), inner.rhs[i]);
+}
+
+Subcircuit::Subcircuit(const std::string& sym, std::shared_ptr<const SubcircuitDefinition> def,
+    std::vector<std::shared_ptr<Node>> nodes)
+    : symbol("X" + sym), definition(std::move(def)), terminals(std::move(nodes)) {
+    if (!definition) throw std::invalid_argument("Subcircuit " + symbol + " needs a definition.");
+    for (const auto& node : terminals) {
+        if (!node) throw std::invalid_argument("Subcircuit " + symbol + " has an unconnected port.");
+    }
+    if (terminals.size() != definition->portCount()) {
+        throw std::invalid_argument("Subcircuit " + symbol + " connects " + std::to_string(terminals.size()) +
+            " nodes to " + std::to_string(definition->portCount()) + " ports of " + definition->getName() + ".");
+    }
+}
+
+void Subcircuit::setTerminal(size_t port, std::shared_ptr<Node> node) {
+    if (!node) throw std::invalid_argument("Subcircuit " + symbol + " has an unconnected port.");
+    terminals.at(port) = std::move(node);
+    terminalsChanged();
+}
+
+namespace {
+
+std::vector<int> indicesOf(const std::vector<std::shared_ptr<Node>>& nodes) {
+    std::vector<int> result;
+    result.reserve(nodes.size());
+    for (const auto& node : nodes) result.push_back(node->getIndex());
+    return result;
+}
+
+} // namespace
+
+// The outer circuit counts branches before every stamp and before it takes the changed elements, so an
+// inner change found here reaches its incremental solver: new values update the instance's columns, a new
+// inner structure or unknown count is a terminal change and refactors
+
+void Subcircuit::syncDefinition() const {
+    auto [structure, values] = definition->revisions();
+    size_t extra = definition->extraUnknowns();
+    if (synced) {
+        if (structure != structure_seen || extra != extra_seen) terminalsChanged();
+        else if (values != values_seen) valuesChanged();
+    }
+    synced = true;
+    structure_seen = structure;
+    values_seen = values;
+    extra_seen = extra;
+}
+
+size_t Subcircuit::branchCount() const {
+    syncDefinition();
+    return extra_seen;
+}
+
+void Subcircuit::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
+    definition->stamp(G, I, analysis, indicesOf(terminals), getBranchIndex());
+}
+
+void Subcircuit::stampNumeric(NumericSystem& sys) const {
+    definition->stampNumeric(sys, indicesOf(terminals), getBranchIndex());
+}
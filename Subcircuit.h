@@ -0,0 +1,104 @@
+#pragma once
+#include "Circuit.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <ginac/ginac.h>
+
+using namespace GiNaC;
+
+// One subcircuit definition, shared by all of its instances
+// The inner circuit is reduced to its ports once, A = [A_PP A_PI; A_IP A_II] gives
+//   Y = A_PP - A_PI * A_II^-1 * A_IP,   J = b_P - A_PI * A_II^-1 * b_I
+// so an instance stamps a port sized admittance block (and J as port currents) instead of the inner circuit.
+// The symbolic model is exact in s. The numeric one reduces G and needs C on the ports only. Inner circuits
+// that can't be reduced (C on internal nodes, or A_II singular, e.g. a source tied to a port) are stamped
+// whole, as extra unknowns of every instance. Models are cached per analysis type and rebuilt when the
+// inner circuit changes, each instance then reports a value or terminal change to its outer circuit, so
+// incremental solves don't keep factors of the old model. The inner ground is the ground of the outer circuit, as in SPICE.
+
+class SubcircuitDefinition
+{
+	// Inner unknowns, decided once for both backends so branchCount() agrees with the stamps
+	struct Layout
+	{
+		bool valid = false;
+		size_t revision = 0, values = 0;
+		std::vector<int> local; // Inner unknown -> -1 - port, or its position among the internal unknowns
+		size_t internal = 0;
+		bool reduced = false;   // Otherwise every instance carries the internal unknowns
+		std::vector<double> Y, C, J;          // Numeric port model, row major
+		std::unique_ptr<NumericSystem> inner; // Numeric inner system, when not reduced
+	};
+
+	struct SymbolicModel
+	{
+		bool valid = false;
+		size_t revision = 0, values = 0;
+		matrix Y, J;
+	};
+
+	std::string name;
+	mutable Circuit circuit; // Stamping assigns its branch indices
+	std::vector<std::shared_ptr<Node>> ports;
+
+	mutable std::mutex mutex; // Instances stamp from several threads
+	mutable Layout layout;
+	mutable SymbolicModel symbolic[2]; // DC, AC
+
+	// Both with the lock held
+	const Layout& currentLayout() const;
+	void reduceNumeric(Layout& l, const NumericSystem& sys) const;
+
+public:
+	// Ports are nodes of the circuit, in the terminal order of the instances. Throws std::invalid_argument
+	// for ground or foreign ports
+	SubcircuitDefinition(std::string name, Circuit circuit, std::vector<std::shared_ptr<Node>> ports);
+	SubcircuitDefinition(const SubcircuitDefinition&) = delete;
+	SubcircuitDefinition& operator=(const SubcircuitDefinition&) = delete;
+
+	const std::string& getName() const { return name; }
+	size_t portCount() const { return ports.size(); }
+	Circuit& getCircuit() { return circuit; } // Changes invalidate the cached models
+	bool isNumeric() const;
+
+	// Structure and value revisions of the inner circuit, instances pass changes on to their outer circuit
+	std::pair<size_t, size_t> revisions() const;
+
+	// Stamps of one instance, ground terminals skipped. `branch` is the first extra unknown of the instance
+	size_t extraUnknowns() const;
+	void stamp(matrix& G, matrix& I, AnalysisType analysis, const std::vector<int>& terminals, int branch) const;
+	void stampNumeric(NumericSystem& sys, const std::vector<int>& terminals, int branch) const;
+};
+
+// Instance of a definition, connected to one outer node per port
+class Subcircuit : public CircuitElement
+{
+	std::string symbol;
+	std::shared_ptr<const SubcircuitDefinition> definition;
+	std::vector<std::shared_ptr<Node>> terminals;
+
+	// Inner revisions and unknowns the outer circuit last counted, see syncDefinition()
+	mutable bool synced = false;
+	mutable size_t structure_seen = 0, values_seen = 0, extra_seen = 0;
+
+	void syncDefinition() const;
+
+public:
+	// Throws std::invalid_argument if the node count differs from the port count
+	Subcircuit(const std::string& sym, std::shared_ptr<const SubcircuitDefinition> def,
+		std::vector<std::shared_ptr<Node>> nodes);
+
+	std::string getSym() const { return symbol; }
+	const SubcircuitDefinition& getDefinition() const { return *definition; }
+	void setTerminal(size_t port, std::shared_ptr<Node> node);
+
+	std::vector<std::shared_ptr<Node>> getTerminals() const override { return terminals; }
+	size_t branchCount() const override;
+
+	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampNumeric(NumericSystem& sys) const override;
+	bool isNumeric() const override { return definition->isNumeric(); }
+};
@@ -0,0 +1,253 @@
+#include "SymbolicSolver.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+size_t expressionSize(const ex& e) {
+    size_t size = 1;
+    for (size_t k = 0; k < e.nops(); k++) size += expressionSize(e.op(k));
+    return size;
+}
+
+namespace {
+
+bool isUnit(const ex& e) {
+    return e.is_equal(1) || e.is_equal(-1);
+}
+
+constexpr size_t product_memo_limit = 1 << 16;
+
+} // namespace
+
+// Rows are brought to polynomial form here, once
+// Stamps give entries like 1/R, s*C and 1/(s*L), the lcm of the denominators clears them for the whole row
+
+SymbolicSolver::SymbolicSolver(const matrix& G, const matrix& I) : n(G.rows()) {
+    if (G.rows() != G.cols() || I.rows() != G.rows() || I.cols() != 1) {
+        throw std::invalid_argument("Symbolic solve needs a square G and a matching I.");
+    }
+
+    input_rows.resize(n);
+    input_rhs.resize(n);
+    std::vector<ex> numer(n + 1), denom(n + 1);
+    for (size_t i = 0; i < n; i++) {
+        ex scale = 1;
+        std::vector<int> cols;
+        for (size_t j = 0; j <= n; j++) {
+            ex value = j < n ? G(i, j) : I(i, 0);
+            if (value.is_zero()) continue;
+            value = value.normal();
+            if (value.is_zero()) continue;
+            numer[j] = value.numer();
+            denom[j] = value.denom();
+            if (!isUnit(denom[j])) scale = lcm(scale, denom[j]);
+            cols.push_back(static_cast<int>(j));
+        }
+
+        for (int j : cols) {
+            ex factor;
+            if (!divide(scale, denom[j], factor)) factor = (scale / denom[j]).normal();
+            ex value = expand(numer[j] * factor);
+            if (j < static_cast<int>(n)) input_rows[i].push_back(makeEntry(j, value));
+            else input_rhs[i] = value;
+        }
+        stats.entries += input_rows[i].size();
+    }
+    stats.unknowns = n;
+}
+
+SymbolicSolver::Entry SymbolicSolver::makeEntry(int col, const ex& value) {
+    size_t size = expressionSize(value);
+    stats.largestEntry = std::max(stats.largestEntry, size);
+    return { col, value, size };
+}
+
+ex SymbolicSolver::product(const ex& a, const ex& b) {
+    if (a.is_equal(1)) return b;
+    if (b.is_equal(1)) return a;
+    if (a.is_equal(-1)) return -b;
+    if (b.is_equal(-1)) return -a;
+
+    auto key = a.compare(b) <= 0 ? std::make_pair(a, b) : std::make_pair(b, a);
+    auto it = products.find(key);
+    if (it != products.end()) {
+        stats.productHits++;
+        return it->second;
+    }
+    if (products.size() >= product_memo_limit) products.clear();
+    ex result = expand(a * b);
+    products.emplace(std::move(key), result);
+    return result;
+}
+
+// Divide the row by the gcd of its entries
+// The update p * a_ij - a_ic * a_pj multiplies every entry by p, this takes such factors (and the
+// factors Bareiss would divide out) back as soon as the whole row shares them
+
+void SymbolicSolver::cancel(int row) {
+    auto& entries = rows[row];
+    if (entries.empty()) return;
+
+    ex g = entries[0].value;
+    for (size_t k = 1; k < entries.size() && !isUnit(g); k++) g = gcd(g, entries[k].value);
+    if (!rhs[row].is_zero() && !isUnit(g)) g = gcd(g, rhs[row]);
+    if (isUnit(g) || g.is_zero()) return;
+
+    std::vector<ex> quotients(entries.size());
+    ex rhs_quotient = 0;
+    for (size_t k = 0; k < entries.size(); k++) {
+        if (!divide(entries[k].value, g, quotients[k])) return;
+    }
+    if (!rhs[row].is_zero() && !divide(rhs[row], g, rhs_quotient)) return;
+
+    for (size_t k = 0; k < entries.size(); k++) entries[k] = makeEntry(entries[k].col, quotients[k]);
+    rhs[row] = rhs_quotient;
+    stats.cancellations++;
+}
+
+void SymbolicSolver::eliminate(const std::vector<char>& deferred) {
+    rows = input_rows;
+    rhs = input_rhs;
+    products.clear();
+    pivot_row.clear();
+    pivot_col.clear();
+
+    col_count.assign(n, 0);
+    for (const auto& row : rows) {
+        for (const auto& entry : row) col_count[entry.col]++;
+    }
+
+    std::vector<char> done(n, 0);
+    std::vector<Entry> merged;
+
+    for (size_t step = 0; step < n; step++) {
+        // Markowitz pivot, the requested unknowns only once nothing else is left
+        int r = -1, c = -1;
+        bool best_deferred = true;
+        size_t best_cost = std::numeric_limits<size_t>::max(), best_size = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (done[i]) continue;
+            size_t row_cost = rows[i].size() - 1;
+            for (const auto& entry : rows[i]) {
+                bool late = deferred[entry.col] != 0;
+                size_t cost = row_cost * static_cast<size_t>(col_count[entry.col] - 1);
+                bool better = r == -1 || (best_deferred && !late) ||
+                    (late == best_deferred && (cost < best_cost || (cost == best_cost && entry.size < best_size)));
+                if (better) {
+                    r = static_cast<int>(i);
+                    c = entry.col;
+                    best_deferred = late;
+                    best_cost = cost;
+                    best_size = entry.size;
+                }
+            }
+        }
+        if (r == -1) {
+            throw std::runtime_error("Symbolically singular system, " + std::to_string(n - step) +
+                " of " + std::to_string(n) + " unknowns are not determined.");
+        }
+
+        done[r] = 1;
+        pivot_row.push_back(r);
+        pivot_col.push_back(c);
+        stats.pivots++;
+        for (const auto& entry : rows[r]) col_count[entry.col]--;
+
+        const auto& prow = rows[r];
+        ex p = std::find_if(prow.begin(), prow.end(), [c](const Entry& e) { return e.col == c; })->value;
+
+        for (size_t i = 0; i < n; i++) {
+            if (done[i]) continue;
+            auto& row = rows[i];
+            auto hit = std::lower_bound(row.begin(), row.end(), c, [](const Entry& e, int col) { return e.col < col; });
+            if (hit == row.end() || hit->col != c) continue;
+            ex a = hit->value;
+
+            // row_i = p * row_i - a * row_p, merged by column
+            merged.clear();
+            auto x = row.cbegin(), y = prow.cbegin();
+            while (x != row.cend() || y != prow.cend()) {
+                int col;
+                ex value;
+                if (y == prow.cend() || (x != row.cend() && x->col < y->col)) {
+                    col = x->col;
+                    value = product(p, (x++)->value);
+                }
+                else if (x == row.cend() || y->col < x->col) {
+                    col = y->col;
+                    value = -product(a, (y++)->value);
+                    if (col != c) {
+                        col_count[col]++;
+                        stats.fill++;
+                    }
+                }
+                else {
+                    col = x->col;
+                    value = expand(product(p, (x++)->value) - product(a, (y++)->value));
+                }
+                if (col == c) continue;
+                if (value.is_zero()) {
+                    col_count[col]--;
+                    continue;
+                }
+                merged.push_back(makeEntry(col, value));
+            }
+            col_count[c]--;
+            row.swap(merged);
+            rhs[i] = expand(product(p, rhs[i]) - product(a, rhs[r]));
+            cancel(static_cast<int>(i));
+        }
+    }
+}
+
+std::vector<ex> SymbolicSolver::solve(const std::vector<int>& unknowns) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<char> deferred(n, 0);
+    for (int u : unknowns) {
+        if (u < 0 || u >= static_cast<int>(n)) throw std::out_of_range("Unknown outside of the symbolic system.");
+        deferred[u] = 1;
+    }
+
+    stats.pivots = stats.fill = stats.cancellations = stats.productHits = 0;
+    eliminate(deferred);
+
+    // Back substitution over the pivots the requested unknowns depend on
+    std::vector<int> step_of(n);
+    for (size_t k = 0; k < n; k++) step_of[pivot_col[k]] = static_cast<int>(k);
+    std::vector<char> needed(n, 0);
+    for (int u : unknowns) needed[step_of[u]] = 1;
+    for (size_t k = 0; k < n; k++) {
+        if (!needed[k]) continue;
+        for (const auto& entry : rows[pivot_row[k]]) needed[step_of[entry.col]] = 1;
+    }
+
+    std::vector<ex> value(n);
+    for (size_t k = n; k-- > 0;) {
+        if (!needed[k]) continue;
+        int r = pivot_row[k], c = pivot_col[k];
+        ex sum = rhs[r], pivot;
+        for (const auto& entry : rows[r]) {
+            if (entry.col == c) pivot = entry.value;
+            else sum -= entry.value * value[entry.col];
+        }
+        value[c] = normal(sum / pivot);
+    }
+
+    std::vector<ex> result;
+    result.reserve(unknowns.size());
+    stats.resultSize = 0;
+    for (int u : unknowns) {
+        result.push_back(value[u]);
+        stats.resultSize += expressionSize(value[u]);
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+std::vector<ex> SymbolicSolver::solveAll() {
+    std::vector<int> unknowns(n);
+    for (size_t k = 0; k < n; k++) unknowns[k] = static_cast<int>(k);
+    return solve(unknowns);
+}
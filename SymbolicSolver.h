@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+#include <ginac/ginac.h>
+
+using namespace GiNaC;
+
+// Nodes of the expression tree, the size measure used by the statistics
+size_t expressionSize(const ex& e);
+
+struct SymbolicStats
+{
+	size_t unknowns = 0, entries = 0;   // Of the input system
+	size_t pivots = 0, fill = 0;        // Fill: entries created by the elimination
+	size_t cancellations = 0;           // Rows divided by a common polynomial factor
+	size_t productHits = 0;             // Products taken from the memo instead of expanded again
+	size_t largestEntry = 0;            // Largest expressionSize() during the elimination
+	size_t resultSize = 0;              // expressionSize() summed over the returned unknowns
+	double seconds = 0;
+};
+
+// Sparse fraction-free elimination for the symbolic MNA system G x = I
+// Every row is first scaled by the lcm of its denominators, so the entries are polynomials in s and
+// the element symbols. Pivots are chosen by the Markowitz count (r - 1) * (c - 1), ties go to the
+// smaller expression. A row update is p * a_ij - a_ic * a_pj, without division, followed by division
+// by the gcd of the row: that keeps the entries as small as Bareiss' exact division would, and also
+// removes factors that only cancel in this particular circuit.
+// Requested unknowns are eliminated last, back substitution then only touches them.
+
+class SymbolicSolver
+{
+	struct Entry
+	{
+		int col;
+		ex value;
+		size_t size; // expressionSize(value), the pivot tie break
+	};
+
+	struct PairLess
+	{
+		bool operator()(const std::pair<ex, ex>& a, const std::pair<ex, ex>& b) const {
+			int c = a.first.compare(b.first);
+			return c != 0 ? c < 0 : a.second.compare(b.second) < 0;
+		}
+	};
+
+	size_t n = 0;
+	std::vector<std::vector<Entry>> input_rows, rows; // Sorted by column, input_rows is kept for the next solve
+	std::vector<ex> input_rhs, rhs;
+	std::vector<int> col_count;                       // Active rows with an entry in the column
+
+	std::vector<int> pivot_row, pivot_col; // In elimination order
+	std::map<std::pair<ex, ex>, ex, PairLess> products; // Expanded products, stamps repeat the same few values
+	SymbolicStats stats;
+
+	Entry makeEntry(int col, const ex& value);
+	ex product(const ex& a, const ex& b);
+	void eliminate(const std::vector<char>& deferred);
+	void cancel(int row);
+
+public:
+	SymbolicSolver(const matrix& G, const matrix& I); // Throws std::invalid_argument on size mismatch
+
+	// Values of the given unknowns as normalized rational functions
+	// Throws std::runtime_error if the system is singular (symbolically, not only for some values)
+	std::vector<ex> solve(const std::vector<int>& unknowns);
+	std::vector<ex> solveAll();
+
+	const SymbolicStats& getStats() const { return stats; }
+};
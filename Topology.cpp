@@ -0,0 +1,168 @@
+#include "Topology.h"
+#include "Component.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// Caller holds the lock
+
+int Topology::attach(const std::shared_ptr<Node>& node) {
+    if (!node) return unconnected;
+    if (node->index == -1) return -1; // Ground is shared by every circuit
+
+    auto owner = node->topology.lock();
+    if (owner.get() == this) return node->index;
+    if (owner) {
+        throw std::logic_error("Node " + node->symbol + " already belongs to another circuit.");
+    }
+
+    int id = static_cast<int>(nodes.size());
+    node->topology = weak_from_this();
+    node->index = id;
+    if (node->symbol.empty()) node->symbol = "V" + std::to_string(id);
+    nodes.push_back(node);
+    names.add(node->symbol);
+    names_indexed = false;
+    adjacency_valid = false;
+    structure_revision++;
+    return id;
+}
+
+int Topology::addNode(const std::shared_ptr<Node>& node) {
+    if (!node) throw std::invalid_argument("Cannot add a null node.");
+    std::lock_guard<std::mutex> lock(mutex);
+    return attach(node);
+}
+
+int Topology::addElement(const std::shared_ptr<CircuitElement>& element) {
+    if (!element) throw std::invalid_argument("Cannot add a null element.");
+    auto pins = element->getTerminals();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto owner = element->topology.lock();
+    if (owner.get() == this) return element->id;
+    if (owner) throw std::logic_error("Element already belongs to another circuit.");
+
+    std::vector<int> ids;
+    ids.reserve(pins.size());
+    for (const auto& pin : pins) ids.push_back(attach(pin));
+
+    int id = static_cast<int>(elements.size());
+    element->topology = weak_from_this();
+    element->id = id;
+    elements.push_back(element);
+    terminals.insert(terminals.end(), ids.begin(), ids.end());
+    terminal_ptr.push_back(static_cast<int>(terminals.size()));
+    changed_flag.push_back(0);
+    adjacency_valid = false;
+    structure_revision++;
+    return id;
+}
+
+void Topology::reconnect(const CircuitElement& element) {
+    auto pins = element.getTerminals();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    int e = element.id;
+    int first = terminal_ptr[e];
+    if (pins.size() != static_cast<size_t>(terminal_ptr[e + 1] - first)) {
+        throw std::logic_error("Element changed its number of terminals.");
+    }
+    for (size_t k = 0; k < pins.size(); k++) terminals[first + k] = attach(pins[k]);
+    adjacency_valid = false;
+    structure_revision++;
+}
+
+void Topology::rename(const Node& node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    names.rename(node.index, node.symbol);
+    names_indexed = false;
+}
+
+void Topology::valuesChanged(const CircuitElement& element) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int e = element.id;
+    value_revision++;
+    if (changed_flag[e]) return;
+    changed_flag[e] = 1;
+    changed.push_back(e);
+}
+
+size_t Topology::revision() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return structure_revision;
+}
+
+size_t Topology::valueRevision() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return value_revision;
+}
+
+std::vector<int> Topology::takeChanged() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<int> result;
+    result.swap(changed);
+    for (int e : result) changed_flag[e] = 0;
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+size_t Topology::nodeCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nodes.size();
+}
+
+size_t Topology::elementCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return elements.size();
+}
+
+std::shared_ptr<Node> Topology::findNode(std::string_view name) const {
+    auto ground = Node::getGround();
+    if (NameTable::equal(name, ground->getSym())) return ground;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!names_indexed) {
+        names.reindex();
+        names_indexed = true;
+    }
+    int id = names.find(name);
+    return id == -1 ? nullptr : nodes[id];
+}
+
+IndexRange Topology::terminalsOf(int element) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (element < 0 || element >= static_cast<int>(elements.size())) {
+        throw std::out_of_range("Element id outside of the topology.");
+    }
+    return { terminals.data() + terminal_ptr[element], terminals.data() + terminal_ptr[element + 1] };
+}
+
+IndexRange Topology::elementsAt(int node) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (node < -1 || node >= static_cast<int>(nodes.size())) {
+        throw std::out_of_range("Node id outside of the topology.");
+    }
+    if (!adjacency_valid) buildAdjacency();
+    return { adjacency.data() + adjacency_ptr[node + 1], adjacency.data() + adjacency_ptr[node + 2] };
+}
+
+// Transpose of the terminal lists by a counting sort, two passes over the terminals
+
+void Topology::buildAdjacency() const {
+    size_t rows = nodes.size() + 1;
+    adjacency_ptr.assign(rows + 1, 0);
+    for (int t : terminals) {
+        if (t != unconnected) adjacency_ptr[t + 2]++;
+    }
+    for (size_t r = 1; r <= rows; r++) adjacency_ptr[r] += adjacency_ptr[r - 1];
+
+    std::vector<int> next(adjacency_ptr.begin(), adjacency_ptr.end() - 1);
+    adjacency.resize(adjacency_ptr[rows]);
+    for (size_t e = 0; e < elements.size(); e++) {
+        for (int p = terminal_ptr[e]; p < terminal_ptr[e + 1]; p++) {
+            if (terminals[p] != unconnected) adjacency[next[terminals[p] + 1]++] = static_cast<int>(e);
+        }
+    }
+    adjacency_valid = true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "NameTable.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+class Node;
+class CircuitElement;
+
+// Run of ids inside one of the topology arrays
+struct IndexRange
+{
+	const int* first = nullptr;
+	const int* last = nullptr;
+
+	const int* begin() const { return first; }
+	const int* end() const { return last; }
+	size_t size() const { return static_cast<size_t>(last - first); }
+	int operator[](size_t k) const { return first[k]; }
+};
+
+// Per circuit graph store
+// Nodes and elements get dense ids in the order they are added, the ground node is -1 in every circuit.
+// The terminals of all elements sit in one array (CSR by element), the node -> element adjacency is its
+// transpose, rebuilt on the first query after a change. Node and CircuitElement objects are handles that
+// carry their id, their own pointers are only read when an element is added or reconnected.
+// Changes are serialized by a lock, so one circuit can be filled from several threads. The handle lists
+// and ranges returned here are meant for after construction and stay valid until the next change.
+
+class Topology : public std::enable_shared_from_this<Topology>
+{
+	mutable std::mutex mutex;
+	std::vector<std::shared_ptr<Node>> nodes;
+	std::vector<std::shared_ptr<CircuitElement>> elements;
+	std::vector<int> terminal_ptr, terminals; // Element e connects terminals[terminal_ptr[e] .. terminal_ptr[e + 1]]
+
+	mutable NameTable names; // Node names, indexed like the nodes
+	mutable bool names_indexed = true;
+	mutable std::vector<int> adjacency_ptr, adjacency; // Row 0 is ground, node id k is row k + 1
+	mutable bool adjacency_valid = false;
+
+	size_t structure_revision = 0;  // Counts changes of the graph, new nodes, elements and terminals
+	size_t value_revision = 0;      // Counts value changes of elements
+	std::vector<int> changed;       // Elements with new values since the last takeChanged()
+	std::vector<char> changed_flag; // Indexed by element id
+
+	int attach(const std::shared_ptr<Node>& node);
+	void buildAdjacency() const;
+
+public:
+	static constexpr int unconnected = -2; // Terminal without a node (default constructed components)
+
+	Topology() : terminal_ptr(1, 0) {}
+	Topology(const Topology&) = delete;
+	Topology& operator=(const Topology&) = delete;
+
+	// Both return the existing id when the object was added before, and throw std::logic_error
+	// if it belongs to another circuit that is still alive. Terminals of a new element join as well.
+	int addNode(const std::shared_ptr<Node>& node);
+	int addElement(const std::shared_ptr<CircuitElement>& element);
+
+	// Called by the handles after a change
+	void reconnect(const CircuitElement& element);
+	void rename(const Node& node);
+	void valuesChanged(const CircuitElement& element);
+
+	// Incremental solves compare the revision with the one they factored, and take the elements
+	// whose values changed in between (sorted by id, the list is cleared)
+	size_t revision() const;
+	std::vector<int> takeChanged();
+	size_t valueRevision() const; // For caches of whole circuits, see Subcircuit
+
+	size_t nodeCount() const;
+	size_t elementCount() const;
+	const std::vector<std::shared_ptr<Node>>& nodeHandles() const { return nodes; }
+	const std::vector<std::shared_ptr<CircuitElement>>& elementHandles() const { return elements; }
+
+	// Case insensitive, the first node added under the name wins. nullptr if unknown
+	std::shared_ptr<Node> findNode(std::string_view name) const;
+
+	IndexRange terminalsOf(int element) const;
+
+	// The terminal CSR itself for loops over every element, without the lock of terminalsOf()
+	const std::vector<int>& terminalPtr() const { return terminal_ptr; }
+	const std::vector<int>& terminalNodes() const { return terminals; }
+	IndexRange elementsAt(int node) const; // Once per terminal on the node, in element order, ground included
+};
@@ -0,0 +1,202 @@
+#include "Transient.h"
+#include "ACSweep.h"
+#include "BlockLU.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+// Backward Euler:  (G + C / h) x1 = b1 + (C / h) x0
+// Trapezoidal:     (G + 2C / h) x1 = b1 + b0 + (2C / h) x0 - G x0
+
+namespace {
+
+class Stepper
+{
+    const FrequencyPattern& pattern;
+    SparseMatrix<double> G, C;
+    BlockLU<double> lu;
+    Integration method;
+    double factored_step = -1;
+    std::vector<double> cx, gx;
+
+public:
+    size_t factorizations = 0;
+
+    Stepper(const FrequencyPattern& p, std::shared_ptr<const LUAnalysis> analysis, Integration m)
+        : pattern(p), G(p.combine(0.0)), lu(std::move(analysis)), method(m) {
+        C = pattern.combine(1.0);
+        auto& cv = C.getValues();
+        const auto& gv = G.getValues();
+        for (size_t k = 0; k < cv.size(); k++) cv[k] -= gv[k]; // C alone on the shared pattern
+    }
+
+    double alpha(double h) const { return (method == Integration::BackwardEuler ? 1.0 : 2.0) / h; }
+
+    // x holds x0 on entry and x1 on return
+    void step(double h, const std::vector<double>& b0, const std::vector<double>& b1, std::vector<double>& x) {
+        // A new step only changes values, the pivots of the last factorization are tried first
+        if (h != factored_step) {
+            SparseMatrix<double> A = pattern.combine(alpha(h));
+            if (factored_step < 0 || !lu.refactor(A)) lu.factorize(A);
+            factored_step = h;
+            factorizations++;
+        }
+
+        C.multiply(x, cx);
+        double a = alpha(h);
+        if (method == Integration::BackwardEuler) {
+            for (size_t k = 0; k < x.size(); k++) x[k] = b1[k] + a * cx[k];
+        }
+        else {
+            G.multiply(x, gx);
+            for (size_t k = 0; k < x.size(); k++) x[k] = b1[k] + b0[k] + a * cx[k] - gx[k];
+        }
+        lu.solve(x);
+    }
+};
+
+} // namespace
+
+TransientResult runTransient(const NumericSystem& sys, const TransientOptions& options, const std::vector<int>& outputs) {
+    if (options.step <= 0 || options.stop <= 0) {
+        throw std::invalid_argument("Transient needs a positive step and stop time.");
+    }
+    for (int idx : outputs) {
+        if (idx >= static_cast<int>(sys.size())) throw std::out_of_range("Transient output outside of the system.");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t n = sys.size();
+
+    TransientResult result;
+    result.outputs = outputs;
+    size_t decimation = std::max<size_t>(1, options.outputEvery);
+    auto store = [&](double t, const std::vector<double>& x) {
+        result.times.push_back(t);
+        for (int idx : outputs) result.values.push_back(idx >= 0 ? x[idx] : 0.0);
+    };
+
+    auto sources = [&](double t, std::vector<double>& b) {
+        b = sys.rhs;
+        if (options.excitation) options.excitation(t, b);
+    };
+
+    FrequencyPattern pattern(sys);
+    auto analysis = std::make_shared<const LUAnalysis>(analyzePattern(pattern.size(), pattern.colPtr(), pattern.rowIdx()));
+
+    std::vector<double> b0, b1, x(n, 0.0);
+    sources(0.0, b0);
+
+    // Initial state, capacitors open and inductors shorted
+    if (options.startFromOperatingPoint) {
+        BlockLU<double> op(analysis);
+        try {
+            op.factorize(pattern.combine(0.0));
+        }
+        catch (const std::runtime_error&) {
+            throw std::runtime_error("No DC operating point (floating capacitor node?), start the transient from zero instead.");
+        }
+        x = b0;
+        op.solve(x);
+        result.factorizations++;
+    }
+    store(0.0, x);
+
+    Stepper stepper(pattern, analysis, options.method);
+
+    if (!options.adaptive) {
+        size_t steps = static_cast<size_t>(std::ceil(options.stop / options.step - 1e-9));
+        // The last step ends on stop, it is shorter (one more factorization) when stop is not a multiple of step
+        double last = options.stop - (steps - 1) * options.step;
+        if (std::abs(last - options.step) <= 1e-9 * options.step) last = options.step;
+        for (size_t k = 1; k <= steps; k++) {
+            double h = k < steps ? options.step : last;
+            double t = k < steps ? k * options.step : options.stop;
+            sources(t, b1);
+            stepper.step(h, b0, b1, x);
+            b0.swap(b1);
+            if (k % decimation == 0 || k == steps) store(t, x);
+        }
+        result.steps = steps;
+    }
+    else {
+        // Error estimate: distance between the step and a predictor through the last points, a divided difference
+        // of the method's order plus one. Backward Euler, LTE = h^2 / 2 * x'': linear predictor through two points.
+        // Trapezoidal, LTE = h^3 / 12 * x''': quadratic predictor through three points. x - p = x''' / 6 *
+        // h (h + h1) (h + h1 + h2), so LTE = (x - p) * h^2 / (2 (h + h1) (h + h1 + h2)), 1/12 at a constant step.
+        // Until three points exist the trapezoidal steps are checked with the backward Euler estimate.
+        // Only unknowns with a C entry (capacitor voltages, inductor currents) carry truncation error,
+        // algebraic unknowns follow them and would only add noise to the estimate
+        std::vector<char> dynamic(n, 0);
+        for (size_t k = 0; k < sys.C.entries(); k++) {
+            if (sys.C.value(k) != 0) dynamic[sys.C.col(k)] = 1;
+        }
+
+        double h_min = options.minStep > 0 ? options.minStep : options.stop * 1e-12;
+        double h_max = options.maxStep > 0 ? options.maxStep : options.stop / 50;
+        bool trapezoidal = options.method == Integration::Trapezoidal;
+        double h = std::min(options.step, h_max), h_prev = 0, h_prev2 = 0, t = 0;
+        std::vector<double> x_prev, x_prev2, trial;
+        size_t accepted = 0;
+
+        while (t < options.stop * (1 - 1e-12)) {
+            double h_step = std::min(h, options.stop - t); // Only the last step gets clipped
+            sources(t + h_step, b1);
+            trial = x;
+            stepper.step(h_step, b0, b1, trial);
+
+            double err = 0, order_p1 = 2;
+            if (trapezoidal && !x_prev2.empty()) {
+                order_p1 = 3;
+                double factor = h_step * h_step / (2 * (h_step + h_prev) * (h_step + h_prev + h_prev2));
+                for (size_t k = 0; k < n; k++) {
+                    if (!dynamic[k]) continue;
+                    double d1 = (x[k] - x_prev[k]) / h_prev, d0 = (x_prev[k] - x_prev2[k]) / h_prev2;
+                    double predicted = x[k] + h_step * d1 + h_step * (h_step + h_prev) * (d1 - d0) / (h_prev + h_prev2);
+                    double scale = options.reltol * std::max(std::abs(trial[k]), std::abs(x[k])) + options.abstol;
+                    err = std::max(err, factor * std::abs(trial[k] - predicted) / scale);
+                }
+            }
+            else if (!x_prev.empty()) {
+                double ratio = h_step / h_prev;
+                for (size_t k = 0; k < n; k++) {
+                    if (!dynamic[k]) continue;
+                    double predicted = x[k] + ratio * (x[k] - x_prev[k]);
+                    double scale = options.reltol * std::max(std::abs(trial[k]), std::abs(x[k])) + options.abstol;
+                    err = std::max(err, 0.5 * std::abs(trial[k] - predicted) / scale);
+                }
+            }
+
+            if (err > 1) {
+                if (h_step <= h_min) {
+                    throw std::runtime_error("Transient step fell below the minimum step at t = " + std::to_string(t) + ".");
+                }
+                result.rejected++;
+                h = std::max(h_min, h_step * std::max(0.2, 0.9 * std::pow(err, -1.0 / order_p1)));
+                continue;
+            }
+
+            if (trapezoidal) {
+                x_prev2.swap(x_prev); // x_prev2 = x_prev, x_prev = x without copying
+                h_prev2 = h_prev;
+            }
+            x_prev.swap(x);
+            x.swap(trial);
+            b0.swap(b1);
+            h_prev = h_step;
+            t += h_step;
+            accepted++;
+            if (accepted % decimation == 0 || t >= options.stop * (1 - 1e-12)) store(t, x);
+
+            // Grow only on a comfortable margin so the step (and the factorization) stays put most of the time
+            if (err < 0.1) h = std::min(h_max, 2 * h);
+        }
+        result.steps = accepted;
+    }
+
+    result.factorizations += stepper.factorizations;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "NumericSystem.h"
+#include <functional>
+#include <vector>
+
+// Time domain analysis of G * x + C * dx/dt = b(t)
+// Discretizing C * dx/dt is the companion model of every capacitor (G_eq = C / h) and
+// inductor branch (R_eq = L / h) at once, with the history terms as the equivalent sources.
+// With a fixed step the companion matrix never changes, so it is factorized once
+// and each step is one forward/back substitution
+
+enum class Integration
+{
+	BackwardEuler,
+	Trapezoidal
+};
+
+struct TransientOptions
+{
+	double step = 1e-6; // Fixed step, or the first step when adaptive
+	double stop = 1e-3;
+	Integration method = Integration::Trapezoidal;
+
+	// Local truncation error control, the step only changes (and the matrix is refactorized) when the error demands it
+	bool adaptive = false;
+	double reltol = 1e-3;
+	double abstol = 1e-6;
+	double minStep = 0; // 0: stop * 1e-12
+	double maxStep = 0; // 0: stop / 50
+
+	bool startFromOperatingPoint = true; // Otherwise start from x = 0
+	size_t outputEvery = 1; // Keep every n-th accepted point
+
+	// Optional time dependent sources, adjusts the RHS (already holding the DC values) for time t
+	std::function<void(double, std::vector<double>&)> excitation;
+};
+
+// Time x requested unknowns, row major
+
+struct TransientResult
+{
+	std::vector<double> times;
+	std::vector<int> outputs; // MNA unknown of every column, -1 is ground
+	std::vector<double> values;
+	size_t steps = 0, rejected = 0, factorizations = 0;
+	double seconds = 0;
+
+	double at(size_t point, size_t output) const { return values[point * outputs.size() + output]; }
+};
+
+TransientResult runTransient(const NumericSystem& sys, const TransientOptions& options, const std::vector<int>& outputs);
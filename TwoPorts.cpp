@@ -1,154 +1,357 @@
 #include "Node.h"
 #include "TwoPorts.h"
+#include "Connectivity.h"
 #include "ginac/ginac.h"
 #include "DiscreteComponents.h"
 #include "Circuit.h"
+#include "NumericSystem.h"
 #include <string>
 
 // Ideal transformer stamping Table B.11
+// V2 = n * V1, I2 = -I1 / n, branch k carries I1
 
-void Transformer::stamp(matrix& G, matrix& I) const {
+void Transformer::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
     int pri_in = getPrimaryInput()->getIndex(), pri_out = getPrimaryOutput()->getIndex();
     int sec_in = getSecondaryInput()->getIndex(), sec_out = getSecondaryOutput()->getIndex();
-    int row = G.rows();
-
-    // Resize matrices to fit I1 I2
-    G = resize_matrix(G, row + 1, row + 1);
-    I = resize_matrix(I, row + 1, 1);
-
-    // V_pri - r * V_sec = 0
-    G(pri_in, pri_in) = 1;
-    G(pri_in, sec_out) -= ratio;
-
-    // I_sec + I_pri = 0
-    G(sec_out, pri_in) += 1 / ratio;
-    G(sec_out, sec_out) += 1;
+    int k = getBranchIndex();
+
+    // V_sec - n * V_pri = 0
+    stampEntry(G, k, sec_in, 1);
+    stampEntry(G, k, sec_out, -1);
+    stampEntry(G, k, pri_in, -ratio);
+    stampEntry(G, k, pri_out, ratio);
+
+    // I_pri flows through the primary, I_sec = -I_pri / n through the secondary
+    stampEntry(G, pri_in, k, 1);
+    stampEntry(G, pri_out, k, -1);
+    stampEntry(G, sec_in, k, -1 / ratio);
+    stampEntry(G, sec_out, k, 1 / ratio);
 }
 
 // Operational Amplifier stamping
 
-void OperationalAmplifier::stamp(matrix& G, matrix& I) const {
+void OperationalAmplifier::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
     int in_p = getPrimaryInput()->getIndex(), in_n = getSecondaryInput()->getIndex();
     int out = getPrimaryOutput()->getIndex();
+    int k = getBranchIndex();
 
-    int row = G.rows();
-    G = resize_matrix(G, row + 1, row + 1);
-    I = resize_matrix(I, row + 1, 1);
+    // V_in+ = V_in-
+    stampEntry(G, k, in_p, 1);
+    stampEntry(G, k, in_n, -1);
 
-    G(row, in_p) += 1;
-    G(row, in_n) -= 1;
-
-    // I_out = 0
-
-    G(out, row) = 1;
+    // I_in = 0, the output current is the extra unknown
+    stampEntry(G, out, k, 1);
 }
 
 // Girator Stamping
 // V2 = r * I1, V1 = -r * I2
 
-void Girator::stamp(matrix& G, matrix& I) const {
+void Girator::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
     int pri_in = getPrimaryInput()->getIndex(), pri_out = getPrimaryOutput()->getIndex();
     int sec_in = getSecondaryInput()->getIndex(), sec_out = getSecondaryOutput()->getIndex();
+    int k1 = getBranchIndex(), k2 = k1 + 1; // I1, I2
 
-    // Resize matrices to accommodate additional variables
-    int row = G.rows();
-    G = resize_matrix(G, row + 2, row + 2);
-    I = resize_matrix(I, row + 2, 1);
+    stampEntry(G, pri_in, k1, 1);
+    stampEntry(G, pri_out, k1, -1);
+    stampEntry(G, sec_in, k2, 1);
+    stampEntry(G, sec_out, k2, -1);
 
     // V2 = r * I1
-    G(row, pri_in) += 1;
-    G(row, pri_out) -= 1;
-    G(row, row + 1) -= gyResistance;
+    stampEntry(G, k1, sec_in, 1);
+    stampEntry(G, k1, sec_out, -1);
+    stampEntry(G, k1, k1, -gyResistance);
 
     // V1 = -r * I2
-    G(row + 1, sec_in) += 1;
-    G(row + 1, sec_out) -= 1;
-    G(row + 1, row) += gyResistance;
-}  
+    stampEntry(G, k2, pri_in, 1);
+    stampEntry(G, k2, pri_out, -1);
+    stampEntry(G, k2, k2, gyResistance);
+}
+
+// Control values from the solved node potentials and port currents
+
+ex ControlledSource::calculateControlValue() {
+    return gain;
+}
+
+ex VCVS::calculateControlValue() {
+    return getControlValue() * (getSecondaryInput()->getPotential() - getSecondaryOutput()->getPotential());
+}
+
+ex VCCS::calculateControlValue() {
+    return getControlValue() * (getSecondaryInput()->getPotential() - getSecondaryOutput()->getPotential());
+}
+
+ex CCVS::calculateControlValue() {
+    return getControlValue() * getCurrent2();
+}
+
+ex CCCS::calculateControlValue() {
+    return getControlValue() * getCurrent2();
+}
+
+ex VCVS::getOutputVoltage() { return outputVoltage; }
+void VCVS::setOutputVoltage(ex voltage) { outputVoltage = voltage; }
+ex CCVS::getOutputVoltage() { return outputVoltage; }
+void CCVS::setOutputVoltage(ex voltage) { outputVoltage = voltage; }
+ex VCCS::getOutputCurrent() { return outputCurrent; }
+void VCCS::setOutputCurrent(ex current) { outputCurrent = current; }
+ex CCCS::getOutputCurrent() { return outputCurrent; }
+void CCCS::setOutputCurrent(ex current) { outputCurrent = current; }
 
 // Voltage Controlled Voltage Source stamping Table B.13 
 // V_out = g * V_control
 
-void VCVS::stamp(matrix& G, matrix& I) const {
+void VCVS::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
     int c_in = getSecondaryInput()->getIndex(), c_out = getSecondaryOutput()->getIndex();
-    int in = getPrimaryInput()->getIndex(), out = getSecondaryOutput()->getIndex();
-
-
-    // Resize matrices for the new variable
-    int vs_row = G.rows();
-    G = resize_matrix(G, vs_row + 1, vs_row + 1);
-    I = resize_matrix(I, vs_row + 1, 1);
+    int in = getPrimaryInput()->getIndex(), out = getPrimaryOutput()->getIndex();
+    int k = getBranchIndex();
 
     ex g = getControlValue();
 
     // Characteristics
-    G(vs_row, in) += 1;
-    G(vs_row, out) -= 1;
-    G(vs_row, c_in) -= g;
-    G(vs_row, c_out) += g;
+    stampEntry(G, k, in, 1);
+    stampEntry(G, k, out, -1);
+    stampEntry(G, k, c_in, -g);
+    stampEntry(G, k, c_out, g);
 
     // Current
-    G(in, vs_row) = 1;
-    G(out, vs_row) = -1;
+    stampEntry(G, in, k, 1);
+    stampEntry(G, out, k, -1);
 }
 
 // CCVS stamping
-// V_out = h * I_control
+// V_out = h * I_control, the control probe is a short circuit with its own branch current
 
-void CCVS::stamp(matrix& G, matrix& I) const {
+void CCVS::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
     int c_in = getSecondaryInput()->getIndex(), c_out = getSecondaryOutput()->getIndex();
     int in = getPrimaryInput()->getIndex(), out = getPrimaryOutput()->getIndex();
-
-    // Resize matrices for the new variable
-    int vs_row = G.rows();
-    G = resize_matrix(G, vs_row + 1, vs_row + 1);
-    I = resize_matrix(I, vs_row + 1, 1);
+    int kc = getBranchIndex(), k = kc + 1; // Control probe, output
 
     ex h = getControlValue();
 
-    // V_out = h * I_control
-    G(vs_row, in) += 1;
-    G(vs_row, out) -= 1;
-    G(vs_row, vs_row) -= h;
+    // V_c_in = V_c_out
+    stampEntry(G, kc, c_in, 1);
+    stampEntry(G, kc, c_out, -1);
+    stampEntry(G, c_in, kc, 1);
+    stampEntry(G, c_out, kc, -1);
 
-    G(c_in, vs_row) += 1;
-    G(c_out, vs_row) -= 1;
+    // V_out = h * I_control
+    stampEntry(G, k, in, 1);
+    stampEntry(G, k, out, -1);
+    stampEntry(G, k, kc, -h);
+    stampEntry(G, in, k, 1);
+    stampEntry(G, out, k, -1);
 }
 
-// I_out = g * ( V_c_in - V_c_out )
+// I_out = g * ( V_c_in - V_c_out ), no extra unknown needed
 
-void VCCS::stamp(matrix& G, matrix& I) const {
+void VCCS::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
     int c_in = getSecondaryInput()->getIndex(), c_out = getSecondaryOutput()->getIndex();
     int in = getPrimaryInput()->getIndex(), out = getPrimaryOutput()->getIndex();
 
     ex g = getControlValue();
 
-    // Resize matrices
-    int vs_row = G.rows();
-    G = resize_matrix(G, vs_row + 1, vs_row + 1);
-    I = resize_matrix(I, vs_row + 1, 1);
-
-    G(in, c_in) += g;
-    G(in, c_out) -= g;
-    G(out, c_in) -= g;
-    G(out, c_out) += g;
+    stampEntry(G, in, c_in, g);
+    stampEntry(G, in, c_out, -g);
+    stampEntry(G, out, c_in, -g);
+    stampEntry(G, out, c_out, g);
 }
 
 // I_out = h * I_control
 
-void CCCS::stamp(matrix& G, matrix& I) const {
+void CCCS::stamp(matrix& G, matrix& I, AnalysisType analysis) const {
     int c_in = getSecondaryInput()->getIndex(), c_out = getSecondaryOutput()->getIndex();
     int in = getPrimaryInput()->getIndex(), out = getPrimaryOutput()->getIndex();
+    int kc = getBranchIndex(); // Control probe
 
     ex h = getControlValue();
-    int aux_row = G.rows();
 
-    G = resize_matrix(G, aux_row + 1, aux_row + 1);
-    I = resize_matrix(I, aux_row + 1, 1);
+    stampEntry(G, kc, c_in, 1);
+    stampEntry(G, kc, c_out, -1);
+    stampEntry(G, c_in, kc, 1);
+    stampEntry(G, c_out, kc, -1);
+
+    stampEntry(G, in, kc, h);
+    stampEntry(G, out, kc, -h);
+}
+
+// Numeric stamps for the sparse backend
+// Branch current k flows into the input terminal of its port
+
+// V2 = n * V1, I2 = -I1 / n
+
+void Transformer::stampNumeric(NumericSystem& sys) const {
+    int pri_in = getPrimaryInput()->getIndex(), pri_out = getPrimaryOutput()->getIndex();
+    int sec_in = getSecondaryInput()->getIndex(), sec_out = getSecondaryOutput()->getIndex();
+    double n = numeric.value();
+    int k = getBranchIndex();
+
+    sys.G.add(k, sec_in, 1);
+    sys.G.add(k, sec_out, -1);
+    sys.G.add(k, pri_in, -n);
+    sys.G.add(k, pri_out, n);
+
+    sys.G.add(pri_in, k, 1);
+    sys.G.add(pri_out, k, -1);
+    sys.G.add(sec_in, k, -1 / n);
+    sys.G.add(sec_out, k, 1 / n);
+}
+
+// V2 = r * I1, V1 = -r * I2
+
+void Girator::stampNumeric(NumericSystem& sys) const {
+    int pri_in = getPrimaryInput()->getIndex(), pri_out = getPrimaryOutput()->getIndex();
+    int sec_in = getSecondaryInput()->getIndex(), sec_out = getSecondaryOutput()->getIndex();
+    double r = numeric.value();
+    int k1 = getBranchIndex(), k2 = k1 + 1;
+
+    sys.G.add(pri_in, k1, 1);
+    sys.G.add(pri_out, k1, -1);
+    sys.G.add(sec_in, k2, 1);
+    sys.G.add(sec_out, k2, -1);
+
+    sys.G.add(k1, sec_in, 1);
+    sys.G.add(k1, sec_out, -1);
+    sys.G.add(k1, k1, -r);
+
+    sys.G.add(k2, pri_in, 1);
+    sys.G.add(k2, pri_out, -1);
+    sys.G.add(k2, k2, r);
+}
+
+void VCVS::stampNumeric(NumericSystem& sys) const {
+    int nodes[] = { getPrimaryInput()->getIndex(), getPrimaryOutput()->getIndex(),
+        getSecondaryInput()->getIndex(), getSecondaryOutput()->getIndex() };
+    stampAt(sys, nodes);
+}
+
+void CCVS::stampNumeric(NumericSystem& sys) const {
+    int nodes[] = { getPrimaryInput()->getIndex(), getPrimaryOutput()->getIndex(),
+        getSecondaryInput()->getIndex(), getSecondaryOutput()->getIndex() };
+    stampAt(sys, nodes);
+}
+
+void VCCS::stampNumeric(NumericSystem& sys) const {
+    int nodes[] = { getPrimaryInput()->getIndex(), getPrimaryOutput()->getIndex(),
+        getSecondaryInput()->getIndex(), getSecondaryOutput()->getIndex() };
+    stampAt(sys, nodes);
+}
+
+void CCCS::stampNumeric(NumericSystem& sys) const {
+    int nodes[] = { getPrimaryInput()->getIndex(), getPrimaryOutput()->getIndex(),
+        getSecondaryInput()->getIndex(), getSecondaryOutput()->getIndex() };
+    stampAt(sys, nodes);
+}
+
+// Nullor: V_in+ = V_in-, output current is whatever it needs to be
+
+void OperationalAmplifier::stampNumeric(NumericSystem& sys) const {
+    int in_p = getPrimaryInput()->getIndex(), in_n = getSecondaryInput()->getIndex();
+    int out = getPrimaryOutput()->getIndex();
+    int k = getBranchIndex();
+
+    sys.G.add(k, in_p, 1);
+    sys.G.add(k, in_n, -1);
+    sys.G.add(out, k, 1);
+}
+
+// Derivative stamps by the ratio, gyration resistance or gain, see CircuitElement::stampDerivative()
+
+bool Transformer::stampDerivative(NumericSystem& sys) const {
+    int pri_in = getPrimaryInput()->getIndex(), pri_out = getPrimaryOutput()->getIndex();
+    int sec_in = getSecondaryInput()->getIndex(), sec_out = getSecondaryOutput()->getIndex();
+    double n = numeric.value();
+    int k = getBranchIndex();
+
+    sys.G.add(k, pri_in, -1);
+    sys.G.add(k, pri_out, 1);
+    sys.G.add(sec_in, k, 1 / (n * n));
+    sys.G.add(sec_out, k, -1 / (n * n));
+    return true;
+}
+
+bool Girator::stampDerivative(NumericSystem& sys) const {
+    int k1 = getBranchIndex(), k2 = k1 + 1;
+
+    sys.G.add(k1, k1, -1);
+    sys.G.add(k2, k2, 1);
+    return true;
+}
+
+bool VCVS::stampDerivative(NumericSystem& sys) const {
+    int c_in = getSecondaryInput()->getIndex(), c_out = getSecondaryOutput()->getIndex();
+    int k = getBranchIndex();
+
+    sys.G.add(k, c_in, -1);
+    sys.G.add(k, c_out, 1);
+    return true;
+}
+
+bool CCVS::stampDerivative(NumericSystem& sys) const {
+    int kc = getBranchIndex(), k = kc + 1;
+    sys.G.add(k, kc, -1);
+    return true;
+}
+
+bool VCCS::stampDerivative(NumericSystem& sys) const {
+    int c_in = getSecondaryInput()->getIndex(), c_out = getSecondaryOutput()->getIndex();
+    int in = getPrimaryInput()->getIndex(), out = getPrimaryOutput()->getIndex();
+
+    sys.G.add(in, c_in, 1);
+    sys.G.add(in, c_out, -1);
+    sys.G.add(out, c_in, -1);
+    sys.G.add(out, c_out, 1);
+    return true;
+}
+
+bool CCCS::stampDerivative(NumericSystem& sys) const {
+    int in = getPrimaryInput()->getIndex(), out = getPrimaryOutput()->getIndex();
+    int kc = getBranchIndex();
+
+    sys.G.add(in, kc, 1);
+    sys.G.add(out, kc, -1);
+    return true;
+}
+
+// Preflight links, see Connectivity.h
+// Terminals are the primary input and output, then the secondary ones (the control probe of controlled sources)
+
+void Transformer::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    links.join(0, 1);
+    links.join(2, 3);
+}
+
+void Girator::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    links.join(0, 1);
+    links.join(2, 3);
+}
+
+// A voltage probe draws no current, so it links nothing: a node that is only sensed has an empty KCL row
+// and has to be tied to ground by other elements
+
+void VCVS::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    links.freeCurrent(0, 1);
+}
+
+// The probe is a short whose current the output reads
+
+void CCVS::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    links.freeCurrent(0, 1);
+    links.fixVoltage(2, 3);
+}
+
+void CCCS::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    links.fixVoltage(2, 3);
+}
+
+// The output is a current source and the probe draws no current, the terminals stay unlinked
+
+void VCCS::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+}
 
-    G(aux_row, c_in) += 1;
-    G(aux_row, c_out) -= 1;
+// V(primary input) = V(secondary input), the output current goes to ground and no equation reads the
+// output potential. The secondary output is not used
 
-    G(in, aux_row) += h;
-    G(out, aux_row) -= h;
+void OperationalAmplifier::linkTerminals(AnalysisType analysis, TerminalLinks& links) const {
+    links.fixVoltage(0, 2);
 }
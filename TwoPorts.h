@@ -1,6 +1,7 @@
 #pragma once
 #include "Node.h"
 #include "Component.h"
+#include "NumericSystem.h"
 #include <memory>
 #include <ginac/ginac.h>
 
@@ -20,6 +21,8 @@ public:
 
     virtual ~TwoPort() = default;
 
+	std::string getSym() const { return symbol; }
+
 	ex getVoltage1() const { return v1; }
 	ex getVoltage2() const { return v2; }
 
@@ -37,6 +40,8 @@ public:
 	std::shared_ptr<Node> getPrimaryOutput() const { return pri_out; }
 	std::shared_ptr<Node> getSecondaryOutput() const { return sec_out; }
 
+	std::vector<std::shared_ptr<Node>> getTerminals() const override { return { pri_in, pri_out, sec_in, sec_out }; }
+
 	virtual void stamp(matrix& G, matrix& I, AnalysisType analysis) const = 0;
 };
 
@@ -45,16 +50,23 @@ class Transformer : public TwoPort
 	// voltage2 = n * voltage1
 	// current2 = -current1 / n
 	ex ratio;
+	NumericValue numeric;
 
 public:
-	Transformer(ex n) : TwoPort(), ratio(n) {}
+	Transformer(ex n) : TwoPort(), ratio(n), numeric(n) {}
 	Transformer(const std::string& sym, ex n, std::shared_ptr<Node> pri_in,std::shared_ptr<Node> pri_out,
-		std::shared_ptr<Node> sec_in, std::shared_ptr<Node> sec_out) {}
+		std::shared_ptr<Node> sec_in, std::shared_ptr<Node> sec_out)
+		: TwoPort("T" + sym, pri_in, pri_out, sec_in, sec_out), ratio(n), numeric(n) {}
 
 	ex getRatio() { return ratio; }
-	void setRatio(ex newRatio) {ratio = newRatio; }
+	void setRatio(ex newRatio) {ratio = newRatio; numeric = NumericValue(newRatio); valuesChanged(); }
 
+	size_t branchCount() const override { return 1; }
 	virtual void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	bool isNumeric() const override { return numeric.isNumeric(); }
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 class Girator : public TwoPort
@@ -62,16 +74,23 @@ class Girator : public TwoPort
 	// voltage2 = r * current 1
 	// voltage1 = -r * current 2
 	ex gyResistance;
+	NumericValue numeric;
 
 public:
-	Girator(ex r) : TwoPort(), gyResistance(r) {}
+	Girator(ex r) : TwoPort(), gyResistance(r), numeric(r) {}
 	Girator(const std::string& sym, ex r, std::shared_ptr<Node> pri_in,std::shared_ptr<Node> pri_out,
-		std::shared_ptr<Node> sec_in, std::shared_ptr<Node> sec_out) {}
+		std::shared_ptr<Node> sec_in, std::shared_ptr<Node> sec_out)
+		: TwoPort("GY" + sym, pri_in, pri_out, sec_in, sec_out), gyResistance(r), numeric(r) {}
 
 	ex getResistance() { return gyResistance; }
-	void setResistance(ex r) { gyResistance = r; }
+	void setResistance(ex r) { gyResistance = r; numeric = NumericValue(r); valuesChanged(); }
 
+	size_t branchCount() const override { return 2; }
 	virtual void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	bool isNumeric() const override { return numeric.isNumeric(); }
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 // Controlled sources
@@ -80,17 +99,23 @@ public:
 class ControlledSource : public TwoPort
 {
 	ex gain;
+	NumericValue numeric;
+
+protected:
+	double numericGain() const { return numeric.value(); }
 
 public:
-	ControlledSource(ex control) : TwoPort(), gain(control) {}
+	ControlledSource(ex control) : TwoPort(), gain(control), numeric(control) {}
 	ControlledSource(const std::string& sym, std::shared_ptr<Node> in, std::shared_ptr<Node> out,
-		std::shared_ptr<Node> c_in, std::shared_ptr<Node> c_out, ex control) {}
+		std::shared_ptr<Node> c_in, std::shared_ptr<Node> c_out, ex control)
+		: TwoPort(sym, in, out, c_in, c_out), gain(control), numeric(control) {}
 	ex getControlValue() const { return gain; }
-	void setControlValue(ex control) { gain = control; }
+	void setControlValue(ex control) { gain = control; numeric = NumericValue(control); valuesChanged(); }
 
 	virtual ex calculateControlValue();
 
 	virtual void stamp(matrix& G, matrix& I, AnalysisType analysis) const = 0;
+	bool isNumeric() const override { return numeric.isNumeric(); }
 };
 
 class VCVS : public ControlledSource
@@ -108,7 +133,25 @@ public:
 
 	ex calculateControlValue() override;
 
+	size_t branchCount() const override { return 1; }
 	void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	// Numeric stamp on the node ids of getTerminals(), see Resistor::stampAt()
+	void stampAt(NumericSystem& sys, const int* nodes) const {
+		int in = nodes[0], out = nodes[1], c_in = nodes[2], c_out = nodes[3];
+		double g = numericGain();
+		int k = getBranchIndex();
+
+		sys.G.add(k, in, 1);
+		sys.G.add(k, out, -1);
+		sys.G.add(k, c_in, -g);
+		sys.G.add(k, c_out, g);
+
+		sys.G.add(in, k, 1);
+		sys.G.add(out, k, -1);
+	}
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 class CCVS : public ControlledSource
@@ -126,7 +169,28 @@ public:
 
 	ex calculateControlValue() override;
 
+	size_t branchCount() const override { return 2; }
 	virtual void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	// The control probe is a short circuit with its own branch current
+	void stampAt(NumericSystem& sys, const int* nodes) const {
+		int in = nodes[0], out = nodes[1], c_in = nodes[2], c_out = nodes[3];
+		double h = numericGain();
+		int kc = getBranchIndex(), k = kc + 1;
+
+		sys.G.add(kc, c_in, 1);
+		sys.G.add(kc, c_out, -1);
+		sys.G.add(c_in, kc, 1);
+		sys.G.add(c_out, kc, -1);
+
+		sys.G.add(k, in, 1);
+		sys.G.add(k, out, -1);
+		sys.G.add(k, kc, -h);
+		sys.G.add(in, k, 1);
+		sys.G.add(out, k, -1);
+	}
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 class CCCS : public ControlledSource
@@ -144,7 +208,24 @@ public:
 
 	ex calculateControlValue() override;
 	
+	size_t branchCount() const override { return 1; }
 	virtual void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampAt(NumericSystem& sys, const int* nodes) const {
+		int in = nodes[0], out = nodes[1], c_in = nodes[2], c_out = nodes[3];
+		double h = numericGain();
+		int kc = getBranchIndex();
+
+		sys.G.add(kc, c_in, 1);
+		sys.G.add(kc, c_out, -1);
+		sys.G.add(c_in, kc, 1);
+		sys.G.add(c_out, kc, -1);
+
+		sys.G.add(in, kc, h);
+		sys.G.add(out, kc, -h);
+	}
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 class VCCS : public ControlledSource
@@ -163,6 +244,18 @@ public:
 	ex calculateControlValue() override;
 
 	virtual void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampAt(NumericSystem& sys, const int* nodes) const {
+		int in = nodes[0], out = nodes[1], c_in = nodes[2], c_out = nodes[3];
+		double g = numericGain();
+
+		sys.G.add(in, c_in, g);
+		sys.G.add(in, c_out, -g);
+		sys.G.add(out, c_in, -g);
+		sys.G.add(out, c_out, g);
+	}
+	void stampNumeric(NumericSystem& sys) const override;
+	bool stampDerivative(NumericSystem& sys) const override;
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
 
 // Operational Amplifier
@@ -186,5 +279,9 @@ public:
 	void setVoltage1(ex volt) override {}
 	void setCurrent1(ex curr) override {}
 
+	size_t branchCount() const override { return 1; }
 	virtual void stamp(matrix& G, matrix& I, AnalysisType analysis) const override;
+	void stampNumeric(NumericSystem& sys) const override;
+	bool isNumeric() const override { return true; }
+	void linkTerminals(AnalysisType analysis, TerminalLinks& links) const override;
 };
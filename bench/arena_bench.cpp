@@ -0,0 +1,98 @@
+// Numeric stamping of arena and heap elements
+// Builds the same n x n RC mesh twice, once with std::make_shared and addComponent() and once with
+// Circuit::emplace(), and times building and the Stamping phase of a DC solve (best of `repeats`). One JSON
+// object per thread count; max_difference compares the two solutions, they should agree exactly.
+// Usage: arena_bench [side] [repeats]
+
+#include "Circuit.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+template <bool Arena, typename T, typename... Args>
+void add(Circuit& circuit, Args&&... args) {
+    if constexpr (Arena) circuit.emplace<T>(std::forward<Args>(args)...);
+    else circuit.addComponent(std::make_shared<T>(std::forward<Args>(args)...));
+}
+
+template <bool Arena>
+Circuit mesh(size_t n) {
+    Circuit circuit;
+    std::vector<std::shared_ptr<Node>> nodes(n * n);
+    for (size_t k = 0; k < nodes.size(); k++) {
+        nodes[k] = std::make_shared<Node>("n" + std::to_string(k));
+        circuit.addNode(nodes[k]);
+    }
+    size_t count = 0;
+    auto ground = Node::getGround();
+    ex c = 1e-12, i = 1e-6, v = 1.0; // The source constructors take non-const references
+    for (size_t y = 0; y < n; y++) {
+        for (size_t x = 0; x < n; x++) {
+            auto& a = nodes[y * n + x];
+            if (x + 1 < n) {
+                count++;
+                std::string name = std::to_string(count);
+                ex r = 1e3 + count % 97;
+                add<Arena, Resistor>(circuit, name, r, a, nodes[y * n + x + 1]);
+            }
+            if (y + 1 < n) {
+                count++;
+                std::string name = std::to_string(count);
+                ex r = 1e3 + count % 89;
+                add<Arena, Resistor>(circuit, name, r, a, nodes[(y + 1) * n + x]);
+            }
+            add<Arena, Capacitor>(circuit, std::to_string(++count), c, a, ground);
+            add<Arena, CurrentSource>(circuit, std::to_string(++count), i, a, ground);
+        }
+    }
+    add<Arena, VoltageSource>(circuit, std::to_string(++count), v, nodes[0], ground);
+    add<Arena, VoltageSource>(circuit, std::to_string(++count), v, nodes.back(), ground);
+    return circuit;
+}
+
+template <bool Arena>
+double run(size_t n, unsigned threads, size_t repeats, double& build, std::vector<std::complex<double>>& solution) {
+    double stamping = 1e300;
+    build = 1e300;
+    for (size_t r = 0; r < repeats; r++) {
+        auto start = std::chrono::steady_clock::now();
+        Circuit circuit = mesh<Arena>(n);
+        build = std::min(build, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        circuit.setAssemblyThreads(threads);
+        circuit.setProfiling(true);
+        circuit.solve();
+        stamping = std::min(stamping, circuit.getSolveStats().phaseSeconds(SolvePhase::Stamping));
+        solution = circuit.getSolution();
+    }
+    return stamping;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t side = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 300;
+    size_t repeats = argc > 2 ? std::max<size_t>(1, std::strtoul(argv[2], nullptr, 10)) : 3;
+
+    for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+        double heap_build, arena_build;
+        std::vector<std::complex<double>> heap_solution, arena_solution;
+        double heap = run<false>(side, threads, repeats, heap_build, heap_solution);
+        double arena = run<true>(side, threads, repeats, arena_build, arena_solution);
+
+        double difference = 0;
+        for (size_t k = 0; k < heap_solution.size(); k++) difference = std::max(difference, std::abs(heap_solution[k] - arena_solution[k]));
+        std::cout << "{\"side\": " << side << ", \"threads\": " << threads << ", \"unknowns\": " << heap_solution.size()
+                  << ", \"heap_build_seconds\": " << heap_build << ", \"arena_build_seconds\": " << arena_build
+                  << ", \"heap_stamp_seconds\": " << heap << ", \"arena_stamp_seconds\": " << arena
+                  << ", \"max_difference\": " << difference << "}" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Stamp and solve times across circuit families and sizes
+// Numeric runs time the sparse stamps and the DC and AC solves, symbolic runs (small sizes only) time the
+// GiNaC stamps and the transfer function V(out) / V(in) and count expression nodes. Prints one JSON
+// object per run, with the peak resident set of that run where the kernel can reset it, and the
+// per phase profile of the DC solve (see SolveStats.h).
+// Usage: circuit_bench [family] [scale] [repeats] [threads]
+//   family: all, ladder, mesh2d, mesh3d, rc_tree, rlc_tree, opamp (default all)
+//   scale multiplies the numeric sizes (default 1), times are the best of `repeats` runs (default 3)
+//   threads for the numeric assembly, see Circuit::setAssemblyThreads (default 1, 0 is all cores)
+
+#include "Circuit.h"
+#include "SymbolicSolver.h"
+#include "generators.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Linux 4.0+ resets VmHWM through clear_refs, otherwise the peak is the process wide one
+void resetPeakRSS() {
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+long peakRSSKilobytes() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::strtol(line.c_str() + 6, nullptr, 10);
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct Family
+{
+    const char* name;
+    std::function<Circuit(size_t, bool)> make;
+    std::vector<size_t> numeric;  // Sizes before scaling
+    std::vector<size_t> symbolic; // Sizes for the GiNaC path
+};
+
+// Best of `repeats`
+double best(size_t repeats, const std::function<void()>& run) {
+    double result = std::numeric_limits<double>::infinity();
+    for (size_t k = 0; k < repeats; k++) {
+        auto start = Clock::now();
+        run();
+        result = std::min(result, since(start));
+    }
+    return result;
+}
+
+void numericRun(const Family& family, size_t size, size_t repeats, unsigned threads) {
+    resetPeakRSS();
+    auto start = Clock::now();
+    Circuit circuit = family.make(size, false);
+    double build = since(start);
+    const auto& elements = circuit.getTopology().elementHandles();
+
+    circuit.setProfiling(true);
+    circuit.setAssemblyThreads(threads);
+    circuit.setAnalysisType(AnalysisType::DC);
+    double dc = best(repeats, [&] { circuit.solve(); });
+    size_t n = circuit.getSolution().size();
+    std::string profile = circuit.getSolveStats().toJSON(); // Of the last repeat
+
+    // Solves assigned the indices, restamping on its own gives the stamp share
+    size_t entries = 0;
+    double stamp = best(repeats, [&] {
+        NumericSystem sys(n);
+        for (const auto& element : elements) element->stampNumeric(sys);
+        entries = sys.G.entries() + sys.C.entries();
+    });
+
+    circuit.setAnalysisType(AnalysisType::AC);
+    circuit.setFrequency(2 * 3.141592653589793 * 1e6);
+    double ac = best(repeats, [&] { circuit.solve(); });
+
+    auto out = circuit.findNode("out");
+    double v_out = out ? std::abs(circuit.getSolution()[out->getIndex()]) : 0.0;
+
+    std::cout << "{\"circuit\": \"" << family.name << "\", \"size\": " << size << ", \"backend\": \"numeric\""
+              << ", \"threads\": " << threads << ", \"unknowns\": " << n << ", \"elements\": " << elements.size() << ", \"stamp_entries\": " << entries
+              << ", \"build_seconds\": " << build << ", \"stamp_seconds\": " << stamp
+              << ", \"dc_solve_seconds\": " << dc << ", \"ac_solve_seconds\": " << ac
+              << ", \"ac_out\": " << v_out << ", \"dc_profile\": " << profile
+              << ", \"peak_rss_kb\": " << peakRSSKilobytes() << "}" << std::endl;
+}
+
+void symbolicRun(const Family& family, size_t size, size_t repeats) {
+    resetPeakRSS();
+    Circuit circuit = family.make(size, true);
+    const auto& elements = circuit.getTopology().elementHandles();
+
+    SymbolicStats stats;
+    ex H = circuit.transferFunction("out", "in", &stats);
+    size_t n = stats.unknowns;
+
+    size_t stamp_nodes = 0;
+    double stamp = best(repeats, [&] {
+        matrix G(n, n), I(n, 1);
+        for (const auto& element : elements) element->stamp(G, I, AnalysisType::AC);
+        stamp_nodes = 0;
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                if (!G(i, j).is_zero()) stamp_nodes += expressionSize(G(i, j));
+            }
+            if (!I(i, 0).is_zero()) stamp_nodes += expressionSize(I(i, 0));
+        }
+    });
+
+    std::cout << "{\"circuit\": \"" << family.name << "\", \"size\": " << size << ", \"backend\": \"symbolic\""
+              << ", \"unknowns\": " << n << ", \"elements\": " << elements.size() << ", \"stamp_entries\": " << stats.entries
+              << ", \"stamp_nodes\": " << stamp_nodes << ", \"stamp_seconds\": " << stamp
+              << ", \"solve_seconds\": " << stats.seconds << ", \"fill\": " << stats.fill
+              << ", \"largest_entry_nodes\": " << stats.largestEntry << ", \"result_nodes\": " << expressionSize(H)
+              << ", \"peak_rss_kb\": " << peakRSSKilobytes() << "}" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string only = argc > 1 ? argv[1] : "all";
+    size_t scale = argc > 2 ? std::max<size_t>(1, std::strtoul(argv[2], nullptr, 10)) : 1;
+    size_t repeats = argc > 3 ? std::max<size_t>(1, std::strtoul(argv[3], nullptr, 10)) : 3;
+    unsigned threads = argc > 4 ? static_cast<unsigned>(std::strtoul(argv[4], nullptr, 10)) : 1;
+
+    const std::vector<Family> families = {
+        { "ladder", resistorLadder, { 100, 1000, 10000, 100000 }, { 2, 4, 8 } },
+        { "mesh2d", resistorMesh2D, { 10, 30, 100, 300 }, { 2, 3 } },
+        { "mesh3d", resistorMesh3D, { 5, 10, 15, 20 }, { 2 } },
+        { "rc_tree", rcTree, { 6, 10, 14, 17 }, { 1, 2, 3 } },
+        { "rlc_tree", rlcTree, { 6, 10, 14, 16 }, { 1, 2 } },
+        { "opamp", opampCascade, { 10, 100, 1000, 10000 }, { 1, 2, 4 } },
+    };
+
+    bool found = false;
+    for (const auto& family : families) {
+        if (only != "all" && only != family.name) continue;
+        found = true;
+        // Trees grow by depth, a larger scale adds levels instead of multiplying them
+        for (size_t size : family.numeric) {
+            bool byDepth = std::string(family.name).find("tree") != std::string::npos;
+            size_t scaled = byDepth ? size + static_cast<size_t>(std::log2(static_cast<double>(scale))) : size * scale;
+            numericRun(family, scaled, repeats, threads);
+        }
+        for (size_t size : family.symbolic) symbolicRun(family, size, repeats);
+    }
+    if (!found) {
+        std::cerr << "Unknown circuit family " << only << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+// Domain decomposition solves of large resistor meshes
+// Every mesh is solved once with a single BlockLU and then split into 2 .. 64 domains, each run prints one
+// JSON object with the interface size, the phase times and the largest deviation from the single LU solution.
+// Usage: domain_bench [2d side] [3d side] [threads]
+
+#include "Circuit.h"
+#include "generators.h"
+#include <algorithm>
+#include <complex>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+int main(int argc, char** argv) {
+    size_t side2 = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 400;
+    size_t side3 = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 24;
+    unsigned threads = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 0;
+
+    struct Family { const char* name; std::function<Circuit()> make; };
+    const std::vector<Family> families = {
+        { "mesh2d", [&] { return resistorMesh2D(side2, false); } },
+        { "mesh3d", [&] { return resistorMesh3D(side3, false); } },
+    };
+
+    for (const auto& family : families) {
+        std::vector<std::complex<double>> reference;
+        for (size_t parts : { 1, 2, 4, 8, 16, 32, 64 }) {
+            Circuit circuit = family.make();
+            circuit.setDomainDecomposition(parts, threads);
+            circuit.setProfiling(true);
+            circuit.solve();
+            const SolveStats& stats = circuit.getSolveStats();
+
+            const auto& x = circuit.getSolution();
+            if (parts == 1) reference = x;
+            double deviation = 0;
+            for (size_t k = 0; k < x.size(); k++) deviation = std::max(deviation, std::abs(x[k] - reference[k]));
+
+            std::cout << "{\"circuit\": \"" << family.name << "\", \"unknowns\": " << stats.unknowns << ", \"parts\": " << parts
+                      << ", \"domains\": " << stats.domains << ", \"interface\": " << stats.interfaceUnknowns
+                      << ", \"factor_nonzeros\": " << stats.factorNonZeros
+                      << ", \"analysis_seconds\": " << stats.phaseSeconds(SolvePhase::Analysis)
+                      << ", \"factorization_seconds\": " << stats.phaseSeconds(SolvePhase::Factorization)
+                      << ", \"solve_seconds\": " << stats.phaseSeconds(SolvePhase::Solve)
+                      << ", \"total_seconds\": " << stats.totalSeconds << ", \"max_deviation\": " << deviation << "}" << std::endl;
+        }
+    }
+    return 0;
+}
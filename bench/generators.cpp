@@ -0,0 +1,179 @@
+#include "generators.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Values and names for one circuit, the sequence restarts with every generator call
+class Builder
+{
+    Circuit& circuit;
+    bool symbolic;
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    size_t count = 0;
+
+    // nominal * [0.5, 1.5), or a fresh symbol
+    ex value(const char* prefix, double nominal) {
+        std::string id = std::to_string(++count);
+        if (symbolic) return symbol(prefix + id);
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return nominal * (0.5 + static_cast<double>(state >> 11) / 9007199254740992.0);
+    }
+
+public:
+    Builder(Circuit& c, bool sym) : circuit(c), symbolic(sym) {}
+
+    std::shared_ptr<Node> node(const std::string& name) {
+        auto n = std::make_shared<Node>(name);
+        circuit.addNode(n);
+        return n;
+    }
+
+    void resistor(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, double nominal = 1e3) {
+        ex r = value("R", nominal);
+        circuit.addComponent(std::make_shared<Resistor>(std::to_string(count), r, a, b));
+    }
+    void capacitor(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, double nominal = 1e-9) {
+        ex c = value("C", nominal);
+        circuit.addComponent(std::make_shared<Capacitor>(std::to_string(count), c, a, b));
+    }
+    void inductor(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, double nominal = 1e-6) {
+        ex l = value("L", nominal);
+        circuit.addComponent(std::make_shared<Inductor>(std::to_string(count), l, a, b));
+    }
+    void voltage(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, double nominal = 1.0) {
+        ex v = symbolic ? ex(symbol("V" + std::to_string(++count))) : ex(nominal);
+        circuit.addComponent(std::make_shared<VoltageSource>(std::to_string(count), v, a, b));
+    }
+    void current(const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b, double nominal = 1e-3) {
+        ex i = value("I", nominal);
+        circuit.addComponent(std::make_shared<CurrentSource>(std::to_string(count), i, a, b));
+    }
+    void opamp(const std::shared_ptr<Node>& plus, const std::shared_ptr<Node>& minus,
+        const std::shared_ptr<Node>& out) {
+        circuit.addComponent(std::make_shared<OperationalAmplifier>(std::to_string(++count), plus, minus, out, Node::getGround()));
+    }
+};
+
+// Mesh over a box of nodes, dims holds the extent along each axis
+Circuit mesh(const std::vector<size_t>& dims, bool symbolic) {
+    Circuit circuit;
+    Builder b(circuit, symbolic);
+    auto ground = Node::getGround();
+
+    size_t total = 1;
+    for (size_t d : dims) total *= d;
+    if (total == 0) return circuit;
+
+    std::vector<std::shared_ptr<Node>> nodes(total);
+    for (size_t k = 0; k < total; k++) {
+        std::string name = k == 0 ? "in" : k == total / 2 ? "out" : "n" + std::to_string(k);
+        nodes[k] = b.node(name);
+    }
+
+    for (size_t k = 0; k < total; k++) {
+        size_t stride = 1, rest = k;
+        for (size_t d : dims) {
+            if (rest % d + 1 < d) b.resistor(nodes[k], nodes[k + stride], 0.1);
+            rest /= d;
+            stride *= d;
+        }
+        b.current(nodes[k], ground);
+    }
+
+    // Pads on the corners of the first two axes
+    size_t nx = dims[0], ny = dims.size() > 1 ? dims[1] : 1;
+    std::vector<size_t> pads = { 0, nx - 1, nx * (ny - 1), nx * ny - 1 };
+    for (size_t k = 0; k < pads.size(); k++) {
+        bool repeated = false;
+        for (size_t j = 0; j < k; j++) repeated = repeated || pads[j] == pads[k];
+        if (!repeated) b.voltage(nodes[pads[k]], ground);
+    }
+    return circuit;
+}
+
+Circuit tree(size_t depth, bool withInductors, bool symbolic) {
+    Circuit circuit;
+    Builder b(circuit, symbolic);
+    auto ground = Node::getGround();
+
+    size_t count = (size_t(1) << (depth + 1)) - 1;
+    std::vector<std::shared_ptr<Node>> nodes(count);
+    auto source = b.node("in");
+    nodes[0] = b.node("root");
+    b.voltage(source, ground);
+    b.resistor(source, nodes[0], 50);
+
+    for (size_t k = 1; k < count; k++) {
+        nodes[k] = b.node(k == count - 1 ? "out" : "n" + std::to_string(k));
+        const auto& parent = nodes[(k - 1) / 2];
+        if (withInductors) {
+            auto mid = b.node("m" + std::to_string(k));
+            b.resistor(parent, mid, 10);
+            b.inductor(mid, nodes[k]);
+        }
+        else {
+            b.resistor(parent, nodes[k], 10);
+        }
+        b.capacitor(nodes[k], ground, 1e-12);
+    }
+    b.capacitor(nodes[0], ground, 1e-12);
+    return circuit;
+}
+
+} // namespace
+
+Circuit resistorLadder(size_t sections, bool symbolic) {
+    Circuit circuit;
+    Builder b(circuit, symbolic);
+    auto ground = Node::getGround();
+
+    auto prev = b.node("in");
+    b.voltage(prev, ground);
+    for (size_t k = 1; k <= sections; k++) {
+        auto node = b.node(k == sections ? "out" : "n" + std::to_string(k));
+        b.resistor(prev, node);
+        b.resistor(node, ground, 1e4);
+        prev = node;
+    }
+    return circuit;
+}
+
+Circuit resistorMesh2D(size_t n, bool symbolic) {
+    return mesh({ n, n }, symbolic);
+}
+
+Circuit resistorMesh3D(size_t n, bool symbolic) {
+    return mesh({ n, n, n }, symbolic);
+}
+
+Circuit rcTree(size_t depth, bool symbolic) {
+    return tree(depth, false, symbolic);
+}
+
+Circuit rlcTree(size_t depth, bool symbolic) {
+    return tree(depth, true, symbolic);
+}
+
+Circuit opampCascade(size_t stages, bool symbolic) {
+    Circuit circuit;
+    Builder b(circuit, symbolic);
+    auto ground = Node::getGround();
+
+    auto prev = b.node("in");
+    b.voltage(prev, ground);
+    for (size_t k = 1; k <= stages; k++) {
+        std::string id = std::to_string(k);
+        auto x = b.node("a" + id), y = b.node("b" + id);
+        auto out = b.node(k == stages ? "out" : "o" + id);
+        b.resistor(prev, x, 1e4);
+        b.resistor(x, y, 1e4);
+        b.capacitor(x, out, 2e-9);
+        b.capacitor(y, ground, 1e-9);
+        b.opamp(y, out, out); // Follower
+        prev = out;
+    }
+    return circuit;
+}
@@ -0,0 +1,23 @@
+#pragma once
+// Synthetic circuits for the benchmarks
+// Every generator names its driven node "in" and the node worth probing "out". Element values are
+// numbers from a fixed pseudo random sequence, or one symbol per element when `symbolic` is set.
+
+#include "Circuit.h"
+#include <cstddef>
+
+// Source, then `sections` times a series and a shunt resistor
+Circuit resistorLadder(size_t sections, bool symbolic = false);
+
+// Power grid like n x n (x n) resistor mesh with a load current at every node and
+// voltage pads at the corners
+Circuit resistorMesh2D(size_t n, bool symbolic = false);
+Circuit resistorMesh3D(size_t n, bool symbolic = false);
+
+// Complete binary tree of the given depth, fed at the root through a source resistor. Every branch is
+// a resistor (in series with an inductor for RLC) and every node has a capacitor to ground
+Circuit rcTree(size_t depth, bool symbolic = false);
+Circuit rlcTree(size_t depth, bool symbolic = false);
+
+// Cascade of unity gain Sallen-Key low pass stages around ideal op-amps
+Circuit opampCascade(size_t stages, bool symbolic = false);
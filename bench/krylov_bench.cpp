@@ -0,0 +1,85 @@
+// Iterative DC solves of power grid meshes against the sparse LU
+// Every mesh is solved once by LU (up to `lu limit` nodes) and by CG with each preconditioner, then once
+// more from the converged solution after a small load change (the warm start). One JSON object per run with
+// the iterations, setup and iteration seconds and the largest deviation from the LU solution.
+// Usage: krylov_bench [mesh side] [lu limit] [threads]
+
+#include "Circuit.h"
+#include "generators.h"
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+int main(int argc, char** argv) {
+    size_t side = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500;
+    size_t lu_limit = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    unsigned threads = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 0;
+
+    struct Family { const char* name; std::function<Circuit()> make; };
+    const std::vector<Family> families = {
+        { "mesh2d", [&] { return resistorMesh2D(side, false); } },
+        { "mesh3d", [&] { return resistorMesh3D(side / 8, false); } },
+    };
+    struct Setting { const char* name; KrylovPreconditioner preconditioner; size_t fill; };
+    const std::vector<Setting> settings = {
+        { "multigrid", KrylovPreconditioner::Multigrid, 0 },
+        { "ilu0", KrylovPreconditioner::ILU, 0 },
+        { "ilu2", KrylovPreconditioner::ILU, 2 },
+        { "jacobi", KrylovPreconditioner::Jacobi, 0 },
+    };
+
+    for (const auto& family : families) {
+        std::vector<std::complex<double>> reference;
+        double lu_seconds = 0;
+        Circuit direct = family.make();
+        if (direct.getTopology().nodeCount() <= lu_limit) {
+            direct.setAssemblyThreads(threads);
+            auto start = std::chrono::steady_clock::now();
+            direct.solve();
+            lu_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            reference = direct.getSolution();
+        }
+
+        for (const auto& setting : settings) {
+            Circuit circuit = family.make();
+            KrylovOptions options;
+            options.preconditioner = setting.preconditioner;
+            options.fill = setting.fill;
+            options.maxIterations = 10000;
+            options.threads = threads;
+            circuit.setAssemblyThreads(threads);
+            circuit.setIterativeSolver(true, options);
+
+            auto start = std::chrono::steady_clock::now();
+            circuit.solve();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            KrylovStats stats = circuit.getKrylovStats();
+
+            double deviation = 0;
+            for (size_t k = 0; k < reference.size(); k++) deviation = std::max(deviation, std::abs(reference[k] - circuit.getSolution()[k]));
+
+            // The load in the middle of the element list 1 % up (the first ones sit on pads), solved from the last solution
+            std::vector<std::shared_ptr<CurrentSource>> loads;
+            for (const auto& element : circuit.getTopology().elementHandles()) {
+                if (auto load = std::dynamic_pointer_cast<CurrentSource>(element)) loads.push_back(load);
+            }
+            ex value = loads[loads.size() / 2]->getCurrent() * 1.01;
+            loads[loads.size() / 2]->setCurrent(value);
+            circuit.solve();
+
+            std::cout << "{\"circuit\": \"" << family.name << "\", \"preconditioner\": \"" << setting.name
+                      << "\", \"unknowns\": " << stats.unknowns << ", \"fixed_nodes\": " << stats.fixedNodes
+                      << ", \"iterations\": " << stats.iterations << ", \"levels\": " << stats.levels
+                      << ", \"preconditioner_nonzeros\": " << stats.preconditionerNonZeros
+                      << ", \"setup_seconds\": " << stats.setupSeconds << ", \"iteration_seconds\": " << stats.iterationSeconds
+                      << ", \"solve_seconds\": " << seconds << ", \"lu_seconds\": " << lu_seconds
+                      << ", \"max_deviation\": " << deviation
+                      << ", \"warm_iterations\": " << circuit.getKrylovStats().iterations << "}" << std::endl;
+        }
+    }
+    return 0;
+}
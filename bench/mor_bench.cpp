@@ -0,0 +1,45 @@
+// PRIMA model order reduction of RC and RLC trees
+// Ports are the root, the "out" leaf and the first leaf. For every order the reduction time and the
+// largest relative port impedance error against the full model over 1 MHz .. 10 GHz are printed as one
+// JSON object, with the time of that sweep on the full and on the reduced model.
+// Usage: mor_bench [largest depth]
+
+#include "Circuit.h"
+#include "generators.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    size_t largest = argc > 1 ? std::max<size_t>(2, std::strtoul(argv[1], nullptr, 10)) : 16;
+    std::vector<double> frequencies = sweepFrequencies(SweepType::Decade, 10, 1e6, 1e10);
+
+    struct Family { const char* name; std::function<Circuit(size_t, bool)> make; };
+    const std::vector<Family> families = { { "rc_tree", rcTree }, { "rlc_tree", rlcTree } };
+
+    for (const auto& family : families) {
+        for (size_t depth = 8; depth <= largest; depth += 4) {
+            Circuit circuit = family.make(depth, false);
+            std::string leaf = "n" + std::to_string((size_t(1) << depth) - 1);
+            std::vector<std::shared_ptr<Node>> ports = { circuit.findNode("root"), circuit.findNode("out"), circuit.findNode(leaf) };
+
+            for (size_t order : { 6, 12, 24, 48 }) {
+                ReductionOptions options;
+                options.order = order;
+                ReducedModel model = circuit.reduce(ports, options);
+                ReductionError error = circuit.reductionError(ports, model, frequencies);
+
+                std::cout << "{\"circuit\": \"" << family.name << "\", \"depth\": " << depth
+                          << ", \"nodes\": " << circuit.getTopology().nodeCount() << ", \"ports\": " << ports.size()
+                          << ", \"order\": " << model.order << ", \"reduction_seconds\": " << model.seconds
+                          << ", \"max_relative_error\": " << error.maxRelative << ", \"worst_hz\": " << error.worstFrequency
+                          << ", \"full_sweep_seconds\": " << error.fullSeconds
+                          << ", \"reduced_sweep_seconds\": " << error.reducedSeconds << "}" << std::endl;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+// Netlist parser throughput
+// Checks a few small decks first, then writes a synthetic RC mesh netlist (with subcircuits and controlled
+// sources) and times parsing and building separately. Usage: netlist_bench [megabytes] [file to keep]
+// Build: g++ -O2 -std=c++17 -I.. netlist_bench.cpp ../*.cpp -lginac -lcln
+
+#include "NetlistParser.h"
+#include "Circuit.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+static size_t writeNetlist(const std::string& path, size_t megabytes) {
+    std::ofstream out(path, std::ios::binary);
+    out << "synthetic rc mesh\n";
+    out << ".subckt cell a b\n"
+           "R1 a mid 1k\n"
+           "C1 mid 0 10p\n"
+           "R2 mid b 1.5k\n"
+           ".ends cell\n";
+    out << "V1 n0_0 0 DC 1 AC 1\n";
+
+    size_t target = megabytes * 1000 * 1000, line = 0;
+    char buffer[160];
+    for (size_t k = 0; static_cast<size_t>(out.tellp()) < target; k++) {
+        size_t row = k / 1000, col = k % 1000;
+        int len = 0;
+        switch (k % 8) {
+        case 0: case 1: case 2:
+            len = std::snprintf(buffer, sizeof buffer, "R%zu n%zu_%zu n%zu_%zu %zuk\n", k, row, col, row, col + 1, 1 + k % 97);
+            break;
+        case 3:
+            len = std::snprintf(buffer, sizeof buffer, "R%zu n%zu_%zu n%zu_%zu 4.7k ; vertical\n", k, row, col, row + 1, col);
+            break;
+        case 4:
+            len = std::snprintf(buffer, sizeof buffer, "C%zu n%zu_%zu 0 %zuf\n", k, row, col, 100 + k % 900);
+            break;
+        case 5:
+            len = std::snprintf(buffer, sizeof buffer, "X%zu n%zu_%zu n%zu_%zu cell\n", k, row, col, row + 1, col + 1);
+            break;
+        case 6:
+            len = std::snprintf(buffer, sizeof buffer, "G%zu n%zu_%zu 0 n%zu_%zu 0 1e-6\n", k, row, col, row, col + 2);
+            break;
+        default:
+            len = std::snprintf(buffer, sizeof buffer, "L%zu n%zu_%zu\n+ n%zu_%zu 1n\n", k, row, col, row + 1, col + 2);
+            break;
+        }
+        out.write(buffer, len);
+        line++;
+    }
+    out << ".tran 1n 1u\n.end\n";
+    return line;
+}
+
+// Decks whose .end arrives alone in a batch: after the title, after .ends and after a full batch
+static bool checkDecks() {
+    std::string full = "title\n";
+    for (int k = 0; k < 64; k++) full += "R" + std::to_string(k) + " a" + std::to_string(k) + " 0 1k\n";
+    full += ".end\nR99 x 0 1k\n";
+    struct Deck { std::string text; size_t cards; };
+    const Deck decks[] = {
+        { "title\n.end\n", 0 },
+        { "title\n.subckt a p q\nR1 p q 1k\n.ends\n.end\n", 1 },
+        { full, 64 },
+    };
+
+    bool ok = true;
+    for (const Deck& deck : decks) {
+        try {
+            NetlistParser parser;
+            parser.parseBuffer(deck.text.data(), deck.text.size());
+            if (parser.getStats().cards != deck.cards) {
+                std::cerr << "netlist check: " << parser.getStats().cards << " cards instead of " << deck.cards << "\n";
+                ok = false;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "netlist check: " << e.what() << "\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (!checkDecks()) return 1;
+
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100;
+    std::string path = argc > 2 ? argv[2] : "netlist_bench.cir";
+
+    size_t cards = writeNetlist(path, megabytes);
+
+    NetlistParser parser;
+    parser.parseFile(path);
+    Circuit circuit;
+    bool build = megabytes <= 20; // Building allocates a Node/Component per entry, keep it to smaller files
+    if (build) parser.build(circuit);
+
+    const NetlistStats& stats = parser.getStats();
+    std::cout << "{\"bytes\": " << stats.bytes << ", \"cards\": " << stats.cards << ", \"written\": " << cards
+              << ", \"parse_seconds\": " << stats.parseSeconds << ", \"mb_per_second\": " << stats.megabytesPerSecond();
+    if (build) std::cout << ", \"elements\": " << stats.elements << ", \"nodes\": " << stats.nodes << ", \"build_seconds\": " << stats.buildSeconds;
+    std::cout << "}" << std::endl;
+
+    if (argc <= 2) std::remove(path.c_str()); // Keep a file the caller named
+    return stats.megabytesPerSecond() >= 100 ? 0 : 1;
+}
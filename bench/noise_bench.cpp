@@ -0,0 +1,41 @@
+// Output noise of RC and RLC trees
+// Thermal noise of every resistor at the output node over a decade sweep, one adjoint solve per point on
+// 1 .. `threads` workers. One JSON object per run with the points per second and the RMS output noise,
+// which doesn't depend on the thread count.
+// Usage: noise_bench [depth] [points per decade] [threads]
+
+#include "Circuit.h"
+#include "generators.h"
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+int main(int argc, char** argv) {
+    size_t depth = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 12;
+    size_t points = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 500;
+    unsigned threads = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 8;
+
+    struct Family { const char* name; std::function<Circuit(size_t)> make; };
+    const std::vector<Family> families = {
+        { "rc_tree", [](size_t d) { return rcTree(d, false); } },
+        { "rlc_tree", [](size_t d) { return rlcTree(d, false); } },
+    };
+
+    for (const auto& family : families) {
+        Circuit circuit = family.make(depth);
+        auto out = circuit.findNode("out");
+        for (unsigned workers = 1; workers <= threads; workers *= 2) {
+            NoiseOptions options;
+            options.threads = workers;
+            NoiseResult result = circuit.noise(out, SweepType::Decade, points, 1, 1e9, nullptr, options);
+
+            std::cout << "{\"circuit\": \"" << family.name << "\", \"nodes\": " << circuit.getTopology().nodeCount()
+                      << ", \"generators\": " << result.elements.size() << ", \"points\": " << result.frequencies.size()
+                      << ", \"threads\": " << workers << ", \"seconds\": " << result.seconds
+                      << ", \"points_per_second\": " << result.frequencies.size() / result.seconds
+                      << ", \"rms_output\": " << result.integratedOutput() << "}" << std::endl;
+        }
+    }
+    return 0;
+}
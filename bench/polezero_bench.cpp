@@ -0,0 +1,44 @@
+// Dominant poles of RC and RLC trees
+// For every circuit the `count` poles closest to s = 0 are found by shift-invert Arnoldi, one JSON object
+// per run with the Krylov dimension it took, the time and the slowest and fastest of the poles found.
+// Usage: polezero_bench [count] [largest depth]
+
+#include "Circuit.h"
+#include "generators.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::max<size_t>(1, std::strtoul(argv[1], nullptr, 10)) : 10;
+    size_t largest = argc > 2 ? std::max<size_t>(2, std::strtoul(argv[2], nullptr, 10)) : 14;
+
+    struct Family { const char* name; std::function<Circuit(size_t)> make; };
+    const std::vector<Family> families = {
+        { "rc_tree", [](size_t depth) { return rcTree(depth, false); } },
+        { "rlc_tree", [](size_t depth) { return rlcTree(depth, false); } },
+    };
+
+    for (const auto& family : families) {
+        for (size_t depth = 8; depth <= largest; depth += 2) {
+            Circuit circuit = family.make(depth);
+            PoleZeroOptions options;
+            options.count = count;
+            PoleZeroResult result = circuit.poles(options);
+
+            std::cout << "{\"circuit\": \"" << family.name << "\", \"depth\": " << depth
+                      << ", \"nodes\": " << circuit.getTopology().nodeCount() << ", \"count\": " << result.poles.size()
+                      << ", \"dimension\": " << result.poleDimension << ", \"converged\": " << (result.converged ? "true" : "false")
+                      << ", \"seconds\": " << result.seconds;
+            if (!result.poles.empty()) {
+                std::cout << ", \"slowest\": [" << result.poles.front().real() << ", " << result.poles.front().imag()
+                          << "], \"fastest\": [" << result.poles.back().real() << ", " << result.poles.back().imag() << "]";
+            }
+            std::cout << "}" << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Adjoint sensitivities of V(out) against finite differences
+// The adjoint run gives dV(out) / dp for every element at once. Finite differences are timed on `samples`
+// resistors (central differences at value * (1 +- 1e-4), full solves) and scaled to the element count, their derivatives give
+// the largest relative deviation of the adjoint ones. One JSON object per circuit, DC for the meshes and
+// three AC points for the trees.
+// Usage: sensitivity_bench [mesh side] [tree depth] [samples]
+
+#include "Circuit.h"
+#include "generators.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+int main(int argc, char** argv) {
+    size_t side = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+    size_t depth = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 14;
+    size_t samples = argc > 3 ? std::max<size_t>(1, std::strtoul(argv[3], nullptr, 10)) : 8;
+    const double two_pi = 2.0 * std::acos(-1.0);
+
+    struct Family { const char* name; std::function<Circuit()> make; std::vector<double> frequencies; };
+    const std::vector<Family> families = {
+        { "mesh2d", [&] { return resistorMesh2D(side, false); }, {} },
+        { "mesh3d", [&] { return resistorMesh3D(side / 8, false); }, {} },
+        { "rc_tree", [&] { return rcTree(depth, false); }, { 1e3, 1e5, 1e7 } },
+    };
+
+    for (const auto& family : families) {
+        Circuit circuit = family.make();
+        auto out = circuit.findNode("out");
+        SensitivityResult result = circuit.sensitivity({ out }, family.frequencies, 0);
+
+        // Every k-th resistor, perturbed one at a time at the last point
+        std::vector<size_t> picked;
+        const auto& elements = circuit.getTopology().elementHandles();
+        for (size_t e = 0; e < result.elements.size() && picked.size() < samples; e += result.elements.size() / samples + 1) {
+            if (std::dynamic_pointer_cast<Resistor>(elements[result.elements[e]])) picked.push_back(e);
+        }
+        if (!family.frequencies.empty()) {
+            circuit.setAnalysisType(AnalysisType::AC);
+            circuit.setFrequency(two_pi * family.frequencies.back());
+        }
+
+        double deviation = 0;
+        auto start = std::chrono::steady_clock::now();
+        circuit.solve();
+        for (size_t e : picked) {
+            auto resistor = std::dynamic_pointer_cast<Resistor>(elements[result.elements[e]]);
+            ex value = resistor->getResistance();
+            double r = ex_to<numeric>(value).to_double(), h = r * 1e-4;
+            resistor->setResistance(r + h);
+            circuit.solve();
+            std::complex<double> upper = circuit.getSolution()[out->getIndex()];
+            resistor->setResistance(r - h);
+            circuit.solve();
+            std::complex<double> difference = (upper - circuit.getSolution()[out->getIndex()]) / (2 * h);
+            resistor->setResistance(value);
+
+            std::complex<double> adjoint = result.at(result.frequencies.size() - 1, 0, e);
+            double scale = std::max(std::abs(adjoint), std::abs(difference));
+            if (scale > 0) deviation = std::max(deviation, std::abs(adjoint - difference) / scale);
+        }
+        double per_solve = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / (2 * picked.size() + 1);
+
+        std::cout << "{\"circuit\": \"" << family.name << "\", \"unknowns\": " << circuit.getSolution().size()
+                  << ", \"elements\": " << result.elements.size() << ", \"points\": " << result.frequencies.size()
+                  << ", \"adjoint_seconds\": " << result.seconds
+                  << ", \"finite_difference_seconds\": " << per_solve * (result.elements.size() + 1) * result.frequencies.size()
+                  << ", \"checked\": " << picked.size() << ", \"max_deviation\": " << deviation << "}" << std::endl;
+    }
+    return 0;
+}
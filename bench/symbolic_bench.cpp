@@ -0,0 +1,75 @@
+// Symbolic transfer functions
+// RC ladders and cascades of unity gain Sallen-Key low pass stages, every element with its own symbol.
+// Times H(s) = V(out) / V(in) through the sparse fraction-free solver, prints the statistics and the
+// size of the result as one JSON object per circuit.
+// Usage: symbolic_bench [largest ladder sections] [largest filter stages]
+// Build: g++ -O2 -std=c++17 -I.. symbolic_bench.cpp ../*.cpp -lginac -lcln
+
+#include "Circuit.h"
+#include "SymbolicSolver.h"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+static std::shared_ptr<Node> addNode(Circuit& circuit, const std::string& name) {
+    auto node = std::make_shared<Node>(name);
+    circuit.addNode(node);
+    return node;
+}
+
+static void ladder(Circuit& circuit, size_t sections) {
+    auto ground = Node::getGround();
+    auto prev = addNode(circuit, "in");
+    ex source = symbol("Vin");
+    circuit.addComponent(std::make_shared<VoltageSource>("in", source, prev, ground));
+    for (size_t k = 1; k <= sections; k++) {
+        auto node = addNode(circuit, k == sections ? "out" : "n" + std::to_string(k));
+        circuit.addComponent(std::make_shared<Resistor>(std::to_string(k), symbol("R" + std::to_string(k)), prev, node));
+        circuit.addComponent(std::make_shared<Capacitor>(std::to_string(k), symbol("C" + std::to_string(k)), node, ground));
+        prev = node;
+    }
+}
+
+static void sallenKey(Circuit& circuit, size_t stages) {
+    auto ground = Node::getGround();
+    auto prev = addNode(circuit, "in");
+    ex source = symbol("Vin");
+    circuit.addComponent(std::make_shared<VoltageSource>("in", source, prev, ground));
+    for (size_t k = 1; k <= stages; k++) {
+        std::string id = std::to_string(k);
+        auto a = addNode(circuit, "a" + id), b = addNode(circuit, "b" + id);
+        auto out = addNode(circuit, k == stages ? "out" : "o" + id);
+        circuit.addComponent(std::make_shared<Resistor>(id + "a", symbol("Ra" + id), prev, a));
+        circuit.addComponent(std::make_shared<Resistor>(id + "b", symbol("Rb" + id), a, b));
+        circuit.addComponent(std::make_shared<Capacitor>(id + "a", symbol("Ca" + id), a, out));
+        circuit.addComponent(std::make_shared<Capacitor>(id + "b", symbol("Cb" + id), b, ground));
+        circuit.addComponent(std::make_shared<OperationalAmplifier>(id, b, out, out, ground)); // Follower
+        prev = out;
+    }
+}
+
+static void run(const char* kind, size_t size, void (*make)(Circuit&, size_t)) {
+    Circuit circuit;
+    make(circuit, size);
+
+    SymbolicStats stats;
+    ex H = circuit.transferFunction("out", "in", &stats);
+    ex num = H.numer(), den = H.denom();
+
+    std::cout << "{\"circuit\": \"" << kind << "\", \"size\": " << size << ", \"unknowns\": " << stats.unknowns
+              << ", \"entries\": " << stats.entries << ", \"pivots\": " << stats.pivots << ", \"fill\": " << stats.fill
+              << ", \"cancellations\": " << stats.cancellations << ", \"product_hits\": " << stats.productHits
+              << ", \"largest_entry\": " << stats.largestEntry << ", \"numerator_size\": " << expressionSize(num)
+              << ", \"denominator_size\": " << expressionSize(den) << ", \"denominator_degree\": " << den.degree(s)
+              << ", \"seconds\": " << stats.seconds << "}" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t sections = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 12;
+    size_t stages = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+
+    for (size_t k = 1; k <= sections; k++) run("rc_ladder", k, ladder);
+    for (size_t k = 1; k <= stages; k++) run("sallen_key", k, sallenKey);
+    return 0;
+}